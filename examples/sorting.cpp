@@ -1,12 +1,17 @@
 #include "glm/glm.hpp"
 #include "graphics/camera.h"
 #include "graphics/mesh.h"
+#include "graphics/meshoptimizer.h"
 #include "graphics/shaders.h"
 #include "graphics/shapes.h"
 #include "graphics/font.h"
 
+#include "gui/profiler_overlay.h"
+#include "gui/renderloop.h"
 #include "gui/window.h"
 
+#include "sortingrenderer.h"
+
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -93,7 +98,7 @@ Mesh createUVSphere(const ml::vec3& center, float radius, int stacks, int segmen
             const float y = xy * sinf(theta); // r * cos(u) * sin(v)
             vertices.push_back({{center.x() + x, center.y() + y, center.z() + z},
                                 col,
-                                {(short)(x * invR), (short)(y * invR), (short)(z * invR)},
+                                {glpp::packNormal(x * invR), glpp::packNormal(y * invR), glpp::packNormal(z * invR)},
                                 {static_cast<float>(segment) / static_cast<float>(segments), static_cast<float>(stack) / static_cast<float>(stacks)},
                                 (float)texSlot});
 
@@ -107,7 +112,10 @@ Mesh createUVSphere(const ml::vec3& center, float radius, int stacks, int segmen
             }
         }
     }
-    return Mesh(vertices, indices);
+    // The seam and the poles repeat positions with other texture coordinates, those are kept;
+    // the tolerance only merges what differs by rounding, then the triangles are ordered for the vertex cache
+    glpp::optimizeMesh(vertices, indices, 1e-5f);
+    return Mesh(std::move(vertices), std::move(indices));
 }
 
 
@@ -139,55 +147,9 @@ class Renderer3D: public glpp::Renderer {
         }
     }
     Renderer3D() {
-        glEnable(GL_DEPTH_TEST);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    }
-};
-
-class SortingRenderer: public glpp::Renderer {
-    std::vector<glpp::Mesh> m_meshes;
-    float                   m_height, m_width;
-
-  public:
-    explicit SortingRenderer(size_t height, size_t width, const std::vector<int>& initialArr):
-        m_height(height), m_width(width) {
-        float horizontalPosition = -2.5f;
-        float elementWidth       = m_width / initialArr.size();
-        float maxHeight          = *std::max_element(initialArr.begin(), initialArr.end());
-        //        m_meshes.push_back(plane({-2.5f, -2.5f, 0.0f}, {5.0f, 5.0f}, {1.0f, 0.0f, 0.0f}));
-        for(auto value: initialArr) {
-            float elementHeight = m_height * (value / maxHeight);
-            m_meshes.push_back(plane({horizontalPosition, -2.5f, 0.0f}, {elementWidth, elementHeight}, {1.0f, 0.0f, 0.0f}));
-            horizontalPosition += elementWidth;
-        }
-    }
-
-    void draw(const std::vector<int>& arr) {
-        //		if(arr.size() != m_meshes.size()) {
-        //		}
-        int i = 0;
-        m_meshes.clear();
-        float horizontalPosition = -2.5f;
-        float elementWidth       = m_width / arr.size();
-        float maxHeight          = *std::max_element(arr.begin(), arr.end());
-        //        m_meshes.push_back(plane({-2.5f, -2.5f, 0.0f}, {5.0f, 5.0f}, {1.0f, 0.0f, 0.0f}));
-        int j = 0;
-        auto defaultColor = rgba{1.0f, 1.0f, 1.0f, 1.0f};
-        auto selectedColor = rgba{1.0f, 0.0f, 0.0f, 1.0f};
-        for(auto value: arr) {
-            j++;
-            float elementHeight = m_height * (value / maxHeight);
-//			m_meshes[i] = plane({horizontalPosition, -2.5f, 0.0f}, {elementWidth, elementHeight}, {1.0f, 0.0f, 0.0f});
-            m_meshes.push_back(plane({horizontalPosition, -2.5f, 0.0f}, {elementWidth, elementHeight}, i == j ? selectedColor : defaultColor));
-            horizontalPosition += elementWidth;
-        }
-
-        for(Mesh& mesh: m_meshes) {
-            glpp::Renderer::draw(mesh);
-        }
-
-        //        Mesh mesh2 = plane({-0.5f,-0.5f,0.0f}, {1.0f, 1.0f}, {1.0f, 0.0f, 0.0f});
-        //        glpp::Renderer::draw(mesh2);
+        // Through the shadowed state, such that later changes aren't skipped as redundant
+        state().setDepth(DepthState::opaque());
+        state().setBlend(BlendState::alpha());
     }
 };
 
@@ -220,6 +182,12 @@ int callback(ImGuiInputTextCallbackData* data){
     std::cout << "Writing: " << data->Buf << std::endl;
 }
 
+/* The state that is sorted on the update thread, rendered by the GL thread */
+struct SortState {
+    std::vector<int> arr;
+    int              i = 1;
+};
+
 class VectorRenderer : protected Renderer {
     void draw(ml::vec2 vec){
 
@@ -257,58 +225,40 @@ int main() {
     Mesh mesh3 = plane({-0.5f, -0.5f, -0.5f}, {100.0f, 100.0f}, {1.0f, 1.0f, 1.0f});
 
     camera.back(10);
-    int i = 0;
-    bool show_demo_window = true;
-    float startTime = glfwGetTime();
-    while(window.isOpen()) {
-        window.pollEvents();
-
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-
-        window.clear({0.05f, 0.05f, 0.05f, 1.0f});
-//        window.clear({0.95f, 0.95f, 0.95f, 1.0f});
-
-
-        if(window.keyIsPressed(Key::Q) || window.keyIsPressed(Key::ESCAPE))
-            window.close();
-
-        shader.bind();
-        shader.use();
 
-        // feed inputs to dear imgui, start new frame
-//        ImGui_ImplOpenGL3_NewFrame();
-//        ImGui_ImplGlfw_NewFrame();
-//        ImGui::NewFrame();
+    // Sort on a worker thread at a fixed rate, such that a slow sorting step never stalls rendering
+    RenderLoop<SortState> loop(window, {.updateRate = 120.0, .vsync = true, .targetFps = 60.0});
+    loop.run(
+        SortState{arr, 1},
+        [](SortState& state, double) {
+            if(state.i < static_cast<int>(state.arr.size()))
+                insertion_sort(state.arr, state.i++);
+        },
+        [&](const SortState&, const SortState& current, float) {
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+
+            window.clear({0.05f, 0.05f, 0.05f, 1.0f});
+
+            shader.use();
+            model = ml::scale(0.4f);
+            shader.setUniform("scene_shaders", projection * view * model);
+
+            // The bars are discrete, so there is nothing to interpolate
+            window.draw(current.arr);
+
+            ImGui::ShowDemoWindow();
+            glpp::drawProfilerOverlay();
+            ImGui::InputTextMultiline("", "Hello", 5, {500, 1000}, ImGuiInputTextFlags_AllowTabInput, callback,nullptr);
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        },
+        [](Window& window) {
+            if(window.keyIsPressed(Key::Q) || window.keyIsPressed(Key::ESCAPE))
+                window.close();
+        });
 
-        model = ml::scale(0.4f);
-        //        model = ml::translate<float>({0.0f, -2.0f, 0.0f});
-        //		view       = camera.view();
-        //		projection = ml::ortho(0.0f, 10.0f, 0.0f, 10.0f, 0.1f, 100.0f);
-
-        shader.setUniform("scene_shaders", projection * view * model);
-        shader.use();
-//        std::cout  << "si: " << (glfwGetTime() - startTime) << ", " << startTime << ", " << i << std::endl;
-//        std::cout << "si: " << startTime << ", " << i << std::endl;
-//        startTime = glfwGetTime();
-
-        insertion_sort(arr, i);
-        // render your GUI
-//        ImGui::Begin("Demo window");
-//        ImGui::Button("Hello!");
-//        ImGui::End();
-
-        window.draw(arr);
-
-        ImGui::ShowDemoWindow();
-        ImGui::InputTextMultiline("", "Hello", 5, {500, 1000}, ImGuiInputTextFlags_AllowTabInput, callback,nullptr);
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        window.display();
-    }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
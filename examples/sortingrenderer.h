@@ -0,0 +1,68 @@
+#ifndef GLPP_SORTINGRENDERER_H
+#define GLPP_SORTINGRENDERER_H
+
+#include "graphics/mesh.h"
+#include "graphics/profiler.h"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Draws an array as bars of width / size, starting at (-2.5, -2.5)
+ * The height of a bar is its value relative to the largest value times height.
+ */
+class SortingRenderer: public glpp::Renderer {
+    // Every bar is a quad of one structure of arrays mesh, such that a frame only re-uploads the positions
+    glpp::StreamMesh m_bars;
+    float            m_height, m_width;
+
+    void build(size_t count) {
+        glpp::VertexStreams      streams;
+        std::vector<glpp::Index> indices;
+        streams.reserve(count * 4);
+        indices.reserve(count * 6);
+        float elementWidth = m_width / count;
+        auto  color        = rgba{1.0f, 1.0f, 1.0f, 1.0f};
+        for(size_t i = 0; i < count; i++) {
+            float       x     = -2.5f + elementWidth * i;
+            glpp::Index first = streams.size();
+            // The heights are set by update()
+            streams.push_back({x, -2.5f, 0.0f}, color, {0.0f, 0.0f});
+            streams.push_back({x + elementWidth, -2.5f, 0.0f}, color, {1.0f, 0.0f});
+            streams.push_back({x, -2.5f, 0.0f}, color, {0.0f, 1.0f});
+            streams.push_back({x + elementWidth, -2.5f, 0.0f}, color, {1.0f, 1.0f});
+            indices.insert(indices.end(), {first, first + 1, first + 2, first + 2, first + 1, first + 3});
+        }
+        m_bars = glpp::StreamMesh(std::move(streams), std::move(indices));
+    }
+
+    void update(const std::vector<int>& arr) {
+        if(m_bars.streams.size() != arr.size() * 4)
+            build(arr.size());
+        float maxHeight = *std::max_element(arr.begin(), arr.end());
+        for(size_t i = 0; i < arr.size(); i++) {
+            float top = -2.5f + m_height * (arr[i] / maxHeight);
+            auto  left = m_bars.streams.position(i * 4 + 2), right = m_bars.streams.position(i * 4 + 3);
+            m_bars.streams.setPosition(i * 4 + 2, {left.x(), top, left.z()});
+            m_bars.streams.setPosition(i * 4 + 3, {right.x(), top, right.z()});
+        }
+        // Only the position stream is dirty, the colors and texture coordinates stay on the GPU
+        m_bars.regenBuffers();
+    }
+
+  public:
+    explicit SortingRenderer(size_t height, size_t width, const std::vector<int>& initialArr):
+        m_height(height), m_width(width) {
+        update(initialArr);
+    }
+
+    void draw(const std::vector<int>& arr) {
+        GLPP_PROFILE("SortingRenderer::build");
+        update(arr);
+
+        GLPP_PROFILE_GPU("SortingRenderer::draw");
+        glpp::Renderer::draw(m_bars);
+    }
+};
+
+#endif //GLPP_SORTINGRENDERER_H
@@ -6,6 +6,11 @@
 // Include GLFW
 #include <GLFW/glfw3.h>
 
+// Shaders and other resources the library loads itself, set by CMake to the resources directory of the source tree
+#ifndef GLPP_RESOURCES
+#error "GLPP_RESOURCES has to be defined as the path of the resources directory, eg. by CMake"
+#endif
+
 namespace glpp {
 	using Index = GLuint;
 }
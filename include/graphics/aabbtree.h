@@ -0,0 +1,359 @@
+#ifndef AABBTREE_H
+#define AABBTREE_H
+
+#include "boundingbox.h"
+
+#include <vector>
+
+namespace glpp {
+	/**
+	 * Dynamic bounding volume hierarchy of axis aligned bounding boxes
+	 * Leaves store a "fat" box that is inflated by a margin,
+	 * such that small movements don't require the leaf to be reinserted.
+	 * The tree is kept balanced using AVL rotations on insertion and removal.
+	 * @tparam T The value stored per leaf, eg. a pointer to a Shape
+	 */
+	template<typename T>
+	class AABBTree {
+		struct Node {
+			BoundingBox box;
+			T           value{};
+			int         parent = null; // Doubles as the next free node while in the free list
+			int         left   = null;
+			int         right  = null;
+			int         height = 0;    // Leaves have a height of 0, free nodes a height of -1
+
+			inline bool leaf() const { return left == null; }
+		};
+		std::vector<Node> m_nodes;
+		int               m_root  = null;
+		int               m_free  = null;
+		size_t            m_count = 0;
+		float             m_margin;
+
+		int  allocate();
+		void release(int node);
+		void insertLeaf(int leaf);
+		void removeLeaf(int leaf);
+		int  balance(int node);
+		void refit(int node);
+
+		/* Half the perimeter, cheaper than the surface area and still meaningful for flat 2D boxes */
+		static inline float cost(const BoundingBox& box) {
+			ml::vec3 e = box.extent();
+			return e.x() + e.y() + e.z();
+		}
+
+	  public:
+		static constexpr int null = -1;
+
+		explicit AABBTree(float margin = 0.1f):
+			m_margin(margin) {}
+
+		/**
+		 * Insert a box into the tree
+		 * @return the proxy id used to update or remove the box
+		 */
+		int insert(const BoundingBox& box, T value);
+		void remove(int proxy);
+		/**
+		 * Move a proxy to a new box
+		 * @return whether the leaf had to be reinserted
+		 */
+		bool update(int proxy, const BoundingBox& box);
+		void clear();
+
+		/**
+		 * Call callback(T&) for every value whose fat box intersects box
+		 * Only the nodes overlapping box are visited.
+		 */
+		template<typename F>
+		void query(const BoundingBox& box, F&& callback);
+
+		inline T&                 value(int proxy) { return m_nodes[proxy].value; }
+		inline const BoundingBox& fatBox(int proxy) const { return m_nodes[proxy].box; }
+		inline size_t             size() const { return m_count; }
+		inline int                height() const { return m_root == null ? 0 : m_nodes[m_root].height; }
+	};
+
+	template<typename T>
+	int AABBTree<T>::allocate() {
+		if(m_free == null) {
+			m_nodes.emplace_back();
+			return static_cast<int>(m_nodes.size() - 1);
+		}
+		int node       = m_free;
+		m_free         = m_nodes[node].parent;
+		m_nodes[node]  = Node{};
+		return node;
+	}
+
+	template<typename T>
+	void AABBTree<T>::release(int node) {
+		m_nodes[node].parent = m_free;
+		m_nodes[node].height = -1;
+		m_nodes[node].value  = T{};
+		m_free               = node;
+	}
+
+	template<typename T>
+	int AABBTree<T>::insert(const BoundingBox& box, T value) {
+		int proxy              = allocate();
+		m_nodes[proxy].box     = box.inflated(m_margin);
+		m_nodes[proxy].value   = std::move(value);
+		m_nodes[proxy].height  = 0;
+		insertLeaf(proxy);
+		m_count++;
+		return proxy;
+	}
+
+	template<typename T>
+	void AABBTree<T>::remove(int proxy) {
+		removeLeaf(proxy);
+		release(proxy);
+		m_count--;
+	}
+
+	template<typename T>
+	bool AABBTree<T>::update(int proxy, const BoundingBox& box) {
+		if(m_nodes[proxy].box.contains(box))
+			return false;
+		removeLeaf(proxy);
+		m_nodes[proxy].box = box.inflated(m_margin);
+		insertLeaf(proxy);
+		return true;
+	}
+
+	template<typename T>
+	void AABBTree<T>::clear() {
+		m_nodes.clear();
+		m_root  = null;
+		m_free  = null;
+		m_count = 0;
+	}
+
+	template<typename T>
+	template<typename F>
+	void AABBTree<T>::query(const BoundingBox& box, F&& callback) {
+		if(m_root == null)
+			return;
+		// The tree is balanced, so the depth stays small
+		int stack[64];
+		int top      = 0;
+		stack[top++] = m_root;
+		while(top > 0) {
+			int   index = stack[--top];
+			Node& node  = m_nodes[index];
+			if(!node.box.intersects(box))
+				continue;
+			if(node.leaf()) {
+				callback(node.value);
+			} else {
+				stack[top++] = node.left;
+				stack[top++] = node.right;
+			}
+		}
+	}
+
+	template<typename T>
+	void AABBTree<T>::refit(int node) {
+		Node& n  = m_nodes[node];
+		n.height = 1 + std::max(m_nodes[n.left].height, m_nodes[n.right].height);
+		n.box    = BoundingBox::merge(m_nodes[n.left].box, m_nodes[n.right].box);
+	}
+
+	template<typename T>
+	void AABBTree<T>::insertLeaf(int leaf) {
+		if(m_root == null) {
+			m_root                 = leaf;
+			m_nodes[leaf].parent   = null;
+			return;
+		}
+
+		// Find the best sibling by descending the cheapest path (surface area heuristic)
+		BoundingBox leafBox = m_nodes[leaf].box;
+		int         index   = m_root;
+		while(!m_nodes[index].leaf()) {
+			const Node& node         = m_nodes[index];
+			float       area         = cost(node.box);
+			float       combinedArea = cost(BoundingBox::merge(node.box, leafBox));
+			// Cost of creating a new parent for this node and the new leaf
+			float newParentCost = 2.0f * combinedArea;
+			// Minimum cost of pushing the leaf further down the tree
+			float inheritanceCost = 2.0f * (combinedArea - area);
+
+			auto childCost = [&](int child) {
+				const Node& c = m_nodes[child];
+				float merged  = cost(BoundingBox::merge(leafBox, c.box));
+				return (c.leaf() ? merged : merged - cost(c.box)) + inheritanceCost;
+			};
+			float leftCost  = childCost(node.left);
+			float rightCost = childCost(node.right);
+
+			if(newParentCost < leftCost && newParentCost < rightCost)
+				break;
+			index = leftCost < rightCost ? node.left : node.right;
+		}
+		int sibling = index;
+
+		// Create a new parent for the sibling and the leaf
+		int oldParent                = m_nodes[sibling].parent;
+		int newParent                = allocate();
+		m_nodes[newParent].parent    = oldParent;
+		m_nodes[newParent].box       = BoundingBox::merge(leafBox, m_nodes[sibling].box);
+		m_nodes[newParent].height    = m_nodes[sibling].height + 1;
+		m_nodes[newParent].left      = sibling;
+		m_nodes[newParent].right     = leaf;
+		m_nodes[sibling].parent      = newParent;
+		m_nodes[leaf].parent         = newParent;
+
+		if(oldParent == null) {
+			m_root = newParent;
+		} else if(m_nodes[oldParent].left == sibling) {
+			m_nodes[oldParent].left = newParent;
+		} else {
+			m_nodes[oldParent].right = newParent;
+		}
+
+		// Walk back up the tree fixing heights and boxes
+		index = m_nodes[leaf].parent;
+		while(index != null) {
+			index = balance(index);
+			refit(index);
+			index = m_nodes[index].parent;
+		}
+	}
+
+	template<typename T>
+	void AABBTree<T>::removeLeaf(int leaf) {
+		if(leaf == m_root) {
+			m_root = null;
+			return;
+		}
+
+		int parent      = m_nodes[leaf].parent;
+		int grandParent = m_nodes[parent].parent;
+		int sibling     = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+		if(grandParent == null) {
+			m_root                  = sibling;
+			m_nodes[sibling].parent = null;
+			release(parent);
+			return;
+		}
+
+		// Replace the parent by the sibling
+		if(m_nodes[grandParent].left == parent) {
+			m_nodes[grandParent].left = sibling;
+		} else {
+			m_nodes[grandParent].right = sibling;
+		}
+		m_nodes[sibling].parent = grandParent;
+		release(parent);
+
+		int index = grandParent;
+		while(index != null) {
+			index = balance(index);
+			refit(index);
+			index = m_nodes[index].parent;
+		}
+	}
+
+	/**
+	 * Perform a left or right rotation if node A is imbalanced
+	 * @return the new root of the subtree
+	 */
+	template<typename T>
+	int AABBTree<T>::balance(int iA) {
+		Node& A = m_nodes[iA];
+		if(A.leaf() || A.height < 2)
+			return iA;
+
+		int   iB      = A.left;
+		int   iC      = A.right;
+		Node& B       = m_nodes[iB];
+		Node& C       = m_nodes[iC];
+		int   balance = C.height - B.height;
+
+		// Rotate C up
+		if(balance > 1) {
+			int   iF = C.left;
+			int   iG = C.right;
+			Node& F  = m_nodes[iF];
+			Node& G  = m_nodes[iG];
+
+			C.left   = iA;
+			C.parent = A.parent;
+			A.parent = iC;
+
+			if(C.parent == null) {
+				m_root = iC;
+			} else if(m_nodes[C.parent].left == iA) {
+				m_nodes[C.parent].left = iC;
+			} else {
+				m_nodes[C.parent].right = iC;
+			}
+
+			if(F.height > G.height) {
+				C.right  = iF;
+				A.right  = iG;
+				G.parent = iA;
+				A.box    = BoundingBox::merge(B.box, G.box);
+				C.box    = BoundingBox::merge(A.box, F.box);
+				A.height = 1 + std::max(B.height, G.height);
+				C.height = 1 + std::max(A.height, F.height);
+			} else {
+				C.right  = iG;
+				A.right  = iF;
+				F.parent = iA;
+				A.box    = BoundingBox::merge(B.box, F.box);
+				C.box    = BoundingBox::merge(A.box, G.box);
+				A.height = 1 + std::max(B.height, F.height);
+				C.height = 1 + std::max(A.height, G.height);
+			}
+			return iC;
+		}
+
+		// Rotate B up
+		if(balance < -1) {
+			int   iD = B.left;
+			int   iE = B.right;
+			Node& D  = m_nodes[iD];
+			Node& E  = m_nodes[iE];
+
+			B.left   = iA;
+			B.parent = A.parent;
+			A.parent = iB;
+
+			if(B.parent == null) {
+				m_root = iB;
+			} else if(m_nodes[B.parent].left == iA) {
+				m_nodes[B.parent].left = iB;
+			} else {
+				m_nodes[B.parent].right = iB;
+			}
+
+			if(D.height > E.height) {
+				B.right  = iD;
+				A.left   = iE;
+				E.parent = iA;
+				A.box    = BoundingBox::merge(C.box, E.box);
+				B.box    = BoundingBox::merge(A.box, D.box);
+				A.height = 1 + std::max(C.height, E.height);
+				B.height = 1 + std::max(A.height, D.height);
+			} else {
+				B.right  = iE;
+				A.left   = iD;
+				D.parent = iA;
+				A.box    = BoundingBox::merge(C.box, D.box);
+				B.box    = BoundingBox::merge(A.box, E.box);
+				A.height = 1 + std::max(C.height, D.height);
+				B.height = 1 + std::max(A.height, E.height);
+			}
+			return iB;
+		}
+		return iA;
+	}
+}
+
+#endif //AABBTREE_H
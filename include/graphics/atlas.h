@@ -0,0 +1,276 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "debug.h"
+#include "ml/ml.h"
+#include "renderstate.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace glpp {
+	struct AtlasRect {
+		int x, y, width, height;
+	};
+
+	/**
+	 * Packs rectangles into a fixed area with the bottom-left skyline heuristic
+	 * The skyline is the top edge of everything packed so far, a rectangle is put where its top ends up lowest.
+	 * Rectangles can't be freed individually, clear() frees all of them.
+	 */
+	class SkylinePacker {
+		struct Node {
+			int x, y, width;
+		};
+		int               m_width, m_height;
+		std::vector<Node> m_skyline;
+		size_t            m_usedArea = 0;
+
+		/* The y at which a rectangle starting at node i rests, or -1 if it doesn't fit there */
+		int fit(size_t i, int width, int height) const {
+			if(m_skyline[i].x + width > m_width)
+				return -1;
+			int y = m_skyline[i].y;
+			for(int left = width; left > 0; left -= m_skyline[i++].width) {
+				y = std::max(y, m_skyline[i].y);
+				if(y + height > m_height)
+					return -1;
+			}
+			return y;
+		}
+
+	  public:
+		SkylinePacker(int width, int height): m_width(width), m_height(height) { clear(); }
+
+		void clear() {
+			m_skyline.assign(1, {0, 0, m_width});
+			m_usedArea = 0;
+		}
+
+		std::optional<AtlasRect> pack(int width, int height) {
+			if(width <= 0 || height <= 0)
+				return std::nullopt;
+			size_t best = m_skyline.size();
+			int    bestTop = std::numeric_limits<int>::max(), bestWidth = 0, bestY = 0;
+			for(size_t i = 0; i < m_skyline.size(); i++) {
+				int y = fit(i, width, height);
+				if(y >= 0 && (y + height < bestTop || (y + height == bestTop && m_skyline[i].width < bestWidth))) {
+					best      = i;
+					bestTop   = y + height;
+					bestWidth = m_skyline[i].width;
+					bestY     = y;
+				}
+			}
+			if(best == m_skyline.size())
+				return std::nullopt;
+
+			const AtlasRect rect{m_skyline[best].x, bestY, width, height};
+			m_skyline.insert(m_skyline.begin() + static_cast<std::ptrdiff_t>(best), {rect.x, bestTop, width});
+			// Cut the nodes now covered by the new one
+			for(size_t i = best + 1; i < m_skyline.size();) {
+				const int covered = m_skyline[i - 1].x + m_skyline[i - 1].width - m_skyline[i].x;
+				if(covered <= 0)
+					break;
+				if(covered < m_skyline[i].width) {
+					m_skyline[i].x += covered;
+					m_skyline[i].width -= covered;
+					break;
+				}
+				m_skyline.erase(m_skyline.begin() + static_cast<std::ptrdiff_t>(i));
+			}
+			// Merge neighbours at the same height
+			for(size_t i = 0; i + 1 < m_skyline.size();) {
+				if(m_skyline[i].y == m_skyline[i + 1].y) {
+					m_skyline[i].width += m_skyline[i + 1].width;
+					m_skyline.erase(m_skyline.begin() + static_cast<std::ptrdiff_t>(i + 1));
+				} else {
+					i++;
+				}
+			}
+			m_usedArea += size_t(width) * size_t(height);
+			return rect;
+		}
+
+		inline int width() const { return m_width; }
+		inline int height() const { return m_height; }
+		/* Fraction of the area covered by packed rectangles */
+		inline float occupancy() const { return static_cast<float>(m_usedArea) / (static_cast<float>(m_width) * static_cast<float>(m_height)); }
+	};
+
+	/* Where an image lives in a TextureAtlas, uv is the normalized rectangle (u0, v0, u1, v1) within the layer */
+	struct AtlasEntry {
+		int       layer;
+		AtlasRect rect;
+		ml::vec4  uv;
+	};
+
+	/**
+	 * Packs many small images into the layers of one GL_TEXTURE_2D_ARRAY
+	 * Everything drawn from the atlas binds the same texture, meshes select an image by its layer
+	 * (eg. Vertex::textureSlot) and uv, so batches never break on a texture switch.
+	 * When no layer has space the least recently used layer is evicted as a whole, images used in the
+	 * current frame (see beginFrame()) are never evicted.
+	 */
+	class TextureAtlas {
+		struct Page {
+			SkylinePacker         packer;
+			uint64_t              lastUse = 0;
+			std::vector<uint64_t> keys;
+		};
+
+		unsigned int                             m_texture{};
+		GLenum                                   m_internalFormat, m_format;
+		int                                      m_size, m_padding;
+		std::vector<Page>                        m_pages;
+		std::unordered_map<uint64_t, AtlasEntry> m_entries;
+		uint64_t                                 m_frame = 1;
+		std::function<void(uint64_t key)>        m_onEvict;
+		std::vector<unsigned char>               m_padded; // an image with its edges extruded into the padding
+
+		std::optional<AtlasEntry> place(int layer, uint64_t key, int width, int height, const void* pixels);
+		void                      evict(Page& page);
+
+	  public:
+		/**
+		 * @param size width and height of every layer in pixels
+		 * @param layers amount of layers, clamped to GL_MAX_ARRAY_TEXTURE_LAYERS
+		 * @param internalFormat eg. GL_RGBA8 for sprites, GL_R8 for glyphs
+		 * @param padding pixels around every image that repeat its edge, such that filtering neither bleeds into
+		 *                its neighbours nor samples what an evicted image left there
+		 */
+		TextureAtlas(int size = 2048, int layers = 4, GLenum internalFormat = GL_RGBA8, int padding = 1);
+		~TextureAtlas() {
+			RenderState::current().deletedTexture(m_texture);
+			glDeleteTextures(1, &m_texture);
+		}
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+		/* Called with the key of every evicted image, eg. to drop cached lookups */
+		inline void setEvictionCallback(std::function<void(uint64_t key)> onEvict) { m_onEvict = std::move(onEvict); }
+
+		/* Start a new frame, images looked up or added from now on are kept for this frame */
+		inline void beginFrame() { m_frame++; }
+
+		/* The image stored under key, marked as used in this frame */
+		const AtlasEntry* find(uint64_t key) {
+			auto it = m_entries.find(key);
+			if(it == m_entries.end())
+				return nullptr;
+			m_pages[static_cast<size_t>(it->second.layer)].lastUse = m_frame;
+			return &it->second;
+		}
+
+		/* Mark a layer as used in this frame, for callers that keep entries themselves instead of calling find() */
+		inline void touch(int layer) { m_pages[static_cast<size_t>(layer)].lastUse = m_frame; }
+
+		/**
+		 * Upload a tightly packed image in the format of the atlas and store it under key
+		 * @return nullopt if the image is larger than a layer, or every layer is in use this frame
+		 */
+		std::optional<AtlasEntry> add(uint64_t key, int width, int height, const void* pixels);
+
+		void bind(unsigned int slot = 0) const { RenderState::current().bindTexture(slot, GL_TEXTURE_2D_ARRAY, m_texture); }
+
+		inline unsigned int id() const { return m_texture; }
+		inline int          size() const { return m_size; }
+		inline int          layers() const { return static_cast<int>(m_pages.size()); }
+		inline size_t       entries() const { return m_entries.size(); }
+	};
+
+	TextureAtlas::TextureAtlas(int size, int layers, GLenum internalFormat, int padding):
+		m_internalFormat(internalFormat), m_format(internalFormat == GL_R8 ? GL_RED : internalFormat == GL_RG8 ? GL_RG : GL_RGBA),
+		m_size(size), m_padding(padding) {
+		GLint maxLayers = 0;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+		layers = std::clamp(layers, 1, std::max(maxLayers, 1));
+		m_pages.assign(static_cast<size_t>(layers), Page{SkylinePacker(size, size)});
+
+		glGenTextures(1, &m_texture);
+		bind();
+		glASSERT(glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, m_internalFormat, size, size, layers));
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	std::optional<AtlasEntry> TextureAtlas::place(int layer, uint64_t key, int width, int height, const void* pixels) {
+		Page& page = m_pages[static_cast<size_t>(layer)];
+		auto  rect = page.packer.pack(width + 2 * m_padding, height + 2 * m_padding);
+		if(!rect)
+			return std::nullopt;
+
+		const AtlasRect  image{rect->x + m_padding, rect->y + m_padding, width, height};
+		const float      size = static_cast<float>(m_size);
+		const AtlasEntry entry{layer, image,
+							   ml::vec4(static_cast<float>(image.x) / size, static_cast<float>(image.y) / size,
+										static_cast<float>(image.x + width) / size, static_cast<float>(image.y + height) / size)};
+		bind();
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if(m_padding == 0 || width == 0 || height == 0) {
+			glASSERT(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, image.x, image.y, layer, width, height, 1, m_format, GL_UNSIGNED_BYTE, pixels));
+		} else {
+			// The padding is uploaded with the image, otherwise it keeps whatever was placed there before eviction
+			const size_t texel = m_format == GL_RED ? 1 : m_format == GL_RG ? 2 : 4;
+			const auto*  source = static_cast<const unsigned char*>(pixels);
+			m_padded.resize(size_t(rect->width) * rect->height * texel);
+			for(int y = 0; y < rect->height; y++) {
+				const int row = std::clamp(y - m_padding, 0, height - 1);
+				for(int x = 0; x < rect->width; x++) {
+					const int column = std::clamp(x - m_padding, 0, width - 1);
+					std::memcpy(&m_padded[(size_t(y) * rect->width + x) * texel], source + (size_t(row) * width + column) * texel, texel);
+				}
+			}
+			glASSERT(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, rect->x, rect->y, layer, rect->width, rect->height, 1, m_format, GL_UNSIGNED_BYTE,
+									 m_padded.data()));
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		page.keys.push_back(key);
+		page.lastUse   = m_frame;
+		m_entries[key] = entry;
+		return entry;
+	}
+
+	void TextureAtlas::evict(Page& page) {
+		for(uint64_t key: page.keys) {
+			m_entries.erase(key);
+			if(m_onEvict)
+				m_onEvict(key);
+		}
+		page.keys.clear();
+		page.packer.clear();
+		page.lastUse = 0;
+	}
+
+	std::optional<AtlasEntry> TextureAtlas::add(uint64_t key, int width, int height, const void* pixels) {
+		if(width + 2 * m_padding > m_size || height + 2 * m_padding > m_size)
+			return std::nullopt;
+		if(auto it = m_entries.find(key); it != m_entries.end()) {
+			// Replace the image, its old area stays unused until the layer is evicted
+			auto& keys = m_pages[static_cast<size_t>(it->second.layer)].keys;
+			keys.erase(std::find(keys.begin(), keys.end(), key));
+			m_entries.erase(it);
+		}
+
+		for(int layer = 0; layer < layers(); layer++) {
+			if(auto entry = place(layer, key, width, height, pixels))
+				return entry;
+		}
+		// Every layer is full, reuse the least recently used one unless it is needed this frame
+		auto lru = std::min_element(m_pages.begin(), m_pages.end(), [](const Page& lhs, const Page& rhs) { return lhs.lastUse < rhs.lastUse; });
+		if(lru->lastUse == m_frame)
+			return std::nullopt;
+		evict(*lru);
+		return place(static_cast<int>(lru - m_pages.begin()), key, width, height, pixels);
+	}
+}
+
+#endif //ATLAS_H
@@ -0,0 +1,509 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace glpp {
+	/* GPU block compressed formats, every 4x4 block of pixels takes a fixed amount of bytes */
+	enum class BlockFormat : uint32_t {
+		BC1, // RGB in 8 bytes, for opaque color maps
+		BC3, // RGBA in 16 bytes, a BC4 block for the alpha followed by a BC1 block
+		BC4, // R in 8 bytes, eg. roughness or height
+		BC5, // RG in 16 bytes, two BC4 blocks, for normal maps
+		BC7  // RGBA in 16 bytes, the highest quality
+	};
+
+	/**
+	 * Encoders and decoders of single blocks and whole images, pixels are always RGBA8
+	 * The encoders fit the endpoints to the principal axis of the colors of a block, which is fast enough to
+	 * run at build time over all mipmaps, but not the exhaustive search of dedicated compressors.
+	 * BC7 is written in mode 6, a single line through RGBA with 16 levels, or in mode 5, separate lines through RGB and
+	 * alpha with 4 levels each, whichever decodes closer; decodeBlock() only reads these two modes. Neither partitions
+	 * a block, so blocks of several unrelated colors lose more than with dedicated compressors.
+	 */
+	namespace BlockCompression {
+		using Pixels = std::array<uint8_t, 64>; // 4x4 RGBA, row by row
+
+		constexpr size_t blockBytes(BlockFormat format) { return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16; }
+		constexpr size_t compressedSize(BlockFormat format, int width, int height) {
+			return size_t((width + 3) / 4) * size_t((height + 3) / 4) * blockBytes(format);
+		}
+		/* Format for an image loaded with the given amount of channels, BC7 if it has alpha (grey + alpha or RGBA) */
+		constexpr BlockFormat defaultFormat(int channels) {
+			return channels == 2 || channels == 4 ? BlockFormat::BC7 : BlockFormat::BC1;
+		}
+
+		/* Least significant bit first, the order of all BC formats */
+		class BitWriter {
+			uint8_t* m_data;
+			size_t   m_bit = 0;
+
+		  public:
+			explicit BitWriter(uint8_t* data, size_t bytes): m_data(data) { std::memset(data, 0, bytes); }
+			void write(uint32_t value, size_t bits) {
+				for(size_t i = 0; i < bits; i++, m_bit++)
+					m_data[m_bit / 8] |= uint8_t(((value >> i) & 1) << (m_bit % 8));
+			}
+		};
+		class BitReader {
+			const uint8_t* m_data;
+			size_t         m_bit = 0;
+
+		  public:
+			explicit BitReader(const uint8_t* data): m_data(data) {}
+			uint32_t read(size_t bits) {
+				uint32_t value = 0;
+				for(size_t i = 0; i < bits; i++, m_bit++)
+					value |= uint32_t((m_data[m_bit / 8] >> (m_bit % 8)) & 1) << i;
+				return value;
+			}
+		};
+
+		/**
+		 * Endpoints of the line through the first channels of the pixels along which they vary most
+		 * The axis is found by power iteration on the covariance, the endpoints are the extreme projections.
+		 */
+		template<size_t Channels>
+		void fitLine(const Pixels& pixels, std::array<float, Channels>& from, std::array<float, Channels>& to) {
+			std::array<float, Channels> mean{};
+			for(size_t p = 0; p < 16; p++)
+				for(size_t c = 0; c < Channels; c++)
+					mean[c] += pixels[p * 4 + c] / 16.0f;
+			float covariance[Channels][Channels]{};
+			for(size_t p = 0; p < 16; p++)
+				for(size_t i = 0; i < Channels; i++)
+					for(size_t j = 0; j < Channels; j++)
+						covariance[i][j] += (pixels[p * 4 + i] - mean[i]) * (pixels[p * 4 + j] - mean[j]);
+
+			std::array<float, Channels> axis;
+			axis.fill(1.0f);
+			for(int iteration = 0; iteration < 8; iteration++) {
+				std::array<float, Channels> next{};
+				float                       length = 0.0f;
+				for(size_t i = 0; i < Channels; i++) {
+					for(size_t j = 0; j < Channels; j++)
+						next[i] += covariance[i][j] * axis[j];
+					length = std::max(length, std::abs(next[i]));
+				}
+				if(length == 0.0f)
+					break; // a single color, any axis works
+				for(size_t i = 0; i < Channels; i++)
+					axis[i] = next[i] / length;
+			}
+
+			float minimum = std::numeric_limits<float>::max(), maximum = std::numeric_limits<float>::lowest(), norm = 0.0f;
+			for(float value: axis)
+				norm += value * value;
+			for(size_t p = 0; p < 16; p++) {
+				float t = 0.0f;
+				for(size_t c = 0; c < Channels; c++)
+					t += (pixels[p * 4 + c] - mean[c]) * axis[c];
+				minimum = std::min(minimum, t / norm);
+				maximum = std::max(maximum, t / norm);
+			}
+			for(size_t c = 0; c < Channels; c++) {
+				from[c] = std::clamp(mean[c] + axis[c] * minimum, 0.0f, 255.0f);
+				to[c]   = std::clamp(mean[c] + axis[c] * maximum, 0.0f, 255.0f);
+			}
+		}
+
+		inline uint16_t packRgb565(const std::array<float, 3>& color) {
+			return uint16_t(std::lround(color[0] * 31.0f / 255.0f) << 11 | std::lround(color[1] * 63.0f / 255.0f) << 5 |
+							std::lround(color[2] * 31.0f / 255.0f));
+		}
+		inline std::array<int, 3> unpackRgb565(uint16_t color) {
+			const int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+			return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2};
+		}
+
+		/* 4 color BC1 block, the color half of BC3 as well */
+		inline void encodeBC1(const Pixels& pixels, uint8_t* block) {
+			std::array<float, 3> from, to;
+			fitLine<3>(pixels, from, to);
+			uint16_t color0 = packRgb565(to), color1 = packRgb565(from);
+			if(color0 < color1)
+				std::swap(color0, color1);
+			std::array<std::array<int, 3>, 4> palette;
+			palette[0] = unpackRgb565(color0);
+			palette[1] = unpackRgb565(color1);
+			for(size_t c = 0; c < 3; c++) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			uint32_t indices = 0;
+			// Equal endpoints select the 3 color mode, where index 0 is still the only color
+			if(color0 != color1) {
+				for(size_t p = 0; p < 16; p++) {
+					int best = 0, bestError = std::numeric_limits<int>::max();
+					for(int i = 0; i < 4; i++) {
+						int error = 0;
+						for(size_t c = 0; c < 3; c++)
+							error += (pixels[p * 4 + c] - palette[i][c]) * (pixels[p * 4 + c] - palette[i][c]);
+						if(error < bestError) {
+							best      = i;
+							bestError = error;
+						}
+					}
+					indices |= uint32_t(best) << (p * 2);
+				}
+			}
+			std::memcpy(block, &color0, 2);
+			std::memcpy(block + 2, &color1, 2);
+			std::memcpy(block + 4, &indices, 4);
+		}
+		inline void decodeBC1(const uint8_t* block, Pixels& pixels) {
+			uint16_t color0, color1;
+			uint32_t indices;
+			std::memcpy(&color0, block, 2);
+			std::memcpy(&color1, block + 2, 2);
+			std::memcpy(&indices, block + 4, 4);
+			std::array<std::array<int, 4>, 4> palette{};
+			const auto                        first = unpackRgb565(color0), second = unpackRgb565(color1);
+			for(size_t c = 0; c < 3; c++) {
+				palette[0][c] = first[c];
+				palette[1][c] = second[c];
+				palette[2][c] = color0 > color1 ? (2 * first[c] + second[c]) / 3 : (first[c] + second[c]) / 2;
+				palette[3][c] = color0 > color1 ? (first[c] + 2 * second[c]) / 3 : 0;
+			}
+			for(size_t i = 0; i < 4; i++)
+				palette[i][3] = color0 <= color1 && i == 3 ? 0 : 255;
+			for(size_t p = 0; p < 16; p++)
+				for(size_t c = 0; c < 4; c++)
+					pixels[p * 4 + c] = uint8_t(palette[(indices >> (p * 2)) & 3][c]);
+		}
+
+		/* 8 level BC4 block of a single channel, the alpha half of BC3 and both halves of BC5 */
+		inline void encodeBC4(const Pixels& pixels, size_t channel, uint8_t* block) {
+			int low = 255, high = 0;
+			for(size_t p = 0; p < 16; p++) {
+				low  = std::min<int>(low, pixels[p * 4 + channel]);
+				high = std::max<int>(high, pixels[p * 4 + channel]);
+			}
+			BitWriter writer(block, 8);
+			writer.write(uint32_t(high), 8);
+			writer.write(uint32_t(low), 8);
+			for(size_t p = 0; p < 16; p++) {
+				// Steps from high to low, 0 and 7 are the endpoints, which have the codes 0 and 1
+				const int step = high == low ? 0 : int(std::lround(float(high - pixels[p * 4 + channel]) * 7.0f / float(high - low)));
+				writer.write(uint32_t(step == 0 ? 0 : step == 7 ? 1 : step + 1), 3);
+			}
+		}
+		inline void decodeBC4(const uint8_t* block, size_t channel, Pixels& pixels) {
+			BitReader reader(block);
+			const int first = int(reader.read(8)), second = int(reader.read(8));
+			int       palette[8] = {first, second};
+			for(int i = 2; i < 8; i++) {
+				if(first > second)
+					palette[i] = ((8 - i) * first + (i - 1) * second) / 7;
+				else
+					palette[i] = i < 6 ? ((6 - i) * first + (i - 1) * second) / 5 : i == 6 ? 0 : 255;
+			}
+			for(size_t p = 0; p < 16; p++)
+				pixels[p * 4 + channel] = uint8_t(palette[reader.read(3)]);
+		}
+
+		/* BC7 mode 6: 7 bit RGBA endpoints with a shared lowest bit each, and 4 bit indices */
+		inline void encodeBC7Mode6(const Pixels& pixels, uint8_t* block) {
+			static constexpr int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+			std::array<float, 4> line[2];
+			fitLine<4>(pixels, line[0], line[1]);
+
+			// Quantize every endpoint with both values of its lowest bit, keeping the closer one
+			std::array<uint32_t, 4> quantized[2];
+			uint32_t                parity[2];
+			std::array<int, 4>      endpoints[2];
+			for(size_t e = 0; e < 2; e++) {
+				float bestError = std::numeric_limits<float>::max();
+				for(uint32_t p = 0; p < 2; p++) {
+					std::array<uint32_t, 4> values;
+					float                   error = 0.0f;
+					for(size_t c = 0; c < 4; c++) {
+						values[c]        = uint32_t(std::clamp<long>(std::lround((line[e][c] - float(p)) / 2.0f), 0, 127));
+						const float diff = float(values[c] << 1 | p) - line[e][c];
+						error += diff * diff;
+					}
+					if(error < bestError) {
+						bestError   = error;
+						quantized[e] = values;
+						parity[e]   = p;
+					}
+				}
+				for(size_t c = 0; c < 4; c++)
+					endpoints[e][c] = int(quantized[e][c] << 1 | parity[e]);
+			}
+
+			uint32_t indices[16];
+			for(size_t p = 0; p < 16; p++) {
+				int bestError = std::numeric_limits<int>::max();
+				for(uint32_t i = 0; i < 16; i++) {
+					int error = 0;
+					for(size_t c = 0; c < 4; c++) {
+						const int value = ((64 - weights[i]) * endpoints[0][c] + weights[i] * endpoints[1][c] + 32) >> 6;
+						error += (pixels[p * 4 + c] - value) * (pixels[p * 4 + c] - value);
+					}
+					if(error < bestError) {
+						bestError  = error;
+						indices[p] = i;
+					}
+				}
+			}
+			// The highest bit of the first index is implied to be 0, so swap the endpoints if it's set
+			if(indices[0] >= 8) {
+				std::swap(quantized[0], quantized[1]);
+				std::swap(parity[0], parity[1]);
+				for(uint32_t& index: indices)
+					index = 15 - index;
+			}
+
+			BitWriter writer(block, 16);
+			writer.write(1 << 6, 7);
+			for(size_t c = 0; c < 4; c++) {
+				writer.write(quantized[0][c], 7);
+				writer.write(quantized[1][c], 7);
+			}
+			writer.write(parity[0], 1);
+			writer.write(parity[1], 1);
+			for(size_t p = 0; p < 16; p++)
+				writer.write(indices[p], p == 0 ? 3 : 4);
+		}
+		/**
+		 * BC7 mode 5: 7 bit RGB and 8 bit alpha endpoints with 2 bit indices each
+		 * Alpha gets its own line, so it is kept for blocks where it doesn't follow the color, eg. cutouts over a gradient.
+		 */
+		inline void encodeBC7Mode5(const Pixels& pixels, uint8_t* block) {
+			static constexpr int weights[4] = {0, 21, 43, 64};
+			std::array<float, 3> line[2];
+			fitLine<3>(pixels, line[0], line[1]);
+			uint32_t color[2][3], alpha[2] = {255, 0};
+			int      expanded[2][4];
+			for(size_t e = 0; e < 2; e++) {
+				for(size_t c = 0; c < 3; c++) {
+					color[e][c]    = uint32_t(std::clamp<long>(std::lround(line[e][c] * 127.0f / 255.0f), 0, 127));
+					expanded[e][c] = int(color[e][c] << 1 | color[e][c] >> 6);
+				}
+			}
+			for(size_t p = 0; p < 16; p++) {
+				alpha[0] = std::min<uint32_t>(alpha[0], pixels[p * 4 + 3]);
+				alpha[1] = std::max<uint32_t>(alpha[1], pixels[p * 4 + 3]);
+			}
+			expanded[0][3] = int(alpha[0]);
+			expanded[1][3] = int(alpha[1]);
+
+			// The closest of the 4 levels, over the color channels and over alpha separately
+			uint32_t colorIndices[16], alphaIndices[16];
+			for(size_t p = 0; p < 16; p++) {
+				int colorError = std::numeric_limits<int>::max(), alphaError = std::numeric_limits<int>::max();
+				for(uint32_t i = 0; i < 4; i++) {
+					int error = 0;
+					for(size_t c = 0; c < 4; c++) {
+						const int value = ((64 - weights[i]) * expanded[0][c] + weights[i] * expanded[1][c] + 32) >> 6;
+						const int diff  = (pixels[p * 4 + c] - value) * (pixels[p * 4 + c] - value);
+						if(c < 3) {
+							error += diff;
+						} else if(diff < alphaError) {
+							alphaError      = diff;
+							alphaIndices[p] = i;
+						}
+					}
+					if(error < colorError) {
+						colorError      = error;
+						colorIndices[p] = i;
+					}
+				}
+			}
+			// The highest bit of both first indices is implied to be 0
+			if(colorIndices[0] >= 2) {
+				std::swap(color[0], color[1]);
+				for(uint32_t& index: colorIndices)
+					index = 3 - index;
+			}
+			if(alphaIndices[0] >= 2) {
+				std::swap(alpha[0], alpha[1]);
+				for(uint32_t& index: alphaIndices)
+					index = 3 - index;
+			}
+
+			BitWriter writer(block, 16);
+			writer.write(1 << 5, 6);
+			writer.write(0, 2); // no channel rotation
+			for(size_t c = 0; c < 3; c++) {
+				writer.write(color[0][c], 7);
+				writer.write(color[1][c], 7);
+			}
+			writer.write(alpha[0], 8);
+			writer.write(alpha[1], 8);
+			for(size_t p = 0; p < 16; p++)
+				writer.write(colorIndices[p], p == 0 ? 1 : 2);
+			for(size_t p = 0; p < 16; p++)
+				writer.write(alphaIndices[p], p == 0 ? 1 : 2);
+		}
+
+		inline bool decodeBC7Mode6(const uint8_t* block, Pixels& pixels) {
+			static constexpr int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+			BitReader            reader(block);
+			reader.read(7);
+			int endpoints[2][4];
+			for(size_t c = 0; c < 4; c++) {
+				endpoints[0][c] = int(reader.read(7)) << 1;
+				endpoints[1][c] = int(reader.read(7)) << 1;
+			}
+			for(auto& endpoint: endpoints) {
+				const int parity = int(reader.read(1));
+				for(int& value: endpoint)
+					value |= parity;
+			}
+			for(size_t p = 0; p < 16; p++) {
+				const int weight = weights[reader.read(p == 0 ? 3 : 4)];
+				for(size_t c = 0; c < 4; c++)
+					pixels[p * 4 + c] = uint8_t(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+			}
+			return true;
+		}
+		inline bool decodeBC7Mode5(const uint8_t* block, Pixels& pixels) {
+			static constexpr int weights[4] = {0, 21, 43, 64};
+			BitReader            reader(block);
+			reader.read(6);
+			const uint32_t rotation = reader.read(2);
+			int            endpoints[2][4];
+			for(size_t c = 0; c < 3; c++) {
+				for(auto& endpoint: endpoints) {
+					const int value = int(reader.read(7));
+					endpoint[c]     = value << 1 | value >> 6;
+				}
+			}
+			endpoints[0][3] = int(reader.read(8));
+			endpoints[1][3] = int(reader.read(8));
+			for(size_t p = 0; p < 16; p++) {
+				const int weight = weights[reader.read(p == 0 ? 1 : 2)];
+				for(size_t c = 0; c < 3; c++)
+					pixels[p * 4 + c] = uint8_t(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+			}
+			for(size_t p = 0; p < 16; p++) {
+				const int weight  = weights[reader.read(p == 0 ? 1 : 2)];
+				pixels[p * 4 + 3] = uint8_t(((64 - weight) * endpoints[0][3] + weight * endpoints[1][3] + 32) >> 6);
+			}
+			// Rotation 1 to 3 stored red, green or blue in the alpha line
+			if(rotation > 0)
+				for(size_t p = 0; p < 16; p++)
+					std::swap(pixels[p * 4 + rotation - 1], pixels[p * 4 + 3]);
+			return true;
+		}
+		/* @return false for blocks in other modes than 5 and 6, which are left untouched */
+		inline bool decodeBC7(const uint8_t* block, Pixels& pixels) {
+			// The mode is the amount of zero bits before the first set bit
+			switch(std::countr_zero(block[0])) {
+				case 5: return decodeBC7Mode5(block, pixels);
+				case 6: return decodeBC7Mode6(block, pixels);
+				default: return false;
+			}
+		}
+
+		/* Encode in both modes and keep the one that decodes closer to the pixels */
+		inline void encodeBC7(const Pixels& pixels, uint8_t* block) {
+			auto error = [&pixels](const uint8_t* candidate) {
+				Pixels decoded;
+				decodeBC7(candidate, decoded);
+				int sum = 0;
+				for(size_t i = 0; i < pixels.size(); i++)
+					sum += (int(pixels[i]) - int(decoded[i])) * (int(pixels[i]) - int(decoded[i]));
+				return sum;
+			};
+			uint8_t mode5[16];
+			encodeBC7Mode6(pixels, block);
+			encodeBC7Mode5(pixels, mode5);
+			if(error(mode5) < error(block))
+				std::memcpy(block, mode5, sizeof(mode5));
+		}
+
+		/* Encode one block of 4x4 pixels into blockBytes(format) bytes */
+		inline void encodeBlock(BlockFormat format, const Pixels& pixels, uint8_t* block) {
+			switch(format) {
+				case BlockFormat::BC1: encodeBC1(pixels, block); break;
+				case BlockFormat::BC3:
+					encodeBC4(pixels, 3, block);
+					encodeBC1(pixels, block + 8);
+					break;
+				case BlockFormat::BC4: encodeBC4(pixels, 0, block); break;
+				case BlockFormat::BC5:
+					encodeBC4(pixels, 0, block);
+					encodeBC4(pixels, 1, block + 8);
+					break;
+				case BlockFormat::BC7: encodeBC7(pixels, block); break;
+			}
+		}
+		/* Decode a block written by encodeBlock(), channels that the format doesn't store are 0, alpha 255 */
+		inline void decodeBlock(BlockFormat format, const uint8_t* block, Pixels& pixels) {
+			pixels.fill(0);
+			for(size_t p = 0; p < 16; p++)
+				pixels[p * 4 + 3] = 255;
+			switch(format) {
+				case BlockFormat::BC1: decodeBC1(block, pixels); break;
+				case BlockFormat::BC3:
+					decodeBC1(block + 8, pixels);
+					decodeBC4(block, 3, pixels);
+					break;
+				case BlockFormat::BC4: decodeBC4(block, 0, pixels); break;
+				case BlockFormat::BC5:
+					decodeBC4(block, 0, pixels);
+					decodeBC4(block + 8, 1, pixels);
+					break;
+				case BlockFormat::BC7: decodeBC7(block, pixels); break;
+			}
+		}
+
+		/**
+		 * Compress an RGBA8 image, rows of blocks are encoded in parallel
+		 * Blocks over the edge of images that aren't a multiple of 4 repeat the last row and column.
+		 */
+		std::vector<uint8_t> compress(BlockFormat format, const uint8_t* rgba, int width, int height, ThreadPool& pool = ThreadPool::global()) {
+			const int            columns = (width + 3) / 4, rows = (height + 3) / 4;
+			const size_t         bytes   = blockBytes(format);
+			std::vector<uint8_t> data(compressedSize(format, width, height));
+			pool.parallelFor(
+				size_t(rows),
+				[&](size_t begin, size_t end) {
+					Pixels pixels;
+					for(size_t row = begin; row < end; row++) {
+						for(int column = 0; column < columns; column++) {
+							for(int p = 0; p < 16; p++) {
+								const int x = std::min(column * 4 + p % 4, width - 1), y = std::min(int(row) * 4 + p / 4, height - 1);
+								std::memcpy(&pixels[size_t(p) * 4], rgba + (size_t(y) * size_t(width) + size_t(x)) * 4, 4);
+							}
+							encodeBlock(format, pixels, data.data() + (row * size_t(columns) + size_t(column)) * bytes);
+						}
+					}
+				},
+				8);
+			return data;
+		}
+
+		/* The next mipmap of an RGBA8 image, each pixel averages up to 2x2 pixels of the level above */
+		std::vector<uint8_t> downsample(const uint8_t* rgba, int width, int height) {
+			const int            halfWidth = std::max(width / 2, 1), halfHeight = std::max(height / 2, 1);
+			std::vector<uint8_t> half(size_t(halfWidth) * size_t(halfHeight) * 4);
+			for(int y = 0; y < halfHeight; y++) {
+				for(int x = 0; x < halfWidth; x++) {
+					const int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+					const int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+					for(size_t c = 0; c < 4; c++) {
+						auto at = [&](int px, int py) { return int(rgba[(size_t(py) * size_t(width) + size_t(px)) * 4 + c]); };
+						half[(size_t(y) * size_t(halfWidth) + size_t(x)) * 4 + c] = uint8_t((at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1) + 2) / 4);
+					}
+				}
+			}
+			return half;
+		}
+	}
+}
+
+#endif //BLOCKCOMPRESSION_H
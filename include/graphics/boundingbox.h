@@ -0,0 +1,91 @@
+#ifndef BOUNDINGBOX_H
+#define BOUNDINGBOX_H
+
+#include "ml/ml.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace glpp {
+	/**
+	 * Axis aligned bounding box
+	 * A default constructed box is empty, expanding it with a point makes it a valid box
+	 */
+	struct BoundingBox {
+		ml::vec3 min = ml::vec3(std::numeric_limits<float>::max());
+		ml::vec3 max = ml::vec3(std::numeric_limits<float>::lowest());
+
+		BoundingBox() = default;
+		BoundingBox(const ml::vec3& min, const ml::vec3& max):
+			min(min), max(max) {}
+
+		inline bool empty() const {
+			return min.x() > max.x() || min.y() > max.y() || min.z() > max.z();
+		}
+
+		inline void expand(const ml::vec3& point) {
+			min = {std::min(min.x(), point.x()), std::min(min.y(), point.y()), std::min(min.z(), point.z())};
+			max = {std::max(max.x(), point.x()), std::max(max.y(), point.y()), std::max(max.z(), point.z())};
+		}
+		inline void expand(const BoundingBox& box) {
+			if(box.empty())
+				return;
+			expand(box.min);
+			expand(box.max);
+		}
+		/* Grow the box on every side by margin */
+		inline BoundingBox inflated(float margin) const {
+			return {ml::vec3(min.x() - margin, min.y() - margin, min.z() - margin),
+					ml::vec3(max.x() + margin, max.y() + margin, max.z() + margin)};
+		}
+
+		inline bool intersects(const BoundingBox& rhs) const {
+			return min.x() <= rhs.max.x() && max.x() >= rhs.min.x() &&
+				   min.y() <= rhs.max.y() && max.y() >= rhs.min.y() &&
+				   min.z() <= rhs.max.z() && max.z() >= rhs.min.z();
+		}
+		inline bool contains(const BoundingBox& rhs) const {
+			return min.x() <= rhs.min.x() && max.x() >= rhs.max.x() &&
+				   min.y() <= rhs.min.y() && max.y() >= rhs.max.y() &&
+				   min.z() <= rhs.min.z() && max.z() >= rhs.max.z();
+		}
+
+		inline ml::vec3 center() const {
+			return {(min.x() + max.x()) / 2, (min.y() + max.y()) / 2, (min.z() + max.z()) / 2};
+		}
+		inline ml::vec3 extent() const {
+			return {max.x() - min.x(), max.y() - min.y(), max.z() - min.z()};
+		}
+		/* Surface area of the box, used as the cost heuristic of spatial trees */
+		inline float area() const {
+			ml::vec3 e = extent();
+			return 2.0f * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+		}
+
+		/**
+		 * Transform all 8 corners and return the box that encloses them
+		 * @param transformation e.g. the model matrix of a shape
+		 */
+		BoundingBox transformed(const ml::mat4& transformation) const {
+			BoundingBox result;
+			if(empty())
+				return result;
+			for(int i = 0; i < 8; i++) {
+				ml::vec3 corner = {i & 1 ? max.x() : min.x(),
+								   i & 2 ? max.y() : min.y(),
+								   i & 4 ? max.z() : min.z()};
+				ml::vec4 transformedCorner = transformation * ml::vec4(corner, 1.0f);
+				result.expand({transformedCorner.x(), transformedCorner.y(), transformedCorner.z()});
+			}
+			return result;
+		}
+
+		static BoundingBox merge(const BoundingBox& lhs, const BoundingBox& rhs) {
+			BoundingBox result = lhs;
+			result.expand(rhs);
+			return result;
+		}
+	};
+}
+
+#endif //BOUNDINGBOX_H
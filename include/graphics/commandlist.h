@@ -0,0 +1,134 @@
+#ifndef COMMANDLIST_H
+#define COMMANDLIST_H
+
+#include "mesh.h"
+#include "radixsort.h"
+#include "sortkey.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * Everything needed to issue one draw call, recorded without touching OpenGL
+	 * The key decides the order in which the packets are replayed, lowest first.
+	 * @see SortKey
+	 */
+	struct DrawPacket {
+		uint64_t     key;
+		Mesh*        mesh;
+		Shader*      shader;
+		unsigned int texture; // 0 if the mesh isn't textured
+		ml::mat4     transform;
+		GLenum       primitive = GL_TRIANGLES;
+		// Index of an instance drawn instead of the mesh, eg. a shape of an SDFRenderer, -1 to draw the mesh
+		int32_t      instance = -1;
+	};
+
+	/* Packets recorded by a single thread */
+	class CommandList {
+		std::vector<DrawPacket> m_packets;
+
+	  public:
+		inline void push(const DrawPacket& packet) { m_packets.push_back(packet); }
+		inline void clear() { m_packets.clear(); }
+		inline size_t size() const { return m_packets.size(); }
+		inline const std::vector<DrawPacket>& packets() const { return m_packets; }
+	};
+
+	/**
+	 * Records draw packets on the thread pool and replays them on the GL thread
+	 * Every chunk of items is recorded into its own CommandList, so recording needs no synchronisation,
+	 * the lists are then merged and radix sorted by key. The lists keep their memory between frames.
+	 */
+	class CommandRecorder {
+		std::vector<CommandList> m_lists;
+		std::vector<DrawPacket>  m_packets, m_scratch;
+		size_t                   m_usedLists = 0;
+		ThreadPool&              m_pool;
+
+	  public:
+		explicit CommandRecorder(ThreadPool& pool = ThreadPool::global()):
+			m_lists(pool.size() + 1), m_pool(pool) {}
+
+		/**
+		 * Call record(i, list) for every i in [0, count) on the thread pool, then sort all recorded packets
+		 * record runs concurrently, it may only read shared state and may not call OpenGL.
+		 * @param minChunk the smallest amount of items recorded by one thread
+		 */
+		template<typename Record>
+		void record(size_t count, Record&& record, size_t minChunk = 1024) {
+			for(size_t i = 0; i < m_usedLists; i++)
+				m_lists[i].clear();
+			std::atomic<size_t> nextList{0};
+			m_pool.parallelFor(count, [&](size_t begin, size_t end) {
+				CommandList& list = m_lists[nextList++];
+				for(size_t i = begin; i < end; i++)
+					record(i, list);
+			}, minChunk);
+			m_usedLists = nextList;
+
+			size_t total = 0;
+			for(size_t i = 0; i < m_usedLists; i++)
+				total += m_lists[i].size();
+			m_packets.clear();
+			m_packets.reserve(total);
+			for(size_t i = 0; i < m_usedLists; i++)
+				m_packets.insert(m_packets.end(), m_lists[i].packets().begin(), m_lists[i].packets().end());
+			radixSort(m_packets, m_scratch, [](const DrawPacket& packet) { return packet.key; });
+		}
+
+		/* The packets of the last record(), sorted by key */
+		inline const std::vector<DrawPacket>& packets() const { return m_packets; }
+
+		/* Index of the first packet in the layer or a later one, the packets before it are in earlier layers */
+		size_t layerBegin(uint8_t layer) const {
+			auto it = std::lower_bound(m_packets.begin(), m_packets.end(), uint64_t(layer) << SortKey::layerShift,
+									   [](const DrawPacket& packet, uint64_t key) { return packet.key < key; });
+			return static_cast<size_t>(it - m_packets.begin());
+		}
+		/* Index of the first translucent packet in the layer, or of the next layer if it has none */
+		size_t translucentBegin(uint8_t layer) const {
+			const uint64_t first = uint64_t(layer) << SortKey::layerShift | uint64_t(1) << SortKey::translucentShift;
+			auto it = std::lower_bound(m_packets.begin(), m_packets.end(), first,
+									   [](const DrawPacket& packet, uint64_t key) { return packet.key < key; });
+			return static_cast<size_t>(it - m_packets.begin());
+		}
+
+		/**
+		 * Issue the sorted packets [first, last) on the GL thread
+		 * The shader and depth state are only changed when they differ, submit(packet, i) sets the transform and draws,
+		 * i being the index of the packet in packets().
+		 */
+		template<typename Submit>
+		void replay(Submit&& submit, size_t first, size_t last) const {
+			Shader* bound = nullptr;
+			for(size_t i = first; i < last; i++) {
+				const DrawPacket& packet = m_packets[i];
+				if(packet.shader != bound) {
+					bound = packet.shader;
+					bound->use();
+				}
+				RenderState::current().setDepth(SortKey::isTranslucent(packet.key) ? DepthState::translucent() : DepthState::opaque());
+				submit(packet, i);
+			}
+		}
+		/* Number of packets from i on that draw an instance, such that consecutive instances are drawn with one call */
+		size_t instanceRun(size_t i) const {
+			size_t end = i;
+			while(end < m_packets.size() && m_packets[end].instance >= 0)
+				end++;
+			return end - i;
+		}
+
+		template<typename Submit>
+		void replay(Submit&& submit) const {
+			replay(std::forward<Submit>(submit), 0, m_packets.size());
+		}
+	};
+}
+
+#endif //COMMANDLIST_H
@@ -15,10 +15,18 @@
 
 namespace glpp {
 
+/*
+ * Checks every wrapped call with glGetError in debug builds
+ * glGetError synchronizes with the driver, so release builds report errors through enableDebugOutput() instead
+ */
+#ifdef NDEBUG
+#define glASSERT(x) x
+#else
 #define glASSERT(x) \
 	glClearError(); \
 	x;              \
 	assert(glLogCall(#x, __FILE__, __LINE__) == GL_NO_ERROR)
+#endif
 
 #define ASSERT(condition, message)   \
 	do {                             \
@@ -33,6 +41,18 @@ namespace glpp {
 		std::cout << "ERROR\nSource: " << source << "\nType: " << type << "\nID: " << m_rendererID << "\nSeverity: " << severity << "\nLength: " << length << "\nMessage: " << message;
 	}
 
+	/**
+	 * Let the driver report errors through debugMessageCallback (GL_KHR_debug, core since 4.3)
+	 * Unlike glGetError this doesn't stall the pipeline. Notifications are filtered out.
+	 */
+	inline void enableDebugOutput() {
+		if(!GLAD_GL_KHR_debug && !GLAD_GL_VERSION_4_3)
+			return;
+		glEnable(GL_DEBUG_OUTPUT);
+		glDebugMessageCallback(debugMessageCallback, nullptr);
+		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+	}
+
 	/** Debugging usign glGetError() **/
 	/** Clear all errors given by OpenGL **/
 	inline static void glClearError() {
@@ -1,81 +1,452 @@
 #ifndef FONT_H
 #define FONT_H
 
+#include "atlas.h"
+#include "threadpool.h"
+
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
-#include <map>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
 
 namespace glpp {
-
-	struct Character {
-		unsigned int  textureID; // ID handle of the glyph texture
-		ml::vec2i size;      // Size of glyph
-		ml::vec2i bearing;   // Offset from baseline to left/top of glyph
-		signed long   offset;    // Offset to advance to the next glyph
+	struct Glyph {
+		ml::vec2 size;     // Size of the glyph in pixels
+		ml::vec2 bearing;  // Offset from the pen on the baseline to the left/top of the glyph
+		float    advance;  // Offset to advance the pen to the next glyph
+		int      layer;    // Atlas layer, -1 for glyphs without pixels, eg. spaces
+		ml::vec4 uv;       // Rectangle in the atlas layer, top row first
+		bool     resident; // Whether the pixels are in the atlas, evicted glyphs are rasterized again on use
 	};
 
+	/**
+	 * How glyphs are stored in the atlas
+	 * Bitmap keeps the coverage at the pixel height of the font, sharp at that size only.
+	 * DistanceField keeps the signed distance to the outline, such that one atlas serves every size.
+	 */
+	enum class GlyphMode { Bitmap, DistanceField };
+
+	/**
+	 * Signed distance field of a coverage bitmap, grown by spread pixels on every side
+	 * 0.5 (127) is the outline, values rise inside, a change of 0.5 is a distance of spread pixels.
+	 */
+	std::vector<unsigned char> distanceField(const unsigned char* coverage, int width, int height, int spread);
+
+	/**
+	 * A font face rasterized at one pixel size into a shared glyph atlas on demand
+	 * Glyphs are looked up through a flat table for ASCII and a hash map for other code points,
+	 * their pixels live in a GL_R8 TextureAtlas and are evicted least recently used when it is full.
+	 * Call beginFrame() once per frame, such that glyphs in use are never evicted while drawing.
+	 *
+	 * In GlyphMode::DistanceField the fields are generated on the thread pool, a new glyph has no pixels
+	 * until a later beginFrame() picks up its field. Fields stay in memory, so evicted glyphs are only uploaded
+	 * again, and are written to the cache directory, such that later runs don't generate them at all.
+	 */
 	class Font {
-		std::map<char, Character> m_characters;
-		FT_Library                m_ft;
-		FT_Face                   m_face;
-		int                       m_faceIndex;
+		static constexpr uint32_t none = ~0u;
+
+		struct Pending {
+			uint32_t                                index;
+			std::future<std::vector<unsigned char>> field;
+		};
+
+		FT_Library                              m_ft{};
+		FT_Face                                 m_face{};
+		GlyphMode                               m_mode;
+		int                                     m_pixelHeight;
+		int                                     m_spread;
+		float                                   m_lineHeight = 0.0f;
+		uint32_t                                m_id;
+		uint64_t                                m_generation = 0;
+		TextureAtlas                            m_atlas;
+		std::vector<Glyph>                      m_glyphs;
+		std::vector<char32_t>                   m_codepoints; // of every glyph, by index
+		std::vector<std::vector<unsigned char>> m_fields;     // distance fields, by glyph index
+		std::array<uint32_t, 128>               m_ascii;
+		std::unordered_map<char32_t, uint32_t>  m_unicode;
+		std::vector<unsigned char>              m_bitmap; // scratch for tightly packed glyph rows
+		std::vector<Pending>                    m_pending;
+		std::filesystem::path                   m_cachePath;
+		bool                                    m_cacheDirty = false;
+
+		uint32_t& slot(char32_t codepoint);
+		uint32_t  create(char32_t codepoint);
+		void      rasterize(char32_t codepoint, uint32_t index);
+		void      upload(uint32_t index, const unsigned char* pixels);
+		void      loadCache();
 
 	  public:
-		Character& getCharacter(char c) {
-			return m_characters.at(c);
+		/**
+		 * @param pixelHeight height of the rasterized glyphs, scale the text to draw it at other sizes
+		 * @param cacheDirectory where distance fields are kept between runs, empty to generate them every run
+		 * @param atlasSize width and height of each atlas layer
+		 */
+		Font(const std::filesystem::path& fontPath, int pixelHeight, GlyphMode mode = GlyphMode::Bitmap,
+			 const std::filesystem::path& cacheDirectory = {}, int atlasSize = 1024, int atlasLayers = 2);
+		~Font() {
+			saveCache();
+			if(m_face)
+				FT_Done_Face(m_face);
+			if(m_ft)
+				FT_Done_FreeType(m_ft);
+		}
+		Font(const Font&) = delete;
+		Font& operator=(const Font&) = delete;
+
+		/* The glyph of a code point, rasterized into the atlas if it isn't already */
+		Glyph glyph(char32_t codepoint);
+
+		/* Decode the UTF-8 code point at i and advance i past it, invalid bytes decode to U+FFFD */
+		static char32_t nextCodepoint(std::string_view text, size_t& i);
+
+		/* Start a new frame of the atlas and upload the distance fields finished since the last one */
+		void beginFrame();
+
+		/* Write the distance fields generated so far to the cache directory, also done on destruction */
+		void saveCache();
+
+		inline TextureAtlas& atlas() { return m_atlas; }
+		inline GlyphMode     mode() const { return m_mode; }
+		inline int           pixelHeight() const { return m_pixelHeight; }
+		/* Pixels around the outline covered by a distance field */
+		inline int           spread() const { return m_spread; }
+		inline float         lineHeight() const { return m_lineHeight; }
+		/* Unique per font, eg. to key caches */
+		inline uint32_t      id() const { return m_id; }
+		/* Changes whenever glyphs are evicted or pending glyphs appear, glyphs kept from before a change are stale */
+		inline uint64_t      generation() const { return m_generation; }
+		/* Amount of distance fields still being generated */
+		inline size_t        pending() const { return m_pending.size(); }
+	};
+
+	Font::Font(const std::filesystem::path& fontPath, int pixelHeight, GlyphMode mode, const std::filesystem::path& cacheDirectory,
+			   int atlasSize, int atlasLayers):
+		m_mode(mode), m_pixelHeight(pixelHeight), m_spread(std::max(2, pixelHeight / 8)), m_atlas(atlasSize, atlasLayers, GL_R8) {
+		static std::atomic<uint32_t> fonts{0};
+		m_id = fonts++;
+		m_ascii.fill(none);
+
+		// Evicted glyphs keep their metrics, only their pixels are gone
+		m_atlas.setEvictionCallback([this](uint64_t key) {
+			m_glyphs[key].resident = false;
+			m_generation++;
+		});
+
+		if(FT_Init_FreeType(&m_ft)) {
+			std::cerr << "ERROR::FREETYPE: Could not initialize FreeType Library" << std::endl;
+			m_ft = nullptr;
+			return;
+		}
+		if(FT_New_Face(m_ft, fontPath.c_str(), 0, &m_face)) {
+			std::cerr << "ERROR::FREETYPE: Failed to load font " << fontPath << std::endl;
+			m_face = nullptr;
+			return;
+		}
+		FT_Set_Pixel_Sizes(m_face, 0, static_cast<FT_UInt>(pixelHeight));
+		m_lineHeight = static_cast<float>(m_face->size->metrics.height >> 6);
+
+		if(m_mode == GlyphMode::DistanceField && !cacheDirectory.empty()) {
+			// Key the cache by the font file as well, such that an updated font isn't served stale fields
+			std::error_code error;
+			uint64_t        hash = 14695981039346656037ull;
+			auto            mix  = [&hash](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+			mix(std::filesystem::file_size(fontPath, error));
+			mix(static_cast<uint64_t>(std::filesystem::last_write_time(fontPath, error).time_since_epoch().count()));
+			mix(static_cast<uint64_t>(pixelHeight));
+			mix(static_cast<uint64_t>(m_spread));
+			char name[32];
+			std::snprintf(name, sizeof(name), "-%016llx.sdf", static_cast<unsigned long long>(hash));
+			m_cachePath = cacheDirectory / (fontPath.stem().string() + name);
+			loadCache();
+		}
+	}
+
+	uint32_t& Font::slot(char32_t codepoint) {
+		if(codepoint < m_ascii.size())
+			return m_ascii[codepoint];
+		return m_unicode.try_emplace(codepoint, none).first->second;
+	}
+
+	uint32_t Font::create(char32_t codepoint) {
+		const auto index = static_cast<uint32_t>(m_glyphs.size());
+		m_glyphs.push_back({});
+		m_codepoints.push_back(codepoint);
+		m_fields.emplace_back();
+		slot(codepoint) = index;
+		return index;
+	}
+
+	Glyph Font::glyph(char32_t codepoint) {
+		uint32_t index = slot(codepoint);
+		if(index == none) {
+			index = create(codepoint);
+			rasterize(codepoint, index);
+		} else if(!m_glyphs[index].resident) {
+			rasterize(codepoint, index);
+		}
+
+		const Glyph& glyph = m_glyphs[index];
+		if(glyph.layer >= 0)
+			m_atlas.touch(glyph.layer);
+		return glyph;
+	}
+
+	void Font::rasterize(char32_t codepoint, uint32_t index) {
+		Glyph& glyph   = m_glyphs[index];
+		glyph.resident = true;
+		glyph.layer    = -1;
+		// Distance fields are kept, evicted or cached glyphs only need to be uploaded
+		if(!m_fields[index].empty()) {
+			upload(index, m_fields[index].data());
+			return;
 		}
-		// if width is set to 0 the glyph width will be dynamically calculated
-		inline Font(const std::filesystem::path& fontPath, int height, int width = 0) {
-			if(FT_Init_FreeType(&m_ft)) {
-				std::cerr << "ERROR::FREETYPE: Could not initialize FreeType Library" << std::endl;
+		if(!m_face || FT_Load_Char(m_face, codepoint, FT_LOAD_RENDER)) {
+			std::cerr << "ERROR::FREETYPE: Failed to load Glyph " << static_cast<uint32_t>(codepoint) << std::endl;
+			glyph.size = glyph.bearing = ml::vec2(0.0f, 0.0f);
+			glyph.advance = 0.0f;
+			return;
+		}
+		const FT_GlyphSlot slot   = m_face->glyph;
+		const FT_Bitmap&   bitmap = slot->bitmap;
+		glyph.size    = ml::vec2(static_cast<float>(bitmap.width), static_cast<float>(bitmap.rows));
+		glyph.bearing = ml::vec2(static_cast<float>(slot->bitmap_left), static_cast<float>(slot->bitmap_top));
+		glyph.advance = static_cast<float>(slot->advance.x >> 6); // 26.6 fixed point
+		if(bitmap.width == 0 || bitmap.rows == 0) {
+			m_cacheDirty |= m_mode == GlyphMode::DistanceField;
+			return;
+		}
+
+		// FreeType rows may be padded, the atlas expects them tightly packed
+		m_bitmap.resize(size_t(bitmap.width) * bitmap.rows);
+		for(unsigned int row = 0; row < bitmap.rows; row++)
+			std::memcpy(&m_bitmap[size_t(row) * bitmap.width], bitmap.buffer + std::ptrdiff_t(row) * bitmap.pitch, bitmap.width);
+		if(m_mode == GlyphMode::Bitmap) {
+			upload(index, m_bitmap.data());
+			return;
+		}
+
+		// The field extends past the outline, so does the quad
+		const float spread = static_cast<float>(m_spread);
+		glyph.size    = ml::vec2(glyph.size.x() + 2.0f * spread, glyph.size.y() + 2.0f * spread);
+		glyph.bearing = ml::vec2(glyph.bearing.x() - spread, glyph.bearing.y() + spread);
+		m_pending.push_back({index, ThreadPool::global().submit([coverage = m_bitmap, width = int(bitmap.width), height = int(bitmap.rows),
+																 spread = m_spread] { return distanceField(coverage.data(), width, height, spread); })});
+	}
+
+	void Font::upload(uint32_t index, const unsigned char* pixels) {
+		Glyph& glyph = m_glyphs[index];
+		if(auto entry = m_atlas.add(index, static_cast<int>(glyph.size.x()), static_cast<int>(glyph.size.y()), pixels)) {
+			glyph.layer = entry->layer;
+			glyph.uv    = entry->uv;
+		} else {
+			// Every layer holds glyphs of this frame, draw nothing rather than evicting them
+			glyph.resident = false;
+		}
+	}
+
+	void Font::beginFrame() {
+		m_atlas.beginFrame();
+		for(size_t i = 0; i < m_pending.size();) {
+			Pending& pending = m_pending[i];
+			if(pending.field.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				i++;
+				continue;
+			}
+			m_fields[pending.index] = pending.field.get();
+			upload(pending.index, m_fields[pending.index].data());
+			m_cacheDirty = true;
+			m_generation++;
+			m_pending[i] = std::move(m_pending.back());
+			m_pending.pop_back();
+		}
+	}
+
+	/*
+	 * The cache starts with the spread and the amount of glyphs, followed by the code point, size, bearing
+	 * and advance of every glyph and its distance field of size.x * size.y bytes
+	 */
+	void Font::loadCache() {
+		struct Entry {
+			uint32_t                   codepoint;
+			float                      metrics[5];
+			std::vector<unsigned char> field;
+		};
+		std::ifstream file(m_cachePath, std::ios::binary);
+		if(!file)
+			return;
+		uint32_t spread = 0, count = 0;
+		if(!file.read(reinterpret_cast<char*>(&spread), sizeof(spread)) || !file.read(reinterpret_cast<char*>(&count), sizeof(count)) ||
+		   spread != static_cast<uint32_t>(m_spread)) {
+			m_cacheDirty = true;
+			return;
+		}
+		// Only glyphs of a cache that reads completely are used, a truncated or corrupt one is stale and replaced
+		auto valid = [size = static_cast<float>(m_atlas.size())](const float* metrics) {
+			for(int i = 0; i < 5; i++)
+				if(!std::isfinite(metrics[i]))
+					return false;
+			// The field size is an allocation, bound it by what the atlas can hold at all
+			return metrics[0] >= 0.0f && metrics[0] <= size && metrics[1] >= 0.0f && metrics[1] <= size;
+		};
+		std::vector<Entry> entries;
+		for(uint32_t i = 0; i < count; i++) {
+			Entry entry{};
+			if(!file.read(reinterpret_cast<char*>(&entry.codepoint), sizeof(entry.codepoint)) ||
+			   !file.read(reinterpret_cast<char*>(entry.metrics), sizeof(entry.metrics)) || !valid(entry.metrics)) {
+				m_cacheDirty = true;
+				return;
 			}
-			if(FT_New_Face(m_ft, "/usr/share/fonts/liberation/LiberationMono-Regular.ttf", 0, &m_face)) {
-				std::cerr << "ERROR::FREETYPE: Failed to load font" << fontPath.c_str() << std::endl;
+			entry.field.resize(static_cast<size_t>(entry.metrics[0]) * static_cast<size_t>(entry.metrics[1]));
+			if(!file.read(reinterpret_cast<char*>(entry.field.data()), static_cast<std::streamsize>(entry.field.size()))) {
+				m_cacheDirty = true;
+				return;
 			}
+			entries.push_back(std::move(entry));
+		}
 
-			glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // disable byte-alignment restriction
-
-			for(unsigned char c = 0; c < 128; c++) {
-				FT_Set_Pixel_Sizes(m_face, width, height);
-				// load character glyph
-				if(FT_Load_Char(m_face, c, FT_LOAD_RENDER))
-					std::cerr << "ERROR::FREETYPE: Failed to load Glyph" << c << std::endl;
-
-				// generate texture
-				unsigned int texture;
-				glGenTextures(1, &texture);
-				glBindTexture(GL_TEXTURE_2D, texture);
-				glTexImage2D(
-					GL_TEXTURE_2D,
-					0,
-					GL_RED,
-					m_face->glyph->bitmap.width,
-					m_face->glyph->bitmap.rows,
-					0,
-					GL_RED,
-					GL_UNSIGNED_BYTE,
-					m_face->glyph->bitmap.buffer);
-				// set texture options
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-				// now store character for later use
-				Character character = {
-					texture,
-					ml::vec2i(m_face->glyph->bitmap.width, m_face->glyph->bitmap.rows),
-					ml::vec2i(m_face->glyph->bitmap_left, m_face->glyph->bitmap_top),
-					m_face->glyph->advance.x};
-				m_characters.insert(std::pair<char, Character>(c, character));
+		for(auto& entry: entries) {
+			if(slot(entry.codepoint) != none)
+				continue;
+			// Glyphs without pixels are complete, the others are uploaded on first use
+			const float*   metrics = entry.metrics;
+			const uint32_t index   = create(entry.codepoint);
+			m_glyphs[index]        = {{metrics[0], metrics[1]}, {metrics[2], metrics[3]}, metrics[4], -1, {}, entry.field.empty()};
+			m_fields[index]        = std::move(entry.field);
+		}
+	}
+
+	void Font::saveCache() {
+		if(m_cachePath.empty() || !m_cacheDirty)
+			return;
+		std::error_code error;
+		std::filesystem::create_directories(m_cachePath.parent_path(), error);
+		// Write next to the cache and rename, such that other processes never read a partial file
+		std::filesystem::path temporary = m_cachePath;
+		temporary += ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary);
+			const auto    spread = static_cast<uint32_t>(m_spread);
+			uint32_t      count  = 0;
+			file.write(reinterpret_cast<const char*>(&spread), sizeof(spread));
+			file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			for(size_t i = 0; i < m_glyphs.size(); i++) {
+				const Glyph& glyph = m_glyphs[i];
+				// Fields still being generated are left for the next run
+				if(m_fields[i].empty() && glyph.size.x() > 0.0f)
+					continue;
+				const auto  codepoint  = static_cast<uint32_t>(m_codepoints[i]);
+				const float metrics[5] = {glyph.size.x(), glyph.size.y(), glyph.bearing.x(), glyph.bearing.y(), glyph.advance};
+				file.write(reinterpret_cast<const char*>(&codepoint), sizeof(codepoint));
+				file.write(reinterpret_cast<const char*>(metrics), sizeof(metrics));
+				file.write(reinterpret_cast<const char*>(m_fields[i].data()), static_cast<std::streamsize>(m_fields[i].size()));
+				count++;
 			}
+			file.seekp(sizeof(spread));
+			file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			if(!file)
+				return;
+		}
+		std::filesystem::rename(temporary, m_cachePath, error);
+		if(error)
+			std::cerr << "Could not store glyph cache " << m_cachePath << ": " << error.message() << std::endl;
+		else
+			m_cacheDirty = false;
+	}
 
-			FT_Done_Face(m_face);
-			FT_Done_FreeType(m_ft);
+	char32_t Font::nextCodepoint(std::string_view text, size_t& i) {
+		const auto byte = static_cast<unsigned char>(text[i++]);
+		if(byte < 0x80)
+			return byte;
+		int length = byte >= 0xF0 ? 3 : byte >= 0xE0 ? 2 : byte >= 0xC0 ? 1 : -1;
+		if(length < 0 || i + size_t(length) > text.size())
+			return 0xFFFD;
+		char32_t codepoint = byte & (0x3F >> length);
+		for(; length > 0; length--) {
+			const auto continuation = static_cast<unsigned char>(text[i]);
+			if((continuation & 0xC0) != 0x80)
+				return 0xFFFD;
+			codepoint = codepoint << 6 | (continuation & 0x3F);
+			i++;
 		}
-	};
+		return codepoint;
+	}
 
+	/* Squared euclidean distance transform of n samples at stride in place (Felzenszwalb and Huttenlocher) */
+	inline void distanceTransform(float* f, int n, size_t stride, std::vector<float>& d, std::vector<int>& v, std::vector<float>& z) {
+		constexpr float infinity = 1e20f;
+		auto            sample   = [&](int q) { return f[size_t(q) * stride]; };
+		// Where the parabolas rooted at q and p intersect
+		auto intersection = [&](int q, int p) { return ((sample(q) + float(q * q)) - (sample(p) + float(p * p))) / float(2 * (q - p)); };
+
+		int k = 0;
+		v[0]  = 0;
+		z[0]  = -infinity;
+		z[1]  = infinity;
+		for(int q = 1; q < n; q++) {
+			float s = intersection(q, v[size_t(k)]);
+			while(s <= z[size_t(k)])
+				s = intersection(q, v[size_t(--k)]);
+			k++;
+			v[size_t(k)]     = q;
+			z[size_t(k)]     = s;
+			z[size_t(k) + 1] = infinity;
+		}
+		k = 0;
+		for(int q = 0; q < n; q++) {
+			while(z[size_t(k) + 1] < float(q))
+				k++;
+			const float offset = float(q - v[size_t(k)]);
+			d[size_t(q)]       = offset * offset + sample(v[size_t(k)]);
+		}
+		for(int q = 0; q < n; q++)
+			f[size_t(q) * stride] = d[size_t(q)];
+	}
+
+	std::vector<unsigned char> distanceField(const unsigned char* coverage, int width, int height, int spread) {
+		const int    w = width + 2 * spread, h = height + 2 * spread;
+		const size_t pixels = size_t(w) * size_t(h);
+		// Squared distances to the closest pixel inside and outside of the outline
+		std::vector<float> toInside(pixels, 1e20f), toOutside(pixels, 0.0f);
+		for(int y = 0; y < height; y++) {
+			for(int x = 0; x < width; x++) {
+				if(coverage[size_t(y) * size_t(width) + size_t(x)] < 128)
+					continue;
+				const size_t i = size_t(y + spread) * size_t(w) + size_t(x + spread);
+				toInside[i]    = 0.0f;
+				toOutside[i]   = 1e20f;
+			}
+		}
+		std::vector<float> d(size_t(std::max(w, h))), z(size_t(std::max(w, h)) + 1);
+		std::vector<int>   v(size_t(std::max(w, h)));
+		for(auto* grid: {&toInside, &toOutside}) {
+			for(int x = 0; x < w; x++)
+				distanceTransform(grid->data() + x, h, size_t(w), d, v, z);
+			for(int y = 0; y < h; y++)
+				distanceTransform(grid->data() + size_t(y) * size_t(w), w, 1, d, v, z);
+		}
+
+		std::vector<unsigned char> field(pixels);
+		for(size_t i = 0; i < pixels; i++) {
+			// The outline runs half a pixel from the centers of the pixels next to it
+			const float distance = toInside[i] == 0.0f ? std::sqrt(toOutside[i]) - 0.5f : 0.5f - std::sqrt(toInside[i]);
+			const float value    = std::clamp(0.5f + distance / (2.0f * static_cast<float>(spread)), 0.0f, 1.0f);
+			field[i]             = static_cast<unsigned char>(std::lround(value * 255.0f));
+		}
+		return field;
+	}
 }
 
 #endif //FONT_H
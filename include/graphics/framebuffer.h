@@ -0,0 +1,274 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "debug.h"
+#include "renderstate.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * Framebuffer object with texture color attachments and an optional depth-stencil renderbuffer
+	 * Used as render target when no window system framebuffer is available, and for multi-pass rendering.
+	 */
+	class Framebuffer {
+		unsigned int              FBO{}, depthStencil{};
+		std::vector<unsigned int> m_colors;
+		std::vector<GLenum>       m_formats;
+		size_t                    m_width = 0, m_height = 0;
+		bool                      m_depth   = true;
+		GLsizei                   m_samples = 0;
+
+		void create();
+		void release();
+
+	  public:
+		/**
+		 * @param colorFormats the internal format of every color attachment, attachment i is GL_COLOR_ATTACHMENT0 + i
+		 * @param depth whether to attach a 24 bit depth and 8 bit stencil buffer
+		 * @param samples multisampled attachments if not 0, the color textures are then GL_TEXTURE_2D_MULTISAMPLE
+		 */
+		Framebuffer(size_t width, size_t height, std::vector<GLenum> colorFormats = {GL_RGBA8}, bool depth = true, GLsizei samples = 0):
+			m_formats(std::move(colorFormats)), m_width(width), m_height(height), m_depth(depth), m_samples(samples) {
+			create();
+		}
+		~Framebuffer() { release(); }
+
+		Framebuffer(const Framebuffer&) = delete;
+		Framebuffer& operator=(const Framebuffer&) = delete;
+		Framebuffer(Framebuffer&& other) noexcept:
+			FBO(std::exchange(other.FBO, 0)), depthStencil(std::exchange(other.depthStencil, 0)),
+			m_colors(std::move(other.m_colors)), m_formats(std::move(other.m_formats)),
+			m_width(other.m_width), m_height(other.m_height), m_depth(other.m_depth), m_samples(other.m_samples) {}
+
+		/* Bind for drawing and reading, and set the viewport to the size of the framebuffer */
+		void bind() {
+			glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+			glViewport(0, 0, static_cast<GLsizei>(m_width), static_cast<GLsizei>(m_height));
+		}
+		static void bindDefault() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
+
+		/* Recreate the attachments with a new size, the contents are lost */
+		void resize(size_t width, size_t height) {
+			if(width == m_width && height == m_height)
+				return;
+			release();
+			m_width  = width;
+			m_height = height;
+			create();
+		}
+
+		inline unsigned int id() const { return FBO; }
+		inline unsigned int colorTexture(size_t attachment = 0) const { return m_colors[attachment]; }
+		inline size_t       width() const { return m_width; }
+		inline size_t       height() const { return m_height; }
+		inline GLsizei      samples() const { return m_samples; }
+		/* The texture target of the color attachments */
+		inline GLenum       textureTarget() const { return m_samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D; }
+	};
+
+	void Framebuffer::create() {
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+		m_colors.resize(m_formats.size());
+		glGenTextures(static_cast<GLsizei>(m_colors.size()), m_colors.data());
+		std::vector<GLenum> drawBuffers;
+		for(size_t i = 0; i < m_colors.size(); i++) {
+			RenderState::current().bindTexture(0, textureTarget(), m_colors[i]);
+			// Storage only, the format and type of the (absent) data don't matter
+			if(m_samples > 0) {
+				glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, m_samples, m_formats[i], static_cast<GLsizei>(m_width),
+										  static_cast<GLsizei>(m_height), GL_TRUE);
+			} else {
+				glTexStorage2D(GL_TEXTURE_2D, 1, m_formats[i], static_cast<GLsizei>(m_width), static_cast<GLsizei>(m_height));
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			}
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, textureTarget(), m_colors[i], 0);
+			drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+		}
+		glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+
+		if(m_depth) {
+			glGenRenderbuffers(1, &depthStencil);
+			glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, GL_DEPTH24_STENCIL8, static_cast<GLsizei>(m_width),
+											 static_cast<GLsizei>(m_height));
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+		}
+
+		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			logging::error("Framebuffer({}x{}) is incomplete"_format(m_width, m_height));
+	}
+
+	void Framebuffer::release() {
+		for(auto color: m_colors)
+			RenderState::current().deletedTexture(color);
+		glDeleteTextures(static_cast<GLsizei>(m_colors.size()), m_colors.data());
+		glDeleteRenderbuffers(1, &depthStencil);
+		glDeleteFramebuffers(1, &FBO);
+		m_colors.clear();
+		FBO = depthStencil = 0;
+	}
+
+	/**
+	 * 8 bit RGBA image as read back from OpenGL, the first row is the bottom of the frame
+	 */
+	struct Image {
+		size_t               width = 0, height = 0;
+		std::vector<uint8_t> pixels;
+
+		Image() = default;
+		Image(size_t width, size_t height):
+			width(width), height(height), pixels(width * height * 4) {}
+
+		inline uint8_t*       pixel(size_t x, size_t y) { return &pixels[(y * width + x) * 4]; }
+		inline const uint8_t* pixel(size_t x, size_t y) const { return &pixels[(y * width + x) * 4]; }
+		inline bool           empty() const { return pixels.empty(); }
+	};
+
+	struct ImageDifference {
+		size_t differentPixels = 0;
+		int    maxDifference   = 0;
+		// Whether the sizes match at all, the other fields are meaningless if they don't
+		bool sameSize = true;
+
+		inline bool matches() const { return sameSize && differentPixels == 0; }
+	};
+
+	/**
+	 * Compare two images per channel
+	 * @param tolerance the difference a channel may have before a pixel counts as different,
+	 *        software and hardware rasterizers differ slightly on edges
+	 */
+	inline ImageDifference compare(const Image& lhs, const Image& rhs, int tolerance = 2) {
+		ImageDifference difference;
+		if(lhs.width != rhs.width || lhs.height != rhs.height) {
+			difference.sameSize = false;
+			return difference;
+		}
+		for(size_t i = 0; i < lhs.pixels.size(); i += 4) {
+			int maxChannel = 0;
+			for(size_t c = 0; c < 4; c++)
+				maxChannel = std::max(maxChannel, std::abs(lhs.pixels[i + c] - rhs.pixels[i + c]));
+			difference.maxDifference = std::max(difference.maxDifference, maxChannel);
+			if(maxChannel > tolerance)
+				difference.differentPixels++;
+		}
+		return difference;
+	}
+
+	/* Write the image as binary PPM, used to store reference frames; alpha is dropped */
+	inline bool writePPM(const std::filesystem::path& path, const Image& image) {
+		std::ofstream file(path, std::ios::binary);
+		if(!file)
+			return false;
+		file << "P6\n" << image.width << " " << image.height << "\n255\n";
+		// PPM starts at the top row
+		for(size_t y = image.height; y-- > 0;)
+			for(size_t x = 0; x < image.width; x++)
+				file.write(reinterpret_cast<const char*>(image.pixel(x, y)), 3);
+		return static_cast<bool>(file);
+	}
+	inline Image readPPM(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		std::string   magic;
+		size_t        width = 0, height = 0, maxValue = 0;
+		file >> magic >> width >> height >> maxValue;
+		file.get();
+		if(!file || magic != "P6" || maxValue != 255) {
+			logging::error("Failed to read PPM image: {}"_format(path.string()));
+			return {};
+		}
+		Image image(width, height);
+		for(size_t y = height; y-- > 0;) {
+			for(size_t x = 0; x < width; x++) {
+				file.read(reinterpret_cast<char*>(image.pixel(x, y)), 3);
+				image.pixel(x, y)[3] = 255;
+			}
+		}
+		return image;
+	}
+
+	/**
+	 * Reads frames back through two pixel pack buffers
+	 * read() only starts the transfer of the current frame and returns the previous frame,
+	 * which has been copied by then, so the CPU never waits for the GPU to finish the current frame.
+	 */
+	class FrameReader {
+		std::array<unsigned int, 2> PBOs{};
+		std::array<bool, 2>         m_pending{};
+		size_t                      m_width, m_height;
+		size_t                      m_frame = 0;
+
+		inline size_t bytes() const { return m_width * m_height * 4; }
+
+	  public:
+		FrameReader(size_t width, size_t height):
+			m_width(width), m_height(height) {
+			glGenBuffers(2, PBOs.data());
+			for(auto PBO: PBOs) {
+				RenderState::current().bindBuffer(GL_PIXEL_PACK_BUFFER, PBO);
+				glBufferData(GL_PIXEL_PACK_BUFFER, bytes(), nullptr, GL_STREAM_READ);
+			}
+			RenderState::current().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+		~FrameReader() {
+			for(auto PBO: PBOs)
+				RenderState::current().deletedBuffer(PBO);
+			glDeleteBuffers(2, PBOs.data());
+		}
+		FrameReader(const FrameReader&) = delete;
+		FrameReader& operator=(const FrameReader&) = delete;
+
+		/**
+		 * Start reading the bound read framebuffer
+		 * @param previous receives the frame started by the previous call
+		 * @return whether previous was written
+		 */
+		bool read(Image& previous) {
+			const size_t current = m_frame % 2;
+			const size_t other   = (m_frame + 1) % 2;
+			RenderState::current().bindBuffer(GL_PIXEL_PACK_BUFFER, PBOs[current]);
+			glReadPixels(0, 0, static_cast<GLsizei>(m_width), static_cast<GLsizei>(m_height), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			m_pending[current] = true;
+			m_frame++;
+
+			if(!m_pending[other]) {
+				RenderState::current().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+				return false;
+			}
+			RenderState::current().bindBuffer(GL_PIXEL_PACK_BUFFER, PBOs[other]);
+			auto* data = static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes(), GL_MAP_READ_BIT));
+			if(data) {
+				previous = Image(m_width, m_height);
+				std::memcpy(previous.pixels.data(), data, bytes());
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			m_pending[other] = false;
+			RenderState::current().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			return data != nullptr;
+		}
+
+		/* Read the bound read framebuffer immediately, waits for the GPU to finish */
+		Image readNow() const {
+			Image image(m_width, m_height);
+			RenderState::current().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(0, 0, static_cast<GLsizei>(m_width), static_cast<GLsizei>(m_height), GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+			return image;
+		}
+	};
+}
+
+#endif //FRAMEBUFFER_H
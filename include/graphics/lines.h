@@ -0,0 +1,159 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include "common.h"
+#include "debug.h"
+#include "renderstate.h"
+#include "shaders.h"
+
+#include <utility>
+#include <vector>
+
+namespace glpp {
+	enum class LineJoin { Miter, Round, Bevel };
+	enum class LineCap { Butt, Square, Round };
+
+	struct LineStyle {
+		float    width = 2.0f; // in pixels, independent of the zoom
+		rgba     color{1.0f, 1.0f, 1.0f, 1.0f};
+		LineJoin join       = LineJoin::Miter;
+		LineCap  cap        = LineCap::Butt;
+		float    miterLimit = 4.0f; // in half widths, sharper joins are beveled
+	};
+
+	/**
+	 * Polylines stored as their points only, 2 floats per point
+	 * The points are uploaded with adjacency and drawn as GL_LINE_STRIP_ADJACENCY,
+	 * the LineRenderer extrudes them to triangles on the GPU. Uploads happen lazily on the next draw.
+	 */
+	class PolylineBatch {
+		unsigned int         VAO{}, VBO{};
+		std::vector<float>   m_points;
+		std::vector<GLint>   m_firsts;
+		std::vector<GLsizei> m_counts;
+		size_t               m_capacity = 0; // in floats
+		bool                 m_dirty    = false;
+
+	  public:
+		PolylineBatch() {
+			glGenVertexArrays(1, &VAO);
+			glGenBuffers(1, &VBO);
+			RenderState::current().bindVertexArray(VAO);
+			RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+			glASSERT(glEnableVertexAttribArray(0));
+			glASSERT(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr));
+		}
+		~PolylineBatch() {
+			if(VAO) {
+				RenderState::current().deletedVertexArray(VAO);
+				RenderState::current().deletedBuffer(VBO);
+				glDeleteVertexArrays(1, &VAO);
+				glDeleteBuffers(1, &VBO);
+			}
+		}
+		PolylineBatch(PolylineBatch&& other) noexcept:
+			VAO(std::exchange(other.VAO, 0)), VBO(std::exchange(other.VBO, 0)), m_points(std::move(other.m_points)),
+			m_firsts(std::move(other.m_firsts)), m_counts(std::move(other.m_counts)),
+			m_capacity(std::exchange(other.m_capacity, 0)), m_dirty(other.m_dirty) {}
+		PolylineBatch(const PolylineBatch&) = delete;
+		PolylineBatch& operator=(const PolylineBatch&) = delete;
+
+		/**
+		 * Append the points of a polyline with its neighbours for GL_LINE_STRIP_ADJACENCY
+		 * Open polylines repeat their end points, which the geometry shader turns into caps,
+		 * closed ones wrap around, such that every point is a join.
+		 * @return the amount of points appended
+		 */
+		static size_t appendAdjacency(const std::vector<ml::vec2>& points, bool closed, std::vector<float>& out) {
+			const size_t n = points.size();
+			if(n < 2)
+				return 0;
+			auto push = [&](const ml::vec2& point) {
+				out.push_back(point.x());
+				out.push_back(point.y());
+			};
+			push(closed ? points[n - 1] : points[0]);
+			for(const auto& point: points)
+				push(point);
+			if(closed) {
+				push(points[0]);
+				push(points[1]);
+			} else {
+				push(points[n - 1]);
+			}
+			return closed ? n + 3 : n + 2;
+		}
+
+		void add(const std::vector<ml::vec2>& points, bool closed = false) {
+			const auto first = static_cast<GLint>(m_points.size() / 2);
+			if(size_t count = appendAdjacency(points, closed, m_points)) {
+				m_firsts.push_back(first);
+				m_counts.push_back(static_cast<GLsizei>(count));
+				m_dirty = true;
+			}
+		}
+		void clear() {
+			m_points.clear();
+			m_firsts.clear();
+			m_counts.clear();
+			m_dirty = true;
+		}
+		inline size_t size() const { return m_counts.size(); }
+		inline bool   empty() const { return m_counts.empty(); }
+		/* Bytes uploaded for all polylines */
+		inline size_t bytes() const { return m_points.size() * sizeof(float); }
+
+		/* Issue all polylines with one multi draw, the line shader has to be bound */
+		void draw() {
+			if(empty())
+				return;
+			RenderState::current().bindVertexArray(VAO);
+			if(m_dirty) {
+				RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+				if(m_points.size() > m_capacity) {
+					m_capacity = m_points.size();
+					glASSERT(glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(float), m_points.data(), GL_DYNAMIC_DRAW));
+				} else {
+					glASSERT(glBufferSubData(GL_ARRAY_BUFFER, 0, m_points.size() * sizeof(float), m_points.data()));
+				}
+				m_dirty = false;
+			}
+			glASSERT(glMultiDrawArrays(GL_LINE_STRIP_ADJACENCY, m_firsts.data(), m_counts.data(), static_cast<GLsizei>(m_counts.size())));
+		}
+	};
+
+	/**
+	 * Draws polylines of a constant width in pixels with miter, round or bevel joins
+	 * The geometry shader extrudes every segment in screen space from its neighbours, compared to
+	 * expanding quads on the CPU (createLine) only a quarter of the data is uploaded and the joins are closed.
+	 */
+	class LineRenderer {
+		Shader        m_shader;
+		UniformHandle m_mvp, m_viewport, m_width, m_miterLimit, m_join, m_cap, m_color;
+
+	  public:
+		explicit LineRenderer(const std::filesystem::path& resources = GLPP_RESOURCES):
+			m_shader(resources / "line_shaders"), m_mvp(m_shader.uniform("mvp")), m_viewport(m_shader.uniform("viewport")),
+			m_width(m_shader.uniform("width")), m_miterLimit(m_shader.uniform("miterLimit")), m_join(m_shader.uniform("join")),
+			m_cap(m_shader.uniform("cap")), m_color(m_shader.uniform("color")) {}
+
+		inline Shader& shader() { return m_shader; }
+
+		/* @param viewport size of the viewport in pixels */
+		void draw(PolylineBatch& batch, const ml::mat4& mvp, const LineStyle& style, const ml::vec2& viewport) {
+			if(batch.empty())
+				return;
+			m_shader.use();
+			m_shader.setUniform(m_mvp, mvp);
+			m_shader.setUniform(m_viewport, viewport);
+			m_shader.setUniform(m_width, style.width);
+			m_shader.setUniform(m_miterLimit, style.miterLimit);
+			m_shader.setUniform(m_join, static_cast<int>(style.join));
+			m_shader.setUniform(m_cap, static_cast<int>(style.cap));
+			m_shader.setUniform(m_color, ml::vec4(style.color.r(), style.color.g(), style.color.b(), style.color.a()));
+			batch.draw();
+		}
+	};
+}
+
+#endif //LINES_H
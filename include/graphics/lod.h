@@ -0,0 +1,119 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include "camera.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+namespace glpp {
+	/**
+	 * Level of detail helpers
+	 * Detail is chosen from the projected size on screen, in pixels
+	 */
+	namespace LOD {
+		/**
+		 * Amount of pixels a single world unit covers horizontally
+		 * For a perspective projection this is the size at a distance of 1, divide by the distance to the camera.
+		 * @param projection the projection the geometry is drawn with, eg. Camera::projection()
+		 * @param viewportWidth width of the viewport in pixels
+		 */
+		inline float pixelsPerUnit(const ml::mat4& projection, float viewportWidth) {
+			// The first element scales x from world units to normalized device coordinates [-1, 1]
+			return std::abs(projection.data()[0]) * viewportWidth / 2.0f;
+		}
+		inline float pixelsPerUnit(Camera& camera, float viewportWidth) {
+			return pixelsPerUnit(camera.projection(), viewportWidth);
+		}
+
+		/**
+		 * Amount of segments needed for a circle such that the distance between the
+		 * true circle and its polygon (the sagitta) stays below tolerance pixels
+		 * @param pixelRadius radius of the circle on screen
+		 */
+		inline int circleSegments(float pixelRadius, float tolerance = 0.5f, int minSegments = 8, int maxSegments = 1024) {
+			if(pixelRadius <= tolerance)
+				return minSegments;
+			const float theta    = 2.0f * std::acos(1.0f - tolerance / pixelRadius);
+			const int   segments = static_cast<int>(std::ceil(2.0f * M_PI / theta));
+			return std::clamp(segments, minSegments, maxSegments);
+		}
+	}
+
+	/**
+	 * Min-max decimation of a polyline sampled along increasing x
+	 * Within every pixel column only the first, lowest, highest and last sample are kept (in order),
+	 * which leaves the rasterized line unchanged while bounding the points to 4 per column.
+	 * @param unitsPerPixel width of a pixel column in world units
+	 */
+	inline std::vector<ml::vec2> decimateSamples(const std::vector<ml::vec2>& points, float unitsPerPixel) {
+		if(points.size() <= 4 || unitsPerPixel <= 0.0f)
+			return points;
+
+		std::vector<ml::vec2> result;
+		result.reserve(std::min(points.size(), static_cast<size_t>(4 * (points.back().x() - points.front().x()) / unitsPerPixel) + 4));
+
+		size_t begin = 0;
+		while(begin < points.size()) {
+			const long column = static_cast<long>(std::floor(points[begin].x() / unitsPerPixel));
+			size_t     end    = begin + 1;
+			size_t     low = begin, high = begin;
+			while(end < points.size() && static_cast<long>(std::floor(points[end].x() / unitsPerPixel)) == column) {
+				if(points[end].y() < points[low].y())
+					low = end;
+				if(points[end].y() > points[high].y())
+					high = end;
+				end++;
+			}
+			const size_t last = end - 1;
+			// Emit the extremes of this column in their original order without duplicates
+			size_t kept[4]  = {begin, std::min(low, high), std::max(low, high), last};
+			size_t previous = points.size();
+			for(size_t i: kept) {
+				if(i != previous)
+					result.push_back(points[i]);
+				previous = i;
+			}
+			begin = end;
+		}
+		return result;
+	}
+
+	/**
+	 * Caches decimated versions of a sampled polyline per zoom level
+	 * Levels are powers of two of the pixel size, such that continuous zooming
+	 * only decimates once every time the zoom halves or doubles.
+	 */
+	class PolylineLOD {
+		std::vector<ml::vec2>                     m_points;
+		std::map<int, std::vector<ml::vec2>>      m_levels;
+
+	  public:
+		explicit PolylineLOD(std::vector<ml::vec2> points):
+			m_points(std::move(points)) {}
+
+		const std::vector<ml::vec2>& points() const { return m_points; }
+
+		/**
+		 * @param pixelsPerUnit eg. LOD::pixelsPerUnit(projection, viewportWidth)
+		 * @return the samples decimated to at most 4 points per pixel column
+		 */
+		const std::vector<ml::vec2>& select(float pixelsPerUnit) {
+			// Round the pixel size down to a power of two, a finer decimation is always valid
+			const int level = static_cast<int>(std::floor(std::log2(1.0f / pixelsPerUnit)));
+			auto      it    = m_levels.find(level);
+			if(it == m_levels.end())
+				it = m_levels.emplace(level, decimateSamples(m_points, std::exp2(static_cast<float>(level)))).first;
+			return it->second;
+		}
+
+		void setPoints(std::vector<ml::vec2> points) {
+			m_points = std::move(points);
+			m_levels.clear();
+		}
+	};
+}
+
+#endif //LOD_H
@@ -7,6 +7,9 @@
 
 #include "common.h"
 
+#include <algorithm>
+#include <limits>
+#include <span>
 #include <utility>
 //#include "assimp/Importer.hpp"
 //#include "assimp/postprocess.h"
@@ -14,7 +17,9 @@
 //#include "shapes.h"
 #include "gui/window.h"
 #include "vertex.h"
+#include "vertexstreams.h"
 #include "graphics/shaders.h"
+#include "graphics/oit.h"
 
 namespace glpp {
 
@@ -26,6 +31,18 @@ namespace glpp {
     */
 	class Mesh {
 		unsigned int VBO{}, VAO{}, EBO{};
+		// Cached on every (re)upload, such that culling never has to walk the vertices
+		BoundingBox  m_bounds;
+		unsigned int m_revision = 0;
+		// Indices are uploaded as 16 bit when every vertex fits, halving the index fetches
+		GLenum       m_indexType = GL_UNSIGNED_INT;
+		size_t       m_indexCount = 0; // as uploaded, meshes uploaded from spans keep no indices
+		// The 16 bit copy of the indices, kept such that uploading again doesn't allocate
+		std::vector<GLushort> m_narrowIndices;
+
+		void computeBounds();
+		void uploadIndices(std::span<const Index> indices, size_t vertexCount);
+		void createBuffers(std::span<const Vertex> vertices, std::span<const Index> indices);
 
       public:
 		void regenBuffers();
@@ -34,9 +51,19 @@ namespace glpp {
         std::vector<Texture> textures;
 
 		ml::vec3 center();
+		/* Local space bounds of the vertices as they were last uploaded */
+		const BoundingBox& bounds() const { return m_bounds; }
+		/* Incremented on every upload, used to detect changed bounds */
+		unsigned int revision() const { return m_revision; }
+		/* For writing the vertices on the GPU, eg. from a compute shader */
+		unsigned int vertexBuffer() const { return VBO; }
 
 		size_t indicesSize() const {
-			return indices.size();
+			return m_indexCount;
+		}
+		/* GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, the type of the uploaded indices */
+		GLenum indexType() const {
+			return m_indexType;
 		}
 		void setTexture(Texture&& texture) {
 			textures.push_back(std::move(texture));
@@ -50,6 +77,8 @@ namespace glpp {
 
 
         void release(){
+			RenderState::current().deletedVertexArray(VAO);
+			RenderState::current().deletedBuffer(VBO);
 			glASSERT(glDeleteVertexArrays(1, &VAO));
 			glASSERT(glDeleteBuffers(1, &VBO));
 			glASSERT(glDeleteBuffers(1, &EBO));
@@ -70,6 +99,12 @@ namespace glpp {
             std::swap(VAO, other.VAO);
             std::swap(VBO, other.VBO);
             std::swap(EBO, other.EBO);
+            m_bounds = other.m_bounds;
+            // A new revision either way, such that observers of the moved from mesh see a change
+            m_revision = other.m_revision + 1;
+            m_indexType = other.m_indexType;
+            m_indexCount = other.m_indexCount;
+            m_narrowIndices = std::move(other.m_narrowIndices);
             vertices = std::move(other.vertices);
             indices = std::move(other.indices);
             textures = std::move(other.textures);
@@ -83,11 +118,17 @@ namespace glpp {
 				std::swap(VAO, other.VAO);
                 std::swap(VBO, other.VBO);
                 std::swap(EBO, other.EBO);
+                m_bounds = other.m_bounds;
+                // Newer than both, observers of either mesh see a change
+                m_revision = std::max(m_revision, other.m_revision) + 1;
+                m_indexType = other.m_indexType;
+                m_indexCount = other.m_indexCount;
+                m_narrowIndices = std::move(other.m_narrowIndices);
                 vertices = std::move(other.vertices);
                 indices = std::move(other.indices);
                 textures = std::move(other.textures);
 			}
-
+			return *this;
         }
 
         Mesh(std::vector<Vertex> vertices, std::vector<Index> indices, std::vector<Texture> textures) {
@@ -101,6 +142,14 @@ namespace glpp {
 			this->indices  = std::move(indices);
 			genBuffers();
 		}
+		/**
+		 * Upload without keeping the vertices and indices, eg. straight from a mapped mesh file
+		 * The mesh can be drawn but not changed, vertices and indices stay empty.
+		 */
+		Mesh(std::span<const Vertex> vertices, std::span<const Index> indices, const BoundingBox& bounds): m_bounds(bounds) {
+			m_revision++;
+			createBuffers(vertices, indices);
+		}
 		Mesh(VertexIndexPair pair) {
 			vertices = std::move(pair.first);
 			indices  = std::move(pair.second);
@@ -115,7 +164,7 @@ namespace glpp {
             release();
 		}
 		void bind() {
-			glASSERT(glBindVertexArray(VAO));
+			glASSERT(RenderState::current().bindVertexArray(VAO));
 		}
 
 		void draw(Shader& shader);
@@ -156,11 +205,13 @@ namespace glpp {
 			genBuffers();
 		}
 		~VertexMesh() {
+			RenderState::current().deletedVertexArray(VAO);
+			RenderState::current().deletedBuffer(VBO);
 			glASSERT(glDeleteVertexArrays(1, &VAO));
 			glASSERT(glDeleteBuffers(1, &VBO));
 		}
 		void bind() {
-			glASSERT(glBindVertexArray(VAO));
+			glASSERT(RenderState::current().bindVertexArray(VAO));
 		}
 		void draw(Shader& shader) {
 		}
@@ -171,25 +222,46 @@ namespace glpp {
 		void loadFromFile(const std::filesystem::path& path) {
 		}
 	};
+    void Mesh::computeBounds() {
+        m_bounds = BoundingBox();
+        for(auto& vertex : vertices) {
+            m_bounds.expand(vertex.positions);
+        }
+        m_revision++;
+    }
     void Mesh::regenBuffers() {
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        computeBounds();
+        RenderState::current().bindVertexArray(VAO);
+        RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        uploadIndices(indices, vertices.size());
+        // The vertex array stays bound, it's usually drawn right after the upload
     }
+	void Mesh::uploadIndices(std::span<const Index> indices, size_t vertexCount) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		m_indexCount = indices.size();
+		if(vertexCount > std::numeric_limits<GLushort>::max() + size_t(1)) {
+			m_indexType = GL_UNSIGNED_INT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
+			return;
+		}
+		m_indexType = GL_UNSIGNED_SHORT;
+		m_narrowIndices.assign(indices.begin(), indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * m_narrowIndices.size(), m_narrowIndices.data(), GL_DYNAMIC_DRAW);
+	}
 	void Mesh::genBuffers() {
+		computeBounds();
+		createBuffers(vertices, indices);
+	}
+	void Mesh::createBuffers(std::span<const Vertex> vertices, std::span<const Index> indices) {
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
 		glGenBuffers(1, &EBO);
-		glBindVertexArray(VAO);
+		RenderState::current().bindVertexArray(VAO);
 
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
+		uploadIndices(indices, vertices.size());
 
 		// positions
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offset_of(&Vertex::positions));
@@ -203,20 +275,16 @@ namespace glpp {
 		// texCoords
 		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offset_of(&Vertex::textureSlot));
 		glEnableVertexAttribArray(3);
-		// Normals
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offset_of(&Vertex::normals));
+		// Normals, normalized shorts
+		glVertexAttribPointer(4, 3, GL_SHORT, GL_TRUE, sizeof(Vertex), (void*)offset_of(&Vertex::normals));
 		glEnableVertexAttribArray(4);
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		RenderState::current().bindBuffer(GL_ARRAY_BUFFER, 0);
+		RenderState::current().bindVertexArray(0);
 	}
 
 	ml::vec3 Mesh::center() {
-		//TODO: Calculate center
-		//		ml::vec3 result;
-		//		for(auto& vertex : vertices){
-		//			result *= vertex.positions;
-		//		}
+		return m_bounds.center();
 	}
 
 	void Mesh::draw(Shader& shader) {
@@ -239,33 +307,66 @@ namespace glpp {
 //		}
 //		glActiveTexture(GL_TEXTURE0);
 
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+		RenderState::current().bindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, m_indexCount, m_indexType, 0);
 	}
 
+    /**
+     * How translucent geometry is blended
+     * Sorted: alpha blending, which is only correct when drawn back to front
+     * WeightedBlended: order-independent approximation, no sorting needed @see WeightedBlendedOIT
+     */
+    enum class Transparency {
+        Sorted,
+        WeightedBlended
+    };
+
     class Renderer {
+        Transparency                        m_transparency = Transparency::Sorted;
+        std::unique_ptr<WeightedBlendedOIT> m_oit;
+
       public:
         size_t width, height;
         explicit Renderer() {
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            state().setBlend(BlendState::alpha());
+            state().setPointSize(5.0f);
+        }
+
+        /* Tracks the bound objects, use it to inspect the issued and skipped GL calls */
+        RenderState& state() {
+            return RenderState::current();
+        }
+
+        void setTransparency(Transparency transparency) {
+            m_transparency = transparency;
+        }
+        Transparency transparency() const {
+            return m_transparency;
+        }
+        /* The targets and shaders of the weighted blended mode, created on first use */
+        WeightedBlendedOIT& oit() {
+            if(!m_oit)
+                m_oit = std::make_unique<WeightedBlendedOIT>();
+            return *m_oit;
         }
 
         void drawLine(Mesh& mesh) {
             mesh.bind();
-            glASSERT(glDrawElements(GL_LINE_STRIP, mesh.indicesSize(), GL_UNSIGNED_INT, 0));
+            glASSERT(glDrawElements(GL_LINE_STRIP, mesh.indicesSize(), mesh.indexType(), 0));
         }
 
         void draw(Mesh& mesh) {
             mesh.bind();
-			glPointSize(5.0f);
 //			glLineWidth(5.0f);
 //            glASSERT(glDrawElements(GL_POINTS, mesh.vertices.size(), GL_UNSIGNED_INT, 0));
 //            glASSERT(glDrawElements(GL_LINES, mesh.indicesSize(), GL_UNSIGNED_INT, 0));
-			glASSERT(glDrawElements(GL_TRIANGLES, mesh.indicesSize(), GL_UNSIGNED_INT, 0));
+			glASSERT(glDrawElements(GL_TRIANGLES, mesh.indicesSize(), mesh.indexType(), 0));
 //            glDrawArrays(GL_TRIANGLES, 0, 36);
         }
+        void draw(StreamMesh& mesh) {
+            mesh.bind();
+            glASSERT(glDrawElements(GL_TRIANGLES, mesh.indicesSize(), GL_UNSIGNED_INT, 0));
+        }
         void draw(VertexMesh& mesh) {
             mesh.bind();
             glDrawArrays(GL_LINE, 0, 36);
@@ -0,0 +1,214 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "boundingbox.h"
+#include "common.h"
+#include "mappedfile.h"
+#include "vertex.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace glpp {
+	/* Texture paths of a material, relative to the model */
+	struct MeshMaterial {
+		std::string diffuse, specular;
+	};
+
+	/* A mesh as imported, before it is uploaded */
+	struct MeshData {
+		std::vector<Vertex> vertices;
+		std::vector<Index>  indices;
+		int32_t             material = -1;
+		BoundingBox         bounds;
+	};
+
+	/**
+	 * Layout of a mesh file:
+	 *   MeshFileHeader, a MeshRecord per mesh, the materials as length prefixed strings,
+	 *   then the vertices and indices of every mesh, each aligned to 16 bytes
+	 * Vertices are stored as Vertex structs, such that a mapped file can be uploaded without conversion.
+	 * The header records the version, the size of a Vertex and the size and modification time of the source,
+	 * a file that doesn't match any of them is ignored and imported again.
+	 */
+	struct MeshFileHeader {
+		char     magic[8];
+		uint32_t version;
+		uint32_t vertexSize, indexSize;
+		uint32_t meshCount, materialCount;
+		uint32_t padding;
+		uint64_t sourceSize;
+		int64_t  sourceTime;
+	};
+	struct MeshRecord {
+		uint64_t vertexOffset, indexOffset;
+		uint32_t vertexCount, indexCount;
+		int32_t  material;
+		float    min[3], max[3];
+		uint32_t padding;
+	};
+
+	/* A mesh file mapped into memory, the vertices and indices are read in place */
+	class MeshFile {
+		static constexpr char magic[8] = "GLPPMSH";
+
+		MappedFile                m_file;
+		const MeshRecord*         m_records = nullptr;
+		uint32_t                  m_meshes  = 0;
+		std::vector<MeshMaterial> m_materials;
+
+		static size_t align(size_t offset) { return (offset + 15) & ~size_t(15); }
+
+	  public:
+		static constexpr uint32_t version = 2;
+
+		/* Map a mesh file, it is invalid unless it was written for the same source and Vertex layout */
+		MeshFile(const std::filesystem::path& path, uint64_t sourceSize, int64_t sourceTime);
+
+		/* Write meshes and materials to path, through a temporary file such that readers never see a partial one */
+		static bool write(const std::filesystem::path& path, const std::vector<MeshData>& meshes, const std::vector<MeshMaterial>& materials,
+						  uint64_t sourceSize, int64_t sourceTime);
+
+		inline bool   valid() const { return m_records != nullptr; }
+		inline size_t meshes() const { return m_meshes; }
+
+		std::span<const Vertex> vertices(size_t mesh) const {
+			const MeshRecord& record = m_records[mesh];
+			return {reinterpret_cast<const Vertex*>(m_file.data() + record.vertexOffset), record.vertexCount};
+		}
+		std::span<const Index> indices(size_t mesh) const {
+			const MeshRecord& record = m_records[mesh];
+			return {reinterpret_cast<const Index*>(m_file.data() + record.indexOffset), record.indexCount};
+		}
+		inline int32_t material(size_t mesh) const { return m_records[mesh].material; }
+		BoundingBox    bounds(size_t mesh) const {
+			const MeshRecord& record = m_records[mesh];
+			return {{record.min[0], record.min[1], record.min[2]}, {record.max[0], record.max[1], record.max[2]}};
+		}
+		inline const std::vector<MeshMaterial>& materials() const { return m_materials; }
+	};
+
+	MeshFile::MeshFile(const std::filesystem::path& path, uint64_t sourceSize, int64_t sourceTime): m_file(path) {
+		const std::byte* data = m_file.data();
+		const size_t     size = m_file.size();
+		MeshFileHeader   header{};
+		if(size < sizeof(header))
+			return;
+		std::memcpy(&header, data, sizeof(header));
+		if(std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version || header.vertexSize != sizeof(Vertex) ||
+		   header.indexSize != sizeof(Index) || header.sourceSize != sourceSize || header.sourceTime != sourceTime)
+			return;
+
+		size_t offset = sizeof(header) + header.meshCount * sizeof(MeshRecord);
+		if(offset > size)
+			return;
+		auto string = [&](std::string& value) {
+			uint32_t length = 0;
+			if(offset + sizeof(length) > size)
+				return false;
+			std::memcpy(&length, data + offset, sizeof(length));
+			offset += sizeof(length);
+			if(offset + length > size)
+				return false;
+			value.assign(reinterpret_cast<const char*>(data + offset), length);
+			offset += length;
+			return true;
+		};
+		m_materials.resize(header.materialCount);
+		for(auto& material: m_materials) {
+			if(!string(material.diffuse) || !string(material.specular))
+				return;
+		}
+		// Every mesh has to lie within the file, such that the spans never read past the mapping
+		const auto* records = reinterpret_cast<const MeshRecord*>(data + sizeof(header));
+		for(uint32_t i = 0; i < header.meshCount; i++) {
+			const MeshRecord& record = records[i];
+			if(record.vertexOffset % 16 != 0 || record.indexOffset % 16 != 0 ||
+			   record.vertexOffset + uint64_t(record.vertexCount) * sizeof(Vertex) > size ||
+			   record.indexOffset + uint64_t(record.indexCount) * sizeof(Index) > size)
+				return;
+		}
+		m_records = records;
+		m_meshes  = header.meshCount;
+	}
+
+	bool MeshFile::write(const std::filesystem::path& path, const std::vector<MeshData>& meshes, const std::vector<MeshMaterial>& materials,
+						 uint64_t sourceSize, int64_t sourceTime) {
+		MeshFileHeader header{};
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.version       = version;
+		header.vertexSize    = sizeof(Vertex);
+		header.indexSize     = sizeof(Index);
+		header.meshCount     = static_cast<uint32_t>(meshes.size());
+		header.materialCount = static_cast<uint32_t>(materials.size());
+		header.sourceSize    = sourceSize;
+		header.sourceTime    = sourceTime;
+
+		std::vector<char> strings;
+		for(const auto& material: materials) {
+			for(const std::string* value: {&material.diffuse, &material.specular}) {
+				const auto length = static_cast<uint32_t>(value->size());
+				strings.insert(strings.end(), reinterpret_cast<const char*>(&length), reinterpret_cast<const char*>(&length) + sizeof(length));
+				strings.insert(strings.end(), value->begin(), value->end());
+			}
+		}
+		std::vector<MeshRecord> records(meshes.size());
+		size_t                  offset = align(sizeof(header) + records.size() * sizeof(MeshRecord) + strings.size());
+		for(size_t i = 0; i < meshes.size(); i++) {
+			const MeshData& mesh   = meshes[i];
+			MeshRecord&     record = records[i];
+			record.vertexCount  = static_cast<uint32_t>(mesh.vertices.size());
+			record.indexCount   = static_cast<uint32_t>(mesh.indices.size());
+			record.material     = mesh.material;
+			record.vertexOffset = offset;
+			offset              = align(offset + mesh.vertices.size() * sizeof(Vertex));
+			record.indexOffset  = offset;
+			offset              = align(offset + mesh.indices.size() * sizeof(Index));
+			record.min[0]       = mesh.bounds.min.x();
+			record.min[1]       = mesh.bounds.min.y();
+			record.min[2]       = mesh.bounds.min.z();
+			record.max[0]       = mesh.bounds.max.x();
+			record.max[1]       = mesh.bounds.max.y();
+			record.max[2]       = mesh.bounds.max.z();
+		}
+
+		std::error_code error;
+		std::filesystem::create_directories(path.parent_path(), error);
+		std::filesystem::path temporary = path;
+		temporary += ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary);
+			auto          pad = [&file] {
+				static constexpr char zeros[16]{};
+				const auto            position = static_cast<size_t>(file.tellp());
+				file.write(zeros, static_cast<std::streamsize>(align(position) - position));
+			};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(MeshRecord)));
+			file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+			for(const auto& mesh: meshes) {
+				pad();
+				file.write(reinterpret_cast<const char*>(mesh.vertices.data()), static_cast<std::streamsize>(mesh.vertices.size() * sizeof(Vertex)));
+				pad();
+				file.write(reinterpret_cast<const char*>(mesh.indices.data()), static_cast<std::streamsize>(mesh.indices.size() * sizeof(Index)));
+			}
+			if(!file)
+				return false;
+		}
+		std::filesystem::rename(temporary, path, error);
+		if(error) {
+			std::cerr << "Could not store mesh cache " << path << ": " << error.message() << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+#endif //MESHCACHE_H
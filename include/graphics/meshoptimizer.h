@@ -0,0 +1,248 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "common.h"
+#include "vertex.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * Average cache miss ratio, the amount of vertices transformed per triangle with a FIFO post transform cache
+	 * 0.5 is the optimum of a large regular grid, 3 means nothing is reused.
+	 */
+	float acmr(const std::vector<Index>& indices, size_t vertexCount, size_t cacheSize = 16) {
+		if(indices.size() < 3)
+			return 0.0f;
+		std::vector<size_t> cachedAt(vertexCount, 0);
+		size_t              time = cacheSize + 1, misses = 0;
+		for(Index index: indices) {
+			if(time - cachedAt[index] > cacheSize) {
+				cachedAt[index] = time++;
+				misses++;
+			}
+		}
+		return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+	}
+
+	/**
+	 * Merge vertices with equal attributes and drop the triangles that became degenerate
+	 * @param tolerance vertices whose positions and texture coordinates round to the same multiple of it are merged,
+	 * eg. a closing vertex of a circle that only differs by the error of sin(2 pi). 0 merges exact copies only.
+	 * @return amount of vertices removed
+	 */
+	size_t weldVertices(std::vector<Vertex>& vertices, std::vector<Index>& indices, float tolerance = 0.0f) {
+		using Key = std::array<int64_t, 13>;
+		struct Hash {
+			size_t operator()(const Key& key) const {
+				uint64_t hash = 14695981039346656037ull;
+				for(int64_t value: key)
+					hash = (hash ^ static_cast<uint64_t>(value)) * 1099511628211ull;
+				return static_cast<size_t>(hash);
+			}
+		};
+		auto exact = [](float value) {
+			uint32_t bits;
+			value = value == 0.0f ? 0.0f : value; // -0 equals 0
+			std::memcpy(&bits, &value, sizeof(bits));
+			return static_cast<int64_t>(bits);
+		};
+		auto rounded = [&](float value) { return tolerance > 0.0f ? std::llround(value / tolerance) : exact(value); };
+
+		std::unordered_map<Key, Index, Hash> unique;
+		unique.reserve(vertices.size());
+		std::vector<Index>  remap(vertices.size());
+		std::vector<Vertex> welded;
+		welded.reserve(vertices.size());
+		for(size_t i = 0; i < vertices.size(); i++) {
+			const Vertex& v   = vertices[i];
+			const Key     key = {rounded(v.positions.x()), rounded(v.positions.y()), rounded(v.positions.z()),
+								 exact(v.color.r()),     exact(v.color.g()),     exact(v.color.b()),     exact(v.color.a()),
+								 v.normals.x(),          v.normals.y(),          v.normals.z(),
+								 rounded(v.texCoords.x()), rounded(v.texCoords.y()), exact(static_cast<float>(v.textureSlot))};
+			auto [it, inserted] = unique.try_emplace(key, static_cast<Index>(welded.size()));
+			if(inserted)
+				welded.push_back(v);
+			remap[i] = it->second;
+		}
+
+		size_t kept = 0;
+		for(size_t i = 0; i + 2 < indices.size(); i += 3) {
+			const Index a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+			if(a == b || b == c || a == c)
+				continue;
+			indices[kept++] = a;
+			indices[kept++] = b;
+			indices[kept++] = c;
+		}
+		indices.resize(kept);
+
+		const size_t removed = vertices.size() - welded.size();
+		vertices             = std::move(welded);
+		return removed;
+	}
+
+	/**
+	 * Reorder triangles such that their vertices are still in the post transform cache (Tipsify, Sander et al. 2007)
+	 * Triangles are emitted in fans around vertices, the next fan is picked among the vertices just emitted
+	 * that are still in the cache once all of their triangles are drawn.
+	 * @return the first triangle of every cluster, the runs between jumps that optimizeOverdraw() may reorder
+	 */
+	std::vector<size_t> optimizeVertexCache(std::vector<Index>& indices, size_t vertexCount, size_t cacheSize = 16) {
+		const size_t triangles = indices.size() / 3;
+		// Triangles around every vertex, as offsets into one array
+		std::vector<uint32_t> offsets(vertexCount + 1, 0), adjacency(triangles * 3);
+		for(size_t i = 0; i < triangles * 3; i++)
+			offsets[indices[i] + 1]++;
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		std::vector<uint32_t> live(vertexCount), fill(offsets.begin(), offsets.end() - 1);
+		for(size_t i = 0; i < triangles * 3; i++) {
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			live[indices[i]]++;
+		}
+
+		std::vector<Index>  output;
+		std::vector<size_t> clusters;
+		output.reserve(triangles * 3);
+		std::vector<size_t> cachedAt(vertexCount, 0);
+		std::vector<bool>   emitted(triangles, false);
+		std::vector<Index>  deadEnds, candidates;
+		size_t              time = cacheSize + 1, cursor = 0;
+		int64_t             fan  = vertexCount > 0 && triangles > 0 ? static_cast<int64_t>(indices[0]) : -1;
+		bool                jump = true;
+		while(fan >= 0) {
+			if(jump)
+				clusters.push_back(output.size() / 3);
+			candidates.clear();
+			for(uint32_t a = offsets[size_t(fan)]; a < offsets[size_t(fan) + 1]; a++) {
+				const uint32_t triangle = adjacency[a];
+				if(emitted[triangle])
+					continue;
+				emitted[triangle] = true;
+				for(size_t corner = 0; corner < 3; corner++) {
+					const Index v = indices[triangle * 3 + corner];
+					output.push_back(v);
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if(time - cachedAt[v] > cacheSize)
+						cachedAt[v] = time++;
+				}
+			}
+
+			// The candidate that stays longest in the cache, given the vertices its remaining triangles add
+			fan = -1;
+			size_t best = 0;
+			for(Index v: candidates) {
+				if(live[v] == 0)
+					continue;
+				const size_t age      = time - cachedAt[v];
+				const size_t priority = age + 2 * live[v] <= cacheSize ? age : 0;
+				if(fan < 0 || priority > best) {
+					fan  = v;
+					best = priority;
+				}
+			}
+			jump = fan < 0;
+			while(fan < 0 && !deadEnds.empty()) {
+				const Index v = deadEnds.back();
+				deadEnds.pop_back();
+				if(live[v] > 0)
+					fan = v;
+			}
+			for(; fan < 0 && cursor < vertexCount; cursor++) {
+				if(live[cursor] > 0)
+					fan = static_cast<int64_t>(cursor);
+			}
+		}
+		indices = std::move(output);
+		return clusters;
+	}
+
+	/**
+	 * Order the clusters of optimizeVertexCache() such that those facing away from the center of the mesh come first
+	 * Outer surfaces then tend to occlude the inner ones before they are shaded, while the triangles within a
+	 * cluster keep their cache friendly order (a simplified version of the overdraw pass of Sander et al. 2007).
+	 */
+	void optimizeOverdraw(std::vector<Index>& indices, const std::vector<Vertex>& vertices, const std::vector<size_t>& clusters) {
+		const size_t triangles = indices.size() / 3;
+		if(clusters.size() < 2 || triangles == 0)
+			return;
+		ml::vec3 center(0.0f, 0.0f, 0.0f);
+		for(const auto& vertex: vertices)
+			center = center + vertex.positions;
+		center = center * (1.0f / static_cast<float>(vertices.size()));
+
+		struct Cluster {
+			size_t first, last;
+			float  sort;
+		};
+		std::vector<Cluster> order;
+		order.reserve(clusters.size());
+		for(size_t c = 0; c < clusters.size(); c++) {
+			const size_t last = c + 1 < clusters.size() ? clusters[c + 1] : triangles;
+			// Area weighted centroid and normal of the cluster
+			ml::vec3 centroid(0.0f, 0.0f, 0.0f), normal(0.0f, 0.0f, 0.0f);
+			float    area = 0.0f;
+			for(size_t t = clusters[c]; t < last; t++) {
+				const ml::vec3& a = vertices[indices[t * 3]].positions;
+				const ml::vec3& b = vertices[indices[t * 3 + 1]].positions;
+				const ml::vec3& p = vertices[indices[t * 3 + 2]].positions;
+				const ml::vec3  u = b - a, v = p - a;
+				const ml::vec3  cross(u.y() * v.z() - u.z() * v.y(), u.z() * v.x() - u.x() * v.z(), u.x() * v.y() - u.y() * v.x());
+				const float     weight = std::sqrt(cross.x() * cross.x() + cross.y() * cross.y() + cross.z() * cross.z());
+				centroid               = centroid + (a + b + p) * (weight / 3.0f);
+				normal                 = normal + cross;
+				area += weight;
+			}
+			const ml::vec3 offset = area > 0.0f ? centroid * (1.0f / area) - center : ml::vec3(0.0f, 0.0f, 0.0f);
+			const float    length = std::sqrt(normal.x() * normal.x() + normal.y() * normal.y() + normal.z() * normal.z());
+			const float    facing = length > 0.0f ? (offset.x() * normal.x() + offset.y() * normal.y() + offset.z() * normal.z()) / length : 0.0f;
+			order.push_back({clusters[c], last, facing});
+		}
+		std::stable_sort(order.begin(), order.end(), [](const Cluster& lhs, const Cluster& rhs) { return lhs.sort > rhs.sort; });
+
+		std::vector<Index> sorted;
+		sorted.reserve(indices.size());
+		for(const auto& cluster: order)
+			sorted.insert(sorted.end(), indices.begin() + std::ptrdiff_t(cluster.first * 3), indices.begin() + std::ptrdiff_t(cluster.last * 3));
+		indices = std::move(sorted);
+	}
+
+	/* Reorder the vertices in the order the indices first use them, such that vertex fetches are sequential, unused ones are dropped */
+	void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<Index>& indices) {
+		constexpr Index     unused = std::numeric_limits<Index>::max();
+		std::vector<Index>  remap(vertices.size(), unused);
+		std::vector<Vertex> ordered;
+		ordered.reserve(vertices.size());
+		for(Index& index: indices) {
+			if(remap[index] == unused) {
+				remap[index] = static_cast<Index>(ordered.size());
+				ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices = std::move(ordered);
+	}
+
+	/**
+	 * Weld, reorder for the vertex cache, reduce overdraw and reorder for vertex fetch, in that order
+	 * Meant for meshes that are uploaded once, a triangle list is expected.
+	 */
+	void optimizeMesh(std::vector<Vertex>& vertices, std::vector<Index>& indices, float weldTolerance = 0.0f) {
+		weldVertices(vertices, indices, weldTolerance);
+		const std::vector<size_t> clusters = optimizeVertexCache(indices, vertices.size());
+		optimizeOverdraw(indices, vertices, clusters);
+		optimizeVertexFetch(vertices, indices);
+	}
+}
+
+#endif //MESHOPTIMIZER_H
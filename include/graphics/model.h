@@ -4,111 +4,183 @@
 //#include "utils/logging.h"
 
 #include "graphics/mesh.h"
+#include "graphics/meshcache.h"
+#include "graphics/meshoptimizer.h"
+#include "graphics/textureloader.h"
+#include "threadpool.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
-#include <stb_image.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
 #include <string>
+#include <system_error>
 #include <vector>
 
 namespace glpp {
+	/**
+	 * Meshes loaded from a model file
+	 * Loading goes through three stages: Assimp imports the scene, the meshes are converted in parallel
+	 * on the thread pool, and only the final stage uploads them on the GL thread.
+	 * Meshes are welded and reordered for the vertex cache while converting, see optimizeMesh().
+	 * The converted meshes are written to a mesh file in the cache directory, later loads map that file
+	 * and go straight to the upload, skipping Assimp altogether.
+	 * Textures are only loaded on request through a TextureLoader, such that they never block the load of the meshes.
+	 */
 	class Model {
 		// model data
-		std::vector<Mesh> meshes;
-		std::string       directory;
+		std::vector<Mesh>         meshes;
+		std::vector<MeshMaterial> materials;
+		// Index into materials per mesh, -1 without material
+		std::vector<int32_t>      meshMaterials;
+		// Diffuse texture per material, empty until loadTextures()
+		std::vector<std::shared_ptr<AsyncTexture>> textures;
+		std::string               directory;
 
-		void                 loadModel(const std::string& path);
-		void                 processNode(aiNode* node, const aiScene* scene);
-		std::vector<Vertex>  processVertices(aiMesh* mesh);
-		std::vector<Index>   processIndices(aiMesh* mesh);
-		Mesh                 processMesh(aiMesh* mesh, const aiScene* scene);
-		std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType textureType);
+		bool                  loadCached(const std::filesystem::path& cache, uint64_t sourceSize, int64_t sourceTime);
+		std::vector<MeshData> importModel(const std::string& path);
+		static void           collectMeshes(const aiNode* node, std::vector<unsigned int>& order);
+		static MeshData       processMesh(const aiMesh* mesh);
+		static std::string    materialTexture(const aiMaterial* material, aiTextureType type);
 
 	  public:
-		explicit Model(const std::string& path) {
-			loadModel(path);
-		}
+		/* @param cacheDirectory where converted meshes are kept, empty to import with Assimp on every load */
+		explicit Model(const std::string& path,
+					   const std::filesystem::path& cacheDirectory = std::filesystem::temp_directory_path() / "glpp-meshes");
+
+		/* Textures that are still loading are drawn with the placeholder of their loader */
 		inline void draw(Shader& shader) {
-			for(auto& mesh: meshes)
-				mesh.draw(shader);
+			for(size_t i = 0; i < meshes.size(); i++) {
+				const int32_t material = meshMaterials[i];
+				if(material >= 0 && static_cast<size_t>(material) < textures.size() && textures[material])
+					textures[material]->bind(0);
+				meshes[i].draw(shader);
+			}
 		}
+		/* Queue the diffuse textures of the materials, draw() binds them once they are uploaded */
+		void loadTextures(TextureLoader& loader, bool flip = false);
+		inline size_t                           size() const { return meshes.size(); }
+		/* Texture paths of the materials, relative to the directory of the model */
+		inline const std::vector<MeshMaterial>& getMaterials() const { return materials; }
 	};
 
-	void Model::loadModel(const std::string& path) {
-		Assimp::Importer import;
-		const aiScene*   scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-		if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-			logging::error(format("ERROR::ASSIMP::{}", import.GetErrorString()));
-			return;
-		}
+	Model::Model(const std::string& path, const std::filesystem::path& cacheDirectory) {
 		directory = path.substr(0, path.find_last_of('/'));
-		processNode(scene->mRootNode, scene);
-	}
-	void Model::processNode(aiNode* node, const aiScene* scene) {
-		for(unsigned int i = 0; i < node->mNumMeshes; i++) {
-			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			meshes.push_back(processMesh(mesh, scene));
+
+		std::error_code       error;
+		const auto            sourceSize = static_cast<uint64_t>(std::filesystem::file_size(path, error));
+		const auto            sourceTime = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+		std::filesystem::path cache;
+		if(!cacheDirectory.empty()) {
+			// Models with the same name in different directories get their own file
+			char name[32];
+			std::snprintf(name, sizeof(name), "-%016zx.mesh", std::hash<std::string>()(std::filesystem::absolute(path, error).string()));
+			cache = cacheDirectory / (std::filesystem::path(path).stem().string() + name);
+			if(loadCached(cache, sourceSize, sourceTime))
+				return;
 		}
-		for(unsigned int i = 0; i < node->mNumChildren; i++) {
-			processNode(node->mChildren[i], scene);
+
+		std::vector<MeshData> imported = importModel(path);
+		if(!cache.empty() && !imported.empty())
+			MeshFile::write(cache, imported, materials, sourceSize, sourceTime);
+		meshes.reserve(imported.size());
+		for(auto& mesh: imported) {
+			meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices));
+			meshMaterials.push_back(mesh.material);
 		}
 	}
-	std::vector<Vertex> Model::processVertices(aiMesh* mesh) {
-		std::vector<Vertex> vertices;
-		// Fill vertices
-		for(unsigned int i = 0; i < mesh->mNumVertices; i++) {
-			Vertex vertex;
-			auto&  positions = mesh->mVertices[i];
-			auto&  normals   = mesh->mNormals[i];
-			auto&  texCoords = mesh->mTextureCoords[0][i];
-
-			vertex.positions = {positions.x, positions.y, positions.z};
-			vertex.normals   = {static_cast<short>(normals.x),
-                              static_cast<short>(normals.y),
-                              static_cast<short>(normals.z)};
-			if(mesh->mTextureCoords[0]) {
-				vertex.texCoords = {texCoords.x, texCoords.y};
-			}
-			vertices.push_back(vertex);
+
+	void Model::loadTextures(TextureLoader& loader, bool flip) {
+		textures.resize(materials.size());
+		for(size_t i = 0; i < materials.size(); i++) {
+			if(!materials[i].diffuse.empty() && !textures[i])
+				textures[i] = loader.load(directory + "/" + materials[i].diffuse, flip);
 		}
-		return vertices;
 	}
-	std::vector<Index> Model::processIndices(aiMesh* mesh) {
-		std::vector<Index> indices;
-		for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
-			aiFace face = mesh->mFaces[i];
-			for(unsigned int j = 00; j < face.mNumIndices; j++) {
-				indices.push_back(face.mIndices[j]);
-			}
+
+	bool Model::loadCached(const std::filesystem::path& cache, uint64_t sourceSize, int64_t sourceTime) {
+		MeshFile file(cache, sourceSize, sourceTime);
+		if(!file.valid())
+			return false;
+		materials = file.materials();
+		meshes.reserve(file.meshes());
+		for(size_t i = 0; i < file.meshes(); i++) {
+			// Uploaded straight from the mapping, the vertices aren't kept on the CPU
+			meshes.emplace_back(file.vertices(i), file.indices(i), file.bounds(i));
+			meshMaterials.push_back(file.material(i));
 		}
-		return indices;
+		return true;
 	}
-	Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-		std::vector<Vertex>  vertices = processVertices(mesh);
-		std::vector<Index>   indices  = processIndices(mesh);
-		std::vector<Texture> textures;
-		if(mesh->mMaterialIndex >= 0) {
-			aiMaterial*          material     = scene->mMaterials[mesh->mMaterialIndex];
-			std::vector<Texture> diffuseMaps  = loadMaterialTextures(material, aiTextureType_DIFFUSE, TextureType::Diffuse);
-			std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, TextureType::Specular);
-			textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-			textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+
+	std::vector<MeshData> Model::importModel(const std::string& path) {
+		Assimp::Importer import;
+		const aiScene*   scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+		if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+			logging::error("ERROR::ASSIMP::{}"_format(import.GetErrorString()));
+			return {};
 		}
 
-		return Mesh(vertices, indices, textures);
+		materials.resize(scene->mNumMaterials);
+		for(unsigned int i = 0; i < scene->mNumMaterials; i++) {
+			materials[i] = {materialTexture(scene->mMaterials[i], aiTextureType_DIFFUSE),
+							materialTexture(scene->mMaterials[i], aiTextureType_SPECULAR)};
+		}
+
+		// Meshes in the order the nodes reference them, converted independently of each other
+		std::vector<unsigned int> order;
+		collectMeshes(scene->mRootNode, order);
+		std::vector<MeshData> imported(order.size());
+		ThreadPool::global().parallelFor(
+			order.size(),
+			[&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; i++)
+					imported[i] = processMesh(scene->mMeshes[order[i]]);
+			},
+			1);
+		return imported;
+	}
+
+	void Model::collectMeshes(const aiNode* node, std::vector<unsigned int>& order) {
+		order.insert(order.end(), node->mMeshes, node->mMeshes + node->mNumMeshes);
+		for(unsigned int i = 0; i < node->mNumChildren; i++)
+			collectMeshes(node->mChildren[i], order);
 	}
 
-	std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType textureType) {
-		std::vector<Texture> textures;
-		for(unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
-			aiString str;
-			mat->GetTexture(type, i, &str);
-			//			Texture texture(directory + str.C_Str());
-			//			texture.type = textureType;
-			//			textures.push_back(texture);
+	MeshData Model::processMesh(const aiMesh* mesh) {
+		MeshData data;
+		data.material = static_cast<int32_t>(mesh->mMaterialIndex);
+		data.vertices.resize(mesh->mNumVertices);
+		for(unsigned int i = 0; i < mesh->mNumVertices; i++) {
+			Vertex&           vertex   = data.vertices[i];
+			const aiVector3D& position = mesh->mVertices[i];
+			vertex.positions           = {position.x, position.y, position.z};
+			if(mesh->HasNormals()) {
+				const aiVector3D& normal = mesh->mNormals[i];
+				vertex.normals           = {packNormal(normal.x), packNormal(normal.y), packNormal(normal.z)};
+			}
+			if(mesh->mTextureCoords[0])
+				vertex.texCoords = {mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y};
+			data.bounds.expand(vertex.positions);
 		}
-		return textures;
+
+		// Faces are triangulated, so most have 3 indices
+		data.indices.reserve(size_t(mesh->mNumFaces) * 3);
+		for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
+			const aiFace& face = mesh->mFaces[i];
+			data.indices.insert(data.indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+		}
+		// Done once here, the cached file stores the optimized mesh
+		optimizeMesh(data.vertices, data.indices);
+		return data;
+	}
+
+	std::string Model::materialTexture(const aiMaterial* material, aiTextureType type) {
+		aiString path;
+		if(material->GetTextureCount(type) == 0 || material->GetTexture(type, 0, &path) != AI_SUCCESS)
+			return {};
+		return path.C_Str();
 	}
 }
 
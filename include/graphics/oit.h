@@ -0,0 +1,125 @@
+#ifndef OIT_H
+#define OIT_H
+
+#include "common.h"
+#include "debug.h"
+#include "framebuffer.h"
+#include "renderstate.h"
+#include "shaders.h"
+#include "uniformbuffer.h"
+
+#include <array>
+#include <optional>
+
+namespace glpp {
+	/**
+	 * Weighted blended order-independent transparency
+	 * Translucent geometry is drawn in any order into an RGBA16F accumulation and an R8 revealage target,
+	 * composite() then resolves them onto the framebuffer that was bound at begin().
+	 * Draws between begin() and composite() have to use shader(), which writes both targets.
+	 */
+	class WeightedBlendedOIT {
+		std::optional<Framebuffer> m_targets;
+		Shader                     m_shader, m_composite;
+		// Loaded when compositing onto a multisampled target for the first time
+		std::optional<Shader>      m_compositeMultisample;
+		std::filesystem::path      m_resources;
+		UniformHandle              m_drawID;
+		unsigned int               emptyVAO{};
+		// The target and viewport to composite onto
+		GLint                m_target = 0;
+		std::array<GLint, 4> m_viewport{};
+
+	  public:
+		explicit WeightedBlendedOIT(const std::filesystem::path& resources = GLPP_RESOURCES):
+			m_shader(resources / "oit_shaders"), m_composite(resources / "oit_composite"), m_resources(resources),
+			m_drawID(m_shader.uniform("drawID")) {
+			glGenVertexArrays(1, &emptyVAO);
+			m_shader.bindUniformBlock("Frame", FrameData::binding);
+			m_shader.bindStorageBlock("Transforms", transformsBinding);
+			m_composite.setUniform(m_composite.uniform("accumulation"), 0);
+			m_composite.setUniform(m_composite.uniform("revealage"), 1);
+		}
+		~WeightedBlendedOIT() {
+			RenderState::current().deletedVertexArray(emptyVAO);
+			glDeleteVertexArrays(1, &emptyVAO);
+		}
+		WeightedBlendedOIT(const WeightedBlendedOIT&) = delete;
+		WeightedBlendedOIT& operator=(const WeightedBlendedOIT&) = delete;
+
+		inline Shader&              shader() { return m_shader; }
+		/* Index into the Transforms buffer, the projection comes from the Frame block like in the scene shader */
+		inline const UniformHandle& drawIDUniform() const { return m_drawID; }
+
+		/**
+		 * Redirect drawing into the accumulation targets, which cover the current viewport
+		 * The depth buffer of the current target is copied, such that opaque geometry still hides translucent geometry.
+		 * A multisampled depth buffer can't be blitted into a single sampled one, so the targets take the sample count of the current target.
+		 */
+		void begin();
+		/* Blend the accumulated translucent geometry onto the target that was bound at begin() */
+		void composite();
+	};
+
+	void WeightedBlendedOIT::begin() {
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_target);
+		glGetIntegerv(GL_VIEWPORT, m_viewport.data());
+		GLint samples = 0;
+		glGetIntegerv(GL_SAMPLES, &samples);
+		// Blits from a multisampled framebuffer need identical rectangles, so the targets extend to the far corner of the viewport
+		const auto width  = static_cast<size_t>(m_viewport[0] + m_viewport[2]);
+		const auto height = static_cast<size_t>(m_viewport[1] + m_viewport[3]);
+		if(m_targets && m_targets->samples() != samples)
+			m_targets.reset();
+		if(!m_targets)
+			m_targets.emplace(width, height, std::vector<GLenum>{GL_RGBA16F, GL_R8}, true, samples);
+		else
+			m_targets->resize(width, height);
+		m_targets->bind();
+		glViewport(m_viewport[0], m_viewport[1], m_viewport[2], m_viewport[3]);
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_target);
+		glASSERT(glBlitFramebuffer(m_viewport[0], m_viewport[1], m_viewport[0] + m_viewport[2], m_viewport[1] + m_viewport[3],
+								   m_viewport[0], m_viewport[1], m_viewport[0] + m_viewport[2], m_viewport[1] + m_viewport[3],
+								   GL_DEPTH_BUFFER_BIT, GL_NEAREST));
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_targets->id());
+
+		const std::array<GLfloat, 4> nothing = {0.0f, 0.0f, 0.0f, 0.0f};
+		const std::array<GLfloat, 4> revealed = {1.0f, 1.0f, 1.0f, 1.0f};
+		glClearBufferfv(GL_COLOR, 0, nothing.data());
+		glClearBufferfv(GL_COLOR, 1, revealed.data());
+
+		// Sum the weighted colors, and multiply the revealage by 1 - alpha of every fragment
+		RenderState::current().setBlend({true, GL_ONE, GL_ONE});
+		glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+		RenderState::current().invalidateBlend();
+		RenderState::current().setDepth(DepthState::translucent());
+	}
+
+	void WeightedBlendedOIT::composite() {
+		glBindFramebuffer(GL_FRAMEBUFFER, m_target);
+		glViewport(m_viewport[0], m_viewport[1], m_viewport[2], m_viewport[3]);
+
+		RenderState& state = RenderState::current();
+		state.setDepth(DepthState::disabled());
+		state.setBlend({true, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA});
+		if(m_targets->samples() > 0) {
+			if(!m_compositeMultisample) {
+				m_compositeMultisample.emplace(m_resources / "oit_composite_multisample");
+				m_compositeMultisample->setUniform(m_compositeMultisample->uniform("accumulation"), 0);
+				m_compositeMultisample->setUniform(m_compositeMultisample->uniform("revealage"), 1);
+			}
+			m_compositeMultisample->setUniform(m_compositeMultisample->uniform("samples"), static_cast<int>(m_targets->samples()));
+			m_compositeMultisample->use();
+		} else {
+			m_composite.use();
+		}
+		state.bindTexture(0, m_targets->textureTarget(), m_targets->colorTexture(0));
+		state.bindTexture(1, m_targets->textureTarget(), m_targets->colorTexture(1));
+		state.bindVertexArray(emptyVAO);
+		glASSERT(glDrawArrays(GL_TRIANGLES, 0, 3));
+		state.setBlend(BlendState::alpha());
+	}
+}
+
+#endif //OIT_H
@@ -0,0 +1,300 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "debug.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * Frame profiler with scoped CPU zones and GPU timer queries
+	 * GPU times are measured with a pair of GL_TIMESTAMP queries per zone, such that GPU zones may be nested.
+	 * The results are only read once they are available, a few frames later, such that profiling never waits for the GPU.
+	 * Frames are delimited by frame(), which Window::display() calls.
+	 * @see GLPP_PROFILE
+	 */
+	class Profiler {
+	  public:
+		struct Zone {
+			std::string name;
+			int         depth;
+			// Milliseconds since the start of the frame
+			double cpuStart = 0.0, cpuEnd = 0.0;
+			// Milliseconds measured on the GPU, negative if not measured or not (yet) available
+			double gpu = -1.0;
+		};
+		struct Frame {
+			// Microseconds since the profiler was created
+			double            start    = 0.0;
+			double            duration = 0.0;
+			std::vector<Zone> zones;
+			// Values sampled once per frame, eg. input latency
+			std::vector<std::pair<std::string, double>> counters;
+		};
+
+		/* Identifies a zone of a frame, returned by begin() and passed to end() */
+		struct ZoneHandle {
+			uint64_t frame;
+			size_t   index;
+		};
+
+		/* Amount of frames in flight before the query results are read */
+		static constexpr size_t latency = 4;
+		/* Amount of completed frames kept for the overlay and trace export */
+		static constexpr size_t historySize = 300;
+
+	  private:
+		using Clock = std::chrono::steady_clock;
+
+		/* The timestamps at the begin and end of a zone, 0 if the zone isn't measured on the GPU */
+		struct GpuQueries {
+			GLuint begin = 0, end = 0;
+		};
+		struct PendingFrame {
+			Frame                   frame;
+			std::vector<GpuQueries> queries; // Per zone
+			bool                    used = false;
+		};
+
+		Clock::time_point                   m_epoch = Clock::now();
+		std::array<PendingFrame, latency>   m_frames;
+		size_t                              m_current = 0;
+		// Counts the frames, such that end() can ignore zones of a frame that frame() already finished
+		uint64_t                            m_frameNumber = 0;
+		std::vector<size_t>                 m_stack;
+		std::vector<GLuint>                 m_queryPool;
+		std::deque<Frame>                   m_history;
+		bool                                m_enabled = true;
+
+		double now() const {
+			return std::chrono::duration<double, std::micro>(Clock::now() - m_epoch).count();
+		}
+		GLuint acquireQuery() {
+			if(m_queryPool.empty()) {
+				GLuint query;
+				glGenQueries(1, &query);
+				return query;
+			}
+			GLuint query = m_queryPool.back();
+			m_queryPool.pop_back();
+			return query;
+		}
+		/* Move the results of a frame into the history, if all of its queries are available */
+		bool collect(PendingFrame& pending, bool force);
+		void release(PendingFrame& pending) {
+			for(const auto& query: pending.queries) {
+				if(query.begin != 0)
+					m_queryPool.insert(m_queryPool.end(), {query.begin, query.end});
+			}
+			pending.queries.clear();
+		}
+
+		Profiler() { m_frames[0].frame.start = now(); }
+
+	  public:
+		~Profiler() = default;
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+
+		static Profiler& instance() {
+			static Profiler profiler;
+			return profiler;
+		}
+
+		inline void enable(bool enabled) { m_enabled = enabled; }
+		inline bool enabled() const { return m_enabled; }
+
+		/**
+		 * Start a zone, zones may be nested
+		 * @param gpu also measure the GPU time
+		 * @return the zone, to be passed to end()
+		 */
+		ZoneHandle begin(std::string name, bool gpu = false);
+		/* End a zone, ignored if frame() already closed it */
+		void       end(ZoneHandle zone);
+
+		/* Record a value for the current frame, shown next to the zones */
+		void counter(std::string name, double value) {
+			m_frames[m_current].frame.counters.emplace_back(std::move(name), value);
+		}
+
+		/* Finish the current frame and start the next one */
+		void frame();
+
+		/**
+		 * Drop the history, the frames in flight and the open zones, eg. such that tests don't see each other's frames
+		 * Zones begun before are ignored when they end.
+		 */
+		void reset();
+
+		/* Completed frames, the oldest first */
+		inline const std::deque<Frame>& history() const { return m_history; }
+
+		/**
+		 * Write the history in the Chrome trace event format, open it with chrome://tracing or Perfetto
+		 * GPU zones are written to a separate track, starting at the CPU time they were issued.
+		 */
+		bool exportChromeTrace(const std::filesystem::path& path) const;
+
+		/* Measures the scope it lives in */
+		class ScopedZone {
+			ZoneHandle m_zone;
+
+		  public:
+			explicit ScopedZone(std::string name, bool gpu = false):
+				m_zone(Profiler::instance().begin(std::move(name), gpu)) {}
+			~ScopedZone() { Profiler::instance().end(m_zone); }
+			ScopedZone(const ScopedZone&) = delete;
+			ScopedZone& operator=(const ScopedZone&) = delete;
+		};
+	};
+
+	Profiler::ZoneHandle Profiler::begin(std::string name, bool gpu) {
+		PendingFrame& pending = m_frames[m_current];
+		const double  start   = (now() - pending.frame.start) / 1000.0;
+		pending.frame.zones.push_back({std::move(name), static_cast<int>(m_stack.size()), start, start});
+		GpuQueries queries;
+		if(m_enabled && gpu) {
+			queries = {acquireQuery(), acquireQuery()};
+			glQueryCounter(queries.begin, GL_TIMESTAMP);
+		}
+		pending.queries.push_back(queries);
+		m_stack.push_back(pending.frame.zones.size() - 1);
+		return {m_frameNumber, pending.frame.zones.size() - 1};
+	}
+
+	void Profiler::end(ZoneHandle zone) {
+		// The zone was open during frame(), which closed it and may have recycled its frame
+		if(zone.frame != m_frameNumber)
+			return;
+		PendingFrame& pending = m_frames[m_current];
+		if(pending.queries[zone.index].end != 0)
+			glQueryCounter(pending.queries[zone.index].end, GL_TIMESTAMP);
+		pending.frame.zones[zone.index].cpuEnd = (now() - pending.frame.start) / 1000.0;
+		if(!m_stack.empty())
+			m_stack.pop_back();
+	}
+
+	bool Profiler::collect(PendingFrame& pending, bool force) {
+		if(!pending.used)
+			return true;
+		auto available = [](GLuint query) {
+			GLint result = GL_FALSE;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &result);
+			return result == GL_TRUE;
+		};
+		// Nested zones end out of order, the end of the zone ended last isn't necessarily the last query
+		for(size_t i = 0; i < pending.queries.size() && !force; i++) {
+			if(pending.queries[i].end != 0 && !available(pending.queries[i].end))
+				return false;
+		}
+		for(size_t i = 0; i < pending.queries.size(); i++) {
+			const GpuQueries& queries = pending.queries[i];
+			// When forced, results that still aren't available are dropped instead of waited for
+			if(queries.end != 0 && available(queries.begin) && available(queries.end)) {
+				GLuint64 begin = 0, end = 0;
+				glGetQueryObjectui64v(queries.begin, GL_QUERY_RESULT, &begin);
+				glGetQueryObjectui64v(queries.end, GL_QUERY_RESULT, &end);
+				pending.frame.zones[i].gpu = static_cast<double>(end - begin) / 1e6;
+			}
+		}
+		release(pending);
+		m_history.push_back(std::move(pending.frame));
+		if(m_history.size() > historySize)
+			m_history.pop_front();
+		pending = PendingFrame{};
+		return true;
+	}
+
+	void Profiler::frame() {
+		// Close zones that are still open, eg. when frame() is called from within a zone
+		while(!m_stack.empty())
+			end({m_frameNumber, m_stack.back()});
+
+		PendingFrame& finished = m_frames[m_current];
+		const double  time     = now();
+		finished.frame.duration = (time - finished.frame.start) / 1000.0;
+		finished.used           = true;
+
+		// Read all frames whose queries are available, oldest first
+		for(size_t i = 1; i < latency; i++) {
+			if(!collect(m_frames[(m_current + i) % latency], false))
+				break;
+		}
+		m_current = (m_current + 1) % latency;
+		m_frameNumber++;
+		// The ring is full, the oldest frame has to make room without waiting
+		collect(m_frames[m_current], true);
+		m_frames[m_current].frame.start = time;
+	}
+
+	void Profiler::reset() {
+		for(auto& pending: m_frames) {
+			release(pending);
+			pending = PendingFrame{};
+		}
+		m_stack.clear();
+		m_history.clear();
+		m_current = 0;
+		// Handles of zones begun before refer to an older frame, so end() ignores them
+		m_frameNumber++;
+		m_frames[0].frame.start = now();
+	}
+
+	bool Profiler::exportChromeTrace(const std::filesystem::path& path) const {
+		std::ofstream file(path);
+		if(!file) {
+			logging::error("Failed to open trace file: {}"_format(path.string()));
+			return false;
+		}
+		file << "{\"traceEvents\":[";
+		bool first  = true;
+		auto escape = [](const std::string& name) {
+			std::string escaped;
+			for(char c: name) {
+				if(c == '"' || c == '\\')
+					escaped += '\\';
+				escaped += c;
+			}
+			return escaped;
+		};
+		auto event = [&](const std::string& name, const char* category, int thread, double start, double duration) {
+			file << (first ? "\n" : ",\n")
+				 << R"({"name":")" << escape(name) << R"(","cat":")" << category
+				 << R"(","ph":"X","pid":0,"tid":)" << thread
+				 << R"(,"ts":)" << start << R"(,"dur":)" << duration << "}";
+			first = false;
+		};
+		for(auto& frame: m_history) {
+			event("Frame", "frame", 0, frame.start, frame.duration * 1000.0);
+			for(auto& [name, value]: frame.counters) {
+				file << ",\n"
+					 << R"({"name":")" << escape(name) << R"(","ph":"C","pid":0,"ts":)" << frame.start
+					 << R"(,"args":{"value":)" << value << "}}";
+			}
+			for(auto& zone: frame.zones) {
+				event(zone.name, "cpu", 0, frame.start + zone.cpuStart * 1000.0, (zone.cpuEnd - zone.cpuStart) * 1000.0);
+				if(zone.gpu >= 0.0)
+					event(zone.name, "gpu", 1, frame.start + zone.cpuStart * 1000.0, zone.gpu * 1000.0);
+			}
+		}
+		file << "\n]}\n";
+		return static_cast<bool>(file);
+	}
+}
+
+#define GLPP_PROFILE_CONCAT_(a, b) a##b
+#define GLPP_PROFILE_CONCAT(a, b) GLPP_PROFILE_CONCAT_(a, b)
+/* Measure the CPU time of the current scope */
+#define GLPP_PROFILE(name) glpp::Profiler::ScopedZone GLPP_PROFILE_CONCAT(profileZone, __LINE__)(name)
+/* Measure the CPU and GPU time of the current scope */
+#define GLPP_PROFILE_GPU(name) glpp::Profiler::ScopedZone GLPP_PROFILE_CONCAT(profileZone, __LINE__)(name, true)
+
+#endif //PROFILER_H
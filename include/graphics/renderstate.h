@@ -0,0 +1,248 @@
+#ifndef RENDERSTATE_H
+#define RENDERSTATE_H
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstddef>
+
+namespace glpp {
+	enum class PolygonMode : GLenum {
+		Point = GL_POINT,
+		Line  = GL_LINE,
+		Fill  = GL_FILL
+	};
+
+	struct BlendState {
+		bool   enabled     = false;
+		GLenum source      = GL_ONE;
+		GLenum destination = GL_ZERO;
+
+		bool operator==(const BlendState&) const = default;
+
+		static BlendState alpha() { return {true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA}; }
+		static BlendState disabled() { return {}; }
+	};
+
+	/* Depth testing and writing, translucent geometry is tested against but doesn't write the depth buffer */
+	struct DepthState {
+		bool test  = false;
+		bool write = true;
+
+		bool operator==(const DepthState&) const = default;
+
+		static DepthState opaque() { return {true, true}; }
+		static DepthState translucent() { return {true, false}; }
+		static DepthState disabled() { return {}; }
+	};
+
+	/**
+	 * Location of a uniform in a specific program, looked up once
+	 * @see Shader::uniform
+	 */
+	struct UniformHandle {
+		GLuint program  = 0;
+		GLint  location = -1;
+
+		inline bool valid() const { return location != -1; }
+	};
+
+	/**
+	 * Shadows the OpenGL state that is changed every draw call and skips calls that wouldn't change it
+	 * All binds of the library go through RenderState::current(), such that the shadow stays in sync.
+	 * Call invalidate() after code outside of the library changed the state (eg. ImGui).
+	 */
+	class RenderState {
+	  public:
+		static constexpr size_t maxTextureUnits = 32;
+
+		struct Counters {
+			size_t issued  = 0;
+			size_t skipped = 0;
+		};
+
+	  private:
+		// A value no object name can have, forces the next call to be issued
+		static constexpr GLuint unknown = ~0u;
+		static constexpr std::array<GLenum, 3> textureTargets = {GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP};
+		static constexpr std::array<GLenum, 6> bufferTargets  = {GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER,
+																 GL_DRAW_INDIRECT_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_PACK_BUFFER};
+
+		GLuint                                                          m_program;
+		GLuint                                                          m_vertexArray;
+		std::array<GLuint, bufferTargets.size()>                        m_buffers;
+		std::array<std::array<GLuint, textureTargets.size()>, maxTextureUnits> m_textures;
+		GLuint                                                          m_activeUnit;
+		BlendState                                                      m_blend;
+		bool                                                            m_blendKnown;
+		DepthState                                                      m_depth;
+		bool                                                            m_depthKnown;
+		PolygonMode                                                     m_polygonMode;
+		bool                                                            m_polygonModeKnown;
+		float                                                           m_pointSize;
+		float                                                           m_lineWidth;
+		Counters                                                        m_counters;
+
+		/* Returns whether the call has to be issued, and updates the shadow value */
+		template<typename T>
+		inline bool change(T& shadow, const T& value) {
+			if(shadow == value) {
+				m_counters.skipped++;
+				return false;
+			}
+			shadow = value;
+			m_counters.issued++;
+			return true;
+		}
+		static constexpr int indexOf(const auto& targets, GLenum target) {
+			for(size_t i = 0; i < targets.size(); i++)
+				if(targets[i] == target)
+					return static_cast<int>(i);
+			return -1;
+		}
+
+	  public:
+		RenderState() { invalidate(); }
+
+		/* The state of the current context, the library renders from a single context */
+		static RenderState& current() {
+			static RenderState state;
+			return state;
+		}
+
+		/* Forget all shadowed state, every next call is issued */
+		void invalidate() {
+			m_program     = unknown;
+			m_vertexArray = unknown;
+			m_buffers.fill(unknown);
+			for(auto& unit: m_textures)
+				unit.fill(unknown);
+			m_activeUnit       = unknown;
+			m_blendKnown       = false;
+			m_depthKnown       = false;
+			m_polygonModeKnown = false;
+			m_pointSize        = -1.0f;
+			m_lineWidth        = -1.0f;
+		}
+
+		void useProgram(GLuint program) {
+			if(change(m_program, program))
+				glUseProgram(program);
+		}
+		void bindVertexArray(GLuint vertexArray) {
+			if(change(m_vertexArray, vertexArray))
+				glBindVertexArray(vertexArray);
+		}
+		/**
+		 * Bind a buffer to a target
+		 * GL_ELEMENT_ARRAY_BUFFER is part of the vertex array state and always issued
+		 */
+		void bindBuffer(GLenum target, GLuint buffer) {
+			int index = indexOf(bufferTargets, target);
+			if(index == -1) {
+				m_counters.issued++;
+				glBindBuffer(target, buffer);
+			} else if(change(m_buffers[index], buffer)) {
+				glBindBuffer(target, buffer);
+			}
+		}
+		void activeTexture(GLuint unit) {
+			if(change(m_activeUnit, unit))
+				glActiveTexture(GL_TEXTURE0 + unit);
+		}
+		void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+			int index = indexOf(textureTargets, target);
+			if(index != -1 && unit < maxTextureUnits && m_textures[unit][index] == texture) {
+				m_counters.skipped++;
+				return;
+			}
+			activeTexture(unit);
+			if(index != -1 && unit < maxTextureUnits)
+				m_textures[unit][index] = texture;
+			m_counters.issued++;
+			glBindTexture(target, texture);
+		}
+
+		void setBlend(const BlendState& blend) {
+			if(m_blendKnown && m_blend == blend) {
+				m_counters.skipped++;
+				return;
+			}
+			m_counters.issued++;
+			if(blend.enabled) {
+				glEnable(GL_BLEND);
+				glBlendFunc(blend.source, blend.destination);
+			} else {
+				glDisable(GL_BLEND);
+			}
+			m_blend      = blend;
+			m_blendKnown = true;
+		}
+		/* Blend state was changed outside of setBlend(), eg. per draw buffer with glBlendFunci */
+		void invalidateBlend() { m_blendKnown = false; }
+		void setDepth(const DepthState& depth) {
+			if(m_depthKnown && m_depth == depth) {
+				m_counters.skipped++;
+				return;
+			}
+			m_counters.issued++;
+			if(depth.test)
+				glEnable(GL_DEPTH_TEST);
+			else
+				glDisable(GL_DEPTH_TEST);
+			glDepthMask(depth.write ? GL_TRUE : GL_FALSE);
+			m_depth      = depth;
+			m_depthKnown = true;
+		}
+		void setPolygonMode(PolygonMode mode) {
+			if(m_polygonModeKnown && m_polygonMode == mode) {
+				m_counters.skipped++;
+				return;
+			}
+			m_counters.issued++;
+			glPolygonMode(GL_FRONT_AND_BACK, static_cast<GLenum>(mode));
+			m_polygonMode      = mode;
+			m_polygonModeKnown = true;
+		}
+		void setPointSize(float size) {
+			if(change(m_pointSize, size))
+				glPointSize(size);
+		}
+		void setLineWidth(float width) {
+			if(change(m_lineWidth, width))
+				glLineWidth(width);
+		}
+
+		/**
+		 * Deleting an object that is bound resets the binding to 0 in OpenGL,
+		 * and its name may be reused, so the shadow has to forget it.
+		 */
+		void deletedProgram(GLuint program) {
+			if(m_program == program)
+				m_program = unknown;
+		}
+		void deletedVertexArray(GLuint vertexArray) {
+			if(m_vertexArray == vertexArray)
+				m_vertexArray = unknown;
+		}
+		void deletedBuffer(GLuint buffer) {
+			for(auto& bound: m_buffers)
+				if(bound == buffer)
+					bound = unknown;
+		}
+		void deletedTexture(GLuint texture) {
+			for(auto& unit: m_textures)
+				for(auto& bound: unit)
+					if(bound == texture)
+						bound = unknown;
+		}
+
+		inline GLuint program() const { return m_program; }
+
+		/* Amount of GL calls issued and skipped since the last reset */
+		inline const Counters& counters() const { return m_counters; }
+		inline void            resetCounters() { m_counters = {}; }
+	};
+}
+
+#endif //RENDERSTATE_H
@@ -0,0 +1,158 @@
+#ifndef SDFSHAPES_H
+#define SDFSHAPES_H
+
+#include "common.h"
+#include "debug.h"
+#include "renderstate.h"
+#include "shaders.h"
+#include "vertex.h"
+
+#include <vector>
+
+namespace glpp {
+	enum class SDFShape { Circle, Ellipse, RoundedRect, Ring, Arc };
+
+	struct SDFStyle {
+		rgba  fill{1.0f, 1.0f, 1.0f, 1.0f};
+		rgba  stroke{0.0f, 0.0f, 0.0f, 1.0f};
+		float border = 0.0f; // thickness of the stroke inside the edge, in world units
+	};
+
+	/* Per instance attributes of a shape, in the layout of the instance buffer */
+	struct SDFInstance {
+		ml::vec2 center;
+		ml::vec2 halfSize;
+		float    rotation  = 0.0f;
+		float    parameter = 0.0f; // corner radius of rounded rects, thickness of rings and arcs
+		float    border    = 0.0f;
+		float    shape     = 0.0f; // SDFShape
+		ml::vec2 angles;           // start and end of arcs, counter clockwise in radians
+		rgba     fill;
+		rgba     stroke;
+		ml::vec4 imageUV    = ml::vec4(0.0f, 0.0f, 1.0f, 1.0f); // rectangle of the atlas image stretched over the shape
+		float    imageLayer = -1.0f;                            // layer of the image in the atlas bound to unit 0, -1 if untextured
+	};
+
+	/**
+	 * Draws circles, ellipses, rounded rectangles, rings and arcs as one instanced quad each
+	 * The fragment shader evaluates the signed distance to the shape, so edges and borders stay sharp
+	 * at any zoom and antialiased over a pixel, while every shape only costs one instance instead of
+	 * a tessellated mesh. All shapes are issued with a single draw call, or a range of them to keep their order
+	 * between other draws.
+	 */
+	class SDFRenderer {
+		Shader                   m_shader;
+		UniformHandle            m_mvp, m_pixelSize;
+		unsigned int             VAO{}, VBO{};
+		std::vector<SDFInstance> m_instances;
+		size_t                   m_capacity = 0;
+		bool                     m_dirty    = false;
+
+		size_t push(SDFShape shape, const ml::vec2& center, const ml::vec2& halfSize, float parameter, const SDFStyle& style,
+					float rotation = 0.0f, const ml::vec2& angles = {0.0f, 0.0f}) {
+			m_instances.push_back({center, halfSize, rotation, parameter, style.border, static_cast<float>(shape), angles,
+								   style.fill, style.stroke});
+			m_dirty = true;
+			return m_instances.size() - 1;
+		}
+
+	  public:
+		explicit SDFRenderer(const std::filesystem::path& resources = GLPP_RESOURCES):
+			m_shader(resources / "sdf_shaders"), m_mvp(m_shader.uniform("mvp")), m_pixelSize(m_shader.uniform("pixelSize")) {
+			glGenVertexArrays(1, &VAO);
+			glGenBuffers(1, &VBO);
+			RenderState::current().bindVertexArray(VAO);
+			RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+			auto attribute = [](GLuint index, GLint components, size_t offset) {
+				glVertexAttribPointer(index, components, GL_FLOAT, GL_FALSE, sizeof(SDFInstance), (void*)offset);
+				glEnableVertexAttribArray(index);
+				glVertexAttribDivisor(index, 1);
+			};
+			attribute(0, 2, offset_of(&SDFInstance::center));
+			attribute(1, 2, offset_of(&SDFInstance::halfSize));
+			attribute(2, 4, offset_of(&SDFInstance::rotation));
+			attribute(3, 2, offset_of(&SDFInstance::angles));
+			attribute(4, 4, offset_of(&SDFInstance::fill));
+			attribute(5, 4, offset_of(&SDFInstance::stroke));
+			attribute(6, 4, offset_of(&SDFInstance::imageUV));
+			attribute(7, 1, offset_of(&SDFInstance::imageLayer));
+			m_shader.setUniform(m_shader.uniform("atlas"), 0);
+		}
+		~SDFRenderer() {
+			RenderState::current().deletedVertexArray(VAO);
+			RenderState::current().deletedBuffer(VBO);
+			glDeleteVertexArrays(1, &VAO);
+			glDeleteBuffers(1, &VBO);
+		}
+		SDFRenderer(const SDFRenderer&) = delete;
+		SDFRenderer& operator=(const SDFRenderer&) = delete;
+
+		/** Add a shape, @return its index for instance() **/
+		size_t circle(const ml::vec2& center, float radius, const SDFStyle& style) {
+			return push(SDFShape::Circle, center, {radius, radius}, 0.0f, style);
+		}
+		size_t ellipse(const ml::vec2& center, const ml::vec2& radii, const SDFStyle& style, float rotation = 0.0f) {
+			return push(SDFShape::Ellipse, center, radii, 0.0f, style, rotation);
+		}
+		size_t roundedRect(const ml::vec2& center, const ml::vec2& halfSize, float cornerRadius, const SDFStyle& style,
+						   float rotation = 0.0f) {
+			return push(SDFShape::RoundedRect, center, halfSize, cornerRadius, style, rotation);
+		}
+		/* @param radius outer radius, the ring extends thickness inwards */
+		size_t ring(const ml::vec2& center, float radius, float thickness, const SDFStyle& style) {
+			return push(SDFShape::Ring, center, {radius, radius}, thickness, style);
+		}
+		/* Arc with round ends, eg. to mark an angle, from start to end counter clockwise in radians */
+		size_t arc(const ml::vec2& center, float radius, float thickness, float start, float end, const SDFStyle& style) {
+			return push(SDFShape::Arc, center, {radius, radius}, thickness, style, 0.0f, {start, end});
+		}
+
+		/* Add a shape described by its instance attributes, eg. one a Shape keeps */
+		size_t add(const SDFInstance& instance) {
+			m_instances.push_back(instance);
+			m_dirty = true;
+			return m_instances.size() - 1;
+		}
+
+		/* Change a shape after adding it, it is uploaded again on the next draw */
+		SDFInstance& instance(size_t index) {
+			m_dirty = true;
+			return m_instances[index];
+		}
+		void clear() {
+			m_instances.clear();
+			m_dirty = true;
+		}
+		inline size_t size() const { return m_instances.size(); }
+		inline Shader& shader() { return m_shader; }
+
+		/* @param pixelSize world units per pixel, the quads are grown by it to fit the antialiased edge */
+		void draw(const ml::mat4& mvp, float pixelSize) { draw(mvp, pixelSize, 0, m_instances.size()); }
+		/* Draw the shapes [first, first + count) */
+		void draw(const ml::mat4& mvp, float pixelSize, size_t first, size_t count);
+	};
+
+	void SDFRenderer::draw(const ml::mat4& mvp, float pixelSize, size_t first, size_t count) {
+		if(count == 0 || first + count > m_instances.size())
+			return;
+		RenderState& state = RenderState::current();
+		state.bindVertexArray(VAO);
+		if(m_dirty) {
+			state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+			const size_t bytes = m_instances.size() * sizeof(SDFInstance);
+			if(m_instances.size() > m_capacity) {
+				m_capacity = m_instances.size();
+				glASSERT(glBufferData(GL_ARRAY_BUFFER, bytes, m_instances.data(), GL_DYNAMIC_DRAW));
+			} else {
+				glASSERT(glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, m_instances.data()));
+			}
+			m_dirty = false;
+		}
+		m_shader.use();
+		m_shader.setUniform(m_mvp, mvp);
+		m_shader.setUniform(m_pixelSize, pixelSize);
+		glASSERT(glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count), static_cast<GLuint>(first)));
+	}
+}
+
+#endif //SDFSHAPES_H
@@ -0,0 +1,261 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include "renderstate.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <glad/glad.h>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace glpp {
+	struct ShaderStage {
+		GLenum      type;
+		std::string source;
+	};
+
+	/**
+	 * A linked program and its active uniforms, shared by every Shader built from the same stage sources
+	 * Uniform values are program state, so they are shared as well.
+	 */
+	struct Program {
+		struct Uniform {
+			GLenum type;
+			GLint  location;
+		};
+		GLuint                                   id;
+		std::unordered_map<std::string, Uniform> uniforms;
+		// Indices of the uniform and shader storage blocks by block name
+		std::unordered_map<std::string, GLuint> uniformBlocks, storageBlocks;
+
+		/* Takes ownership of a linked program and looks up its active uniforms */
+		explicit Program(GLuint program): id(program) {
+			GLint count = 0, maxLength = 0;
+			glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+			glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+			std::string name(static_cast<size_t>(std::max(maxLength, 1)), '\0');
+			for(GLint i = 0; i < count; i++) {
+				GLsizei length = 0;
+				GLint   size   = 0;
+				GLenum  type   = 0;
+				glGetActiveUniform(id, static_cast<GLuint>(i), maxLength, &length, &size, &type, name.data());
+				std::string uniform = name.substr(0, static_cast<size_t>(length));
+				// Arrays are reported by their first element
+				if(uniform.ends_with("[0]"))
+					uniform.erase(uniform.size() - 3);
+				// Members of uniform blocks have no location
+				GLint location = glGetUniformLocation(id, uniform.c_str());
+				if(location != -1)
+					uniforms[uniform] = {type, location};
+			}
+
+			GLint blocks = 0;
+			glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+			for(GLint i = 0; i < blocks; i++) {
+				GLint length = 0;
+				glGetActiveUniformBlockiv(id, static_cast<GLuint>(i), GL_UNIFORM_BLOCK_NAME_LENGTH, &length);
+				std::string block(static_cast<size_t>(std::max(length, 1)), '\0');
+				glGetActiveUniformBlockName(id, static_cast<GLuint>(i), length, &length, block.data());
+				block.resize(static_cast<size_t>(length));
+				uniformBlocks[block] = static_cast<GLuint>(i);
+			}
+			// Storage blocks can only be queried through the program interface of OpenGL 4.3
+			if(!GLAD_GL_VERSION_4_3)
+				return;
+			glGetProgramInterfaceiv(id, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &blocks);
+			for(GLint i = 0; i < blocks; i++) {
+				const GLenum property = GL_NAME_LENGTH;
+				GLint        length   = 0;
+				glGetProgramResourceiv(id, GL_SHADER_STORAGE_BLOCK, static_cast<GLuint>(i), 1, &property, 1, nullptr, &length);
+				std::string block(static_cast<size_t>(std::max(length, 1)), '\0');
+				glGetProgramResourceName(id, GL_SHADER_STORAGE_BLOCK, static_cast<GLuint>(i), length, &length, block.data());
+				block.resize(static_cast<size_t>(length));
+				storageBlocks[block] = static_cast<GLuint>(i);
+			}
+		}
+		~Program() {
+			RenderState::current().deletedProgram(id);
+			glDeleteProgram(id);
+		}
+		Program(const Program&) = delete;
+		Program& operator=(const Program&) = delete;
+	};
+
+	/**
+	 * Compiles and links programs once per set of stage sources
+	 * Requests for stages that are already linked share the live program, and linked programs are
+	 * written to the cache directory with glGetProgramBinary, such that later runs skip compiling.
+	 * Binaries are keyed by the stage sources and the driver, a binary the driver rejects is compiled again.
+	 * Only use the cache on the GL thread.
+	 */
+	class ShaderCache {
+		std::unordered_map<uint64_t, std::weak_ptr<Program>> m_programs;
+		std::filesystem::path                                m_directory;
+		uint64_t                                             m_driver = 0;
+
+		static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+			for(size_t i = 0; i < size; i++)
+				hash = (hash ^ static_cast<const unsigned char*>(data)[i]) * 1099511628211ull;
+			return hash;
+		}
+
+		std::filesystem::path binaryPath(uint64_t key);
+		bool                  restore(GLuint program, uint64_t key);
+		void                  store(GLuint program, uint64_t key);
+		static bool           compile(GLuint program, const std::vector<ShaderStage>& stages);
+
+	  public:
+		/* @param directory where program binaries are kept, empty to keep programs in memory only */
+		explicit ShaderCache(std::filesystem::path directory = std::filesystem::temp_directory_path() / "glpp-shaders"):
+			m_directory(std::move(directory)) {}
+
+		static ShaderCache& global() {
+			static ShaderCache cache;
+			return cache;
+		}
+
+		inline void                         setDirectory(std::filesystem::path directory) { m_directory = std::move(directory); }
+		inline const std::filesystem::path& directory() const { return m_directory; }
+
+		/* Hash of the stage sources, independent of the order of the stages */
+		static uint64_t hash(std::vector<ShaderStage> stages) {
+			std::sort(stages.begin(), stages.end(), [](const auto& lhs, const auto& rhs) { return lhs.type < rhs.type; });
+			uint64_t hash = fnv1a(nullptr, 0);
+			for(const auto& stage: stages) {
+				hash = fnv1a(&stage.type, sizeof(stage.type), hash);
+				hash = fnv1a(stage.source.data(), stage.source.size() + 1, hash);
+			}
+			return hash;
+		}
+
+		/* The linked program for the stages, compiled only if it isn't alive or stored already */
+		std::shared_ptr<Program> program(const std::vector<ShaderStage>& stages);
+
+		/* Amount of programs currently shared */
+		size_t size() const {
+			return static_cast<size_t>(std::count_if(m_programs.begin(), m_programs.end(), [](const auto& entry) { return !entry.second.expired(); }));
+		}
+	};
+
+	std::shared_ptr<Program> ShaderCache::program(const std::vector<ShaderStage>& stages) {
+		const uint64_t key = hash(stages);
+		if(auto it = m_programs.find(key); it != m_programs.end()) {
+			if(auto shared = it->second.lock())
+				return shared;
+		}
+
+		GLuint id = glCreateProgram();
+		if(!restore(id, key) && compile(id, stages))
+			store(id, key);
+		auto program    = std::make_shared<Program>(id);
+		m_programs[key] = program;
+		return program;
+	}
+
+	bool ShaderCache::compile(GLuint program, const std::vector<ShaderStage>& stages) {
+		std::vector<GLuint> shaders;
+		for(const auto& stage: stages) {
+			GLuint      shader = glCreateShader(stage.type);
+			const char* source = stage.source.c_str();
+			glShaderSource(shader, 1, &source, nullptr);
+			glCompileShader(shader);
+			GLint compiled = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+			if(compiled == GL_FALSE) {
+				GLchar log[1024];
+				glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+				std::cerr << "ERROR::SHADER_COMPILATION_ERROR of type: " << stage.type << "\n" << log << std::endl;
+			}
+			glAttachShader(program, shader);
+			shaders.push_back(shader);
+		}
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(program);
+		// The stages aren't needed once they are linked
+		for(GLuint shader: shaders) {
+			glDetachShader(program, shader);
+			glDeleteShader(shader);
+		}
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if(linked == GL_FALSE) {
+			GLchar log[1024];
+			glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+			std::cerr << "ERROR::PROGRAM_LINKING_ERROR\n" << log << std::endl;
+		}
+		return linked == GL_TRUE;
+	}
+
+	std::filesystem::path ShaderCache::binaryPath(uint64_t key) {
+		if(m_driver == 0) {
+			m_driver = fnv1a(nullptr, 0);
+			for(GLenum name: {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+				if(auto value = reinterpret_cast<const char*>(glGetString(name)))
+					m_driver = fnv1a(value, std::strlen(value), m_driver);
+			}
+		}
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(fnv1a(&m_driver, sizeof(m_driver), key)));
+		return m_directory / name;
+	}
+
+	bool ShaderCache::restore(GLuint program, uint64_t key) {
+		if(m_directory.empty())
+			return false;
+		std::ifstream file(binaryPath(key), std::ios::binary);
+		if(!file)
+			return false;
+		GLenum format = 0;
+		file.read(reinterpret_cast<char*>(&format), sizeof(format));
+		std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if(!file || binary.empty())
+			return false;
+
+		glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		return linked == GL_TRUE;
+	}
+
+	void ShaderCache::store(GLuint program, uint64_t key) {
+		GLint formats = 0, length = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if(m_directory.empty() || formats == 0 || length == 0)
+			return;
+
+		std::vector<char> binary(static_cast<size_t>(length));
+		GLenum            format = 0;
+		glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+		std::error_code error;
+		std::filesystem::create_directories(m_directory, error);
+		// Write next to the binary and rename, such that other processes never read a partial file
+		const std::filesystem::path path      = binaryPath(key);
+		std::filesystem::path       temporary = path;
+		temporary += ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+			file.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+			if(!file)
+				return;
+		}
+		std::filesystem::rename(temporary, path, error);
+		if(error)
+			std::cerr << "Could not store shader binary " << path << ": " << error.message() << std::endl;
+	}
+}
+
+#endif //SHADERCACHE_H
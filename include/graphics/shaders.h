@@ -5,15 +5,20 @@
 #ifndef LIBRARY_SHADERS_H
 #define LIBRARY_SHADERS_H
 
+#include "renderstate.h"
+#include "shadercache.h"
 #include "types.h"
 #include "utils/include/format.h"
 
 #include <filesystem>
+#include <fstream>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
@@ -52,14 +57,16 @@ namespace glpp {
 		std::unordered_map<std::string, UniformInfo> m_uniforms;
 		GLuint                                       m_rendererID = 0;
 		bool                                         m_compiled   = false;
+		// Shared with every shader built from the same sources, owns m_rendererID
+		std::shared_ptr<Program> m_program;
 
 	  protected:
 		void compileShader(const std::string& shader, GLuint& shaderID);
 		void checkShaderStatus(GLuint& shaderID, GLushort status, GLushort shaderType);
 		void checkCompileErrors(GLuint shader, std::string type);
 		int  getUniformLocation(const std::string& name) const;
-		/* Parse Uniforms from source code to m_uniforms */
-		void parseUniforms();
+		/* The source of a stage, read from its file for paths, throws if the file can't be read */
+		static std::string readSource(const ShaderData& shader);
 
 	  public:
 		/**
@@ -79,9 +86,16 @@ namespace glpp {
 		ShaderData& getShader(ShaderType shaderType);
 		bool        shaderExists(ShaderType shaderType);
 
+		/**
+		 * Add a stage, a linked shader is linked again
+		 * Linked programs are shared by every shader with the same stages, so the shader then uses another program
+		 * and the uniform handles taken before are invalid.
+		 */
 		void addShader(ShaderData&& shader);
 		template<typename... T>
 		void addShader(T... args) { addShader(ShaderData{args...}); }
+		/* Link the stages through the shader cache and take the active uniforms of the program, for shaders built with addShader() */
+		void link();
 
 		void use() const;
         void bind() const;
@@ -101,12 +115,56 @@ namespace glpp {
 			//        }
 			setUniformValue(m_uniforms.at(name).id, value);
 		}
+
+		/**
+		 * Look up a uniform once, such that per draw uploads don't need a string lookup
+		 * @return an invalid handle if the uniform isn't used by the program
+		 */
+		UniformHandle uniform(const std::string& name) const {
+			auto it = m_uniforms.find(name);
+			if(it == m_uniforms.end()) {
+				std::cout << fout("Uniform: '" + name + "' not found in m_shaders.").set_fcolor(red) << std::endl;
+				return {m_rendererID, -1};
+			}
+			return {m_rendererID, it->second.id};
+		}
+
+		/**
+		 * Read a uniform block from the buffer bound to the binding point, eg. a UniformBuffer
+		 * @return false if the program has no such block
+		 */
+		bool bindUniformBlock(const std::string& name, GLuint binding) {
+			if(!m_program)
+				return false;
+			auto it = m_program->uniformBlocks.find(name);
+			if(it == m_program->uniformBlocks.end())
+				return false;
+			glUniformBlockBinding(m_rendererID, it->second, binding);
+			return true;
+		}
+		/* Read a shader storage block from the buffer bound to the binding point, eg. a StorageBuffer */
+		bool bindStorageBlock(const std::string& name, GLuint binding) {
+			if(!m_program)
+				return false;
+			auto it = m_program->storageBlocks.find(name);
+			if(it == m_program->storageBlocks.end())
+				return false;
+			glShaderStorageBlockBinding(m_rendererID, it->second, binding);
+			return true;
+		}
+
+		/* Set the value of a uniform using a handle from uniform(), binds the program if it isn't already */
+		template<typename T>
+		inline void setUniform(const UniformHandle& handle, T value) {
+			if(!handle.valid())
+				return;
+			RenderState::current().useProgram(handle.program);
+			setUniformValue(handle.location, value);
+		}
 	};
 
 	/** Shader class implementations: **/
 	Shader::Shader(std::filesystem::path directory) {
-		m_rendererID = glCreateProgram();
-
 		for(auto& shaderFile: std::filesystem::directory_iterator(directory)) {
 			const std::filesystem::path& filePath = shaderFile.path();
 			std::string                  fileName = filePath.filename();
@@ -114,22 +172,36 @@ namespace glpp {
 			for(std::string_view& word: words) {
 				auto search = fileExtToType.find(std::string(word));
 				if(search != fileExtToType.end())
-					addShader(ShaderData(filePath, search->second));
+					m_shaders.emplace_back(filePath, search->second);
 			}
 		}
-		glLinkProgram(m_rendererID);
-		parseUniforms();
-		m_compiled = true;
+		link();
+	}
+	Shader::Shader(const std::vector<ShaderData>& shaders): m_shaders(shaders) {
+		link();
 	}
-	Shader::Shader(const std::vector<ShaderData>& shaders) {
-		m_rendererID = glCreateProgram();
 
-		for(auto& shader: shaders) {
-			addShader(shader);
-		}
-		glLinkProgram(m_rendererID);
-		m_shaders.insert(m_shaders.end(), shaders.begin(), shaders.end());
-		parseUniforms();
+	std::string Shader::readSource(const ShaderData& shader) {
+		if(shader.sourceType == ShaderData::SourceType::Code)
+			return shader.source;
+		std::ifstream     file(shader.source);
+		std::stringstream source;
+		source << file.rdbuf();
+		// An empty stage would be linked into a program that silently draws nothing
+		if(!file || source.fail())
+			throw std::runtime_error("Failed to read shader: {}"_format(shader.source));
+		return source.str();
+	}
+
+	void Shader::link() {
+		std::vector<ShaderStage> stages;
+		for(auto& shader: m_shaders)
+			stages.push_back({shader.type, readSource(shader)});
+		m_program    = ShaderCache::global().program(stages);
+		m_rendererID = m_program->id;
+		m_uniforms.clear();
+		for(auto& [name, uniform]: m_program->uniforms)
+			m_uniforms[name] = {static_cast<unsigned short>(uniform.type), uniform.location};
 		m_compiled = true;
 	}
 
@@ -145,23 +217,10 @@ namespace glpp {
 		});
 		ASSERT(shaderTypePos == m_shaders.end(),
 			   "Duplicate shader types, shader with type of ShaderType::{} already exists in current shader program."_format(shader.type));
-
-		shader.ID = glCreateShader(shader.type);
-		std::string shaderSource;
-		try {
-			// TODO: optimize for ShaderData::SourceType::Code
-			if(shader.sourceType == ShaderData::SourceType::Path) {
-				shaderSource = fileToStr(shader.source);
-			} else {
-				shaderSource = shader.source;
-			}
-			compileShader(shaderSource, shader.ID);
-			checkShaderStatus(shader.ID, GL_COMPILE_STATUS, shader.type);
-		} catch(std::ifstream::failure& e) {
-			std::cout << "ERROR::SHADER:FILE_NOT_SUCCESSFULLY_READ" << std::endl;
-		}
-		glAttachShader(m_rendererID, shader.ID);
 		m_shaders.emplace_back(std::move(shader));
+		// Attaching to the program would change it for every shader sharing it, the new stages are another program
+		if(m_compiled)
+			link();
 	}
 
 	void Shader::checkShaderStatus(GLuint& shaderID, unsigned short status, unsigned short shaderType) {
@@ -181,44 +240,13 @@ namespace glpp {
 		}
 	}
 	void Shader::use() const {
-		glUseProgram(m_rendererID);
+		RenderState::current().useProgram(m_rendererID);
 	}
     void Shader::bind() const {
-        glUseProgram(m_rendererID);
+        RenderState::current().useProgram(m_rendererID);
     }
 	void Shader::unbind() const {
-		glUseProgram(0);
-	}
-
-	void Shader::parseUniforms() {
-		std::string source;
-		for(auto& shader: m_shaders) {
-			source += shader.sourceType == ShaderData::SourceType::Path ?
-                          fileToStr(shader.source) :
-                          shader.source;
-		}
-
-		TokenReader reader(source);
-		reader.addIgnoreLine("//");
-		reader.addIgnoreUntil("/*", "*/");
-		while(reader.gotoNext("uniform") != std::string::npos) {
-			std::string typeName = reader++;
-			std::string varName  = reader++;
-			// Skip the uniform if it's only used a single time
-			//		if(reader.getCount(varName) == 1)
-			//			continue;
-			// TODO: clean the varName for arrays and set the type to array
-
-			// erase character if it is a semicolon (as glsl uniform expressions end with 'foo;')
-			varName.erase(std::remove_if(varName.begin(), varName.end(), [](char c) { return c == ';'; }), varName.end());
-
-			// Ignore the uniform if it's only used a single time
-			reader++;
-			if(reader.findNext(varName) == std::string::npos) {
-				continue;
-			}
-			m_uniforms[varName] = {getGLTypeFromStr(typeName.c_str()), getUniformLocation(varName)};
-		}
+		RenderState::current().useProgram(0);
 	}
 
 	int Shader::getUniformLocation(const std::string& name) const {
@@ -229,13 +257,8 @@ namespace glpp {
 		return location;
 	}
 
-	Shader::~Shader() {
-		for(auto& shader: m_shaders) {
-			glDetachShader(m_rendererID, shader.ID);
-			glDeleteShader(shader.ID);
-		}
-		glDeleteProgram(m_rendererID);
-	}
+	// The program and its stages are owned by the cache
+	Shader::~Shader() = default;
 
 	ShaderData& Shader::getShader(ShaderType shaderType) {
 		return *std::find_if(m_shaders.begin(), m_shaders.end(), [=](ShaderData type) { return type.type == static_cast<GLushort>(shaderType); });
@@ -3,6 +3,8 @@
 
 #include "math-lib2/include/ml/graphics/color.h"
 #include "ml/vector.h"
+#include "mesh.h"
+#include "meshoptimizer.h"
 #include "renderer.h"
 #include "shapetraits.h" // Defines all shape traits, eg. Drawable, Transformable.
 
@@ -268,6 +270,7 @@ namespace glpp {
 		//int in[3] = {0,segments, 1};
 		//indices.insert(indices.end(), std::begin(in), std::end(in));
 	}
+
 	VertexIndexPair createCircle(const ml::vec3& center, float radius, int segments) {
 		std::vector<Vertex> vertices;
 		std::vector<Index>  indices;
@@ -276,23 +279,27 @@ namespace glpp {
 	}
 
 	Mesh createCircle(const ml::vec3& center, float radius, int segments, rgba color, float startRadians = 0.0f, float endRadians = M_2_PI){
-        rgba  col{1.0f, 1.0f, 1.0f, 1.0f};
-        Index maxI = 0;
         std::vector<Vertex> vertices;
         std::vector<Index> indices;
-
-        vertices.push_back({center, col, {}});
-            for(unsigned int i = 0; i <= segments; i++) {
-                float       theta = 2.0f * M_PI * float(i) / float(segments); // Angle
-                const float x     = sin(theta);
-                const float y     = cos(theta);
-                vertices.push_back({{center.x() + (radius * x), center.y() + (-radius * y), center.z()},
-                                    color,
-                                    {},
-                                    {x, y},
-                                    {}});
-                indices.insert(indices.end(), {maxI, maxI + i, maxI + i + 1});
-            }
+        vertices.reserve(segments + 2);
+        indices.reserve(segments * 3);
+
+        vertices.push_back({center, color, {}});
+        for(int i = 0; i <= segments; i++) {
+            float       theta = 2.0f * M_PI * float(i) / float(segments); // Angle
+            const float x     = sin(theta);
+            const float y     = cos(theta);
+            vertices.push_back({{center.x() + (radius * x), center.y() + (-radius * y), center.z()},
+                                color,
+                                {},
+                                {x, y},
+                                {}});
+            if(i < segments)
+                indices.insert(indices.end(), {0, Index(i + 1), Index(i + 2)});
+        }
+        // The closing rim vertex only differs from the first by the error of sin(2 pi), weld it
+        optimizeMesh(vertices, indices, 1e-5f);
+        return Mesh(std::move(vertices), std::move(indices));
 	}
 
 
@@ -0,0 +1,52 @@
+#ifndef SORTKEY_H
+#define SORTKEY_H
+
+#include <algorithm>
+#include <cstdint>
+
+namespace glpp {
+	/**
+	 * 64 bit draw order key, draws are issued in ascending key order
+	 * The most significant fields decide first:
+	 *   opaque:      layer:8 | 0:1 | shader:12 | texture:12 | depth:24 | unused:7
+	 *   translucent: layer:8 | 1:1 | far-to-near depth:24 | sequence:31
+	 * Within a layer opaque draws come first, grouped by shader and texture to minimise state changes,
+	 * then front to back such that the depth test rejects hidden fragments early.
+	 * Translucent draws follow back to front, draws at the same depth keep their sequence (eg. insertion order).
+	 */
+	struct SortKey {
+		static constexpr int layerShift       = 56;
+		static constexpr int translucentShift = 55;
+		static constexpr int shaderShift      = 43;
+		static constexpr int textureShift     = 31;
+		static constexpr int depthShift       = 7;
+		static constexpr int farDepthShift    = 31;
+
+		static constexpr uint64_t depthMask    = (1u << 24) - 1;
+		static constexpr uint64_t idMask       = (1u << 12) - 1;
+		static constexpr uint64_t sequenceMask = (1u << 31) - 1;
+
+		/* Quantize a depth in [0, 1], 0 being nearest, to 24 bits */
+		static constexpr uint64_t quantize(float depth) {
+			return static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * static_cast<float>(depthMask));
+		}
+
+		/**
+		 * @param shader, texture OpenGL names, only the lowest 12 bits are kept,
+		 *        names that collide are merely not grouped together
+		 */
+		static constexpr uint64_t opaque(uint8_t layer, uint32_t shader, uint32_t texture, float depth) {
+			return uint64_t(layer) << layerShift | (shader & idMask) << shaderShift | (texture & idMask) << textureShift |
+				   quantize(depth) << depthShift;
+		}
+		static constexpr uint64_t translucent(uint8_t layer, float depth, uint64_t sequence) {
+			return uint64_t(layer) << layerShift | uint64_t(1) << translucentShift |
+				   (depthMask - quantize(depth)) << farDepthShift | (sequence & sequenceMask);
+		}
+
+		static constexpr uint8_t layer(uint64_t key) { return static_cast<uint8_t>(key >> layerShift); }
+		static constexpr bool    isTranslucent(uint64_t key) { return (key >> translucentShift) & 1; }
+	};
+}
+
+#endif //SORTKEY_H
@@ -0,0 +1,280 @@
+#ifndef STATICBATCH_H
+#define STATICBATCH_H
+
+#include "common.h"
+#include "debug.h"
+#include "renderstate.h"
+#include "vertex.h"
+
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * First fit suballocator of ranges within a fixed capacity
+	 * Freed ranges are merged with their neighbours, such that the space can be reused by larger ranges.
+	 * Only the bookkeeping is done here, the owner maps the offsets into its buffer.
+	 */
+	class RangeAllocator {
+		// Free ranges keyed by their offset
+		std::map<size_t, size_t> m_free;
+		size_t                   m_capacity = 0;
+		size_t                   m_used     = 0;
+
+	  public:
+		explicit RangeAllocator(size_t capacity = 0) { grow(capacity); }
+
+		/* @return the offset of the range, or nothing if no free range is large enough */
+		std::optional<size_t> allocate(size_t size) {
+			if(size == 0)
+				return std::nullopt;
+			for(auto it = m_free.begin(); it != m_free.end(); ++it) {
+				if(it->second < size)
+					continue;
+				auto [offset, freeSize] = *it;
+				m_free.erase(it);
+				if(freeSize > size)
+					m_free.emplace(offset + size, freeSize - size);
+				m_used += size;
+				return offset;
+			}
+			return std::nullopt;
+		}
+
+		void free(size_t offset, size_t size) {
+			if(size == 0)
+				return;
+			m_used -= size;
+			auto next = m_free.lower_bound(offset);
+			// Merge with the following free range
+			if(next != m_free.end() && offset + size == next->first) {
+				size += next->second;
+				next = m_free.erase(next);
+			}
+			// Merge with the preceding free range
+			if(next != m_free.begin()) {
+				auto previous = std::prev(next);
+				if(previous->first + previous->second == offset) {
+					previous->second += size;
+					return;
+				}
+			}
+			m_free.emplace(offset, size);
+		}
+
+		/* Extend the capacity, the new space is appended as a free range */
+		void grow(size_t capacity) {
+			if(capacity <= m_capacity)
+				return;
+			size_t oldCapacity = m_capacity;
+			m_capacity         = capacity;
+			m_used += capacity - oldCapacity;
+			free(oldCapacity, capacity - oldCapacity);
+		}
+
+		inline size_t capacity() const { return m_capacity; }
+		inline size_t used() const { return m_used; }
+		inline size_t freeRanges() const { return m_free.size(); }
+	};
+
+	/* Tag to add a shape as static, @see Scene::add */
+	struct StaticTag {};
+	inline constexpr StaticTag staticDraw;
+
+	/* Layout of a single command in the GL_DRAW_INDIRECT_BUFFER, defined by OpenGL */
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint  baseVertex;
+		GLuint baseInstance;
+	};
+
+	/**
+	 * Static meshes packed into one shared vertex and index buffer
+	 * Meshes are uploaded once when added, every frame only the list of visible meshes
+	 * is written to an indirect command buffer and drawn with a single glMultiDrawElementsIndirect.
+	 * The vertices are not transformed by the shader, so they should be given in world space.
+	 */
+	class StaticMeshPool {
+		struct Allocation {
+			size_t vertexOffset = 0, vertexCount = 0;
+			size_t indexOffset = 0, indexCount = 0;
+			bool   used        = false;
+		};
+
+		unsigned int VAO{}, VBO{}, EBO{}, commandBuffer{};
+		RangeAllocator m_vertices, m_indices;
+		std::vector<Allocation> m_allocations;
+		std::vector<int>        m_freeHandles;
+
+		std::vector<DrawElementsIndirectCommand> m_commands;
+
+		void setupVertexArray();
+		/* Reallocate a buffer with a larger size and copy the old contents */
+		static void growBuffer(unsigned int& buffer, size_t oldBytes, size_t newBytes);
+
+	  public:
+		/* Handle of a mesh that was not added, eg. because it has no triangles */
+		static constexpr int invalid = -1;
+
+		/**
+		 * @param vertexCapacity initial amount of vertices, grows when needed
+		 * @param indexCapacity initial amount of indices, grows when needed
+		 */
+		explicit StaticMeshPool(size_t vertexCapacity = 1 << 16, size_t indexCapacity = 1 << 18);
+		~StaticMeshPool();
+
+		StaticMeshPool(const StaticMeshPool&) = delete;
+		StaticMeshPool& operator=(const StaticMeshPool&) = delete;
+
+		/**
+		 * Upload a mesh into the shared buffers
+		 * @return a handle to draw and remove the mesh, invalid for a mesh without vertices or indices
+		 */
+		int  add(const std::vector<Vertex>& vertices, const std::vector<Index>& indices);
+		void remove(int handle);
+
+		/* Reset the commands, to be called at the start of the culling pass */
+		inline void clearCommands() { m_commands.clear(); }
+		/* Queue a visible mesh for the next draw */
+		void addCommand(int handle) {
+			if(handle == invalid)
+				return;
+			const Allocation& allocation = m_allocations[handle];
+			m_commands.push_back({static_cast<GLuint>(allocation.indexCount), 1,
+								  static_cast<GLuint>(allocation.indexOffset),
+								  static_cast<GLint>(allocation.vertexOffset),
+								  static_cast<GLuint>(handle)});
+		}
+		/* Draw all queued meshes with a single call */
+		void draw();
+
+		inline size_t size() const { return m_allocations.size() - m_freeHandles.size(); }
+		inline size_t commandCount() const { return m_commands.size(); }
+		inline const std::vector<DrawElementsIndirectCommand>& commands() const { return m_commands; }
+		inline const RangeAllocator& vertexAllocator() const { return m_vertices; }
+		inline const RangeAllocator& indexAllocator() const { return m_indices; }
+	};
+
+	StaticMeshPool::StaticMeshPool(size_t vertexCapacity, size_t indexCapacity):
+		m_vertices(vertexCapacity), m_indices(indexCapacity) {
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+		glGenBuffers(1, &commandBuffer);
+
+		RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertexCapacity, nullptr, GL_STATIC_DRAW);
+		RenderState::current().bindVertexArray(VAO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index) * indexCapacity, nullptr, GL_STATIC_DRAW);
+		setupVertexArray();
+	}
+
+	StaticMeshPool::~StaticMeshPool() {
+		RenderState::current().deletedVertexArray(VAO);
+		RenderState::current().deletedBuffer(VBO);
+		RenderState::current().deletedBuffer(commandBuffer);
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		glDeleteBuffers(1, &commandBuffer);
+	}
+
+	void StaticMeshPool::setupVertexArray() {
+		RenderState::current().bindVertexArray(VAO);
+		RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		// Same attribute locations as Mesh, such that the same shaders can be used
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offset_of(&Vertex::positions));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offset_of(&Vertex::color));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offset_of(&Vertex::texCoords));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offset_of(&Vertex::textureSlot));
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(4, 3, GL_SHORT, GL_TRUE, sizeof(Vertex), (void*)offset_of(&Vertex::normals));
+		glEnableVertexAttribArray(4);
+	}
+
+	void StaticMeshPool::growBuffer(unsigned int& buffer, size_t oldBytes, size_t newBytes) {
+		unsigned int grown;
+		glGenBuffers(1, &grown);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+		glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+		RenderState::current().deletedBuffer(buffer);
+		glDeleteBuffers(1, &buffer);
+		buffer = grown;
+	}
+
+	int StaticMeshPool::add(const std::vector<Vertex>& vertices, const std::vector<Index>& indices) {
+		// Nothing to draw, the allocators have no empty ranges to hand out
+		if(vertices.empty() || indices.empty())
+			return invalid;
+		auto vertexOffset = m_vertices.allocate(vertices.size());
+		auto indexOffset  = m_indices.allocate(indices.size());
+		if(!vertexOffset || !indexOffset) {
+			// Grow both buffers to at least double their size, this is rare as the pool only holds static meshes
+			if(vertexOffset)
+				m_vertices.free(*vertexOffset, vertices.size());
+			if(indexOffset)
+				m_indices.free(*indexOffset, indices.size());
+			size_t vertexCapacity = std::max(m_vertices.capacity() * 2, m_vertices.capacity() + vertices.size());
+			size_t indexCapacity  = std::max(m_indices.capacity() * 2, m_indices.capacity() + indices.size());
+			growBuffer(VBO, sizeof(Vertex) * m_vertices.capacity(), sizeof(Vertex) * vertexCapacity);
+			growBuffer(EBO, sizeof(Index) * m_indices.capacity(), sizeof(Index) * indexCapacity);
+			m_vertices.grow(vertexCapacity);
+			m_indices.grow(indexCapacity);
+			setupVertexArray();
+			vertexOffset = m_vertices.allocate(vertices.size());
+			indexOffset  = m_indices.allocate(indices.size());
+		}
+		ASSERT(vertexOffset && indexOffset, "StaticMeshPool: failed to allocate after growing");
+
+		RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex) * *vertexOffset, sizeof(Vertex) * vertices.size(), vertices.data());
+		RenderState::current().bindVertexArray(VAO);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index) * *indexOffset, sizeof(Index) * indices.size(), indices.data());
+
+		int handle;
+		if(m_freeHandles.empty()) {
+			handle = static_cast<int>(m_allocations.size());
+			m_allocations.emplace_back();
+		} else {
+			handle = m_freeHandles.back();
+			m_freeHandles.pop_back();
+		}
+		m_allocations[handle] = {*vertexOffset, vertices.size(), *indexOffset, indices.size(), true};
+		return handle;
+	}
+
+	void StaticMeshPool::remove(int handle) {
+		if(handle == invalid)
+			return;
+		Allocation& allocation = m_allocations[handle];
+		if(!allocation.used)
+			return;
+		m_vertices.free(allocation.vertexOffset, allocation.vertexCount);
+		m_indices.free(allocation.indexOffset, allocation.indexCount);
+		allocation = Allocation{};
+		m_freeHandles.push_back(handle);
+	}
+
+	void StaticMeshPool::draw() {
+		if(m_commands.empty())
+			return;
+		RenderState::current().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		// Respecifying the whole buffer lets the driver orphan the one that may still be in use by the last frame
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * m_commands.size(), m_commands.data(), GL_STREAM_DRAW);
+
+		RenderState::current().bindVertexArray(VAO);
+		glASSERT(glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(m_commands.size()), 0));
+	}
+}
+
+#endif //STATICBATCH_H
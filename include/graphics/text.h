@@ -2,79 +2,254 @@
 #define TEXT_H
 
 #include "font.h"
-#include "shapes.h"
+#include "renderstate.h"
+#include "shaders.h"
+#include "vertex.h"
 
-#include <utility>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <vector>
 
 namespace glpp {
-std::array<Vertex, 6> createText(float xpos, float ypos, float h, float w, rgba color, float textureID) {
-	Vertex v0({xpos, ypos + h}, color, {}, {0.0f, 0.0f}, textureID);
-	Vertex v1({xpos, ypos}, color, {}, {0.0f, 1.0f}, textureID);
-	Vertex v2({xpos + w, ypos}, color, {}, {1.0f, 1.0f}, textureID);
-	Vertex v3({xpos, ypos + h}, color, {}, {0.0f, 0.0f}, textureID);
-	Vertex v4({xpos + w, ypos}, color, {}, {1.0f, 1.0f}, textureID);
-	Vertex v5({xpos + w, ypos + h}, color, {}, {1.0f, 0.0f}, textureID);
-	return {{v0, v1, v2, v3, v4, v5}};
-}
+	/* Per glyph attributes, in the layout of the instance buffer */
+	struct GlyphInstance {
+		ml::vec4 rect; // left, bottom, right, top
+		ml::vec4 uv;   // u0, v0 at the top, u1, v1 at the bottom
+		rgba     color;
+		float    layer;
+	};
+
+	/**
+	 * Positioned glyphs of a string, in font pixels from the start of its baseline
+	 * Building a layout decodes the string and looks up every glyph, while adding it to a TextBatch only
+	 * offsets and scales the prebuilt quads, so layouts of strings that don't change are kept (see TextCache).
+	 */
+	struct TextLayout {
+		/* Where the glyphs of a code point start */
+		struct Cluster {
+			uint32_t byte, glyph;
+			ml::vec2 pen;
+		};
+		std::vector<GlyphInstance> glyphs;
+		std::vector<Cluster>       clusters;
+		ml::vec4                   bounds{0.0f, 0.0f, 0.0f, 0.0f}; // of the glyph quads, left, bottom, right, top
+		ml::vec2                   pen{0.0f, 0.0f};                // after the last glyph
+		size_t                     bytes      = 0;
+		uint64_t                   generation = 0; // of the font when built
+		uint64_t                   layers     = 0; // mask of the atlas layers holding the glyphs
+
+		/**
+		 * Lay out a UTF-8 string, '\n' starts a new line
+		 * @param keep amount of code points kept from the previous build, eg. the prefix the string shares
+		 * with the one built before, only the rest is laid out
+		 */
+		void build(Font& font, std::string_view text, size_t keep = 0);
+
+		/* Mark the atlas layers of the glyphs as used this frame, such that they aren't evicted before drawing */
+		void touch(Font& font) const {
+			for(uint64_t mask = layers; mask != 0; mask &= mask - 1)
+				font.atlas().touch(std::countr_zero(mask));
+		}
+	};
+
+	void TextLayout::build(Font& font, std::string_view text, size_t keep) {
+		size_t   i = 0, glyph = 0;
+		ml::vec2 start(0.0f, 0.0f);
+		if(keep > 0 && keep >= clusters.size()) {
+			keep  = clusters.size();
+			i     = bytes;
+			glyph = glyphs.size();
+			start = pen;
+		} else if(keep > 0) {
+			i     = clusters[keep].byte;
+			glyph = clusters[keep].glyph;
+			start = clusters[keep].pen;
+		}
+		clusters.resize(keep);
+		glyphs.resize(glyph);
+
+		pen = start;
+		while(i < text.size()) {
+			clusters.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(glyphs.size()), pen});
+			const char32_t codepoint = Font::nextCodepoint(text, i);
+			if(codepoint == '\n') {
+				pen = ml::vec2(0.0f, pen.y() - font.lineHeight());
+				continue;
+			}
+			const Glyph g = font.glyph(codepoint);
+			if(g.layer >= 0) {
+				const float x = pen.x() + g.bearing.x(), y = pen.y() + g.bearing.y();
+				glyphs.push_back({ml::vec4(x, y - g.size.y(), x + g.size.x(), y), g.uv, rgba(1.0f, 1.0f, 1.0f, 1.0f), static_cast<float>(g.layer)});
+			}
+			pen = ml::vec2(pen.x() + g.advance, pen.y());
+		}
+		bytes      = text.size();
+		generation = font.generation();
+
+		// Cheap next to the glyph lookups, so the kept prefix is included instead of tracked separately
+		constexpr float max = std::numeric_limits<float>::max();
+		bounds              = glyphs.empty() ? ml::vec4(0.0f, 0.0f, 0.0f, 0.0f) : ml::vec4(max, max, -max, -max);
+		layers              = 0;
+		for(const auto& instance: glyphs) {
+			bounds = ml::vec4(std::min(bounds.x(), instance.rect.x()), std::min(bounds.y(), instance.rect.y()),
+							  std::max(bounds.z(), instance.rect.z()), std::max(bounds.w(), instance.rect.w()));
+			layers |= uint64_t(1) << std::min(static_cast<int>(instance.layer), 63);
+		}
+	}
+
+	/**
+	 * Glyph quads of many strings in the same font, drawn by a TextRenderer with a single draw call
+	 * Every glyph is one instance referencing the shared atlas of the font, so the strings of a whole
+	 * frame, eg. thousands of tick labels, cost one upload and one draw instead of one per glyph.
+	 * Rebuilding the batch every frame is cheap, only glyphs that differ from the last build are uploaded.
+	 * Glyphs may move in the atlas once they are evicted and pending distance fields appear later,
+	 * rebuild the batch when Font::generation() changed.
+	 */
+	class TextBatch {
+		static constexpr size_t clean = std::numeric_limits<size_t>::max();
+
+		Font&                      m_font;
+		unsigned int               VAO{}, VBO{};
+		std::vector<GlyphInstance> m_glyphs; // as uploaded, past the count as well
+		TextLayout                 m_layout; // scratch for strings added directly
+		size_t                     m_count    = 0;
+		size_t                     m_capacity = 0;
+		size_t                     m_dirty    = clean; // first glyph that changed since the last upload
+
+	  public:
+		explicit TextBatch(Font& font): m_font(font) {
+			glGenVertexArrays(1, &VAO);
+			glGenBuffers(1, &VBO);
+			RenderState::current().bindVertexArray(VAO);
+			RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+			auto attribute = [](GLuint index, GLint components, size_t offset) {
+				glVertexAttribPointer(index, components, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void*)offset);
+				glEnableVertexAttribArray(index);
+				glVertexAttribDivisor(index, 1);
+			};
+			attribute(0, 4, offset_of(&GlyphInstance::rect));
+			attribute(1, 4, offset_of(&GlyphInstance::uv));
+			attribute(2, 4, offset_of(&GlyphInstance::color));
+			attribute(3, 1, offset_of(&GlyphInstance::layer));
+		}
+		~TextBatch() {
+			RenderState::current().deletedVertexArray(VAO);
+			RenderState::current().deletedBuffer(VBO);
+			glDeleteVertexArrays(1, &VAO);
+			glDeleteBuffers(1, &VBO);
+		}
+		TextBatch(const TextBatch&) = delete;
+		TextBatch& operator=(const TextBatch&) = delete;
 
-struct Text: public Drawable {
-	Font                font;
-	std::string         text;
-	float               x, y;
-	float               height, width, scale;
-	rgba                color;
-	std::vector<Vertex> vertices;
-	std::vector<Index>  indices;
-
-  public:
-	Text(std::string text, const std::filesystem::path& fontPath, rgba color, float x, float y, float scale):
-		font(fontPath, scale, 0), text(std::move(text)), x(x), y(y), color(color), scale(scale) {
-		// iterate through all characters
-		int n = 0;
-		vertices.reserve(6 * text.size());
-		std::string::const_iterator c;
-		for(c = text.begin(); c != text.end(); c++) {
-			Character ch = font.getCharacter(*c);
-
-			float xpos = x + ch.bearing.x() * scale;
-			float ypos = y - (ch.size.y() - ch.bearing.y()) * scale;
-
-			float w = ch.size.x() * scale;
-			float h = ch.size.y() * scale;
-
-			std::array<Vertex, 6> bla = createText(xpos, ypos, h, w, color, ch.textureID);
-			memcpy(&vertices[n], &bla[0], 6);
-
-			x += (ch.offset >> 6) * scale; // bitshift by 6 to get value in pixels (2^6 = 64)
-			n += 6;
+		/**
+		 * Add a UTF-8 string, '\n' starts a new line
+		 * @param pen start of the baseline
+		 * @param scale world units per font pixel
+		 * @return the pen after the last glyph
+		 */
+		ml::vec2 add(std::string_view text, ml::vec2 pen, float scale, const rgba& color) {
+			m_layout.build(m_font, text);
+			return add(m_layout, pen, scale, color);
 		}
+
+		/* Add a layout built with the font of this batch, @return the pen after the last glyph */
+		ml::vec2 add(const TextLayout& layout, ml::vec2 pen, float scale, const rgba& color);
+
+		/* Width of the longest line of a string and the height of its lines, in world units */
+		ml::vec2 measure(std::string_view text, float scale);
+
+		/* Start over, glyphs added the same as in the last build aren't uploaded again */
+		inline void clear() { m_count = 0; }
+
+		inline Font&  font() { return m_font; }
+		inline size_t size() const { return m_count; }
+		inline bool   empty() const { return m_count == 0; }
+
+		/* Upload the glyphs that changed and issue the draw, called by TextRenderer */
+		void draw();
+	};
+
+	ml::vec2 TextBatch::add(const TextLayout& layout, ml::vec2 pen, float scale, const rgba& color) {
+		for(const auto& glyph: layout.glyphs) {
+			const GlyphInstance instance{ml::vec4(pen.x() + glyph.rect.x() * scale, pen.y() + glyph.rect.y() * scale,
+												  pen.x() + glyph.rect.z() * scale, pen.y() + glyph.rect.w() * scale),
+										 glyph.uv, color, glyph.layer};
+			if(m_count == m_glyphs.size()) {
+				m_glyphs.push_back(instance);
+				m_dirty = std::min(m_dirty, m_count);
+			} else if(std::memcmp(&m_glyphs[m_count], &instance, sizeof(GlyphInstance)) != 0) {
+				m_glyphs[m_count] = instance;
+				m_dirty           = std::min(m_dirty, m_count);
+			}
+			m_count++;
+		}
+		return ml::vec2(pen.x() + layout.pen.x() * scale, pen.y() + layout.pen.y() * scale);
 	}
-//	Vertex& draw(Renderer& renderer) override {}
-//	Vertex& draw(Renderer& renderer, const DrawSettings& settings) override {
-//		renderer.draw(vertices.data(), vertices.size(), indices.data(), indices.size());
-		//		settings.shader->bind();
-		//		settings.shader->setUniform("textColor", color);
-		//		glActiveTexture(GL_TEXTURE0);
-		//		renderer.getVertexArray().bind();
-		//
-		//		// iterate through all characters
-		//		std::string::const_iterator c;
-		//		for(c = text.begin(); c != text.end(); c++) {
-		//			Character ch = font.getCharacter(*c);
-		//
-		//			float xpos = x + ch.bearing.x * scale;
-		//			float ypos = y - (ch.size.y - ch.bearing.y) * scale;
-		//
-		//			float w = ch.size.x * scale;
-		//			float h = ch.size.y * scale;
-		//
-		//			std::array<Vertex, 6> vertices = createText(xpos, ypos, h, w, color, ch.textureSlot);
-		//			x += (ch.offset >> 6) * scale; // bitshift by 6 to get value in pixels (2^6 = 64)
-		//		}
-		//		renderer.getVertexArray().unbind();
-		//		glBindTexture(GL_TEXTURE_2D, 0);
+
+	ml::vec2 TextBatch::measure(std::string_view text, float scale) {
+		float width = 0.0f, line = 0.0f;
+		int   lines = 1;
+		for(size_t i = 0; i < text.size();) {
+			const char32_t codepoint = Font::nextCodepoint(text, i);
+			if(codepoint == '\n') {
+				width = std::max(width, line);
+				line  = 0.0f;
+				lines++;
+				continue;
+			}
+			line += m_font.glyph(codepoint).advance;
+		}
+		return ml::vec2(std::max(width, line) * scale, static_cast<float>(lines) * m_font.lineHeight() * scale);
 	}
-};
+
+	void TextBatch::draw() {
+		if(m_count == 0)
+			return;
+		RenderState& state = RenderState::current();
+		state.bindVertexArray(VAO);
+		if(m_glyphs.size() > m_capacity) {
+			state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+			m_capacity = m_glyphs.capacity();
+			glASSERT(glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(GlyphInstance), nullptr, GL_DYNAMIC_DRAW));
+			glASSERT(glBufferSubData(GL_ARRAY_BUFFER, 0, m_glyphs.size() * sizeof(GlyphInstance), m_glyphs.data()));
+		} else if(m_dirty < m_glyphs.size()) {
+			state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+			glASSERT(glBufferSubData(GL_ARRAY_BUFFER, m_dirty * sizeof(GlyphInstance), (m_glyphs.size() - m_dirty) * sizeof(GlyphInstance),
+									 &m_glyphs[m_dirty]));
+		}
+		m_dirty = clean;
+		glASSERT(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(m_count)));
+	}
+
+	/**
+	 * Draws TextBatches with alpha blending, sampling each glyph from the atlas of its font
+	 * Distance field fonts are antialiased over a pixel at whatever scale they are drawn.
+	 */
+	class TextRenderer {
+		Shader        m_shader;
+		UniformHandle m_mvp, m_distanceField;
+
+	  public:
+		explicit TextRenderer(const std::filesystem::path& resources = GLPP_RESOURCES):
+			m_shader(resources / "text_shaders"), m_mvp(m_shader.uniform("mvp")), m_distanceField(m_shader.uniform("distanceField")) {
+			m_shader.use();
+			m_shader.setUniform(m_shader.uniform("atlas"), 0);
+		}
+
+		void draw(TextBatch& batch, const ml::mat4& mvp) {
+			if(batch.empty())
+				return;
+			RenderState::current().setBlend(BlendState::alpha());
+			batch.font().atlas().bind(0);
+			m_shader.use();
+			m_shader.setUniform(m_mvp, mvp);
+			m_shader.setUniform(m_distanceField, static_cast<int>(batch.font().mode() == GlyphMode::DistanceField));
+			batch.draw();
+		}
+	};
 }
 
 #endif //TEXT_H
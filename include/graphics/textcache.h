@@ -0,0 +1,126 @@
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include "text.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace glpp {
+	/**
+	 * Keeps the layouts of strings between frames, keyed by the string and the font
+	 * The size is that of the font, layouts are scaled when they are added to a TextBatch, so zooming doesn't
+	 * miss the cache. A layout is built again once the generation of its font changed, ie. glyphs moved in the atlas.
+	 * Strings that change every frame but only at the end, like counters and timers, are kept per id with update(),
+	 * which lays out only the part that differs from the previous string.
+	 * Layouts unused for maxAge frames are dropped, such that labels scrolled out of view don't pile up.
+	 */
+	class TextCache {
+		struct Entry {
+			TextLayout layout;
+			uint64_t   lastUse = 0;
+		};
+		struct Dynamic: Entry {
+			std::string text;
+		};
+		// Looks strings up by std::string_view without copying them
+		struct Hash {
+			using is_transparent = void;
+			size_t operator()(std::string_view text) const { return std::hash<std::string_view>()(text); }
+		};
+		using Layouts = std::unordered_map<std::string, Entry, Hash, std::equal_to<>>;
+
+		std::unordered_map<uint32_t, Layouts> m_layouts; // by font id
+		std::unordered_map<uint64_t, Dynamic> m_dynamic;
+		uint64_t                              m_frame = 1;
+		uint64_t                              m_maxAge;
+		size_t                                m_builds = 0;
+
+	  public:
+		explicit TextCache(uint64_t maxAge = 120): m_maxAge(std::max<uint64_t>(maxAge, 1)) {}
+
+		/* Layout of a string that is drawn again in later frames, eg. a tick label or a legend entry */
+		const TextLayout& get(Font& font, std::string_view text);
+
+		/* Layout of the string currently shown under id, eg. a frame counter, laid out again only where it changed */
+		const TextLayout& update(uint64_t id, Font& font, std::string_view text);
+
+		/* Start a new frame, layouts unused for maxAge frames are dropped */
+		void beginFrame();
+
+		void clear() {
+			m_layouts.clear();
+			m_dynamic.clear();
+		}
+		size_t size() const {
+			size_t size = m_dynamic.size();
+			for(const auto& [font, layouts]: m_layouts)
+				size += layouts.size();
+			return size;
+		}
+		/* Amount of layouts built so far, constant over frames that only draw cached text */
+		inline size_t builds() const { return m_builds; }
+	};
+
+	const TextLayout& TextCache::get(Font& font, std::string_view text) {
+		Layouts& layouts = m_layouts[font.id()];
+		auto     it      = layouts.find(text);
+		bool     created = it == layouts.end();
+		if(created)
+			it = layouts.emplace(std::string(text), Entry{}).first;
+
+		Entry& entry  = it->second;
+		entry.lastUse = m_frame;
+		if(created || entry.layout.generation != font.generation()) {
+			entry.layout.build(font, text);
+			m_builds++;
+		} else {
+			entry.layout.touch(font);
+		}
+		return entry.layout;
+	}
+
+	const TextLayout& TextCache::update(uint64_t id, Font& font, std::string_view text) {
+		auto [it, created] = m_dynamic.try_emplace(id);
+		Dynamic& entry     = it->second;
+		entry.lastUse      = m_frame;
+		const bool current = !created && entry.layout.generation == font.generation();
+		if(current && entry.text == text) {
+			entry.layout.touch(font);
+			return entry.layout;
+		}
+
+		// Keep the code points of the prefix shared with the previous string, unless the glyphs moved in the atlas since
+		size_t keep = 0;
+		if(current) {
+			const auto   mismatch = std::mismatch(entry.text.begin(), entry.text.end(), text.begin(), text.end());
+			const size_t prefix   = static_cast<size_t>(mismatch.first - entry.text.begin());
+			const auto&  clusters = entry.layout.clusters;
+			// A code point is kept if it ends within the prefix
+			while(keep < clusters.size() && (keep + 1 < clusters.size() ? clusters[keep + 1].byte : entry.text.size()) <= prefix)
+				keep++;
+			entry.layout.touch(font);
+		}
+		entry.text = text;
+		entry.layout.build(font, text, keep);
+		m_builds++;
+		return entry.layout;
+	}
+
+	void TextCache::beginFrame() {
+		m_frame++;
+		// Sweeping visits every entry, so it is only done once per maxAge frames
+		if(m_frame % m_maxAge != 0)
+			return;
+		auto stale = [this](const auto& entry) { return entry.second.lastUse + m_maxAge < m_frame; };
+		for(auto& [font, layouts]: m_layouts)
+			std::erase_if(layouts, stale);
+		std::erase_if(m_dynamic, stale);
+	}
+}
+
+#endif //TEXTCACHE_H
@@ -2,6 +2,8 @@
 #define TEXTURE_H
 
 #include "debug.h"
+#include "renderstate.h"
+#include "texturefile.h"
 #include <string>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -52,6 +54,10 @@ namespace glpp {
 
 		Texture() = default;
 		//	Texture(float id);
+		/**
+		 * Load an image, or a texture file written by texturec, whose compressed mipmaps are uploaded as they are
+		 * @param flip ignored for texture files, texturec flips them when it compresses them
+		 */
 		explicit Texture(const std::string& path, bool flip = true, TextureWrap xWrap = TextureWrap::Repeat,
 						 TextureWrap yWrap = TextureWrap::Repeat, TextureFilter filter = TextureFilter::Smooth,
 						 bool useMipmap = true, TextureFilter mipmapFilter = TextureFilter::Smooth);
@@ -70,6 +76,7 @@ namespace glpp {
 		}
 
 		void release(){
+            RenderState::current().deletedTexture(m_rendererID);
             glDeleteTextures(1, &m_rendererID);
             m_rendererID = 0;
 		}
@@ -115,7 +122,7 @@ namespace glpp {
 		stbi_set_flip_vertically_on_load(flip);
 
 		glGenTextures(1, &m_rendererID);
-		glBindTexture(GL_TEXTURE_2D, m_rendererID);
+		RenderState::current().bindTexture(0, GL_TEXTURE_2D, m_rendererID);
 		// Specify some necessary attributes
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -124,6 +131,19 @@ namespace glpp {
 
 		float borderColor[] = {1.0f, 1.0f, 0.0f, 1.0f};
 		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+		if(std::filesystem::path(path).extension() == TextureFile::extension) {
+			TextureFile file(path);
+			if(!file.upload(GL_TEXTURE_2D)) {
+				std::cerr << "Failed to load texture: " << path << std::endl;
+				return;
+			}
+			m_width  = file.width();
+			m_height = file.height();
+			if(file.levels() > 1)
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			return;
+		}
 		// Load data on CPU
 		m_buffer = stbi_load(path.c_str(), &m_width, &m_height, &m_bpp, 0);
 
@@ -145,13 +165,11 @@ namespace glpp {
 
 	unsigned int Texture::bind(unsigned int slot) {
 		m_slot = slot;
-		glActiveTexture(GL_TEXTURE0 + slot); // Specify texture slot
-		glBindTexture(GL_TEXTURE_2D, m_rendererID);
+		RenderState::current().bindTexture(slot, GL_TEXTURE_2D, m_rendererID);
 		return slot;
 	}
 	void Texture::unbind() const {
-		glActiveTexture(GL_TEXTURE0 + m_slot); // Specify texture slot
-		glBindTexture(GL_TEXTURE_2D, 0);
+		RenderState::current().bindTexture(m_slot, GL_TEXTURE_2D, 0);
 	}
 	Texture::~Texture() { release(); }
 	void Texture::resize(int height, int width) {
@@ -0,0 +1,170 @@
+#ifndef TEXTUREFILE_H
+#define TEXTUREFILE_H
+
+#include "blockcompression.h"
+#include "debug.h"
+#include "mappedfile.h"
+#include "renderstate.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <system_error>
+#include <vector>
+
+// S3TC is an extension, the other block formats are core since 4.2
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace glpp {
+	inline GLenum glFormat(BlockFormat format) {
+		switch(format) {
+			case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+			case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+			case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+		return GL_NONE;
+	}
+
+	/**
+	 * Layout of a texture file, a container for block compressed textures in the spirit of KTX2:
+	 *   TextureFileHeader, a TextureLevel per mipmap from the largest down, then the data of every level aligned to 16 bytes
+	 * The levels are stored as the GPU expects them, such that a mapped file is uploaded without conversion.
+	 * Written by tools/texturec, which also generates the mipmaps.
+	 */
+	struct TextureFileHeader {
+		char     magic[8];
+		uint32_t version;
+		uint32_t format; // BlockFormat
+		uint32_t width, height;
+		uint32_t levels;
+		uint32_t padding;
+	};
+	struct TextureLevel {
+		uint64_t offset, size;
+		uint32_t width, height;
+	};
+
+	/* A texture file mapped into memory */
+	class TextureFile {
+		static constexpr char magic[8] = "GLPPTEX";
+
+		MappedFile          m_file;
+		TextureFileHeader   m_header{};
+		const TextureLevel* m_levels = nullptr;
+
+		static size_t align(size_t offset) { return (offset + 15) & ~size_t(15); }
+
+	  public:
+		static constexpr uint32_t version   = 1;
+		static constexpr char     extension[] = ".gltex";
+
+		/* Map a texture file, it is invalid if it isn't one or it is truncated */
+		explicit TextureFile(const std::filesystem::path& path);
+
+		/* Write compressed levels, the largest first, through a temporary file such that readers never see a partial one */
+		static bool write(const std::filesystem::path& path, BlockFormat format, int width, int height, const std::vector<std::vector<uint8_t>>& levels);
+
+		inline bool        valid() const { return m_levels != nullptr; }
+		inline BlockFormat format() const { return static_cast<BlockFormat>(m_header.format); }
+		inline int         width() const { return static_cast<int>(m_header.width); }
+		inline int         height() const { return static_cast<int>(m_header.height); }
+		inline size_t      levels() const { return m_header.levels; }
+		inline const TextureLevel& level(size_t i) const { return m_levels[i]; }
+		std::span<const uint8_t>   data(size_t i) const {
+			return {reinterpret_cast<const uint8_t*>(m_file.data() + m_levels[i].offset), m_levels[i].size};
+		}
+
+		/* Upload every level to the bound texture of target, @return false if the file is invalid */
+		bool upload(GLenum target = GL_TEXTURE_2D) const;
+	};
+
+	TextureFile::TextureFile(const std::filesystem::path& path): m_file(path) {
+		const std::byte* data = m_file.data();
+		const size_t     size = m_file.size();
+		if(size < sizeof(m_header))
+			return;
+		std::memcpy(&m_header, data, sizeof(m_header));
+		if(std::memcmp(m_header.magic, magic, sizeof(magic)) != 0 || m_header.version != version ||
+		   m_header.format > static_cast<uint32_t>(BlockFormat::BC7) || m_header.levels == 0 ||
+		   sizeof(m_header) + m_header.levels * sizeof(TextureLevel) > size)
+			return;
+		// Every level has to lie within the file and hold all of its blocks
+		const auto* levels = reinterpret_cast<const TextureLevel*>(data + sizeof(m_header));
+		for(uint32_t i = 0; i < m_header.levels; i++) {
+			const TextureLevel& level = levels[i];
+			if(level.offset % 16 != 0 || level.offset + level.size > size ||
+			   level.size != BlockCompression::compressedSize(format(), int(level.width), int(level.height)))
+				return;
+		}
+		m_levels = levels;
+	}
+
+	bool TextureFile::write(const std::filesystem::path& path, BlockFormat format, int width, int height,
+							const std::vector<std::vector<uint8_t>>& levels) {
+		TextureFileHeader header{};
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.version = version;
+		header.format  = static_cast<uint32_t>(format);
+		header.width   = static_cast<uint32_t>(width);
+		header.height  = static_cast<uint32_t>(height);
+		header.levels  = static_cast<uint32_t>(levels.size());
+
+		std::vector<TextureLevel> records(levels.size());
+		size_t                    offset = align(sizeof(header) + records.size() * sizeof(TextureLevel));
+		for(size_t i = 0; i < levels.size(); i++) {
+			records[i] = {offset, levels[i].size(), static_cast<uint32_t>(std::max(width >> i, 1)), static_cast<uint32_t>(std::max(height >> i, 1))};
+			offset     = align(offset + levels[i].size());
+		}
+
+		std::error_code error;
+		std::filesystem::create_directories(path.parent_path(), error);
+		std::filesystem::path temporary = path;
+		temporary += ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary);
+			auto          pad = [&file] {
+				static constexpr char zeros[16]{};
+				const auto            position = static_cast<size_t>(file.tellp());
+				file.write(zeros, static_cast<std::streamsize>(align(position) - position));
+			};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(TextureLevel)));
+			for(const auto& level: levels) {
+				pad();
+				file.write(reinterpret_cast<const char*>(level.data()), static_cast<std::streamsize>(level.size()));
+			}
+			if(!file)
+				return false;
+		}
+		std::filesystem::rename(temporary, path, error);
+		if(error) {
+			std::cerr << "Could not store texture " << path << ": " << error.message() << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool TextureFile::upload(GLenum target) const {
+		if(!valid())
+			return false;
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels() - 1));
+		for(size_t i = 0; i < levels(); i++) {
+			const TextureLevel& level = m_levels[i];
+			glASSERT(glCompressedTexImage2D(target, static_cast<GLint>(i), glFormat(format()), static_cast<GLsizei>(level.width),
+											static_cast<GLsizei>(level.height), 0, static_cast<GLsizei>(level.size), data(i).data()));
+		}
+		return true;
+	}
+}
+
+#endif //TEXTUREFILE_H
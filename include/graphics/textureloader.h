@@ -0,0 +1,280 @@
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include "common.h"
+#include "debug.h"
+#include "renderstate.h"
+#include "texture.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * A texture that is loaded in the background
+	 * Until its image is decoded and uploaded id() is the placeholder of the loader, so it can be bound right away.
+	 * Only use it on the GL thread.
+	 */
+	class AsyncTexture {
+		friend class TextureLoader;
+
+	  public:
+		enum class State { Queued, Decoding, Uploading, Ready, Failed };
+
+	  private:
+		std::string  m_path;
+		GLuint       m_id;
+		GLuint       m_texture = 0; // owned once uploading starts
+		int          m_width = 0, m_height = 0;
+		State        m_state = State::Queued;
+
+	  public:
+		AsyncTexture(std::string path, GLuint placeholder): m_path(std::move(path)), m_id(placeholder) {}
+		~AsyncTexture() {
+			if(m_texture) {
+				RenderState::current().deletedTexture(m_texture);
+				glDeleteTextures(1, &m_texture);
+			}
+		}
+		AsyncTexture(const AsyncTexture&) = delete;
+		AsyncTexture& operator=(const AsyncTexture&) = delete;
+
+		inline GLuint             id() const { return m_id; }
+		inline State              state() const { return m_state; }
+		inline bool               ready() const { return m_state == State::Ready; }
+		inline const std::string& path() const { return m_path; }
+		inline int                width() const { return m_width; }
+		inline int                height() const { return m_height; }
+
+		void bind(unsigned int slot = 0) const { RenderState::current().bindTexture(slot, GL_TEXTURE_2D, m_id); }
+	};
+
+	/**
+	 * Decodes images on a thread pool and uploads them in slices through a pixel buffer
+	 * update() has to be called once per frame on the GL thread, it starts decoding queued images while the decoded
+	 * but not yet uploaded images fit in the memory budget, and uploads rows until the time budget is spent.
+	 * The memory budget is soft: images already decoding are always accepted.
+	 */
+	class TextureLoader {
+		using Callback = std::function<void(AsyncTexture&)>;
+		using Clock    = std::chrono::steady_clock;
+
+		struct Request {
+			std::shared_ptr<AsyncTexture> texture;
+			bool                          flip;
+			Callback                      callback;
+		};
+		struct Decoded {
+			Request                                                      request;
+			std::unique_ptr<unsigned char, decltype(&stbi_image_free)> pixels{nullptr, &stbi_image_free};
+			int                                                          width = 0, height = 0;
+			int                                                          uploadedRows = 0;
+			std::string                                                  error;
+		};
+
+		ThreadPool&              m_pool;
+		GLuint                   m_placeholder{}, m_pixelBuffer{};
+		size_t                   m_pixelBufferSize;
+		size_t                   m_memoryBudget, m_decodedBytes = 0;
+		std::deque<Request>      m_queued;
+		std::deque<Decoded>      m_decoded;
+		std::mutex               m_mutex; // guards m_decoded and m_decodedBytes
+		std::vector<std::future<void>> m_jobs;
+
+		void decode(Request request);
+		/* Upload the next rows of the image, @return whether it is complete or failed, failures set image.error */
+		bool uploadSlice(Decoded& image);
+		static void finish(Request& request, AsyncTexture::State state);
+
+	  public:
+		/**
+		 * @param placeholder image shown until a texture is ready
+		 * @param memoryBudget bytes of decoded images waiting for their upload
+		 * @param pixelBufferSize bytes uploaded per slice
+		 */
+		explicit TextureLoader(const std::string& placeholder = GLPP_RESOURCES "/default/textures/grid.png",
+							   size_t memoryBudget = 64 << 20, size_t pixelBufferSize = 4 << 20, ThreadPool& pool = ThreadPool::global());
+		~TextureLoader();
+		TextureLoader(const TextureLoader&) = delete;
+		TextureLoader& operator=(const TextureLoader&) = delete;
+
+		/**
+		 * Queue an image for loading
+		 * @param callback called on the GL thread in update() once the texture is ready or failed to load
+		 */
+		std::shared_ptr<AsyncTexture> load(const std::string& path, bool flip = true, Callback callback = {});
+
+		/* Start decoding and upload for at most timeBudget, on the GL thread */
+		void update(std::chrono::microseconds timeBudget = std::chrono::microseconds(2000));
+
+		inline GLuint placeholder() const { return m_placeholder; }
+		/* Whether images are still queued, decoding or uploading */
+		bool busy();
+	};
+
+	TextureLoader::TextureLoader(const std::string& placeholder, size_t memoryBudget, size_t pixelBufferSize, ThreadPool& pool):
+		m_pool(pool), m_pixelBufferSize(pixelBufferSize), m_memoryBudget(memoryBudget) {
+		int            width = 0, height = 0, channels = 0;
+		unsigned char* pixels = stbi_load(placeholder.c_str(), &width, &height, &channels, 4);
+		// Fall back to a single white pixel
+		unsigned char white[4] = {255, 255, 255, 255};
+		if(!pixels)
+			std::cerr << "Failed to load placeholder texture: " << placeholder << std::endl;
+
+		glGenTextures(1, &m_placeholder);
+		RenderState::current().bindTexture(0, GL_TEXTURE_2D, m_placeholder);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glASSERT(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, pixels ? width : 1, pixels ? height : 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+							  pixels ? pixels : white));
+		stbi_image_free(pixels);
+
+		glGenBuffers(1, &m_pixelBuffer);
+	}
+
+	TextureLoader::~TextureLoader() {
+		// The jobs refer to the loader
+		for(auto& job: m_jobs)
+			job.wait();
+		RenderState::current().deletedTexture(m_placeholder);
+		RenderState::current().deletedBuffer(m_pixelBuffer);
+		glDeleteTextures(1, &m_placeholder);
+		glDeleteBuffers(1, &m_pixelBuffer);
+	}
+
+	std::shared_ptr<AsyncTexture> TextureLoader::load(const std::string& path, bool flip, Callback callback) {
+		auto texture = std::make_shared<AsyncTexture>(path, m_placeholder);
+		m_queued.push_back({texture, flip, std::move(callback)});
+		return texture;
+	}
+
+	bool TextureLoader::busy() {
+		std::scoped_lock lock(m_mutex);
+		return !m_queued.empty() || !m_decoded.empty() || !m_jobs.empty();
+	}
+
+	void TextureLoader::decode(Request request) {
+		Decoded image{std::move(request)};
+		int     channels = 0;
+		// The flag is thread local, the global one belongs to the GL thread
+		stbi_set_flip_vertically_on_load_thread(image.request.flip);
+		image.pixels.reset(stbi_load(image.request.texture->path().c_str(), &image.width, &image.height, &channels, 4));
+		if(!image.pixels)
+			image.error = stbi_failure_reason();
+
+		std::scoped_lock lock(m_mutex);
+		if(image.pixels)
+			m_decodedBytes += size_t(image.width) * size_t(image.height) * 4;
+		m_decoded.push_back(std::move(image));
+	}
+
+	void TextureLoader::finish(Request& request, AsyncTexture::State state) {
+		request.texture->m_state = state;
+		if(request.callback)
+			request.callback(*request.texture);
+	}
+
+	bool TextureLoader::uploadSlice(Decoded& image) {
+		AsyncTexture& texture = *image.request.texture;
+		const size_t  rowSize = size_t(image.width) * 4;
+		if(image.uploadedRows == 0) {
+			texture.m_width  = image.width;
+			texture.m_height = image.height;
+			texture.m_state  = AsyncTexture::State::Uploading;
+			const int levels = 1 + static_cast<int>(std::log2(std::max(image.width, image.height)));
+			glGenTextures(1, &texture.m_texture);
+			RenderState::current().bindTexture(0, GL_TEXTURE_2D, texture.m_texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glASSERT(glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, image.width, image.height));
+		}
+
+		// Orphan the pixel buffer, such that writing doesn't wait on the previous slice
+		const int rows = std::clamp(static_cast<int>(m_pixelBufferSize / rowSize), 1, image.height - image.uploadedRows);
+		const size_t bytes = rowSize * size_t(rows);
+		RenderState::current().bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(std::max(bytes, m_pixelBufferSize)), nullptr, GL_STREAM_DRAW);
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if(!mapped) {
+			// The rows weren't uploaded, the texture keeps the placeholder instead of showing a partial image
+			RenderState::current().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			image.error = "failed to map the pixel buffer";
+			return true;
+		}
+		std::memcpy(mapped, image.pixels.get() + rowSize * size_t(image.uploadedRows), bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		RenderState::current().bindTexture(0, GL_TEXTURE_2D, texture.m_texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glASSERT(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, image.uploadedRows, image.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+		RenderState::current().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		image.uploadedRows += rows;
+		if(image.uploadedRows < image.height)
+			return false;
+
+		glGenerateMipmap(GL_TEXTURE_2D);
+		texture.m_id = texture.m_texture;
+		return true;
+	}
+
+	void TextureLoader::update(std::chrono::microseconds timeBudget) {
+		const auto deadline = Clock::now() + timeBudget;
+		m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), [](auto& job) {
+						 return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+					 }), m_jobs.end());
+
+		// Start decoding while the decoded images fit, at most one image per thread at a time
+		{
+			std::scoped_lock lock(m_mutex);
+			while(!m_queued.empty() && m_decodedBytes < m_memoryBudget && m_jobs.size() < m_pool.size()) {
+				m_queued.front().texture->m_state = AsyncTexture::State::Decoding;
+				m_jobs.push_back(m_pool.submit([this, request = std::move(m_queued.front())]() mutable { decode(std::move(request)); }));
+				m_queued.pop_front();
+			}
+		}
+
+		// Upload at least one slice per update, such that loading always progresses
+		do {
+			std::unique_lock lock(m_mutex);
+			if(m_decoded.empty())
+				return;
+			Decoded& image = m_decoded.front();
+			lock.unlock();
+
+			bool complete = true;
+			if(!image.pixels) {
+				std::cerr << "Failed to load texture: " << image.request.texture->path() << ": " << image.error << std::endl;
+				finish(image.request, AsyncTexture::State::Failed);
+			} else if(image.request.texture.use_count() == 1) {
+				// Nobody holds the texture anymore, skip its upload
+			} else if((complete = uploadSlice(image)) && !image.error.empty()) {
+				std::cerr << "Failed to upload texture: " << image.request.texture->path() << ": " << image.error << std::endl;
+				finish(image.request, AsyncTexture::State::Failed);
+			} else if(complete) {
+				finish(image.request, AsyncTexture::State::Ready);
+			}
+			if(!complete)
+				continue;
+
+			lock.lock();
+			if(image.pixels)
+				m_decodedBytes -= size_t(image.width) * size_t(image.height) * 4;
+			m_decoded.pop_front();
+		} while(Clock::now() < deadline);
+	}
+}
+
+#endif //TEXTURELOADER_H
@@ -0,0 +1,107 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include "debug.h"
+#include "ml/ml.h"
+#include "renderstate.h"
+
+#include <algorithm>
+#include <glad/glad.h>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * Data shared by every program for a frame, the std140 layout of
+	 *   layout(std140, row_major) uniform Frame { mat4 projection; vec4 viewport; float time; };
+	 * ml::mat4 is row major, hence the row_major qualifier.
+	 */
+	struct FrameData {
+		static constexpr GLuint binding = 0;
+
+		ml::mat4 projection;
+		ml::vec4 viewport; // width and height in pixels, pixels per world unit
+		float    time = 0.0f;
+		float    padding[3]{};
+	};
+	static_assert(sizeof(FrameData) == 96, "FrameData has to match the std140 layout of the Frame block");
+
+	/**
+	 * Shader storage buffer bindings, every pass has its own such that none relies on another binding its buffer again
+	 * transformsBinding: the per draw transforms, read as transforms[drawID] from a row_major std430 buffer
+	 */
+	constexpr GLuint transformsBinding      = 0;
+	constexpr GLuint computeVerticesBinding = 1; // the vertex buffer ComputePlot writes into
+	constexpr GLuint pageTableBinding       = 2; // the page table of a VirtualTexture
+	constexpr GLuint pageFeedbackBinding    = 3; // the pages a VirtualTexture draw requested
+
+	/**
+	 * A uniform buffer holding one T, bound to a fixed binding point
+	 * T has to follow the std140 layout of the block, every program that binds the block to the same point
+	 * sees the same data, so it is uploaded once instead of per program and draw.
+	 */
+	template<typename T>
+	class UniformBuffer {
+		unsigned int m_buffer{};
+		GLuint       m_binding;
+
+	  public:
+		explicit UniformBuffer(GLuint binding): m_binding(binding) {
+			glGenBuffers(1, &m_buffer);
+			RenderState::current().bindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glASSERT(glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW));
+			glASSERT(glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_buffer));
+		}
+		~UniformBuffer() {
+			RenderState::current().deletedBuffer(m_buffer);
+			glDeleteBuffers(1, &m_buffer);
+		}
+		UniformBuffer(const UniformBuffer&) = delete;
+		UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+		void upload(const T& data) {
+			RenderState::current().bindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glASSERT(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data));
+		}
+		inline GLuint binding() const { return m_binding; }
+		inline GLuint id() const { return m_buffer; }
+	};
+
+	/**
+	 * A shader storage buffer holding an array of T in the std430 layout, bound to a fixed binding point
+	 * The buffer grows to the largest upload and is orphaned on every upload, such that
+	 * writing the next frame doesn't wait on draws still reading the previous one.
+	 */
+	template<typename T>
+	class StorageBuffer {
+		unsigned int m_buffer{};
+		GLuint       m_binding;
+		size_t       m_capacity = 0;
+
+	  public:
+		explicit StorageBuffer(GLuint binding): m_binding(binding) {
+			glGenBuffers(1, &m_buffer);
+		}
+		~StorageBuffer() {
+			RenderState::current().deletedBuffer(m_buffer);
+			glDeleteBuffers(1, &m_buffer);
+		}
+		StorageBuffer(const StorageBuffer&) = delete;
+		StorageBuffer& operator=(const StorageBuffer&) = delete;
+
+		void upload(const T* data, size_t count) {
+			if(count == 0)
+				return;
+			RenderState::current().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+			m_capacity = std::max(m_capacity, count);
+			glASSERT(glBufferData(GL_SHADER_STORAGE_BUFFER, m_capacity * sizeof(T), nullptr, GL_STREAM_DRAW));
+			glASSERT(glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(T), data));
+			glASSERT(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, m_binding, m_buffer));
+		}
+		inline void upload(const std::vector<T>& data) { upload(data.data(), data.size()); }
+
+		inline GLuint binding() const { return m_binding; }
+		inline size_t capacity() const { return m_capacity; }
+	};
+}
+
+#endif //UNIFORMBUFFER_H
@@ -5,6 +5,9 @@
 #include "ml/ml.h"
 #include "opengl.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace glpp {
 	// Get the offset of a struct and it's member
 	template<typename T1, typename T2>
@@ -12,6 +15,10 @@ namespace glpp {
 		T2 object{};
 		return size_t(&(object.*member)) - size_t(&object);
 	}
+	/* Normals are stored as normalized shorts, drawn as GL_SHORT with normalization they are unit floats again */
+	inline short packNormal(float component) { return static_cast<short>(std::round(std::clamp(component, -1.0f, 1.0f) * 32767.0f)); }
+	inline float unpackNormal(short component) { return std::max(static_cast<float>(component) / 32767.0f, -1.0f); }
+
 	struct Normal {
 		unsigned x : 10;
 		unsigned y : 10;
@@ -24,14 +31,14 @@ namespace glpp {
 	struct Vertex {
 		ml::vec3         positions;
 		rgba             color = {1.0f, 1.0f, 1.0f, 1.0f};
-		ml::vec3T<short> normals; // TODO: could be stored in a 32 bit number https://www.khronos.org/opengl/wiki/Vertex_Specification_Best_Practices
+		ml::vec3T<short> normals; // normalized, see packNormal. TODO: could be stored in a 32 bit number https://www.khronos.org/opengl/wiki/Vertex_Specification_Best_Practices
 		ml::vec2         texCoords   = {0.0f, 0.0f};
 		Slot             textureSlot = 0;
 		constexpr Vertex()           = default;
 		explicit Vertex(const ml::vec3& positions):
 			positions(positions) {}
 		Vertex(const ml::vec3& positions, const rgba& color, const ml::vec3T<short>& normals, const ml::vec2& textureCoordinates = {0.0f, 0.0f}, float textureID = 0.0f):
-			positions(positions), color(color), normals(normals), texCoords(textureCoordinates), textureSlot(0) {}
+			positions(positions), color(color), normals(normals), texCoords(textureCoordinates), textureSlot(textureID) {}
 	};
 }
 
@@ -0,0 +1,335 @@
+#ifndef VERTEXSTREAMS_H
+#define VERTEXSTREAMS_H
+
+#include "boundingbox.h"
+#include "renderstate.h"
+#include "vertex.h"
+
+#include <array>
+#include <new>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * Allocator that aligns every allocation on an Alignment byte boundary,
+	 * such that every stream starts on a SIMD register (AVX) boundary
+	 */
+	template<typename T, size_t Alignment = 32>
+	struct AlignedAllocator {
+		using value_type = T;
+		template<typename U>
+		struct rebind {
+			using other = AlignedAllocator<U, Alignment>;
+		};
+
+		AlignedAllocator() = default;
+		template<typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+		T* allocate(size_t n) {
+			return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+		}
+		void deallocate(T* pointer, size_t) {
+			::operator delete(pointer, std::align_val_t(Alignment));
+		}
+		template<typename U>
+		bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+		template<typename U>
+		bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+	};
+
+	template<typename T>
+	using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+	/**
+	 * The separate streams of a VertexStreams container
+	 * The values are equal to the attribute locations used by the Mesh vertex layout
+	 */
+	enum class VertexStream : unsigned int {
+		Position    = 0,
+		Color       = 1,
+		TexCoord    = 2,
+		TextureSlot = 3,
+		Normal      = 4
+	};
+	inline constexpr size_t vertexStreamCount = 5;
+	// Amount of floats a single vertex occupies in every stream
+	inline constexpr std::array<int, vertexStreamCount> vertexStreamComponents = {3, 4, 2, 1, 3};
+
+	/**
+	 * Structure of arrays vertex storage
+	 * Every attribute lives in its own tightly packed, aligned stream,
+	 * such that CPU passes (recoloring, translating, bounds) only touch the data they need
+	 * and each stream can be uploaded as is to its own vertex buffer.
+	 * @see StreamMesh
+	 */
+	class VertexStreams {
+		std::array<AlignedVector<float>, vertexStreamCount> m_streams;
+		size_t                                              m_size  = 0;
+		unsigned int                                        m_dirty = 0;
+
+	  public:
+		VertexStreams() = default;
+		explicit VertexStreams(size_t size) { resize(size); }
+		explicit VertexStreams(const std::vector<Vertex>& vertices) {
+			reserve(vertices.size());
+			for(auto& vertex: vertices)
+				push_back(vertex);
+		}
+
+		inline size_t size() const { return m_size; }
+		inline bool   empty() const { return m_size == 0; }
+
+		void reserve(size_t size) {
+			for(size_t i = 0; i < vertexStreamCount; i++)
+				m_streams[i].reserve(size * vertexStreamComponents[i]);
+		}
+		void resize(size_t size) {
+			for(size_t i = 0; i < vertexStreamCount; i++)
+				m_streams[i].resize(size * vertexStreamComponents[i]);
+			m_size  = size;
+			m_dirty = ~0u;
+		}
+		void clear() {
+			for(auto& stream: m_streams)
+				stream.clear();
+			m_size  = 0;
+			m_dirty = ~0u;
+		}
+
+		void push_back(const ml::vec3& position, const rgba& color, const ml::vec2& texCoords = {0.0f, 0.0f}) {
+			stream(VertexStream::Position).insert(stream(VertexStream::Position).end(), {position.x(), position.y(), position.z()});
+			stream(VertexStream::Color).insert(stream(VertexStream::Color).end(), {color[0], color[1], color[2], color[3]});
+			stream(VertexStream::TexCoord).insert(stream(VertexStream::TexCoord).end(), {texCoords.x(), texCoords.y()});
+			stream(VertexStream::TextureSlot).push_back(0.0f);
+			stream(VertexStream::Normal).insert(stream(VertexStream::Normal).end(), {0.0f, 0.0f, 0.0f});
+			m_size++;
+			m_dirty = ~0u;
+		}
+		void push_back(const Vertex& vertex) {
+			push_back(vertex.positions, vertex.color, vertex.texCoords);
+			stream(VertexStream::TextureSlot).back() = vertex.textureSlot;
+			float* normal = &stream(VertexStream::Normal)[(m_size - 1) * 3];
+			normal[0]     = unpackNormal(vertex.normals.x());
+			normal[1]     = unpackNormal(vertex.normals.y());
+			normal[2]     = unpackNormal(vertex.normals.z());
+		}
+
+		/* Interleave the streams back into the array of structs layout */
+		std::vector<Vertex> toVertices() const {
+			std::vector<Vertex> vertices(m_size);
+			const float*        p = data(VertexStream::Position);
+			const float*        c = data(VertexStream::Color);
+			const float*        t = data(VertexStream::TexCoord);
+			const float*        s = data(VertexStream::TextureSlot);
+			const float*        n = data(VertexStream::Normal);
+			for(size_t i = 0; i < m_size; i++) {
+				vertices[i].positions   = {p[i * 3], p[i * 3 + 1], p[i * 3 + 2]};
+				vertices[i].color       = rgba(c[i * 4], c[i * 4 + 1], c[i * 4 + 2], c[i * 4 + 3]);
+				vertices[i].texCoords   = {t[i * 2], t[i * 2 + 1]};
+				vertices[i].textureSlot = s[i];
+				vertices[i].normals     = {packNormal(n[i * 3]), packNormal(n[i * 3 + 1]), packNormal(n[i * 3 + 2])};
+			}
+			return vertices;
+		}
+
+		inline AlignedVector<float>& stream(VertexStream type) { return m_streams[static_cast<unsigned int>(type)]; }
+		inline const AlignedVector<float>& stream(VertexStream type) const { return m_streams[static_cast<unsigned int>(type)]; }
+		inline float*       data(VertexStream type) { return stream(type).data(); }
+		inline const float* data(VertexStream type) const { return stream(type).data(); }
+
+		inline ml::vec3 position(size_t i) const {
+			const float* p = data(VertexStream::Position) + i * 3;
+			return {p[0], p[1], p[2]};
+		}
+		inline void setPosition(size_t i, const ml::vec3& position) {
+			float* p = data(VertexStream::Position) + i * 3;
+			p[0]     = position.x();
+			p[1]     = position.y();
+			p[2]     = position.z();
+			markDirty(VertexStream::Position);
+		}
+
+		inline void setColor(size_t i, const rgba& color) {
+			float* c = data(VertexStream::Color) + i * 4;
+			c[0]     = color[0];
+			c[1]     = color[1];
+			c[2]     = color[2];
+			c[3]     = color[3];
+			markDirty(VertexStream::Color);
+		}
+
+		/* Dirty streams are re-uploaded by StreamMesh::regenBuffers */
+		inline void markDirty(VertexStream type) { m_dirty |= 1u << static_cast<unsigned int>(type); }
+		inline bool isDirty(VertexStream type) const { return m_dirty & (1u << static_cast<unsigned int>(type)); }
+		inline void clean() { m_dirty = 0; }
+
+		/** CPU passes, each loop only touches a single stream and is written to be auto-vectorized **/
+
+		/* Recolor every vertex, touches only the color stream */
+		void setColor(const rgba& color) {
+			float* __restrict c = data(VertexStream::Color);
+			const float r = color[0], g = color[1], b = color[2], a = color[3];
+			for(size_t i = 0; i < m_size; i++) {
+				c[i * 4]     = r;
+				c[i * 4 + 1] = g;
+				c[i * 4 + 2] = b;
+				c[i * 4 + 3] = a;
+			}
+			markDirty(VertexStream::Color);
+		}
+		/* Multiply the alpha channel of every vertex, eg. for fading */
+		void setAlpha(float alpha) {
+			float* __restrict c = data(VertexStream::Color);
+			for(size_t i = 0; i < m_size; i++)
+				c[i * 4 + 3] *= alpha;
+			markDirty(VertexStream::Color);
+		}
+
+		/* Translate every vertex, touches only the position stream */
+		void translate(const ml::vec3& offset) {
+			float* __restrict p = data(VertexStream::Position);
+			const float x = offset.x(), y = offset.y(), z = offset.z();
+			for(size_t i = 0; i < m_size; i++) {
+				p[i * 3] += x;
+				p[i * 3 + 1] += y;
+				p[i * 3 + 2] += z;
+			}
+			markDirty(VertexStream::Position);
+		}
+
+		/* Scale every vertex relative to origin */
+		void scale(const ml::vec3& factor, const ml::vec3& origin = ml::vec3(0.0f)) {
+			float* __restrict p = data(VertexStream::Position);
+			const float sx = factor.x(), sy = factor.y(), sz = factor.z();
+			const float ox = origin.x(), oy = origin.y(), oz = origin.z();
+			for(size_t i = 0; i < m_size; i++) {
+				p[i * 3]     = (p[i * 3] - ox) * sx + ox;
+				p[i * 3 + 1] = (p[i * 3 + 1] - oy) * sy + oy;
+				p[i * 3 + 2] = (p[i * 3 + 2] - oz) * sz + oz;
+			}
+			markDirty(VertexStream::Position);
+		}
+
+		/* Bounding box of all positions, touches only the position stream */
+		BoundingBox bounds() const {
+			if(m_size == 0)
+				return {};
+			const float* __restrict p = data(VertexStream::Position);
+			float minX = p[0], minY = p[1], minZ = p[2];
+			float maxX = p[0], maxY = p[1], maxZ = p[2];
+			for(size_t i = 1; i < m_size; i++) {
+				minX = p[i * 3] < minX ? p[i * 3] : minX;
+				minY = p[i * 3 + 1] < minY ? p[i * 3 + 1] : minY;
+				minZ = p[i * 3 + 2] < minZ ? p[i * 3 + 2] : minZ;
+				maxX = p[i * 3] > maxX ? p[i * 3] : maxX;
+				maxY = p[i * 3 + 1] > maxY ? p[i * 3 + 1] : maxY;
+				maxZ = p[i * 3 + 2] > maxZ ? p[i * 3 + 2] : maxZ;
+			}
+			return {ml::vec3(minX, minY, minZ), ml::vec3(maxX, maxY, maxZ)};
+		}
+	};
+
+	/**
+	 * GPU counterpart of VertexStreams
+	 * Every stream is uploaded without repacking to its own vertex buffer,
+	 * bound to the same attribute locations as Mesh so the same shaders can be used.
+	 */
+	class StreamMesh {
+		unsigned int                              VAO{}, EBO{};
+		std::array<unsigned int, vertexStreamCount> VBOs{};
+
+	  public:
+		VertexStreams      streams;
+		std::vector<Index> indices;
+
+		StreamMesh() = default;
+		StreamMesh(VertexStreams streams, std::vector<Index> indices):
+			streams(std::move(streams)), indices(std::move(indices)) {
+			genBuffers();
+		}
+
+		StreamMesh(const StreamMesh&) = delete;
+		StreamMesh& operator=(const StreamMesh&) = delete;
+
+		StreamMesh(StreamMesh&& other) noexcept {
+			std::swap(VAO, other.VAO);
+			std::swap(EBO, other.EBO);
+			std::swap(VBOs, other.VBOs);
+			streams = std::move(other.streams);
+			indices = std::move(other.indices);
+		}
+		StreamMesh& operator=(StreamMesh&& other) noexcept {
+			if(this != &other) {
+				release();
+				std::swap(VAO, other.VAO);
+				std::swap(EBO, other.EBO);
+				std::swap(VBOs, other.VBOs);
+				streams = std::move(other.streams);
+				indices = std::move(other.indices);
+			}
+			return *this;
+		}
+		~StreamMesh() { release(); }
+
+		size_t indicesSize() const { return indices.size(); }
+
+		void bind() {
+			glASSERT(RenderState::current().bindVertexArray(VAO));
+		}
+
+		void release() {
+			RenderState::current().deletedVertexArray(VAO);
+			for(auto VBO: VBOs)
+				RenderState::current().deletedBuffer(VBO);
+			glDeleteVertexArrays(1, &VAO);
+			glDeleteBuffers(vertexStreamCount, VBOs.data());
+			glDeleteBuffers(1, &EBO);
+			VAO = EBO = 0;
+			VBOs      = {};
+		}
+
+		void genBuffers();
+		/* Re-upload only the streams that were changed since the last upload */
+		void regenBuffers();
+	};
+
+	void StreamMesh::genBuffers() {
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(vertexStreamCount, VBOs.data());
+		glGenBuffers(1, &EBO);
+		RenderState::current().bindVertexArray(VAO);
+
+		for(unsigned int i = 0; i < vertexStreamCount; i++) {
+			auto& stream = streams.stream(static_cast<VertexStream>(i));
+			RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBOs[i]);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(float) * stream.size(), stream.data(), GL_DYNAMIC_DRAW);
+			// Tightly packed, so the stride is 0
+			glVertexAttribPointer(i, vertexStreamComponents[i], GL_FLOAT, GL_FALSE, 0, (void*)0);
+			glEnableVertexAttribArray(i);
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
+
+		RenderState::current().bindBuffer(GL_ARRAY_BUFFER, 0);
+		RenderState::current().bindVertexArray(0);
+		streams.clean();
+	}
+
+	void StreamMesh::regenBuffers() {
+		RenderState::current().bindVertexArray(VAO);
+		for(unsigned int i = 0; i < vertexStreamCount; i++) {
+			auto type = static_cast<VertexStream>(i);
+			if(!streams.isDirty(type))
+				continue;
+			auto& stream = streams.stream(type);
+			RenderState::current().bindBuffer(GL_ARRAY_BUFFER, VBOs[i]);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(float) * stream.size(), stream.data(), GL_DYNAMIC_DRAW);
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
+		streams.clean();
+	}
+}
+
+#endif //VERTEXSTREAMS_H
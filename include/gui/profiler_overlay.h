@@ -0,0 +1,70 @@
+#ifndef PROFILER_OVERLAY_H
+#define PROFILER_OVERLAY_H
+
+#include "graphics/profiler.h"
+#include "imgui.h"
+
+#include <cfloat>
+
+namespace glpp {
+	/**
+	 * ImGui window with the frame times and the zones of the last completed frame
+	 * Call between ImGui::NewFrame() and ImGui::Render().
+	 * @param open optional close button state, as for ImGui::Begin
+	 */
+	inline void drawProfilerOverlay(bool* open = nullptr) {
+		auto& profiler = Profiler::instance();
+		auto& history  = profiler.history();
+
+		ImGui::SetNextWindowBgAlpha(0.75f);
+		if(!ImGui::Begin("Profiler", open, ImGuiWindowFlags_AlwaysAutoResize)) {
+			ImGui::End();
+			return;
+		}
+		if(history.empty()) {
+			ImGui::Text("Waiting for the first frames");
+			ImGui::End();
+			return;
+		}
+
+		static std::vector<float> frameTimes;
+		frameTimes.clear();
+		double total = 0.0;
+		for(auto& frame: history) {
+			frameTimes.push_back(static_cast<float>(frame.duration));
+			total += frame.duration;
+		}
+		const double average = total / static_cast<double>(history.size());
+		ImGui::Text("Frame: %.2f ms (%.0f fps)", average, 1000.0 / average);
+		ImGui::PlotLines("##frames", frameTimes.data(), static_cast<int>(frameTimes.size()), 0, nullptr, 0.0f, FLT_MAX, ImVec2(320, 60));
+
+		if(ImGui::BeginTable("zones", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+			ImGui::TableSetupColumn("Zone");
+			ImGui::TableSetupColumn("CPU ms");
+			ImGui::TableSetupColumn("GPU ms");
+			ImGui::TableHeadersRow();
+			for(auto& zone: history.back().zones) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%*s%s", zone.depth * 2, "", zone.name.c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", zone.cpuEnd - zone.cpuStart);
+				ImGui::TableNextColumn();
+				if(zone.gpu >= 0.0)
+					ImGui::Text("%.3f", zone.gpu);
+				else
+					ImGui::TextDisabled("-");
+			}
+			ImGui::EndTable();
+		}
+
+		for(auto& [name, value]: history.back().counters)
+			ImGui::Text("%s: %.3f", name.c_str(), value);
+
+		if(ImGui::Button("Export trace"))
+			profiler.exportChromeTrace("trace.json");
+		ImGui::End();
+	}
+}
+
+#endif //PROFILER_OVERLAY_H
@@ -0,0 +1,234 @@
+#ifndef RENDERLOOP_H
+#define RENDERLOOP_H
+
+#include "graphics/profiler.h"
+#include "gui/window.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace glpp {
+	/**
+	 * Lock-free single producer, single consumer triple buffer
+	 * The producer always has a slot to write into and the consumer always reads the latest published slot,
+	 * neither of them ever waits for the other. Intermediate values are skipped if the consumer is slower.
+	 */
+	template<typename T>
+	class TripleBuffer {
+		static constexpr uint8_t fresh = 4; // Set when the shared slot holds a value that wasn't consumed yet
+
+		std::array<T, 3>     m_slots;
+		std::atomic<uint8_t> m_shared{1};
+		uint8_t              m_write = 0;
+		uint8_t              m_read  = 2;
+
+	  public:
+		TripleBuffer() = default;
+		explicit TripleBuffer(const T& value):
+			m_slots{value, value, value} {}
+
+		/* Producer: the slot to fill before publish() */
+		T& writeSlot() { return m_slots[m_write]; }
+		/* Producer: make the written slot the latest value */
+		void publish() {
+			m_write = m_shared.exchange(m_write | fresh, std::memory_order_acq_rel) & 3;
+		}
+
+		/**
+		 * Consumer: take the latest published value, if there is a new one
+		 * @return whether readSlot() changed
+		 */
+		bool update() {
+			if(!(m_shared.load(std::memory_order_relaxed) & fresh))
+				return false;
+			m_read = m_shared.exchange(m_read, std::memory_order_acq_rel) & 3;
+			return true;
+		}
+		/* Consumer: the latest value taken by update() */
+		const T& readSlot() const { return m_slots[m_read]; }
+	};
+
+	/**
+	 * Paces the frames of a window to vsync and/or a target frame rate
+	 * Reports the frame interval and its deviation from the target (jitter) to the Profiler.
+	 */
+	class FramePacer {
+		using Clock = std::chrono::steady_clock;
+
+		Clock::time_point m_deadline  = Clock::now();
+		Clock::time_point m_lastFrame = Clock::now();
+		double            m_targetFps = 0.0;
+
+	  public:
+		/**
+		 * @param vsync wait for the vertical blank on display, not available without a visible window
+		 * @param targetFps limit the frame rate by sleeping, 0 for unlimited
+		 */
+		explicit FramePacer(bool vsync = true, double targetFps = 0.0) {
+			setVsync(vsync);
+			setTargetFps(targetFps);
+		}
+
+		void setVsync(bool vsync) {
+			if(!Window::headless)
+				glfwSwapInterval(vsync ? 1 : 0);
+		}
+		void setTargetFps(double targetFps) {
+			m_targetFps = targetFps;
+			m_deadline  = Clock::now();
+		}
+
+		/* Call after Window::display(), sleeps until the next frame should start */
+		void wait() {
+			if(m_targetFps > 0.0) {
+				auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_targetFps));
+				m_deadline += interval;
+				auto now = Clock::now();
+				// Don't try to catch up after a long stall, that would render a burst of frames
+				if(m_deadline < now)
+					m_deadline = now;
+				else
+					std::this_thread::sleep_until(m_deadline);
+			}
+			auto   now      = Clock::now();
+			double interval = std::chrono::duration<double, std::milli>(now - m_lastFrame).count();
+			m_lastFrame     = now;
+			Profiler::instance().counter("Frame interval (ms)", interval);
+			if(m_targetFps > 0.0)
+				Profiler::instance().counter("Frame jitter (ms)", std::abs(interval - 1000.0 / m_targetFps));
+		}
+	};
+
+	/**
+	 * Runs the update of a State on a worker thread with a fixed timestep, and renders it on the calling (GL) thread
+	 * Every update publishes an immutable snapshot of the previous and current state through a TripleBuffer,
+	 * the render function interpolates between them by the time passed since the snapshot was published.
+	 * State has to be copyable, and may not contain OpenGL objects as it's updated on another thread.
+	 */
+	template<typename State>
+	class RenderLoop {
+	  public:
+		using Clock = std::chrono::steady_clock;
+
+		struct Settings {
+			double updateRate = 60.0; // Fixed updates per second
+			bool   vsync      = true;
+			double targetFps  = 0.0;  // 0 for unlimited
+		};
+		struct Snapshot {
+			State             previous, current;
+			Clock::time_point published;
+			// When the render thread last polled input before this update started, to measure input latency
+			Clock::time_point input;
+			double            updateTime = 0.0; // Milliseconds the update took
+			uint64_t          step       = 0;
+		};
+
+		/* Called on the worker thread, advance the state by dt seconds */
+		using Update = std::function<void(State& state, double dt)>;
+		/* Called on the GL thread, alpha goes from 0 (previous) to 1 (current) */
+		using Render = std::function<void(const State& previous, const State& current, float alpha)>;
+		/* Called on the GL thread after polling events, before rendering */
+		using Input = std::function<void(Window& window)>;
+
+	  private:
+		Window&                        m_window;
+		Settings                       m_settings;
+		FramePacer                     m_pacer;
+		TripleBuffer<Snapshot>         m_snapshots;
+		std::atomic<bool>              m_running{false};
+		std::atomic<Clock::rep>        m_inputTime{0};
+
+		void updateLoop(State state, Update update);
+
+	  public:
+		RenderLoop(Window& window, Settings settings):
+			m_window(window), m_settings(settings), m_pacer(settings.vsync, settings.targetFps) {}
+		explicit RenderLoop(Window& window):
+			RenderLoop(window, Settings{}) {}
+
+		/**
+		 * Run until the window closes or stop() is called
+		 * @param initial the state before the first update
+		 * @param input optional, eg. to close the window on a key press
+		 */
+		void run(State initial, Update update, Render render, Input input = {});
+		void stop() { m_running = false; }
+
+		void setVsync(bool vsync) { m_pacer.setVsync(vsync); }
+		void setTargetFps(double targetFps) { m_pacer.setTargetFps(targetFps); }
+	};
+
+	template<typename State>
+	void RenderLoop<State>::updateLoop(State state, Update update) {
+		const auto step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_settings.updateRate));
+		const double dt = 1.0 / m_settings.updateRate;
+		auto   next     = Clock::now();
+		uint64_t steps  = 0;
+		while(m_running) {
+			Snapshot& snapshot = m_snapshots.writeSlot();
+			snapshot.input     = Clock::time_point(Clock::duration(m_inputTime.load(std::memory_order_relaxed)));
+			auto start         = Clock::now();
+			snapshot.previous  = state;
+			update(state, dt);
+			snapshot.current    = state;
+			snapshot.published  = Clock::now();
+			snapshot.updateTime = std::chrono::duration<double, std::milli>(snapshot.published - start).count();
+			snapshot.step       = ++steps;
+			m_snapshots.publish();
+
+			next += step;
+			auto now = Clock::now();
+			// Drop steps instead of spiraling when an update takes longer than the timestep
+			if(next < now)
+				next = now;
+			std::this_thread::sleep_until(next);
+		}
+	}
+
+	template<typename State>
+	void RenderLoop<State>::run(State initial, Update update, Render render, Input input) {
+		m_snapshots.writeSlot() = Snapshot{initial, initial, Clock::now(), Clock::now()};
+		m_snapshots.publish();
+		m_running = true;
+		m_inputTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+		std::thread worker(&RenderLoop::updateLoop, this, std::move(initial), std::move(update));
+
+		const double step     = 1.0 / m_settings.updateRate;
+		uint64_t     lastStep = 0;
+		while(m_running && m_window.isOpen()) {
+			m_window.pollEvents();
+			m_inputTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+			if(input)
+				input(m_window);
+
+			m_snapshots.update();
+			const Snapshot& snapshot = m_snapshots.readSlot();
+			double since = std::chrono::duration<double>(Clock::now() - snapshot.published).count();
+			float  alpha = static_cast<float>(std::clamp(since / step, 0.0, 1.0));
+			{
+				GLPP_PROFILE_GPU("RenderLoop::render");
+				render(snapshot.previous, snapshot.current, alpha);
+			}
+			// Time from the input poll the update saw to submitting its result, sampled before display() such that
+			// neither waiting for the swap nor the next frame's profiler zones are counted
+			if(snapshot.step != lastStep) {
+				lastStep = snapshot.step;
+				Profiler::instance().counter("Input latency (ms)", std::chrono::duration<double, std::milli>(Clock::now() - snapshot.input).count());
+				Profiler::instance().counter("Update (ms)", snapshot.updateTime);
+			}
+			m_window.display();
+			m_pacer.wait();
+		}
+		m_running = false;
+		worker.join();
+	}
+}
+
+#endif //RENDERLOOP_H
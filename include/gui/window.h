@@ -3,11 +3,16 @@
 
 #include "common.h"
 #include "graphics/debug.h"
+#include "graphics/framebuffer.h"
+#include "graphics/profiler.h"
 #include "gui/event.h"
 #include "math-lib2/include/ml/graphics/color.h"
 #include "ml/vector.h"
 #include "utils/include/sig.h"
 
+#include <cstdlib>
+#include <memory>
+
 namespace glpp {
 	/**
      * Window class for an OpenGL context
@@ -32,6 +37,12 @@ namespace glpp {
 		inline static std::vector<GLFWwindow*> m_windows;
 		GLFWwindow*                            glfwWindow; // Window handle
 
+		// Only used in headless mode, the frames are rendered into m_target instead of a visible window
+		std::unique_ptr<Framebuffer> m_target;
+		std::unique_ptr<FrameReader> m_reader;
+		Image                        m_lastFrame;
+		size_t                       m_frames = 0;
+
         /**
          * Callback function that's called on window resize
          * @param window to be called from when resizing
@@ -101,11 +112,33 @@ namespace glpp {
 		static void onCursorEnterCallback(GLFWwindow* window, int state);
 
         void onResize(ResizeEvent event){
+            if(event.parent != glfwWindow)
+                return;
             m_height = event.height;
             m_width = event.width;
+            // The offscreen target and the read back buffers follow the size of the window
+            if(m_target) {
+                m_target->resize(m_width, m_height);
+                m_target->bind();
+            }
+            if(m_reader)
+                m_reader = std::make_unique<FrameReader>(m_width, m_height);
         }
 
 	  public:
+		/**
+		 * Create an offscreen context instead of a visible window, for benchmarks and tests on machines without a display
+		 * Defaults to true when the GLPP_HEADLESS environment variable is set, or when compiled with GLPP_HEADLESS.
+		 * Uses the null platform of GLFW (3.4+) with an OSMesa context, or EGL when compiled with GLPP_HEADLESS_EGL.
+		 */
+#ifdef GLPP_HEADLESS
+		inline static bool headless = true;
+#else
+		inline static bool headless = std::getenv("GLPP_HEADLESS") != nullptr;
+#endif
+		/* In headless mode, read every displayed frame back asynchronously, @see lastFrame() */
+		bool captureFrames = false;
+
 		GLFWwindow* getGLFWwindow(){
 			return glfwWindow;
 		}
@@ -180,6 +213,31 @@ namespace glpp {
 		void setAntialiasing(unsigned int val) {
 		}
 
+		/* Bind the framebuffer the window renders into, the offscreen target in headless mode */
+		void bindTarget() {
+			if(m_target) {
+				m_target->bind();
+			} else {
+				Framebuffer::bindDefault();
+				glViewport(0, 0, static_cast<GLsizei>(m_width), static_cast<GLsizei>(m_height));
+			}
+		}
+		/* Read the current contents of the window back, waits for rendering to finish */
+		Image capture() {
+			if(m_target)
+				m_target->bind();
+			if(!m_reader)
+				m_reader = std::make_unique<FrameReader>(m_width, m_height);
+			return m_reader->readNow();
+		}
+		/**
+		 * The last frame that was read back by display() when captureFrames is set
+		 * Lags one frame behind, such that the read back never stalls the pipeline.
+		 */
+		const Image& lastFrame() const { return m_lastFrame; }
+		/* Amount of frames displayed */
+		size_t frames() const { return m_frames; }
+
 		/**
          * @return the aspect ratio
          */
@@ -192,11 +250,24 @@ namespace glpp {
 
 	Window::Window(size_t width, size_t height, std::string label, DrawPosition drawPosition):
 		m_height(height), m_width(width), label(label), draw_position(drawPosition), backgroundColor(0.0f, 0.0f, 0.0f, 0.0f) {
+#ifdef GLFW_PLATFORM_NULL
+		// The null platform doesn't need a display server
+		if(headless)
+			glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
 		if(!glfwInit()) {
 			throw std::runtime_error("Failed to initialize GLEW\n");
 		}
 		//glfwWindowHint(GLFW_DOUBLEBUFFER, GLFW_FALSE);
-		glfwWindowHint(GLFW_SAMPLES, 4); // 4x antialiasing
+		glfwWindowHint(GLFW_SAMPLES, headless ? 0 : 4); // 4x antialiasing
+		if(headless) {
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLPP_HEADLESS_EGL
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#else
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+		}
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); // We don't want the old OpenGL
@@ -219,6 +290,16 @@ namespace glpp {
         if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
             std::cout << "Failed to initialize GLAD" << std::endl;
         }
+#ifdef NDEBUG
+		// glASSERT doesn't check errors in release builds
+		enableDebugOutput();
+#endif
+
+		if(headless) {
+			m_target = std::make_unique<Framebuffer>(width, height);
+			m_reader = std::make_unique<FrameReader>(width, height);
+			m_target->bind();
+		}
 
         // Set callbacks
         glfwSetWindowSizeCallback(glfwWindow, onWindowResizeCallback);
@@ -237,11 +318,23 @@ namespace glpp {
 	}
 
 	Window::~Window() {
+		// The GL objects have to be released while the context still exists
+		m_reader.reset();
+		m_target.reset();
 		glfwDestroyWindow(glfwWindow);
 		glfwTerminate();
 	}
 
 	void Window::display() {
+		Profiler::instance().frame();
+		m_frames++;
+		if(m_target) {
+			if(captureFrames) {
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, m_target->id());
+				m_reader->read(m_lastFrame);
+			}
+			return;
+		}
 		glfwSwapBuffers(glfwWindow);
 	}
 
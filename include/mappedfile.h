@@ -0,0 +1,89 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GLPP_MMAP
+#endif
+
+namespace glpp {
+	/**
+	 * A read only view of a whole file
+	 * The file is memory mapped where the platform allows it, so only the pages that are read get loaded,
+	 * and read into memory otherwise. An empty view means the file couldn't be opened.
+	 */
+	class MappedFile {
+		const std::byte*       m_data = nullptr;
+		size_t                 m_size = 0;
+		std::vector<std::byte> m_buffer; // the contents, if the file isn't mapped
+
+	  public:
+		MappedFile() = default;
+		explicit MappedFile(const std::filesystem::path& path) {
+#ifdef GLPP_MMAP
+			int file = ::open(path.c_str(), O_RDONLY);
+			if(file < 0)
+				return;
+			struct stat status {};
+			if(::fstat(file, &status) == 0 && status.st_size > 0) {
+				void* data = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+				if(data != MAP_FAILED) {
+					m_data = static_cast<const std::byte*>(data);
+					m_size = static_cast<size_t>(status.st_size);
+				}
+			}
+			// The mapping stays valid without the descriptor
+			::close(file);
+#else
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if(!file)
+				return;
+			m_buffer.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			if(file.read(reinterpret_cast<char*>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size()))) {
+				m_data = m_buffer.data();
+				m_size = m_buffer.size();
+			}
+#endif
+		}
+		~MappedFile() { release(); }
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept:
+			m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)), m_buffer(std::move(other.m_buffer)) {}
+		MappedFile& operator=(MappedFile&& other) noexcept {
+			if(this != &other) {
+				release();
+				m_data   = std::exchange(other.m_data, nullptr);
+				m_size   = std::exchange(other.m_size, 0);
+				m_buffer = std::move(other.m_buffer);
+			}
+			return *this;
+		}
+
+		void release() {
+#ifdef GLPP_MMAP
+			if(m_data)
+				::munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+			m_data = nullptr;
+			m_size = 0;
+			m_buffer.clear();
+		}
+
+		inline const std::byte* data() const { return m_data; }
+		inline size_t           size() const { return m_size; }
+		inline bool             empty() const { return m_size == 0; }
+	};
+}
+
+#endif //MAPPEDFILE_H
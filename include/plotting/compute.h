@@ -0,0 +1,368 @@
+#ifndef PLOTTING_COMPUTE_H
+#define PLOTTING_COMPUTE_H
+
+#include "graphics/mesh.h"
+#include "graphics/shaders.h"
+#include "graphics/uniformbuffer.h"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+namespace glpp {
+	/**
+	 * Plot expression of x, compiled from the parsed AST into a flat tree
+	 * evaluate() is the CPU reference, glsl() translates the same tree into GLSL for the compute path.
+	 */
+	class PlotExpression {
+	  public:
+		enum class Op {
+			Constant, X,
+			Add, Subtract, Multiply, Divide, Power, Negate,
+			Sin, Cos, Tan, Sqrt, Exp, Log, Abs
+		};
+		struct Node {
+			Op     op;
+			double value = 0.0;
+			int    lhs = -1, rhs = -1;
+		};
+
+	  private:
+		std::vector<Node> m_nodes;
+		int               m_root = -1;
+
+		int add(Node node) {
+			if((node.lhs == -1 && node.op != Op::Constant && node.op != Op::X) || node.lhs < -1 || node.rhs < -1)
+				return -2; // A child failed to compile
+			m_nodes.push_back(node);
+			return static_cast<int>(m_nodes.size()) - 1;
+		}
+		static std::optional<Op> function(const std::string& name);
+		static std::string       text(const Token& token) { return token.start ? std::string(token.start, token.length) : std::string(); }
+		static bool              endsInFunction(AST::Node& node);
+
+		int    compile(AST::Node& node);
+		int    apply(AST::Node& function, int argument);
+		double evaluate(int node, double x) const;
+		void   glsl(int node, std::ostream& os) const;
+
+	  public:
+		/* @return nothing if the source doesn't parse into a supported expression, the reason is written to std::cerr */
+		static std::optional<PlotExpression> compile(std::string source);
+
+		double evaluate(double x) const { return evaluate(m_root, x); }
+		/* A GLSL expression of float x, calls power() @see ComputePlot */
+		std::string glsl() const {
+			std::ostringstream os;
+			os << std::setprecision(9) << std::showpoint;
+			glsl(m_root, os);
+			return os.str();
+		}
+	};
+
+	std::optional<PlotExpression::Op> PlotExpression::function(const std::string& name) {
+		static const std::unordered_map<std::string, Op> functions = {
+			{"sin", Op::Sin}, {"cos", Op::Cos}, {"tan", Op::Tan}, {"sqrt", Op::Sqrt}, {"exp", Op::Exp}, {"log", Op::Log}, {"abs", Op::Abs}};
+		auto it = functions.find(name);
+		return it != functions.end() ? std::optional(it->second) : std::nullopt;
+	}
+
+	/* The parser makes "f(x)" and "2 f(x)" an (implicit) multiplication ending in the function name */
+	bool PlotExpression::endsInFunction(AST::Node& node) {
+		if(node.value.type == TOKEN_IDENTIFIER)
+			return function(text(node.value)).has_value();
+		if((node.value.type == TOKEN_MUL || node.value.type == TOKEN_AMBIGUOUS_IDENTIFIER) && node.right())
+			return endsInFunction(*node.right());
+		return false;
+	}
+
+	int PlotExpression::apply(AST::Node& node, int argument) {
+		if(node.value.type == TOKEN_IDENTIFIER)
+			return add({*function(text(node.value)), 0.0, argument});
+		return add({Op::Multiply, 0.0, compile(*node.left()), apply(*node.right(), argument)});
+	}
+
+	int PlotExpression::compile(AST::Node& node) {
+		const Token& token = node.value;
+		switch(token.type) {
+		case TOKEN_INTEGER:
+		case TOKEN_FLOAT: return add({Op::Constant, std::stod(text(token))});
+		case TOKEN_IDENTIFIER: {
+			const std::string name = text(token);
+			if(name == "x")
+				return add({Op::X});
+			if(name == "pi")
+				return add({Op::Constant, M_PI});
+			if(name == "e")
+				return add({Op::Constant, M_E});
+			std::cerr << "Unknown identifier \"" << name << "\" in plot expression." << std::endl;
+			return -2;
+		}
+		case TOKEN_PLUS:
+		case TOKEN_MIN:
+			// Unary operators have an empty right node
+			if(!node.right() || node.right()->value.start == nullptr) {
+				int operand = compile(*node.left());
+				return token.type == TOKEN_PLUS ? operand : add({Op::Negate, 0.0, operand});
+			}
+			return add({token.type == TOKEN_PLUS ? Op::Add : Op::Subtract, 0.0, compile(*node.left()), compile(*node.right())});
+		case TOKEN_MUL:
+		case TOKEN_AMBIGUOUS_IDENTIFIER:
+			if(endsInFunction(*node.left()))
+				return apply(*node.left(), compile(*node.right()));
+			return add({Op::Multiply, 0.0, compile(*node.left()), compile(*node.right())});
+		case TOKEN_SLASH: return add({Op::Divide, 0.0, compile(*node.left()), compile(*node.right())});
+		case TOKEN_POW: return add({Op::Power, 0.0, compile(*node.left()), compile(*node.right())});
+		case TOKEN_PIPE: return add({Op::Abs, 0.0, compile(*node.left())});
+		default:
+			std::cerr << "Unsupported token " << token << " in plot expression." << std::endl;
+			return -2;
+		}
+	}
+
+	std::optional<PlotExpression> PlotExpression::compile(std::string source) {
+		auto           tokens = tokenize(source);
+		AST            tree   = parse(tokens);
+		PlotExpression expression;
+		expression.m_root = expression.compile(tree);
+		if(expression.m_root < 0)
+			return std::nullopt;
+		return expression;
+	}
+
+	double PlotExpression::evaluate(int index, double x) const {
+		const Node& node = m_nodes[index];
+		auto lhs = [&] { return evaluate(node.lhs, x); };
+		auto rhs = [&] { return evaluate(node.rhs, x); };
+		switch(node.op) {
+		case Op::Constant: return node.value;
+		case Op::X: return x;
+		case Op::Add: return lhs() + rhs();
+		case Op::Subtract: return lhs() - rhs();
+		case Op::Multiply: return lhs() * rhs();
+		case Op::Divide: return lhs() / rhs();
+		case Op::Power: return std::pow(lhs(), rhs());
+		case Op::Negate: return -lhs();
+		case Op::Sin: return std::sin(lhs());
+		case Op::Cos: return std::cos(lhs());
+		case Op::Tan: return std::tan(lhs());
+		case Op::Sqrt: return std::sqrt(lhs());
+		case Op::Exp: return std::exp(lhs());
+		case Op::Log: return std::log(lhs());
+		case Op::Abs: return std::abs(lhs());
+		}
+		return 0.0;
+	}
+
+	void PlotExpression::glsl(int index, std::ostream& os) const {
+		const Node& node = m_nodes[index];
+		auto binary = [&](const char* op) {
+			os << "(";
+			glsl(node.lhs, os);
+			os << op;
+			glsl(node.rhs, os);
+			os << ")";
+		};
+		auto call = [&](const char* name) {
+			os << name << "(";
+			glsl(node.lhs, os);
+			os << ")";
+		};
+		switch(node.op) {
+		case Op::Constant: os << static_cast<float>(node.value); break;
+		case Op::X: os << "x"; break;
+		case Op::Add: binary(" + "); break;
+		case Op::Subtract: binary(" - "); break;
+		case Op::Multiply: binary(" * "); break;
+		case Op::Divide: binary(" / "); break;
+		case Op::Power:
+			os << "power(";
+			glsl(node.lhs, os);
+			os << ", ";
+			glsl(node.rhs, os);
+			os << ")";
+			break;
+		case Op::Negate: call("-"); break;
+		case Op::Sin: call("sin"); break;
+		case Op::Cos: call("cos"); break;
+		case Op::Tan: call("tan"); break;
+		case Op::Sqrt: call("sqrt"); break;
+		case Op::Exp: call("exp"); break;
+		case Op::Log: call("log"); break;
+		case Op::Abs: call("abs"); break;
+		}
+	}
+
+	/**
+	 * Samples a PlotExpression and expands the samples into a thick triangle strip
+	 * The compute path evaluates the expression in a compute shader that writes the vertex positions directly
+	 * into the vertex buffer of mesh(), no vertex data passes through the CPU. tessellate() is the CPU reference,
+	 * and is used instead when compute shaders aren't available (OpenGL < 4.3).
+	 * The bounds of the mesh aren't updated by the compute path.
+	 */
+	class ComputePlot {
+		PlotExpression        m_expression;
+		size_t                m_samples;
+		float                 m_halfWidth;
+		rgba                  m_color;
+		std::optional<Shader> m_program;
+		Mesh                  m_mesh;
+		UniformHandle         m_xMin, m_xStep, m_count, m_width, m_stride, m_offset;
+
+		static constexpr unsigned int groupSize = 64;
+
+		std::string source() const;
+
+	  public:
+		/* @param thickness the width of the line in plot units */
+		ComputePlot(PlotExpression expression, size_t samples, float thickness, rgba color = {0.0f, 0.0f, 0.0f, 1.0f});
+
+		static bool computeSupported() { return GLAD_GL_VERSION_4_3; }
+
+		/**
+		 * CPU reference: samples [xMin, xMax] and offsets every sample by halfWidth along the normal of the curve,
+		 * vertex 2i is on the left of sample i and vertex 2i + 1 on the right
+		 */
+		static std::vector<Vertex> tessellate(const PlotExpression& expression, double xMin, double xMax, size_t samples, float halfWidth, rgba color);
+		/* Two triangles between every pair of samples, these only depend on the amount of samples */
+		static std::vector<Index> stripIndices(size_t samples);
+
+		/* Resample the plot over [xMin, xMax], on the GPU if supported */
+		void sample(double xMin, double xMax, bool useCompute = true);
+		/* Read the vertices back from the vertex buffer, waits for the GPU */
+		std::vector<Vertex> readBack() const;
+
+		inline Mesh& mesh() { return m_mesh; }
+	};
+
+	ComputePlot::ComputePlot(PlotExpression expression, size_t samples, float thickness, rgba color):
+		m_expression(std::move(expression)), m_samples(std::max<size_t>(samples, 2)), m_halfWidth(thickness / 2.0f), m_color(color),
+		m_mesh(std::vector<Vertex>(m_samples * 2, Vertex({0.0f, 0.0f, 0.0f}, color, {})), stripIndices(m_samples)) {
+		if(!computeSupported())
+			return;
+		m_program.emplace(std::vector<ShaderData>{ShaderData(source(), ShaderType::Compute)});
+		m_xMin   = m_program->uniform("xMin");
+		m_xStep  = m_program->uniform("xStep");
+		m_count  = m_program->uniform("count");
+		m_width  = m_program->uniform("halfWidth");
+		m_stride = m_program->uniform("stride");
+		m_offset = m_program->uniform("positionOffset");
+	}
+
+	std::string ComputePlot::source() const {
+		return R"(#version 430 core
+layout(local_size_x = )" + std::to_string(groupSize) + R"() in;
+// The vertex buffer of the mesh, written as floats as the Vertex struct doesn't follow std430 alignment
+layout(std430, binding = )" + std::to_string(computeVerticesBinding) + R"() buffer Vertices {
+    float vertices[];
+};
+uniform float xMin;
+uniform float xStep;
+uniform int count;
+uniform float halfWidth;
+uniform int stride;
+uniform int positionOffset;
+
+// pow() is undefined for negative bases, integer exponents are common in plots
+float power(float base, float exponent){
+    if(base < 0.0 && exponent == floor(exponent))
+        return (mod(exponent, 2.0) == 0.0 ? 1.0 : -1.0) * pow(-base, exponent);
+    return pow(base, exponent);
+}
+float f(float x){
+    return )" + m_expression.glsl() + R"(;
+}
+void write(int vertex, vec2 position){
+    int offset = vertex * stride + positionOffset;
+    vertices[offset] = position.x;
+    vertices[offset + 1] = position.y;
+    vertices[offset + 2] = 0.0;
+}
+void main(){
+    int i = int(gl_GlobalInvocationID.x);
+    if(i >= count)
+        return;
+    // Neighbouring samples are evaluated again instead of shared, such that a single dispatch suffices
+    float x = xMin + float(i) * xStep;
+    vec2 point = vec2(x, f(x));
+    vec2 tangent = vec2(x + xStep, f(x + xStep)) - vec2(x - xStep, f(x - xStep));
+    vec2 normal = length(tangent) > 0.0 ? normalize(vec2(-tangent.y, tangent.x)) : vec2(0.0, 1.0);
+    write(2 * i, point + normal * halfWidth);
+    write(2 * i + 1, point - normal * halfWidth);
+}
+)";
+	}
+
+	std::vector<Vertex> ComputePlot::tessellate(const PlotExpression& expression, double xMin, double xMax, size_t samples, float halfWidth, rgba color) {
+		samples = std::max<size_t>(samples, 2);
+		std::vector<Vertex> vertices;
+		vertices.reserve(samples * 2);
+		// Same float math as the compute shader, such that both paths can be compared
+		const float xStep = static_cast<float>((xMax - xMin) / static_cast<double>(samples - 1));
+		auto        f     = [&](float x) { return static_cast<float>(expression.evaluate(x)); };
+		for(size_t i = 0; i < samples; i++) {
+			const float x       = static_cast<float>(xMin) + static_cast<float>(i) * xStep;
+			const float y       = f(x);
+			const float dx      = 2.0f * xStep;
+			const float dy      = f(x + xStep) - f(x - xStep);
+			const float length  = std::sqrt(dx * dx + dy * dy);
+			float       nx = 0.0f, ny = 1.0f;
+			if(length > 0.0f) {
+				nx = -dy / length;
+				ny = dx / length;
+			}
+			vertices.emplace_back(ml::vec3(x + nx * halfWidth, y + ny * halfWidth, 0.0f), color, ml::vec3T<short>{});
+			vertices.emplace_back(ml::vec3(x - nx * halfWidth, y - ny * halfWidth, 0.0f), color, ml::vec3T<short>{});
+		}
+		return vertices;
+	}
+
+	std::vector<Index> ComputePlot::stripIndices(size_t samples) {
+		std::vector<Index> indices;
+		indices.reserve((samples - 1) * 6);
+		for(Index i = 0; i + 1 < samples; i++) {
+			Index left = 2 * i, right = 2 * i + 1;
+			indices.insert(indices.end(), {left, right, left + 2, left + 2, right, right + 2});
+		}
+		return indices;
+	}
+
+	void ComputePlot::sample(double xMin, double xMax, bool useCompute) {
+		const float xStep = static_cast<float>((xMax - xMin) / static_cast<double>(m_samples - 1));
+		if(!useCompute || !m_program) {
+			m_mesh.vertices = tessellate(m_expression, xMin, xMax, m_samples, m_halfWidth, m_color);
+			m_mesh.regenBuffers();
+			return;
+		}
+		m_program->use();
+		m_program->setUniform(m_xMin, static_cast<float>(xMin));
+		m_program->setUniform(m_xStep, xStep);
+		m_program->setUniform(m_count, static_cast<int>(m_samples));
+		m_program->setUniform(m_width, m_halfWidth);
+		m_program->setUniform(m_stride, static_cast<int>(sizeof(Vertex) / sizeof(float)));
+		m_program->setUniform(m_offset, static_cast<int>(offset_of(&Vertex::positions) / sizeof(float)));
+		// Binding the base also changes the generic binding, which the shadow state has to know about
+		RenderState::current().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_mesh.vertexBuffer());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, computeVerticesBinding, m_mesh.vertexBuffer());
+		glASSERT(glDispatchCompute(static_cast<GLuint>((m_samples + groupSize - 1) / groupSize), 1, 1));
+		// The next draw reads the written vertices as attributes
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	}
+
+	std::vector<Vertex> ComputePlot::readBack() const {
+		std::vector<Vertex> vertices(m_samples * 2);
+		RenderState::current().bindBuffer(GL_ARRAY_BUFFER, m_mesh.vertexBuffer());
+		glGetBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(vertices.size() * sizeof(Vertex)), vertices.data());
+		return vertices;
+	}
+}
+
+#endif //PLOTTING_COMPUTE_H
@@ -3,6 +3,13 @@
 
 #include "ml/ml.h"
 #include "gui/window.h"
+#include "graphics/text.h"
+#include "graphics/textcache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
 //#include <math-lib2/include/ml/vector.h>
 
 using CoordinateTransformator = ml::vec2T<double> (*)(const ml::vec2T<double>& xy);
@@ -61,5 +68,76 @@ CoordinateSystemBase createWindowCoordinates(const glpp::Window& window) {
     };
 }
 
+/**
+ * Tick labels along the axes of a coordinate system
+ * All labels are glyphs of one TextBatch drawn by a TextRenderer, so a dense grid still costs a single draw.
+ * Their layouts are kept in a TextCache, panning and zooming only moves and scales the labels already built.
+ * The axes are clamped to the border of the range when the origin is out of view.
+ */
+class AxisLabels {
+    glpp::TextBatch m_batch;
+    glpp::TextCache m_layouts;
+
+  public:
+    rgba  color{1.0f, 1.0f, 1.0f, 1.0f};
+    float pixelHeight = 14.0f; // on screen, independent of the zoom
+    float padding     = 4.0f;  // between the labels and the axes, in pixels
+    // Ticks per axis above which the labels are skipped, they wouldn't be readable anyway
+    static constexpr int maxTicks = 512;
+
+    explicit AxisLabels(glpp::Font& font): m_batch(font) {}
+
+    /**
+     * Lay out a label at every step along both axes
+     * @param pixelsPerUnit world units to pixels, eg. LOD::pixelsPerUnit(projection, viewportWidth)
+     */
+    void build(const CoordinateSystemBase& system, double xStep, double yStep, float pixelsPerUnit);
+    void draw(glpp::TextRenderer& renderer, const ml::mat4& mvp) { renderer.draw(m_batch, mvp); }
+
+    inline glpp::TextBatch& batch() { return m_batch; }
+    inline glpp::TextCache& layouts() { return m_layouts; }
+
+    /* Shortest representation of a tick value, "%g" without the noise of accumulated steps */
+    static std::string format(double value, double step) {
+        // Values close to zero relative to the step are zero, not 1e-17
+        if(std::abs(value) < std::abs(step) * 1e-6)
+            value = 0.0;
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%g", value);
+        return buffer;
+    }
+};
+
+void AxisLabels::build(const CoordinateSystemBase& system, double xStep, double yStep, float pixelsPerUnit) {
+    m_batch.clear();
+    m_layouts.beginFrame();
+    if(pixelsPerUnit <= 0.0f)
+        return;
+    glpp::Font& font   = m_batch.font();
+    const float scale  = pixelHeight / static_cast<float>(font.pixelHeight()) / pixelsPerUnit;
+    const float pad    = padding / pixelsPerUnit;
+    const float line   = font.lineHeight() * scale;
+    const auto  xAxis  = static_cast<float>(std::clamp(0.0, system.yMin, system.yMax));
+    const auto  yAxis  = static_cast<float>(std::clamp(0.0, system.xMin, system.xMax));
+
+    auto ticks = [](double min, double max, double step, auto&& label) {
+        if(step <= 0.0 || (max - min) / step > maxTicks)
+            return;
+        for(double i = std::ceil(min / step); i * step <= max; i++)
+            label(i * step);
+    };
+    // Centered below the x axis, the origin is labeled once by the y axis
+    ticks(system.xMin, system.xMax, xStep, [&](double x) {
+        if(std::abs(x) < xStep * 1e-6)
+            return;
+        const glpp::TextLayout& layout = m_layouts.get(font, format(x, xStep));
+        const float             width  = layout.pen.x() * scale;
+        m_batch.add(layout, ml::vec2(static_cast<float>(x) - width / 2.0f, xAxis - pad - line), scale, color);
+    });
+    // Right of the y axis, vertically centered on the tick
+    ticks(system.yMin, system.yMax, yStep, [&](double y) {
+        m_batch.add(m_layouts.get(font, format(y, yStep)), ml::vec2(yAxis + pad, static_cast<float>(y) - line / 3.0f), scale, color);
+    });
+}
 
 #endif //GLPP_COORDINATES_H
@@ -5,8 +5,19 @@
 #ifndef PLOT_H
 #define PLOT_H
 
-#include <graphics/shapes.h>
-#include <graphics/shapetraits.h>
+#include <graphics/lines.h>
+#include <graphics/lod.h>
+#include <graphics/text.h>
+#include <plotting/coordinates.h>
+#include <plotting/virtualtexture.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <vector>
 
 namespace glpp {
 	// Virtual class
@@ -18,7 +29,26 @@ namespace glpp {
 		Degree
 	};
 
-	class HeatMap {};
+	/**
+	 * Samples of a 2D dataset as colors, for datasets far larger than a texture
+	 * The data is converted once with TiledDataset::write(), and only the pages in view are streamed in.
+	 */
+	class HeatMap {
+		VirtualTexture m_texture;
+
+	  public:
+		ml::vec2 position, size;
+		float    minValue, maxValue;
+
+		HeatMap(const std::filesystem::path& dataset, const ml::vec2& position, const ml::vec2& size, float minValue, float maxValue):
+			m_texture(dataset), position(position), size(size), minValue(minValue), maxValue(maxValue) {}
+
+		/* Stream the pages in view, once per frame before draw() */
+		void update() { m_texture.update(); }
+		void draw(const ml::mat4& mvp) { m_texture.draw(mvp, {position.x(), position.y(), size.x(), size.y()}, minValue, maxValue); }
+
+		inline VirtualTexture& texture() { return m_texture; }
+	};
 	template<typename T>
 	class HeightMap {
 		int width, height;
@@ -35,174 +65,158 @@ namespace glpp {
 	rgba Blue  = {0.0f, 0.0f, 1.0f, 1.0f};
 	rgba White = {1.0f, 1.0f, 1.0f, 1.0f};
 
-	template<typename T>
-	class Plottable2D: public Drawable2D {
-	  protected:
-	using Drawable2D::m_vertices;
-	using Drawable2D::m_indices;
-	ml::vec3<T> m_pos;
-		ml::vec2<T> m_size;
-
-	  public:
-		Plottable2D(const ml::vec3<T>& position, const ml::vec2<T>& size):
-			m_pos{position}, m_size{size} {}
-		virtual void plotPoint(const ml::vec2<T>&)                    = 0;
-		virtual void plotLine(const ml::vec2<T>&, const ml::vec2<T>&) = 0;
-		virtual void plotFunction()                                   = 0;
-		// ... etc
-	};
-	template<typename T>
-	class Plottable3D: public Drawable3D {
-		virtual void plotPoint(const ml::vec3<T>&)                    = 0;
-		virtual void plotLine(const ml::vec3<T>&, const ml::vec3<T>&) = 0;
-		virtual void plotFunction()                                   = 0;
-		// plotCurve
-		// plotPath...
-		// ... etc
-	};
+	/**
+	 * Axes, a grid and tick labels over a range of plot coordinates, onto which functions are plotted
+	 * Lines are extruded by the LineRenderer and labels drawn by the TextRenderer, both keep their size in
+	 * pixels, so the plane stays sharp at any zoom. Functions are sampled once, every zoom level draws the
+	 * decimated samples of its PolylineLOD.
+	 */
+	class CartesianPlane {
+		struct Function {
+			PolylineLOD   samples;
+			LineStyle     style;
+			PolylineBatch batch;
+			// The level uploaded to the batch, selecting the same level again doesn't upload
+			const std::vector<ml::vec2>* uploaded = nullptr;
+		};
 
-	template<typename T = float>
-	class CartesianPlane: public Plottable2D<T> {
-		using Plottable2D<T>::m_vertices;
-		using Plottable2D<T>::m_indices;
-		using Plottable2D<T>::m_size;
-		using Plottable2D<T>::m_pos;
-		T m_xDiff;
-		T m_xStepSize;
-		T m_yDiff;
-		T m_yStepSize;
-		T xAxisPos = 0, yAxisPos = 0;
-		T prevXMin, prevXMax;
-		T prevYMin, prevYMax;
-		T prevXStep = 1;
-		T prevYStep = 1;
-
-		void cutoff() {
-		}
-		// Recalculate all necessary variables if a change was made to any plane settings.
-		void update() {
-			yAxisPos    = findAxisPos(yMin, yMax);
-			xAxisPos    = findAxisPos(xMin, xMax);
-			m_xDiff     = xMax - xMin / xStep;
-			m_yDiff     = yMax - yMin / yStep;
-			m_xStepSize = m_size.x() / m_xDiff;
-			m_yStepSize = m_size.y() / m_yDiff;
-			// If necessary, cut off any plotted points for the new plot
-			cutoff();
-		}
+		CoordinateSystemBase m_range;
+		double               m_xStep, m_yStep;
+		LineRenderer         m_lines;
+		TextRenderer         m_text;
+		PolylineBatch        m_grid, m_axes;
+		AxisLabels           m_labels;
+		std::deque<Function> m_functions;
+		std::deque<HeatMap>  m_heatMaps;
+		float                m_builtPixelsPerUnit = 0.0f; // the labels are laid out for this zoom
+		uint64_t             m_builtGeneration    = 0;    // and this generation of the font
+		bool                 m_dirty              = true;
 
-		T findAxisPos(T min, T max) {
-			if((min < 0 && max > 0))
-				return abs(min) - max;
-			else if(min == 0)
-				return min;
-			else if(max == 0)
-				return max;
-			else
-				return 0;
-		}
+		void build(float pixelsPerUnit);
 
 	  public:
-		static_assert(std::is_arithmetic_v<T>, "T has to be an arithmetic type.");
-		T xMin, xMax;
-		T yMin, yMax;
-		T xStep = 1;
-		T yStep = 1;
-
-		std::vector<std::pair<T (*)(T), rgb>> functions;
-
-		void plotLine(const ml::vec2<T>& from, const ml::vec2<T>& to) {
-			createLine({m_pos.x() + (from.x() * m_xStepSize), m_pos.y() + (from.y() * m_yStepSize), m_pos.z()},
-					   {m_pos.x() + (to.x() * m_xStepSize), m_pos.y() + (to.y() * m_yStepSize), m_pos.z()},
-					   0.02, rgba(1.0f, 1.0f, 1.0f), m_vertices, m_indices);
-			//createLine({pos.x(), pos.y(), pos.z()}, ml::vec3{pos.x() + size.x(), pos.y(), pos.z()}, thickness, Black, 0.0f, m_vertices, m_indices);
+		LineStyle gridStyle{.width = 1.0f, .color = {0.3f, 0.3f, 0.3f, 1.0f}};
+		LineStyle axisStyle{.width = 2.0f, .color = {1.0f, 1.0f, 1.0f, 1.0f}};
+		bool      showGrid = true;
+
+		/**
+		 * @param font the tick labels are drawn in, has to outlive the plane
+		 * draw() calls font.beginFrame(), other text in the same font is drawn in the same frame.
+		 */
+		CartesianPlane(Font& font, const CoordinateSystemBase& range, double xStep = 1.0, double yStep = 1.0,
+					   const std::filesystem::path& resources = GLPP_RESOURCES):
+			m_range(range), m_xStep(xStep), m_yStep(yStep), m_lines(resources), m_text(resources), m_labels(font) {}
+
+		void setRange(const CoordinateSystemBase& range) {
+			m_range = range;
+			m_dirty = true;
+		}
+		void setSteps(double xStep, double yStep) {
+			m_xStep = xStep;
+			m_yStep = yStep;
+			m_dirty = true;
+		}
+		inline const CoordinateSystemBase& range() const { return m_range; }
+		inline AxisLabels&                 labels() { return m_labels; }
+
+		/* Plot coordinates onto normalized device coordinates, the visible range fills the viewport */
+		ml::mat4 projection() const {
+			// Lines and labels lie at z = 0, in the middle of the depth range
+			return ml::ortho(static_cast<float>(m_range.xMin), static_cast<float>(m_range.xMax), static_cast<float>(m_range.yMin),
+							 static_cast<float>(m_range.yMax), -1.0f, 1.0f);
 		}
 
-		void plotPoint(const ml::vec2<T>& point) {
-			createCircle({m_pos.x() + (point.x() * m_xStepSize), // Make X relative
-						  m_pos.y() + (point.y() * m_yStepSize), // Make Y relative
-						  m_pos.z()},
-						 0.02, 12, m_vertices, m_indices);
+		/* Plot already sampled points, they are decimated per zoom level when drawn */
+		void plot(std::vector<ml::vec2> points, const LineStyle& style = {}) {
+			m_functions.push_back({PolylineLOD(std::move(points)), style, PolylineBatch()});
 		}
-		void plotFunction() override {}
-		void plotFunction(T (*func)(T), rgb lineCol = Black.toRGB()) {
-			//functions.emplace_back(func, lineCol);
-			float thickness = 0.001;
-			for(int x = xMin; x < xMax; x += xStep) {
-				float y     = func(x);
-				float nextX = x + xStep;
-				float nextY = func(nextX);
-				plotLine({x, y}, {nextX, nextY});
+		/* Sample a function over the current x range */
+		void plotFunction(const std::function<float(float)>& function, const LineStyle& style = {}, size_t samples = 4096) {
+			std::vector<ml::vec2> points(std::max<size_t>(samples, 2));
+			const auto            step = static_cast<float>((m_range.xMax - m_range.xMin) / static_cast<double>(points.size() - 1));
+			for(size_t i = 0; i < points.size(); i++) {
+				const float x = static_cast<float>(m_range.xMin) + static_cast<float>(i) * step;
+				points[i]     = ml::vec2(x, function(x));
 			}
+			plot(std::move(points), style);
+		}
+		inline size_t functions() const { return m_functions.size(); }
+		void          clearFunctions() { m_functions.clear(); }
+
+		/**
+		 * Show a dataset written with TiledDataset::write() over a rectangle of the plane
+		 * Heat maps are drawn below the grid and the functions, in the order they were added.
+		 */
+		HeatMap& addHeatMap(const std::filesystem::path& dataset, const ml::vec2& position, const ml::vec2& size, float minValue, float maxValue) {
+			return m_heatMaps.emplace_back(dataset, position, size, minValue, maxValue);
 		}
+		inline size_t heatMaps() const { return m_heatMaps.size(); }
+		void          clearHeatMaps() { m_heatMaps.clear(); }
 
-		struct LineSettings {
-			bool  enabled;
-			rgba  color;
-			float thickness;
-		};
+		/* @param viewport size of the viewport in pixels */
+		void draw(const ml::vec2& viewport);
+	};
 
-		LineSettings grid;
-		LineSettings border;
-		LineSettings xAxis;
-		LineSettings yAxis;
-
-		// Set the background grid
-		void setGrid(bool enable, rgba color, float thickness) {}
-		// Set the X-axis and Y-axis simultaneously.
-		void setAxes(bool enable, rgba color, float thickness) {}
-		void setXAxis(bool enable, rgba color, float thickness) {}
-		void setYAxis(bool enable, rgba color, float thickness) {}
-		//void setNumbers(bool enamble, Font font, rgba color){}
-		// Set the border of the cartesian plane
-		void setBorder(bool enable, rgba color, float thickness) {}
-		// Set the background color
-		void setBackground(bool enable, rgba color) {}
-
-		// Creates an endless grid
-		CartesianPlane(const ml::vec3& pos, const ml::vec2& size) {}
-
-		CartesianPlane(const ml::vec3& pos, const ml::vec2& size, int xMin, int xMax, int yMin, int yMax, int xStep = 1, int yStep = 1):
-			Plottable2D<T>(pos, size), xMin{xMin}, xMax{xMax}, yMin{yMin}, yMax{yMax}, xStep{xStep}, yStep{yStep} {
-			update();
-			float thickness = 0.005;
-			plotLine({0.0f, yMin},
-					 {0.0f, yMax});
-
-			meshSlice2D(m_vertices, m_indices, {{xMin - 50.0f, 2.0f}, {xMax, 2.0f}});
-
-			plotLine({xMin, 0.0f},
-					 {xMax, 0.0f});
-			plotPoint({-5.0f, 5.0f});
-			plotPoint({-5.0f, -5.0f});
-			plotPoint({5.0f, -5.0f});
-			plotPoint({5.0f, 5.0f});
-		}
+	void CartesianPlane::build(float pixelsPerUnit) {
+		m_grid.clear();
+		m_axes.clear();
+		const auto xMin = static_cast<float>(m_range.xMin), xMax = static_cast<float>(m_range.xMax);
+		const auto yMin = static_cast<float>(m_range.yMin), yMax = static_cast<float>(m_range.yMax);
+		// Lines closer than a few pixels would fill the plane, skip the grid until zoomed in
+		auto gridLines = [](double min, double max, double step, float pixelsPerStep, auto&& line) {
+			if(step <= 0.0 || pixelsPerStep < 4.0f)
+				return;
+			for(double i = std::ceil(min / step); i * step <= max; i++)
+				line(static_cast<float>(i * step));
+		};
+		gridLines(m_range.xMin, m_range.xMax, m_xStep, static_cast<float>(m_xStep) * pixelsPerUnit,
+				  [&](float x) { m_grid.add({ml::vec2(x, yMin), ml::vec2(x, yMax)}); });
+		gridLines(m_range.yMin, m_range.yMax, m_yStep, static_cast<float>(m_yStep) * pixelsPerUnit,
+				  [&](float y) { m_grid.add({ml::vec2(xMin, y), ml::vec2(xMax, y)}); });
+
+		// The axes stay at the border when the origin is out of view, like the labels
+		const float xAxis = std::clamp(0.0f, yMin, yMax), yAxis = std::clamp(0.0f, xMin, xMax);
+		m_axes.add({ml::vec2(xMin, xAxis), ml::vec2(xMax, xAxis)});
+		m_axes.add({ml::vec2(yAxis, yMin), ml::vec2(yAxis, yMax)});
+
+		m_labels.build(m_range, m_xStep, m_yStep, pixelsPerUnit);
+		m_builtPixelsPerUnit = pixelsPerUnit;
+		m_builtGeneration    = m_labels.batch().font().generation();
+		m_dirty              = false;
+	}
 
-		bool hasChanged() {
-			return !(prevXMin == xMin &&
-					 prevXMax == xMax &&
-					 prevYMin == yMin &&
-					 prevYMax == yMax &&
-					 prevXStep == xStep &&
-					 prevYStep == yStep);
+	void CartesianPlane::draw(const ml::vec2& viewport) {
+		const ml::mat4 mvp           = projection();
+		const float    pixelsPerUnit = LOD::pixelsPerUnit(mvp, viewport.x());
+		// Uploads the distance fields generated since the last frame, the glyphs in use stay in the atlas
+		Font& font = m_labels.batch().font();
+		font.beginFrame();
+		if(m_dirty || pixelsPerUnit != m_builtPixelsPerUnit) {
+			build(pixelsPerUnit);
+		} else if(font.generation() != m_builtGeneration) {
+			// Glyphs were evicted or their fields arrived, only the labels are laid out again
+			m_labels.build(m_range, m_xStep, m_yStep, pixelsPerUnit);
+			m_builtGeneration = font.generation();
 		}
 
-		void draw() {
+		for(auto& heatMap: m_heatMaps) {
+			heatMap.update();
+			heatMap.draw(mvp);
 		}
-
-		//	Vertex& render(Renderer& renderer) override {}
-
-		Vertex& draw(Renderer& renderer) override {
-			if(hasChanged())
-				update();
-			// Filter all vertices that are not in the min-max range
-			// If necessarry re-sort the vertices, such that all unbounded?
-			// (not in min-max range) vertices are not in the renderer.draw() vertices.size() range
-			renderer.draw(m_vertices.data(), m_vertices.size(),
-						  m_indices.data(), m_indices.size());
+		if(showGrid)
+			m_lines.draw(m_grid, mvp, gridStyle, viewport);
+		m_lines.draw(m_axes, mvp, axisStyle, viewport);
+		for(auto& function: m_functions) {
+			const auto& points = function.samples.select(pixelsPerUnit);
+			if(&points != function.uploaded) {
+				function.batch.clear();
+				function.batch.add(points);
+				function.uploaded = &points;
+			}
+			m_lines.draw(function.batch, mvp, function.style, viewport);
 		}
-	};
+		m_labels.draw(m_text, mvp);
+	}
 
 	class PolarPlane {
 		void plotPoint(float radius, float angle) {
@@ -214,13 +228,6 @@ namespace glpp {
 		}
 	};
 
-	class Animation {
-		struct Frame: public Transformable {
-		};
-		std::vector<Frame> frames;
-		Frame&             operator[](int i) { return frames[i]; }
-		//void addFrame(){}
-	};
 	template<typename T = float>
 	class CartesianGraph {
 		T xMin, xMax;
@@ -259,10 +266,38 @@ namespace glpp {
 		PolarMap
 	};
 
+	/**
+	 * Plot a grid of values, indexed as val[y][x], onto a plane
+	 * A heat map covers the current range of the plane, its samples are written to a dataset in the temp directory.
+	 */
 	template<typename T>
-	void plot2d(const T& val, PlotMode plotMode) {
+	void plot2d(CartesianPlane& plane, const T& val, PlotMode plotMode) {
 		switch(plotMode) {
-		case PlotMode::HeatMap: break;
+		case PlotMode::HeatMap: {
+			const auto height = static_cast<uint32_t>(std::size(val));
+			const auto width  = height > 0 ? static_cast<uint32_t>(std::size(val[0])) : 0u;
+			if(width == 0)
+				break;
+			float minValue = std::numeric_limits<float>::max(), maxValue = std::numeric_limits<float>::lowest();
+			for(const auto& row: val) {
+				for(const auto& value: row) {
+					minValue = std::min(minValue, static_cast<float>(value));
+					maxValue = std::max(maxValue, static_cast<float>(value));
+				}
+			}
+			// Unique between processes as well, another plot must not replace a dataset that is mapped
+			static std::atomic<uint32_t> datasets = 0;
+			const auto                   path     = std::filesystem::temp_directory_path() /
+								"glpp-heatmap-{}-{}.vtx"_format(std::chrono::steady_clock::now().time_since_epoch().count(), datasets++);
+			if(!TiledDataset::write(path, width, height, [&val](uint32_t x, uint32_t y) { return static_cast<float>(val[y][x]); })) {
+				logging::error("Failed to write heat map dataset {}"_format(path.string()));
+				break;
+			}
+			const CoordinateSystemBase& range = plane.range();
+			plane.addHeatMap(path, {static_cast<float>(range.xMin), static_cast<float>(range.yMin)},
+							 {static_cast<float>(range.xMax - range.xMin), static_cast<float>(range.yMax - range.yMin)}, minValue, maxValue);
+			break;
+		}
 		case PlotMode::HeightMap: break;
 		case PlotMode::CartesianMap: break;
 		case PlotMode::PolarMap: break;
@@ -279,12 +314,12 @@ namespace glpp {
 	}
 
 	template<typename T>
-	void plot(const T& val, PlotMode plotMode) {
+	void plot(CartesianPlane& plane, const T& val, PlotMode plotMode) {
 		unsigned short dim = plotable_dim<T>();
 		if(dim == 2)
-			plot2d(val, plotMode);
+			plot2d(plane, val, plotMode);
 		if(dim == 3)
-			plot2d(val, plotMode);
+			plot3d(val, plotMode);
 	}
 }
 
@@ -0,0 +1,603 @@
+#ifndef VIRTUALTEXTURE_H
+#define VIRTUALTEXTURE_H
+
+#include "common.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+#include "graphics/debug.h"
+#include "graphics/renderstate.h"
+#include "graphics/shaders.h"
+#include "graphics/uniformbuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace glpp {
+	struct TiledDatasetHeader {
+		char     magic[8];
+		uint32_t version;
+		uint32_t width, height;
+		uint32_t pageSize;
+		uint32_t levels;
+		uint32_t padding;
+	};
+
+	/**
+	 * A 2D dataset of float samples split into square pages, with a pyramid of levels that each average 2x2 samples
+	 * Layout: TiledDatasetHeader, then the pages of every level from the finest, row by row, each pageSize² floats.
+	 * Samples of edge pages beyond the dataset are 0. The pages are numbered over all levels in the order they
+	 * are stored, the last page is the single page of the coarsest level.
+	 */
+	class TiledDataset {
+		static constexpr char magic[8] = "GLPPVTX";
+
+		MappedFile            m_file;
+		TiledDatasetHeader    m_header{};
+		std::vector<uint32_t> m_firstPage; // of every level, and the amount of pages at the end
+
+		static std::vector<uint32_t> firstPages(uint32_t width, uint32_t height, uint32_t pageSize);
+
+	  public:
+		using Sampler = std::function<float(uint32_t x, uint32_t y)>;
+
+		static constexpr uint32_t version = 1;
+
+		/* Map a dataset file, it is invalid if it isn't one or it is truncated */
+		explicit TiledDataset(const std::filesystem::path& path);
+
+		/**
+		 * Write a dataset, the finest level is sampled page by page, such that datasets larger than memory can be
+		 * generated. Subtrees of pages are built in parallel, sample is called from multiple threads.
+		 */
+		static bool write(const std::filesystem::path& path, uint32_t width, uint32_t height, const Sampler& sample, uint32_t pageSize = 256,
+						  ThreadPool& pool = ThreadPool::global());
+
+		inline bool     valid() const { return !m_firstPage.empty(); }
+		inline uint32_t width() const { return m_header.width; }
+		inline uint32_t height() const { return m_header.height; }
+		inline uint32_t pageSize() const { return m_header.pageSize; }
+		inline uint32_t levels() const { return m_header.levels; }
+		inline uint32_t pageCount() const { return valid() ? m_firstPage.back() : 0; }
+
+		/* Samples of a level, each level halves the previous one rounding up */
+		inline uint32_t levelWidth(uint32_t level) const { return (m_header.width + (1u << level) - 1) >> level; }
+		inline uint32_t levelHeight(uint32_t level) const { return (m_header.height + (1u << level) - 1) >> level; }
+		inline uint32_t pagesX(uint32_t level) const { return (levelWidth(level) + pageSize() - 1) / pageSize(); }
+		inline uint32_t pagesY(uint32_t level) const { return (levelHeight(level) + pageSize() - 1) / pageSize(); }
+		inline uint32_t firstPage(uint32_t level) const { return m_firstPage[level]; }
+		inline uint32_t pageIndex(uint32_t level, uint32_t x, uint32_t y) const { return m_firstPage[level] + y * pagesX(level) + x; }
+
+		/**
+		 * The sample of a level that a coordinate in [0, 1] falls in, for the horizontal or vertical axis
+		 * Computed in the same float operations as the shader, such that the CPU reference picks the same samples.
+		 */
+		uint32_t texel(uint32_t level, float coordinate, bool vertical) const {
+			const float    scaled = coordinate * float(vertical ? height() : width()) / float(1u << level);
+			const uint32_t size   = vertical ? levelHeight(level) : levelWidth(level);
+			return std::min(static_cast<uint32_t>(std::max(scaled, 0.0f)), size - 1);
+		}
+
+		std::span<const float> page(uint32_t index) const {
+			const size_t samples = size_t(pageSize()) * pageSize();
+			return {reinterpret_cast<const float*>(m_file.data() + sizeof(TiledDatasetHeader)) + index * samples, samples};
+		}
+	};
+
+	std::vector<uint32_t> TiledDataset::firstPages(uint32_t width, uint32_t height, uint32_t pageSize) {
+		std::vector<uint32_t> first = {0};
+		for(uint32_t level = 0;; level++) {
+			const uint32_t pagesX = (((width + (1u << level) - 1) >> level) + pageSize - 1) / pageSize;
+			const uint32_t pagesY = (((height + (1u << level) - 1) >> level) + pageSize - 1) / pageSize;
+			first.push_back(first.back() + pagesX * pagesY);
+			if(pagesX == 1 && pagesY == 1)
+				return first;
+		}
+	}
+
+	TiledDataset::TiledDataset(const std::filesystem::path& path): m_file(path) {
+		if(m_file.size() < sizeof(m_header))
+			return;
+		std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+		if(std::memcmp(m_header.magic, magic, sizeof(magic)) != 0 || m_header.version != version || m_header.width == 0 ||
+		   m_header.height == 0 || m_header.pageSize == 0)
+			return;
+		auto first = firstPages(m_header.width, m_header.height, m_header.pageSize);
+		if(first.size() != m_header.levels + 1 ||
+		   sizeof(m_header) + uint64_t(first.back()) * m_header.pageSize * m_header.pageSize * sizeof(float) > m_file.size())
+			return;
+		m_firstPage = std::move(first);
+	}
+
+	bool TiledDataset::write(const std::filesystem::path& path, uint32_t width, uint32_t height, const Sampler& sample, uint32_t pageSize,
+							 ThreadPool& pool) {
+		TiledDatasetHeader header{};
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.version  = version;
+		header.width    = width;
+		header.height   = height;
+		header.pageSize = pageSize;
+		const auto first = firstPages(width, height, pageSize);
+		header.levels    = static_cast<uint32_t>(first.size() - 1);
+
+		std::error_code error;
+		std::filesystem::create_directories(path.parent_path(), error);
+		std::filesystem::path temporary = path;
+		temporary += ".tmp";
+		const size_t pageBytes = size_t(pageSize) * pageSize * sizeof(float);
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			if(!file)
+				return false;
+		}
+		std::filesystem::resize_file(temporary, sizeof(header) + first.back() * pageBytes, error);
+		if(error)
+			return false;
+
+		auto levelSize = [&](uint32_t level, bool vertical) { return ((vertical ? height : width) + (1u << level) - 1) >> level; };
+		auto pagesX    = [&](uint32_t level) { return (levelSize(level, false) + pageSize - 1) / pageSize; };
+		auto pagesY    = [&](uint32_t level) { return (levelSize(level, true) + pageSize - 1) / pageSize; };
+
+		// Pages of the levels above split are built from the pages of split, which are kept in memory
+		uint32_t split = 0;
+		while(split + 1 < header.levels && pagesX(split + 1) * pagesY(split + 1) >= 4 * (pool.size() + 1))
+			split++;
+		std::vector<std::vector<float>> kept(size_t(pagesX(split)) * pagesY(split));
+
+		// Builds a page from its children, depth first, writing every page on the way
+		std::function<std::vector<float>(std::fstream&, uint32_t, uint32_t, uint32_t)> build;
+		build = [&](std::fstream& file, uint32_t level, uint32_t x, uint32_t y) {
+			if(level == split && !kept[size_t(y) * pagesX(split) + x].empty())
+				return kept[size_t(y) * pagesX(split) + x];
+			std::vector<float> page(size_t(pageSize) * pageSize, 0.0f);
+			const uint32_t     levelWidth = levelSize(level, false), levelHeight = levelSize(level, true);
+			if(level == 0) {
+				for(uint32_t sy = 0; sy < pageSize && y * pageSize + sy < levelHeight; sy++)
+					for(uint32_t sx = 0; sx < pageSize && x * pageSize + sx < levelWidth; sx++)
+						page[size_t(sy) * pageSize + sx] = sample(x * pageSize + sx, y * pageSize + sy);
+			} else {
+				std::vector<float> children[2][2];
+				for(uint32_t cy = 0; cy < 2; cy++)
+					for(uint32_t cx = 0; cx < 2; cx++)
+						if(x * 2 + cx < pagesX(level - 1) && y * 2 + cy < pagesY(level - 1))
+							children[cy][cx] = build(file, level - 1, x * 2 + cx, y * 2 + cy);
+				const uint32_t childWidth = levelSize(level - 1, false), childHeight = levelSize(level - 1, true);
+				for(uint32_t sy = 0; sy < pageSize && y * pageSize + sy < levelHeight; sy++) {
+					for(uint32_t sx = 0; sx < pageSize && x * pageSize + sx < levelWidth; sx++) {
+						// Average the samples below, the last row and column of odd sized levels have less of them
+						float sum = 0.0f;
+						int   count = 0;
+						for(uint32_t j = 0; j < 2; j++) {
+							for(uint32_t i = 0; i < 2; i++) {
+								const uint32_t childX = (x * pageSize + sx) * 2 + i, childY = (y * pageSize + sy) * 2 + j;
+								if(childX >= childWidth || childY >= childHeight)
+									continue;
+								const auto& child = children[childY / pageSize - y * 2][childX / pageSize - x * 2];
+								sum += child[size_t(childY % pageSize) * pageSize + childX % pageSize];
+								count++;
+							}
+						}
+						page[size_t(sy) * pageSize + sx] = sum / float(count);
+					}
+				}
+			}
+			file.seekp(static_cast<std::streamoff>(sizeof(header) + (first[level] + y * pagesX(level) + x) * pageBytes));
+			file.write(reinterpret_cast<const char*>(page.data()), static_cast<std::streamsize>(pageBytes));
+			return page;
+		};
+
+		std::atomic<bool> failed{false};
+		pool.parallelFor(
+			kept.size(),
+			[&](size_t begin, size_t end) {
+				// Every thread writes its own pages through its own stream
+				std::fstream file(temporary, std::ios::binary | std::ios::in | std::ios::out);
+				for(size_t i = begin; i < end; i++) {
+					auto page = build(file, split, static_cast<uint32_t>(i % pagesX(split)), static_cast<uint32_t>(i / pagesX(split)));
+					kept[i]   = std::move(page);
+				}
+				if(!file)
+					failed = true;
+			},
+			1);
+		std::fstream file(temporary, std::ios::binary | std::ios::in | std::ios::out);
+		if(split + 1 < header.levels)
+			build(file, header.levels - 1, 0, 0);
+		if(failed || !file)
+			return false;
+		file.close();
+
+		std::filesystem::rename(temporary, path, error);
+		if(error) {
+			std::cerr << "Could not store dataset " << path << ": " << error.message() << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Keeps track of which pages of a TiledDataset are in the slots of a page cache, and streams the missing ones in
+	 * Pages requested in a frame are copied out of the mapped file on the thread pool, so reading them from disk
+	 * never blocks the GL thread, which only copies finished pages into their slot in update().
+	 * Slots are reused least recently requested first. The page of the coarsest level is never evicted, such that
+	 * lookup() always finds a page to fall back to once it was loaded.
+	 */
+	class PageCache {
+	  public:
+		static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+		/* Copy the samples of a page into a slot */
+		using Upload = std::function<void(uint32_t slot, const float* samples)>;
+		struct Lookup {
+			uint32_t slot = none, level = 0, x = 0, y = 0; // the sample within the page of slot
+		};
+
+	  private:
+		struct Slot {
+			uint32_t page    = none;
+			uint64_t lastUse = 0;
+		};
+		struct Loaded {
+			uint32_t           page;
+			std::vector<float> samples;
+		};
+
+		const TiledDataset&            m_dataset;
+		ThreadPool&                    m_pool;
+		std::vector<Slot>              m_slots;
+		std::vector<uint32_t>          m_table;     // slot + 1 of every page, 0 when it isn't resident
+		std::vector<uint64_t>          m_requested; // frame a page was last requested in
+		std::vector<bool>              m_loading;
+		std::vector<uint32_t>          m_wanted; // requested this frame and not resident
+		std::vector<Loaded>            m_loaded;
+		std::mutex                     m_mutex; // guards m_loaded
+		std::vector<std::future<void>> m_jobs;
+		uint64_t                       m_frame = 1;
+
+	  public:
+		PageCache(const TiledDataset& dataset, size_t slots, ThreadPool& pool = ThreadPool::global()):
+			m_dataset(dataset), m_pool(pool), m_slots(std::max<size_t>(slots, 1)), m_table(dataset.pageCount(), 0),
+			m_requested(dataset.pageCount(), 0), m_loading(dataset.pageCount(), false) {}
+		~PageCache() { finish(); }
+		PageCache(const PageCache&) = delete;
+		PageCache& operator=(const PageCache&) = delete;
+
+		/* Mark a page as needed this frame, it is loaded if it isn't resident */
+		void request(uint32_t page) {
+			if(m_requested[page] == m_frame)
+				return;
+			m_requested[page] = m_frame;
+			if(m_table[page])
+				m_slots[m_table[page] - 1].lastUse = m_frame;
+			else if(!m_loading[page])
+				m_wanted.push_back(page);
+		}
+
+		/**
+		 * Start loading the pages requested this frame and copy at most maxUploads loaded pages into slots, then start the next frame
+		 * @return the pages whose slot changed, which have to be updated in the indirection table
+		 */
+		std::vector<uint32_t> update(const Upload& upload, size_t maxUploads = 16);
+
+		/* Wait for the pages being loaded, they are uploaded by the next update() */
+		void finish() {
+			for(auto& job: m_jobs)
+				job.wait();
+			m_jobs.clear();
+		}
+
+		/* The finest resident page that covers coordinate (u, v) at level or above, what the shader samples */
+		Lookup lookup(uint32_t level, float u, float v) const {
+			for(; level < m_dataset.levels(); level++) {
+				const uint32_t x = m_dataset.texel(level, u, false), y = m_dataset.texel(level, v, true);
+				const uint32_t size  = m_dataset.pageSize();
+				const uint32_t entry = m_table[m_dataset.pageIndex(level, x / size, y / size)];
+				if(entry)
+					return {entry - 1, level, x % size, y % size};
+			}
+			return {};
+		}
+
+		inline const std::vector<uint32_t>& table() const { return m_table; }
+		inline size_t                       slots() const { return m_slots.size(); }
+		inline bool                         resident(uint32_t page) const { return m_table[page] != 0; }
+		size_t                              residentCount() const {
+			return size_t(std::count_if(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.page != none; }));
+		}
+	};
+
+	std::vector<uint32_t> PageCache::update(const Upload& upload, size_t maxUploads) {
+		m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(),
+									[](auto& job) { return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }),
+					 m_jobs.end());
+
+		// Coarse pages first, they are the fallback of all pages below them
+		const uint32_t root = m_dataset.pageCount() - 1;
+		request(root);
+		std::sort(m_wanted.begin(), m_wanted.end(), std::greater<>());
+		for(uint32_t page: m_wanted) {
+			if(m_jobs.size() >= m_slots.size())
+				break;
+			m_loading[page] = true;
+			m_jobs.push_back(m_pool.submit([this, page] {
+				// Reading the mapped page faults it in from disk, on this thread
+				const auto samples = m_dataset.page(page);
+				Loaded     loaded{page, std::vector<float>(samples.begin(), samples.end())};
+				std::scoped_lock lock(m_mutex);
+				m_loaded.push_back(std::move(loaded));
+			}));
+		}
+		m_wanted.clear();
+
+		std::vector<Loaded> loaded;
+		{
+			std::scoped_lock lock(m_mutex);
+			const size_t     count = std::min(maxUploads, m_loaded.size());
+			loaded.assign(std::make_move_iterator(m_loaded.begin()), std::make_move_iterator(m_loaded.begin() + std::ptrdiff_t(count)));
+			m_loaded.erase(m_loaded.begin(), m_loaded.begin() + std::ptrdiff_t(count));
+		}
+		std::vector<uint32_t> changed;
+		for(auto& page: loaded) {
+			m_loading[page.page] = false;
+			// A free slot, or the least recently used one that wasn't requested this frame
+			Slot* slot = nullptr;
+			for(Slot& candidate: m_slots) {
+				if(candidate.page == none) {
+					slot = &candidate;
+					break;
+				}
+				if(candidate.page != root && candidate.lastUse < m_frame && (!slot || candidate.lastUse < slot->lastUse))
+					slot = &candidate;
+			}
+			// Every slot is visible this frame, the page is requested again if it still is
+			if(!slot)
+				continue;
+			if(slot->page != none) {
+				m_table[slot->page] = 0;
+				changed.push_back(slot->page);
+			}
+			const auto index = static_cast<uint32_t>(slot - m_slots.data());
+			slot->page       = page.page;
+			slot->lastUse    = m_requested[page.page];
+			m_table[page.page] = index + 1;
+			changed.push_back(page.page);
+			upload(index, page.samples.data());
+		}
+		m_frame++;
+		return changed;
+	}
+
+	/**
+	 * Software rasterizer of a virtual texture, evaluates every pixel the way the VirtualTexture shaders do
+	 * draw() rasterizes the region [from, to] of the dataset over width x height pixels, requesting the page each pixel
+	 * wants like the feedback buffer and sampling the finest resident page, or NaN where none is resident yet.
+	 * The page cache is an array in memory instead of a texture, so streaming can be tested without a GPU.
+	 */
+	class SoftwareVirtualTexture {
+		const TiledDataset& m_dataset;
+		PageCache           m_cache;
+		uint32_t            m_slotsPerRow;
+		std::vector<float>  m_pages;
+
+	  public:
+		SoftwareVirtualTexture(const TiledDataset& dataset, uint32_t slotsPerRow, ThreadPool& pool = ThreadPool::global()):
+			m_dataset(dataset), m_cache(dataset, size_t(slotsPerRow) * slotsPerRow, pool), m_slotsPerRow(slotsPerRow),
+			m_pages(size_t(slotsPerRow) * slotsPerRow * dataset.pageSize() * dataset.pageSize(), 0.0f) {}
+
+		/* The level a pixel samples when it spans texelsPerPixel samples of the finest level */
+		static uint32_t level(float texelsPerPixel, uint32_t levels) {
+			return std::min(static_cast<uint32_t>(std::floor(std::log2(std::max(texelsPerPixel, 1.0f)))), levels - 1);
+		}
+
+		std::vector<float> draw(int width, int height, const ml::vec2& from, const ml::vec2& to) {
+			std::vector<float> pixels(size_t(width) * size_t(height));
+			const float        du = (to.x() - from.x()) / float(width), dv = (to.y() - from.y()) / float(height);
+			const uint32_t     wanted = level(std::max(du * float(m_dataset.width()), dv * float(m_dataset.height())), m_dataset.levels());
+			const uint32_t     size   = m_dataset.pageSize();
+			for(int y = 0; y < height; y++) {
+				for(int x = 0; x < width; x++) {
+					const float u = from.x() + (float(x) + 0.5f) * du, v = from.y() + (float(y) + 0.5f) * dv;
+					m_cache.request(m_dataset.pageIndex(wanted, m_dataset.texel(wanted, u, false) / size, m_dataset.texel(wanted, v, true) / size));
+					const auto found = m_cache.lookup(wanted, u, v);
+					float&     pixel = pixels[size_t(y) * size_t(width) + size_t(x)];
+					if(found.slot == PageCache::none) {
+						pixel = std::numeric_limits<float>::quiet_NaN();
+						continue;
+					}
+					const size_t row = size_t(found.slot / m_slotsPerRow) * size + found.y, column = size_t(found.slot % m_slotsPerRow) * size + found.x;
+					pixel = m_pages[row * m_slotsPerRow * size + column];
+				}
+			}
+			return pixels;
+		}
+
+		/* Stream the pages requested by the draws since the last update */
+		void update(size_t maxUploads = 16) {
+			const uint32_t size = m_dataset.pageSize();
+			m_cache.update(
+				[&](uint32_t slot, const float* samples) {
+					for(uint32_t row = 0; row < size; row++) {
+						float* to = &m_pages[(size_t(slot / m_slotsPerRow) * size + row) * m_slotsPerRow * size + size_t(slot % m_slotsPerRow) * size];
+						std::memcpy(to, samples + size_t(row) * size, size * sizeof(float));
+					}
+				},
+				maxUploads);
+		}
+
+		inline PageCache& cache() { return m_cache; }
+	};
+
+	/**
+	 * Shows a TiledDataset that is too large for a texture, eg. 32k x 32k samples, as a heat map
+	 * Only the pages the view needs are resident, in the slots of one R32F page cache texture. The fragment shader
+	 * picks the level whose samples are closest to a pixel, marks its page in a feedback buffer, and samples the
+	 * finest resident page at or above that level through an indirection table holding the slot of every page.
+	 * update() reads the feedback two frames late, once the fence after the draws writing it has signaled, such that
+	 * reading it back never waits for the GPU, and hands the requests to a PageCache, which streams the pages from the mapped file.
+	 * Samples are fetched without filtering, a zoomed in heat map shows every sample as a cell.
+	 */
+	class VirtualTexture {
+		static constexpr uint32_t maxLevels = 16;
+
+		TiledDataset          m_dataset;
+		uint32_t              m_slotsPerRow;
+		PageCache             m_cache;
+		Shader                m_shader;
+		UniformHandle         m_mvp, m_rect, m_range, m_pages;
+		GLuint                m_texture{}, m_table{}, m_feedback[2]{}, VAO{};
+		GLsync                m_fences[2]{}; // after the last draw writing each feedback buffer
+		std::vector<uint32_t> m_requests;
+		uint64_t              m_frame = 0;
+
+		// Offset of the entries in the table buffer, after the layout of the dataset
+		static constexpr size_t tableHeader = 4 * sizeof(uint32_t) + maxLevels * 4 * sizeof(uint32_t);
+
+	  public:
+		/* @param cacheSize width and height of the page cache texture, rounded down to whole pages */
+		explicit VirtualTexture(const std::filesystem::path& dataset, uint32_t cacheSize = 4096,
+								const std::filesystem::path& resources = GLPP_RESOURCES);
+		~VirtualTexture();
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+		/* Stream the pages that earlier frames needed, once per frame before draw() */
+		void update(size_t maxUploads = 16);
+		/* Draw the dataset over rect (x, y, width, height), with values in [minValue, maxValue] over the color map */
+		void draw(const ml::mat4& mvp, const ml::vec4& rect, float minValue, float maxValue);
+
+		inline const TiledDataset& dataset() const { return m_dataset; }
+		inline PageCache&          cache() { return m_cache; }
+	};
+
+	VirtualTexture::VirtualTexture(const std::filesystem::path& dataset, uint32_t cacheSize, const std::filesystem::path& resources):
+		m_dataset(dataset), m_slotsPerRow(m_dataset.valid() ? std::max(cacheSize / m_dataset.pageSize(), 1u) : 1),
+		m_cache(m_dataset, size_t(m_slotsPerRow) * m_slotsPerRow), m_shader(resources / "virtual_texture_shaders"), m_mvp(m_shader.uniform("mvp")),
+		m_rect(m_shader.uniform("rect")), m_range(m_shader.uniform("range")), m_pages(m_shader.uniform("pages")) {
+		m_shader.bindStorageBlock("PageTable", pageTableBinding);
+		m_shader.bindStorageBlock("Feedback", pageFeedbackBinding);
+		if(!m_dataset.valid() || m_dataset.levels() > maxLevels) {
+			std::cerr << "Failed to load dataset: " << dataset << std::endl;
+			return;
+		}
+		const uint32_t size = m_slotsPerRow * m_dataset.pageSize();
+
+		glGenTextures(1, &m_texture);
+		RenderState::current().bindTexture(0, GL_TEXTURE_2D, m_texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glASSERT(glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, static_cast<GLsizei>(size), static_cast<GLsizei>(size)));
+
+		// The layout of the dataset followed by an empty entry for every page
+		std::vector<uint32_t> table(tableHeader / sizeof(uint32_t) + m_dataset.pageCount(), 0);
+		table[0] = m_dataset.pageSize();
+		table[1] = m_dataset.levels();
+		table[2] = m_slotsPerRow;
+		for(uint32_t level = 0; level < m_dataset.levels(); level++) {
+			uint32_t* entry = &table[4 + level * 4];
+			entry[0]        = m_dataset.levelWidth(level);
+			entry[1]        = m_dataset.levelHeight(level);
+			entry[2]        = m_dataset.pagesX(level);
+			entry[3]        = m_dataset.firstPage(level);
+		}
+		glGenBuffers(1, &m_table);
+		RenderState::current().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_table);
+		glASSERT(glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(table.size() * sizeof(uint32_t)), table.data(), GL_DYNAMIC_DRAW));
+
+		// A bit per page
+		m_requests.resize((m_dataset.pageCount() + 31) / 32, 0);
+		glGenBuffers(2, m_feedback);
+		for(GLuint buffer: m_feedback) {
+			RenderState::current().bindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+			glASSERT(glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(m_requests.size() * sizeof(uint32_t)), m_requests.data(),
+								  GL_DYNAMIC_READ));
+		}
+		// The quad is generated from gl_VertexID, but drawing needs a vertex array
+		glGenVertexArrays(1, &VAO);
+	}
+
+	VirtualTexture::~VirtualTexture() {
+		RenderState::current().deletedTexture(m_texture);
+		RenderState::current().deletedBuffer(m_table);
+		RenderState::current().deletedBuffer(m_feedback[0]);
+		RenderState::current().deletedBuffer(m_feedback[1]);
+		RenderState::current().deletedVertexArray(VAO);
+		glDeleteTextures(1, &m_texture);
+		glDeleteBuffers(1, &m_table);
+		glDeleteBuffers(2, m_feedback);
+		glDeleteVertexArrays(1, &VAO);
+		for(GLsync fence: m_fences)
+			glDeleteSync(fence);
+	}
+
+	void VirtualTexture::update(size_t maxUploads) {
+		if(!m_texture)
+			return;
+		// The buffer the draws of this frame write to was written two frames ago, read and clear it once those draws finished.
+		// Until then the draws of this frame add their requests to the same buffer, which is read a frame later instead
+		m_frame++;
+		GLsync& fence = m_fences[m_frame % 2];
+		if(fence && glClientWaitSync(fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+			glDeleteSync(fence);
+			fence = nullptr;
+			RenderState::current().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_feedback[m_frame % 2]);
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(m_requests.size() * sizeof(uint32_t)), m_requests.data());
+			glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+			for(size_t word = 0; word < m_requests.size(); word++) {
+				for(uint32_t bits = m_requests[word]; bits; bits &= bits - 1)
+					m_cache.request(static_cast<uint32_t>(word * 32 + size_t(std::countr_zero(bits))));
+			}
+		}
+
+		const uint32_t size = m_dataset.pageSize();
+		RenderState::current().bindTexture(0, GL_TEXTURE_2D, m_texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		const auto changed = m_cache.update(
+			[&](uint32_t slot, const float* samples) {
+				glASSERT(glTexSubImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(slot % m_slotsPerRow * size), static_cast<GLint>(slot / m_slotsPerRow * size),
+										 static_cast<GLsizei>(size), static_cast<GLsizei>(size), GL_RED, GL_FLOAT, samples));
+			},
+			maxUploads);
+		RenderState::current().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_table);
+		for(uint32_t page: changed)
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, static_cast<GLintptr>(tableHeader + page * sizeof(uint32_t)), sizeof(uint32_t), &m_cache.table()[page]);
+	}
+
+	void VirtualTexture::draw(const ml::mat4& mvp, const ml::vec4& rect, float minValue, float maxValue) {
+		if(!m_texture)
+			return;
+		m_shader.use();
+		m_shader.setUniform(m_mvp, mvp);
+		m_shader.setUniform(m_rect, rect);
+		m_shader.setUniform(m_range, ml::vec2(minValue, maxValue));
+		m_shader.setUniform(m_pages, 0);
+		RenderState::current().bindTexture(0, GL_TEXTURE_2D, m_texture);
+		// Binding the base also changes the generic binding, which the shadow state has to know about
+		RenderState::current().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_feedback[m_frame % 2]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, pageTableBinding, m_table);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, pageFeedbackBinding, m_feedback[m_frame % 2]);
+		RenderState::current().bindVertexArray(VAO);
+		glASSERT(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+		// The feedback is read back with glGetBufferSubData once the fence signals
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		GLsync& fence = m_fences[m_frame % 2];
+		if(fence)
+			glDeleteSync(fence);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+#endif //VIRTUALTEXTURE_H
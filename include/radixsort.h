@@ -0,0 +1,53 @@
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * Stable least significant digit radix sort on 64 bit keys, 8 bits per pass
+	 * Passes in which every key has the same byte are skipped, so sorting on small keys costs only a few passes.
+	 * @param values sorted in place
+	 * @param scratch reused between calls to avoid allocating every frame
+	 * @param key returns the uint64_t key of a value
+	 */
+	template<typename T, typename Key>
+	void radixSort(std::vector<T>& values, std::vector<T>& scratch, Key&& key) {
+		const size_t count = values.size();
+		if(count < 2)
+			return;
+		scratch.resize(count);
+
+		// Build all histograms in a single pass over the keys
+		std::array<std::array<size_t, 256>, 8> histograms{};
+		for(const T& value: values) {
+			uint64_t k = key(value);
+			for(size_t pass = 0; pass < 8; pass++)
+				histograms[pass][(k >> (pass * 8)) & 0xFF]++;
+		}
+
+		std::vector<T>* source      = &values;
+		std::vector<T>* destination = &scratch;
+		for(size_t pass = 0; pass < 8; pass++) {
+			auto& histogram = histograms[pass];
+			if(histogram[(key((*source)[0]) >> (pass * 8)) & 0xFF] == count)
+				continue;
+
+			size_t offset = 0;
+			for(auto& bucket: histogram) {
+				size_t size = bucket;
+				bucket      = offset;
+				offset += size;
+			}
+			for(T& value: *source)
+				(*destination)[histogram[(key(value) >> (pass * 8)) & 0xFF]++] = std::move(value);
+			std::swap(source, destination);
+		}
+		if(source != &values)
+			values.swap(scratch);
+	}
+}
+
+#endif //RADIXSORT_H
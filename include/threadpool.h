@@ -0,0 +1,113 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace glpp {
+	/**
+	 * Fixed amount of worker threads executing tasks in submission order
+	 * The workers never touch OpenGL, tasks that need the context have to hand their results back to the GL thread.
+	 */
+	class ThreadPool {
+		std::vector<std::thread>          m_workers;
+		std::deque<std::function<void()>> m_tasks;
+		std::mutex                        m_mutex;
+		std::condition_variable           m_condition;
+		bool                              m_stopping = false;
+
+		void work() {
+			while(true) {
+				std::function<void()> task;
+				{
+					std::unique_lock lock(m_mutex);
+					m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+					if(m_tasks.empty())
+						return;
+					task = std::move(m_tasks.front());
+					m_tasks.pop_front();
+				}
+				task();
+			}
+		}
+
+	  public:
+		/* @param threads amount of workers, defaults to one less than the hardware threads as the caller works as well */
+		explicit ThreadPool(size_t threads = std::max(2u, std::thread::hardware_concurrency()) - 1) {
+			for(size_t i = 0; i < threads; i++)
+				m_workers.emplace_back(&ThreadPool::work, this);
+		}
+		~ThreadPool() {
+			{
+				std::scoped_lock lock(m_mutex);
+				m_stopping = true;
+			}
+			m_condition.notify_all();
+			for(auto& worker: m_workers)
+				worker.join();
+		}
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/* Shared pool for the library, created on first use */
+		static ThreadPool& global() {
+			static ThreadPool pool;
+			return pool;
+		}
+
+		inline size_t size() const { return m_workers.size(); }
+
+		template<typename F>
+		auto submit(F&& function) -> std::future<decltype(function())> {
+			using Result = decltype(function());
+			// std::function has to be copyable, so the packaged task is shared
+			auto task   = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+			auto future = task->get_future();
+			{
+				std::scoped_lock lock(m_mutex);
+				m_tasks.emplace_back([task] { (*task)(); });
+			}
+			m_condition.notify_one();
+			return future;
+		}
+
+		/**
+		 * Call function(begin, end) for consecutive chunks of [0, count) in parallel, and wait for all of them
+		 * The calling thread executes chunks as well, so it never idles while waiting.
+		 * @param minChunk the smallest amount of items worth sending to another thread
+		 */
+		template<typename F>
+		void parallelFor(size_t count, F&& function, size_t minChunk = 1024) {
+			if(count == 0)
+				return;
+			const size_t chunks    = std::clamp<size_t>(count / std::max<size_t>(minChunk, 1), 1, size() + 1);
+			const size_t chunkSize = (count + chunks - 1) / chunks;
+			if(chunks == 1) {
+				function(size_t(0), count);
+				return;
+			}
+
+			std::atomic<size_t> next{0};
+			auto                run = [&] {
+				for(size_t chunk = next++; chunk < chunks; chunk = next++)
+					function(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+			};
+			std::vector<std::future<void>> helpers;
+			helpers.reserve(chunks - 1);
+			for(size_t i = 0; i < chunks - 1; i++)
+				helpers.push_back(submit(run));
+			run();
+			for(auto& helper: helpers)
+				helper.get();
+		}
+	};
+}
+
+#endif //THREADPOOL_H
@@ -0,0 +1,12 @@
+#version 410 core
+out vec4 o_Color;
+
+in vec2 g_Round;
+
+uniform vec4 color;
+
+void main(){
+    if(dot(g_Round, g_Round) > 1.0)
+        discard;
+    o_Color = color;
+}
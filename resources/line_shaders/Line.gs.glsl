@@ -0,0 +1,92 @@
+#version 410 core
+// Extrudes the segment between points 1 and 2 to a constant width in pixels,
+// points 0 and 3 are its neighbours. Open polylines repeat their end points, which marks the caps.
+layout(lines_adjacency) in;
+layout(triangle_strip, max_vertices = 12) out;
+
+uniform vec2 viewport;
+uniform float width;
+uniform float miterLimit;
+uniform int join; // 0 miter, 1 round, 2 bevel
+uniform int cap;  // 0 butt, 1 square, 2 round
+
+// Position within a round join or cap in units of the half width, 0 on the rest of the line
+out vec2 g_Round;
+
+float depth;
+
+vec2 toScreen(vec4 clip){
+    return (clip.xy / clip.w * 0.5 + 0.5) * viewport;
+}
+void emit(vec2 screen, vec2 round){
+    gl_Position = vec4(screen / viewport * 2.0 - 1.0, depth, 1.0);
+    g_Round = round;
+    EmitVertex();
+}
+vec2 perpendicular(vec2 v){
+    return vec2(-v.y, v.x);
+}
+// A square around the point, the fragment shader cuts the circle out of it
+void emitRound(vec2 center, float halfWidth){
+    emit(center + vec2(-halfWidth, -halfWidth), vec2(-1.0, -1.0));
+    emit(center + vec2(halfWidth, -halfWidth), vec2(1.0, -1.0));
+    emit(center + vec2(-halfWidth, halfWidth), vec2(-1.0, 1.0));
+    emit(center + vec2(halfWidth, halfWidth), vec2(1.0, 1.0));
+    EndPrimitive();
+}
+// Whether the join between the two directions is mitered, sharp angles fall back to a bevel
+bool mitered(vec2 incoming, vec2 outgoing){
+    vec2 tangent = normalize(incoming + outgoing);
+    return join == 0 && 1.0 / max(dot(perpendicular(tangent), perpendicular(incoming)), 1e-3) <= miterLimit;
+}
+vec2 miterOffset(vec2 incoming, vec2 outgoing, float halfWidth){
+    vec2 miter = perpendicular(normalize(incoming + outgoing));
+    return miter * halfWidth / dot(miter, perpendicular(incoming));
+}
+
+void main(){
+    depth = gl_in[1].gl_Position.z / gl_in[1].gl_Position.w;
+    vec2 p0 = toScreen(gl_in[0].gl_Position);
+    vec2 p1 = toScreen(gl_in[1].gl_Position);
+    vec2 p2 = toScreen(gl_in[2].gl_Position);
+    vec2 p3 = toScreen(gl_in[3].gl_Position);
+    if(length(p2 - p1) < 1e-4)
+        return;
+
+    float halfWidth = width * 0.5;
+    vec2 direction = normalize(p2 - p1);
+    vec2 normal = perpendicular(direction);
+    bool startCap = length(p1 - p0) < 1e-4;
+    bool endCap = length(p3 - p2) < 1e-4;
+    vec2 previous = startCap ? direction : normalize(p1 - p0);
+    vec2 next = endCap ? direction : normalize(p3 - p2);
+
+    vec2 start = p1, end = p2;
+    if(startCap && cap == 1)
+        start -= direction * halfWidth;
+    if(endCap && cap == 1)
+        end += direction * halfWidth;
+    vec2 startOffset = !startCap && mitered(previous, direction) ? miterOffset(previous, direction, halfWidth) : normal * halfWidth;
+    vec2 endOffset = !endCap && mitered(direction, next) ? miterOffset(direction, next, halfWidth) : normal * halfWidth;
+
+    emit(start + startOffset, vec2(0.0));
+    emit(start - startOffset, vec2(0.0));
+    emit(end + endOffset, vec2(0.0));
+    emit(end - endOffset, vec2(0.0));
+    EndPrimitive();
+
+    if(startCap && cap == 2)
+        emitRound(p1, halfWidth);
+    if(endCap && cap == 2)
+        emitRound(p2, halfWidth);
+    if(!endCap && join == 1)
+        emitRound(p2, halfWidth);
+    // Fill the wedge on the outer side of the join, the next segment starts on the normal as well
+    if(!endCap && join != 1 && !mitered(direction, next)){
+        float side = direction.x * next.y - direction.y * next.x > 0.0 ? -1.0 : 1.0;
+        emit(p2, vec2(0.0));
+        emit(p2 + normal * halfWidth * side, vec2(0.0));
+        emit(p2 + perpendicular(next) * halfWidth * side, vec2(0.0));
+        EndPrimitive();
+    }
+}
@@ -0,0 +1,9 @@
+#version 410 core
+// Polyline points only, the geometry shader extrudes them into triangles
+layout(location = 0) in vec2 a_Position;
+
+uniform mat4 mvp;
+
+void main(){
+    gl_Position = mvp * vec4(a_Position, 0.0, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 410 core
+out vec4 o_Color;
+
+uniform sampler2D accumulation;
+uniform sampler2D revealage;
+
+void main(){
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float reveal = texelFetch(revealage, texel, 0).r;
+    // Nothing translucent covers this pixel
+    if(reveal == 1.0)
+        discard;
+    vec4 accumulated = texelFetch(accumulation, texel, 0);
+    vec3 average = accumulated.rgb / max(accumulated.a, 1e-5);
+    // Blended with (1 - alpha, alpha): the average color covers 1 - reveal of the background
+    o_Color = vec4(average, reveal);
+}
@@ -0,0 +1,24 @@
+#version 410 core
+out vec4 o_Color;
+
+// The accumulation targets have the sample count of the target they are composited onto
+uniform sampler2DMS accumulation;
+uniform sampler2DMS revealage;
+uniform int samples;
+
+void main(){
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float reveal = 0.0;
+    vec4 accumulated = vec4(0.0);
+    for(int i = 0; i < samples; i++){
+        reveal += texelFetch(revealage, texel, i).r;
+        accumulated += texelFetch(accumulation, texel, i);
+    }
+    reveal /= float(samples);
+    // Nothing translucent covers this pixel
+    if(reveal == 1.0)
+        discard;
+    vec3 average = accumulated.rgb / max(accumulated.a, 1e-5);
+    // Blended with (1 - alpha, alpha): the average color covers 1 - reveal of the background
+    o_Color = vec4(average, reveal);
+}
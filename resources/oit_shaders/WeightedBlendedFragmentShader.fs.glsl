@@ -0,0 +1,22 @@
+#version 410 core
+// Weighted blended order-independent transparency, McGuire and Bavoil 2013
+layout(location = 0) out vec4 o_Accumulation;
+layout(location = 1) out float o_Revealage;
+
+in vec4 v_Color;
+in vec2 v_TexCoord;
+flat in float v_TexIndex;
+in vec4 v_Position;
+
+// The atlas of the scene shader, @see scene_shaders
+uniform sampler2DArray atlas;
+
+void main(){
+    vec4 color = v_Color;
+    if(v_TexIndex > 0.5)
+        color *= texture(atlas, vec3(v_TexCoord, v_TexIndex - 1.0));
+    // Nearer and more opaque fragments weigh more, clamped to stay within 16 bit float range
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    o_Accumulation = vec4(color.rgb * color.a, color.a) * weight;
+    o_Revealage = color.a;
+}
@@ -1,16 +1,32 @@
-#version 410 core
+#version 430 core
 layout(location = 0) in vec3 a_Position;
 layout(location = 1) in vec4 a_Color;
 layout(location = 2) in vec2 a_TexCoord;
 layout(location = 3) in float a_TexIndex;
 layout(location = 4) in vec3 a_Normals;
 
-uniform mat4 mvp;
+layout(std140, row_major) uniform Frame {
+  mat4 projection;
+  vec4 viewport;
+  float time;
+} frame;
+layout(std430, row_major) readonly buffer Transforms {
+  mat4 transforms[];
+};
+// Index of the model transform of the draw, -1 for geometry already in world space
+uniform int drawID;
+
 out vec4 v_Position;
 out vec4 v_Color;
+out vec2 v_TexCoord;
+// Layer + 1 in the atlas, 0 for untextured vertices
+flat out float v_TexIndex;
 
 void main(){
-  gl_Position = mvp * vec4(a_Position, 1.0);
+  mat4 model = drawID < 0 ? mat4(1.0) : transforms[drawID];
+  gl_Position = frame.projection * model * vec4(a_Position, 1.0);
   v_Color = a_Color;
+  v_TexCoord = a_TexCoord;
+  v_TexIndex = a_TexIndex;
   v_Position = gl_Position;
-}
\ No newline at end of file
+}
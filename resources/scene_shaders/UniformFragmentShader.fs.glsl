@@ -3,10 +3,14 @@ out vec4 o_Color;
 
 in vec4 v_Color;
 in vec2 v_TexCoord;
+flat in float v_TexIndex;
 in vec4 v_Position;
 
-uniform mat4 mvp;
+// Images of all textured shapes, selected by layer such that they share one draw
+uniform sampler2DArray atlas;
 
 void main(){
     o_Color = v_Color;
-}
\ No newline at end of file
+    if(v_TexIndex > 0.5)
+        o_Color *= texture(atlas, vec3(v_TexCoord, v_TexIndex - 1.0));
+}
@@ -0,0 +1,64 @@
+#version 410 core
+out vec4 o_Color;
+
+in vec2 v_Local;
+flat in vec2 v_HalfSize;
+flat in vec4 v_Parameters;
+flat in vec2 v_Angles;
+flat in vec4 v_Fill;
+flat in vec4 v_Stroke;
+flat in vec4 v_ImageUV;
+flat in float v_ImageLayer;
+
+uniform sampler2DArray atlas;
+
+const int CIRCLE = 0, ELLIPSE = 1, ROUNDED_RECT = 2, RING = 3, ARC = 4;
+
+float ellipse(vec2 p, vec2 radii){
+    float k0 = length(p / radii);
+    float k1 = length(p / (radii * radii));
+    return k0 * (k0 - 1.0) / max(k1, 1e-6);
+}
+float roundedRect(vec2 p, vec2 halfSize, float radius){
+    vec2 q = abs(p) - halfSize + radius;
+    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radius;
+}
+// Arc of the given thickness with round ends, from angle start to end counter clockwise
+float arc(vec2 p, float start, float end, float radius, float thickness){
+    float middle = (start + end) * 0.5, aperture = (end - start) * 0.5;
+    float s = sin(-middle), c = cos(-middle);
+    p = vec2(c * p.x - s * p.y, s * p.x + c * p.y);
+    p.y = abs(p.y);
+    vec2 sc = vec2(cos(aperture), sin(aperture));
+    float d = sc.x * p.y > sc.y * p.x ? length(p - sc * radius) : abs(length(p) - radius);
+    return d - thickness * 0.5;
+}
+
+void main(){
+    int shape = int(v_Parameters.w);
+    float parameter = v_Parameters.y;
+    float d;
+    if(shape == CIRCLE)
+        d = length(v_Local) - v_HalfSize.x;
+    else if(shape == ELLIPSE)
+        d = ellipse(v_Local, v_HalfSize);
+    else if(shape == ROUNDED_RECT)
+        d = roundedRect(v_Local, v_HalfSize, parameter);
+    else if(shape == RING)
+        d = abs(length(v_Local) - v_HalfSize.x + parameter * 0.5) - parameter * 0.5;
+    else
+        d = arc(v_Local, v_Angles.x, v_Angles.y, v_HalfSize.x - parameter * 0.5, parameter);
+
+    // Antialias over one pixel, independent of the zoom
+    float pixel = max(fwidth(d), 1e-6);
+    float coverage = clamp(0.5 - d / pixel, 0.0, 1.0);
+    if(coverage <= 0.0)
+        discard;
+    float border = v_Parameters.z;
+    vec4 fill = v_Fill;
+    // The image is stretched over the bounding rectangle of the shape
+    if(v_ImageLayer >= 0.0)
+        fill *= texture(atlas, vec3(mix(v_ImageUV.xy, v_ImageUV.zw, v_Local / v_HalfSize * 0.5 + 0.5), v_ImageLayer));
+    vec4 color = border > 0.0 ? mix(v_Stroke, fill, clamp(0.5 - (d + border) / pixel, 0.0, 1.0)) : fill;
+    o_Color = vec4(color.rgb, color.a * coverage);
+}
@@ -0,0 +1,39 @@
+#version 410 core
+// One instance per shape, the quad covering it is generated from gl_VertexID
+layout(location = 0) in vec2 a_Center;
+layout(location = 1) in vec2 a_HalfSize;
+layout(location = 2) in vec4 a_Parameters; // rotation, shape parameter, border, shape
+layout(location = 3) in vec2 a_Angles;
+layout(location = 4) in vec4 a_Fill;
+layout(location = 5) in vec4 a_Stroke;
+layout(location = 6) in vec4 a_ImageUV;
+layout(location = 7) in float a_ImageLayer; // -1 if untextured
+
+uniform mat4 mvp;
+uniform float pixelSize; // world units per pixel
+
+out vec2 v_Local;
+flat out vec2 v_HalfSize;
+flat out vec4 v_Parameters;
+flat out vec2 v_Angles;
+flat out vec4 v_Fill;
+flat out vec4 v_Stroke;
+flat out vec4 v_ImageUV;
+flat out float v_ImageLayer;
+
+void main(){
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    // Grow the quad by a pixel such that the antialiased edge isn't clipped
+    v_Local = corner * (a_HalfSize + pixelSize);
+    float s = sin(a_Parameters.x), c = cos(a_Parameters.x);
+    vec2 world = a_Center + vec2(c * v_Local.x - s * v_Local.y, s * v_Local.x + c * v_Local.y);
+    gl_Position = mvp * vec4(world, 0.0, 1.0);
+
+    v_HalfSize = a_HalfSize;
+    v_Parameters = a_Parameters;
+    v_Angles = a_Angles;
+    v_Fill = a_Fill;
+    v_Stroke = a_Stroke;
+    v_ImageUV = a_ImageUV;
+    v_ImageLayer = a_ImageLayer;
+}
@@ -0,0 +1,20 @@
+#version 410 core
+out vec4 o_Color;
+
+in vec3 v_UV;
+in vec4 v_Color;
+
+uniform sampler2DArray atlas;
+uniform bool distanceField;
+
+void main(){
+    float coverage = texture(atlas, v_UV).r;
+    if(distanceField){
+        // 0.5 is the outline, blend over the distance one pixel on screen spans
+        float width = max(fwidth(coverage), 1e-4) * 0.5;
+        coverage = smoothstep(0.5 - width, 0.5 + width, coverage);
+    }
+    if(coverage <= 0.0)
+        discard;
+    o_Color = vec4(v_Color.rgb, v_Color.a * coverage);
+}
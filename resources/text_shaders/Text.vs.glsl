@@ -0,0 +1,18 @@
+#version 410 core
+// One instance per glyph, the quad covering it is generated from gl_VertexID
+layout(location = 0) in vec4 a_Rect;  // left, bottom, right, top
+layout(location = 1) in vec4 a_UV;    // u0, v0 at the top, u1, v1 at the bottom
+layout(location = 2) in vec4 a_Color;
+layout(location = 3) in float a_Layer;
+
+uniform mat4 mvp;
+
+out vec3 v_UV;
+out vec4 v_Color;
+
+void main(){
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    gl_Position = mvp * vec4(mix(a_Rect.xy, a_Rect.zw, corner), 0.0, 1.0);
+    v_UV = vec3(mix(a_UV.x, a_UV.z, corner.x), mix(a_UV.w, a_UV.y, corner.y), a_Layer);
+    v_Color = a_Color;
+}
@@ -0,0 +1,61 @@
+#version 430 core
+// Keep in sync with SoftwareVirtualTexture::draw(), the CPU reference of this shader
+in vec2 v_UV;
+out vec4 o_Color;
+
+uniform sampler2D pages; // the page cache, R32F
+uniform vec2 range;      // the values at both ends of the color map
+
+// Bound to pageTableBinding and pageFeedbackBinding by VirtualTexture
+layout(std430) readonly buffer PageTable {
+    uint pageSize;
+    uint levels;
+    uint slotsPerRow;
+    uint padding;
+    uvec4 level[16]; // samples wide and high, pages per row, index of the first page
+    uint entries[];  // slot + 1 of every page, 0 when it isn't resident
+};
+// A bit for every page that was wanted
+layout(std430) buffer Feedback {
+    uint requested[];
+};
+
+uvec2 texel(uint l){
+    return min(uvec2(max(v_UV * vec2(level[0].xy) / float(1u << l), 0.0)), level[l].xy - 1u);
+}
+
+vec3 colormap(float t){
+    const vec3 stops[5] = vec3[](vec3(0.05, 0.03, 0.53), vec3(0.49, 0.01, 0.66), vec3(0.80, 0.28, 0.47), vec3(0.97, 0.59, 0.25), vec3(0.94, 0.98, 0.13));
+    float scaled = t * 4.0;
+    int i = min(int(scaled), 3);
+    return mix(stops[i], stops[i + 1], scaled - float(i));
+}
+
+void main(){
+    // The level whose samples are closest to a pixel, without going below a sample per pixel
+    vec2 samples = v_UV * vec2(level[0].xy);
+    float texelsPerPixel = max(length(dFdx(samples)), length(dFdy(samples)));
+    uint wanted = min(uint(floor(log2(max(texelsPerPixel, 1.0)))), levels - 1u);
+
+    uvec2 page = texel(wanted) / pageSize;
+    uint index = level[wanted].w + page.y * level[wanted].z + page.x;
+    uint bit = 1u << (index & 31u);
+    // Most pixels of a page find its bit set already, which avoids the atomic
+    if((requested[index >> 5] & bit) == 0u)
+        atomicOr(requested[index >> 5], bit);
+
+    // The finest resident page at or above the wanted level, the coarsest one is always resident
+    for(uint l = wanted; l < levels; l++){
+        uvec2 t = texel(l);
+        uvec2 p = t / pageSize;
+        uint entry = entries[level[l].w + p.y * level[l].z + p.x];
+        if(entry == 0u)
+            continue;
+        uint slot = entry - 1u;
+        ivec2 at = ivec2(uvec2(slot % slotsPerRow, slot / slotsPerRow) * pageSize + t % pageSize);
+        float value = texelFetch(pages, at, 0).r;
+        o_Color = vec4(colormap(clamp((value - range.x) / (range.y - range.x), 0.0, 1.0)), 1.0);
+        return;
+    }
+    discard;
+}
@@ -0,0 +1,12 @@
+#version 430 core
+// The quad covering rect is generated from gl_VertexID, the first row of the dataset is at the bottom
+uniform mat4 mvp;
+uniform vec4 rect; // x, y, width, height
+
+out vec2 v_UV;
+
+void main(){
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    v_UV = corner;
+    gl_Position = mvp * vec4(rect.xy + corner * rect.zw, 0.0, 1.0);
+}
@@ -5,6 +5,7 @@
 #include "graphics/mesh.h"
 #include "graphics/shaders.h"
 #include "graphics/shapes.h"
+#include "gui/renderloop.h"
 #include "gui/window.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -473,6 +474,7 @@ struct MyScene: Scene {
 #define SETUP_SCENE(SCENE_TYPE) \
 	SCENE_TYPE scene;\
     scene.setup();\
+    glpp::FramePacer pacer(true, 60.0);\
     while(scene.window.isOpen()) {\
         scene.window.pollEvents();\
         if(scene.window.keyIsPressed(Key::Q) || scene.window.keyIsPressed(Key::ESCAPE)) {\
@@ -482,6 +484,7 @@ struct MyScene: Scene {
         scene.update();\
         scene.render();\
         scene.window.display();\
+        pacer.wait();\
     }
 
 #include "plotting/tokenizer.h"
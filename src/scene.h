@@ -2,6 +2,17 @@
 #define GLPP_SCENE_H
 
 #include "geometry.h"
+#include "graphics/aabbtree.h"
+#include "graphics/atlas.h"
+#include "graphics/commandlist.h"
+#include "graphics/lines.h"
+#include "graphics/lod.h"
+#include "graphics/profiler.h"
+#include "graphics/sdfshapes.h"
+#include "graphics/staticbatch.h"
+#include "graphics/uniformbuffer.h"
+
+#include <deque>
 
 /**
  * 2-Dimensional Scene
@@ -13,6 +24,125 @@ class Scene {
 
   protected:
     std::vector<std::shared_ptr<Shape>> shapes_2d;
+    // Spatial index over the world space bounds of shapes_2d, used to cull invisible shapes
+    glpp::AABBTree<Shape*> spatialIndex;
+    std::vector<Shape*>    visibleShapes;
+    size_t                 insertionCount = 0;
+    // Draw packets of the visible dynamic shapes, recorded in parallel every frame
+    glpp::CommandRecorder  commands;
+    // The model transforms of the recorded packets in replay order, indexed by drawID in the shaders
+    std::vector<ml::mat4>  transformData;
+    // Polylines extruded on the GPU, one batch per style, a deque such that added batches keep their address
+    std::deque<std::pair<glpp::LineStyle, glpp::PolylineBatch>> polylines;
+
+  public:
+    /**
+     * A function sampled along increasing x
+     * Only the samples decimated for the current zoom are uploaded, @see glpp::PolylineLOD
+     */
+    struct SampledPlot {
+        glpp::LineStyle              style;
+        glpp::PolylineLOD            lod;
+        glpp::PolylineBatch          batch;
+        const std::vector<ml::vec2>* uploaded = nullptr;
+
+        void setSamples(std::vector<ml::vec2> samples) {
+            lod.setPoints(std::move(samples));
+            uploaded = nullptr;
+        }
+    };
+
+  protected:
+    std::deque<SampledPlot> plots;
+
+    enum Layer : uint8_t { lines, shapes };
+    /**
+     * Record the draw of a shape, called concurrently for different shapes
+     * 3D shapes are opaque and drawn front to back, the other shapes are blended and drawn back to front,
+     * in the given sequence when they are at the same depth.
+     * @param weighted blend with weighted blended OIT instead, which doesn't need the translucent shapes in order
+     */
+    template<typename T>
+    void record(T& shape, const ml::mat4& projection, size_t sequence, Layer layer, bool weighted, glpp::CommandList& list) {
+        glpp::Mesh&    mesh      = shape.mesh();
+        // Only the model transform is recorded, the shaders take the projection from the Frame block
+        const ml::mat4 transform = shape.transformation();
+        const float        depth   = depthOf(projection, transform);
+        const unsigned int texture = mesh.textures.empty() ? 0u : mesh.textures.front().getID();
+        const GLenum       primitive = std::is_base_of_v<Shape1D, T> ? GLenum(GL_LINE_STRIP) : GLenum(GL_TRIANGLES);
+        if constexpr(std::is_base_of_v<Shape3D, T>) {
+            list.push({glpp::SortKey::opaque(layer, shader.getID(), texture, depth), &mesh, &shader, texture, transform, primitive});
+        } else if(weighted) {
+            // The same key for all, such that the radix sort skips every pass but the layer and translucency
+            list.push({glpp::SortKey::translucent(layer, 0.0f, 0), &mesh, &renderer.oit().shader(), texture, transform, primitive});
+        } else {
+            list.push({glpp::SortKey::translucent(layer, depth, sequence), &mesh, &shader, texture, transform, primitive});
+        }
+    }
+
+    /**
+     * Record a shape drawn by shapeSDFs, ordered like the meshes it overlaps
+     * @param visibleIndex index of the shape in visibleShapes, its instance is added after sorting
+     */
+    void recordSDF(Shape& shape, const ml::mat4& projection, size_t visibleIndex, glpp::CommandList& list) {
+        const ml::mat4 transform = shape.transformation();
+        list.push({glpp::SortKey::translucent(Layer::shapes, depthOf(projection, transform), shape.order), nullptr, &shapeSDFs.shader(), 0u,
+                   transform, GLenum(GL_TRIANGLE_STRIP), static_cast<int32_t>(visibleIndex)});
+    }
+    // Depth of the origin of a shape in [0, 1], 0 being nearest
+    static float depthOf(const ml::mat4& projection, const ml::mat4& transform) {
+        const ml::vec4 origin = projection * transform * ml::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return origin.z() / origin.w() * 0.5f + 0.5f;
+    }
+
+    void index(Shape& shape) {
+        shape.order           = insertionCount++;
+        shape.indexedVersion  = shape.version();
+        shape.indexedRevision = shape.mesh().revision();
+        shape.proxy           = spatialIndex.insert(shape.bounds(), &shape);
+    }
+    void unindex(Shape& shape) {
+        if(shape.proxy != glpp::AABBTree<Shape*>::null) {
+            spatialIndex.remove(shape.proxy);
+            shape.proxy = glpp::AABBTree<Shape*>::null;
+        }
+        if(shape.staticHandle != -1) {
+            staticMeshes.remove(shape.staticHandle);
+            shape.staticHandle = -1;
+        }
+    }
+    /* Upload the mesh of a static shape in world space into the shared static buffers */
+    void bake(Shape& shape) {
+        // Distance field shapes are a single instance either way
+        if(shape.sdf)
+            return;
+        glpp::Mesh&               mesh     = shape.mesh();
+        std::vector<glpp::Vertex> vertices = mesh.vertices;
+        const ml::mat4            model    = shape.transformation();
+        for(auto& vertex : vertices) {
+            ml::vec4 position = model * ml::vec4(vertex.positions, 1.0f);
+            vertex.positions  = {position.x(), position.y(), position.z()};
+        }
+        shape.staticHandle = staticMeshes.add(vertices, mesh.indices);
+    }
+    /**
+     * Refit the index for every shape that moved or changed its mesh since it was last indexed
+     * This only compares two counters per shape, the bounds are only recomputed for changed shapes.
+     */
+    void refitIndex() {
+        for(auto& shape : shapes_2d) {
+            if(shape->indexedVersion == shape->version() && shape->indexedRevision == shape->mesh().revision())
+                continue;
+            shape->indexedVersion  = shape->version();
+            shape->indexedRevision = shape->mesh().revision();
+            spatialIndex.update(shape->proxy, shape->bounds());
+            // Static shapes rarely change, but when they do their baked copy is replaced
+            if(shape->staticHandle != -1) {
+                staticMeshes.remove(shape->staticHandle);
+                bake(*shape);
+            }
+        }
+    }
 
   public:
     glpp::Window   window;
@@ -20,15 +150,39 @@ class Scene {
     glpp::Observer2DCamera camera;
     glpp::Renderer renderer;
     CoordinateSystemBase coordinateSystem;
+    glpp::UniformHandle  drawIDUniform;
+    glpp::StaticMeshPool staticMeshes;
+    // Projection and viewport shared by every program, uploaded once per frame
+    glpp::UniformBuffer<glpp::FrameData> frame;
+    glpp::StorageBuffer<ml::mat4>        transforms;
+    glpp::LineRenderer   lineRenderer;
+    // Circles, rounded rects, rings and arcs drawn as instanced quads, eg. sdfShapes.circle(center, radius, style)
+    glpp::SDFRenderer    sdfShapes;
+    // The visible shapes that are drawn as signed distance fields, refilled every frame
+    glpp::SDFRenderer    shapeSDFs;
+    // Images of the textured shapes, one array texture such that they don't break the batches
+    glpp::TextureAtlas   atlas;
 
     Scene():
-        window(1920, 1080, "Scene"), shader("/home/marten/projects/glpp/resources/scene_shaders"), camera(window, 10.0f), renderer(),
+        window(1920, 1080, "Scene"), shader(GLPP_RESOURCES "/scene_shaders"), camera(window, 10.0f), renderer(),
         coordinateSystem{
             .xMin = -10,
             .xMax = 10,
             .yMin = window.aspect() * -10,
             .yMax = window.aspect() * 10
-        } {
+        }, drawIDUniform(shader.uniform("drawID")), frame(glpp::FrameData::binding), transforms(glpp::transformsBinding) {
+        shader.bindUniformBlock("Frame", glpp::FrameData::binding);
+        shader.bindStorageBlock("Transforms", glpp::transformsBinding);
+        shader.setUniform(shader.uniform("atlas"), 0);
+        // Shapes whose image was evicted to make room are drawn untextured until they get an image again
+        atlas.setEvictionCallback([this](uint64_t key) {
+          for(auto& shape : shapes_2d) {
+              if(shape->image == key) {
+                  shape->image.reset();
+                  shape->setImage(nullptr);
+              }
+          }
+        });
         std::cout << window.aspect() << std::endl;
     }
 
@@ -43,18 +197,73 @@ class Scene {
 //        shapes_1d.push_back(std::make_unique<T>(std::move(shape)));
 //    }
 
+    /**
+     * Adds a shape to the scene
+     * @return the shape as it is stored by the scene, use this reference to remove the shape
+     */
     template<typename T> requires Creatable<T>
-    void add(T& shape) {
+    T& add(T& shape) {
         shape.create();
-        shapes_2d.push_back(std::make_shared<T>(std::move(shape)));
+        auto stored = std::make_shared<T>(std::move(shape));
+        shapes_2d.push_back(stored);
+        index(*stored);
+        return *stored;
     }
 
     template<typename T> requires Creatable<T>
-    void add(T&& shape) {
+    T& add(T&& shape) {
         shape.create();
-        shapes_2d.push_back(std::make_shared<T>(shape));
+        auto stored = std::make_shared<T>(shape);
+        shapes_2d.push_back(stored);
+        index(*stored);
+        return *stored;
     }
 
+    /**
+     * Adds a shape that doesn't move, eg. scene.add(Circle{...}, glpp::staticDraw)
+     * Its mesh is baked in world space into buffers shared by all static shapes,
+     * the visible static shapes are then drawn with a single call before the other shapes.
+     */
+    template<typename T> requires Creatable<T>
+    T& add(T shape, glpp::StaticTag) {
+        T& stored = add(std::move(shape));
+        bake(stored);
+        return stored;
+    }
+
+    /**
+     * Texture a shape with an image, eg. a sprite, packed into the atlas of the scene under key
+     * Images already in the atlas are reused, pixels are tightly packed RGBA8 rows.
+     * @return false if the image doesn't fit into the atlas
+     */
+    bool setImage(Shape& shape, uint64_t key, int width, int height, const void* pixels) {
+        std::optional<glpp::AtlasEntry> entry;
+        if(const glpp::AtlasEntry* found = atlas.find(key))
+            entry = *found;
+        else
+            entry = atlas.add(key, width, height, pixels);
+        if(!entry)
+            return false;
+        shape.image = key;
+        shape.setImage(&*entry);
+        return true;
+    }
+
+    /**
+     * Adds a batch of polylines that share a style, eg. a grid or a plotted function
+     * The batch is drawn with the other lines, add polylines to it with batch.add(points).
+     */
+    glpp::PolylineBatch& addPolylines(const glpp::LineStyle& style) {
+        return polylines.emplace_back(style, glpp::PolylineBatch{}).second;
+    }
+
+    /**
+     * Adds a plotted function, eg. samples of PlotExpression::evaluate
+     * Dense samples are reduced to at most 4 points per pixel column before they are drawn.
+     */
+    SampledPlot& addPlot(std::vector<ml::vec2> samples, const glpp::LineStyle& style) {
+        return plots.emplace_back(SampledPlot{style, glpp::PolylineLOD(std::move(samples)), glpp::PolylineBatch{}});
+    }
 
     template<Derived<Shape3D> T> requires Creatable<T>
     void add(T& shape) {
@@ -77,7 +286,13 @@ class Scene {
     }
     template<Derived<Shape2D> T>
     void remove(T& shape){
-        shapes_2d.erase(std::find(shapes_2d.begin(), shapes_2d.end(), shape));
+        auto it = std::find_if(shapes_2d.begin(), shapes_2d.end(), [&shape](auto& stored) {
+          return stored.get() == &shape;
+        });
+        if(it == shapes_2d.end())
+            return;
+        unindex(**it);
+        shapes_2d.erase(it);
     }
     template<Derived<Shape3D> T>
     void remove(T& shape){
@@ -89,8 +304,24 @@ class Scene {
         remove(shape);
         remove(args...);
     }
+    /**
+     * The part of the plane shown by the coordinate system, unbounded in depth
+     */
+    glpp::BoundingBox visibleBounds() const {
+        return {ml::vec3(static_cast<float>(coordinateSystem.xMin), static_cast<float>(coordinateSystem.yMin), std::numeric_limits<float>::lowest()),
+                ml::vec3(static_cast<float>(coordinateSystem.xMax), static_cast<float>(coordinateSystem.yMax), std::numeric_limits<float>::max())};
+    }
+
+    ml::mat4 projection() const {
+        return ml::ortho(static_cast<float>(coordinateSystem.xMin), static_cast<float>(coordinateSystem.xMax), static_cast<float>(coordinateSystem.yMin), static_cast<float>(coordinateSystem.yMax), 0.1f, 1.0f);
+    }
+    float pixelsPerUnit() const {
+        return glpp::LOD::pixelsPerUnit(projection(), static_cast<float>(window.width()));
+    }
+
     double startTime = 0.0, dx = 0.0;
     void render() {
+        GLPP_PROFILE_GPU("Scene::render");
         //		auto proj = camera.projection();
         //		auto view = camera.view();
         shader.use();
@@ -98,26 +329,128 @@ class Scene {
 //				animations.erase(std::find(animations.begin(), animations.end(), animation));
 
 
-        for(auto& shape : shapes_1d){
-//            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-//            glLineWidth(shape->borderThickness);
-            renderer.drawLine(shape->mesh());
+        // Only query the shapes that intersect the visible part of the plane
+        {
+            GLPP_PROFILE("Scene::cull");
+            refitIndex();
+            visibleShapes.clear();
+            spatialIndex.query(visibleBounds(), [this](Shape* shape) {
+              visibleShapes.push_back(shape);
+            });
+            // The layers of visible images can't be evicted by images added during this frame
+            atlas.beginFrame();
+            for(Shape* shape : visibleShapes) {
+                if(shape->image)
+                    atlas.touch(shape->imageLayer);
+            }
+        }
+
+        const ml::mat4 projection = this->projection();
+        const bool     weighted   = renderer.transparency() == glpp::Transparency::WeightedBlended;
+
+        const float    pixelsPerUnit = glpp::LOD::pixelsPerUnit(projection, static_cast<float>(window.width()));
 
-//            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        {
+            GLPP_PROFILE("Scene::record");
+            const size_t lines = shapes_1d.size(), visible = visibleShapes.size();
+            if(weighted)
+                renderer.oit(); // Load the shaders on the GL thread, record() only reads them
+            // Every shape is only touched by the thread recording its chunk
+            commands.record(lines + visible + shapes_3d.size(), [&](size_t i, glpp::CommandList& list) {
+              if(i < lines) {
+                  record(*shapes_1d[i], projection, i, Layer::lines, false, list);
+              } else if(i < lines + visible) {
+                  Shape* shape = visibleShapes[i - lines];
+                  if(shape->sdf && !weighted)
+                      recordSDF(*shape, projection, i - lines, list);
+                  else if(shape->staticHandle == -1 && !shape->sdf)
+                      record(*shape, projection, shape->order, Layer::shapes, weighted, list);
+              } else {
+                  record(*shapes_3d[i - lines - visible], projection, 0, Layer::shapes, false, list);
+              }
+            });
+        }
+        // One upload of the frame and all transforms, instead of a matrix uniform per draw
+        frame.upload({projection, ml::vec4(static_cast<float>(window.width()), static_cast<float>(window.height()), pixelsPerUnit, 0.0f),
+                      static_cast<float>(glfwGetTime())});
+        const auto& packets = commands.packets();
+        transformData.resize(packets.size());
+        for(size_t i = 0; i < packets.size(); i++)
+            transformData[i] = packets[i].transform;
+        transforms.upload(transformData);
+        // The distance field shapes are added in replay order, such that every run of them is a range of instances.
+        // Weighted blending doesn't depend on the order, there they are all drawn before the blended shapes.
+        shapeSDFs.clear();
+        if(weighted) {
+            for(Shape* shape : visibleShapes) {
+                if(shape->sdf)
+                    shapeSDFs.add(shape->sdfInstance());
+            }
+        } else {
+            for(const auto& packet : packets) {
+                if(packet.instance >= 0)
+                    shapeSDFs.add(visibleShapes[packet.instance]->sdfInstance());
+            }
         }
 
-        for(auto& shape : shapes_2d){
+        size_t sdfDrawn = 0;
+        auto submit = [&](const glpp::DrawPacket& packet, size_t i) {
+          if(packet.instance >= 0) {
+              // A run of distance field shapes is drawn with one call at its first packet
+              if(i > 0 && packets[i - 1].instance >= 0)
+                  return;
+              const size_t run = commands.instanceRun(i);
+              shapeSDFs.draw(projection, 1.0f / pixelsPerUnit, sdfDrawn, run);
+              sdfDrawn += run;
+              return;
+          }
+          packet.shader->setUniform(packet.shader == &shader ? drawIDUniform : renderer.oit().drawIDUniform(), static_cast<int>(i));
+          if(packet.primitive == GL_LINE_STRIP)
+              renderer.drawLine(*packet.mesh);
+          else
+              renderer.draw(*packet.mesh);
+        };
+        // Lines stay behind all shapes, including the static ones
+        const size_t shapesBegin = commands.layerBegin(Layer::shapes);
+        commands.replay(submit, 0, shapesBegin);
+        const ml::vec2 viewport(static_cast<float>(window.width()), static_cast<float>(window.height()));
+        renderer.state().setDepth(glpp::DepthState::translucent());
+        for(auto& [style, batch] : polylines)
+            lineRenderer.draw(batch, projection, style, viewport);
+        for(auto& plot : plots) {
+            // A different level is only selected when the zoom halved or doubled
+            const auto& points = plot.lod.select(pixelsPerUnit);
+            if(&points != plot.uploaded) {
+                plot.batch.clear();
+                plot.batch.add(points);
+                plot.uploaded = &points;
+            }
+            lineRenderer.draw(plot.batch, projection, plot.style, viewport);
+        }
 
-            shader.setUniform("mvp", ml::ortho(static_cast<float>(coordinateSystem.xMin), static_cast<float>(coordinateSystem.xMax), static_cast<float>(coordinateSystem.yMin), static_cast<float>(coordinateSystem.yMax), 0.1f, 1.0f) * shape->transformation());
-            renderer.draw(shape->mesh());
-//			if(shape->borderThickness > 0.0f){
-//                glLineWidth(shape->borderThickness);
-            renderer.draw(shape->mesh());
-//			}
+        // Static shapes are already in world space, all visible ones are drawn with one indirect draw
+        staticMeshes.clearCommands();
+        for(Shape* shape : visibleShapes){
+            if(shape->staticHandle != -1)
+                staticMeshes.addCommand(shape->staticHandle);
         }
+        shader.use();
+        shader.setUniform(drawIDUniform, -1);
+        renderer.state().setDepth(glpp::DepthState::translucent());
+        // Textured shapes, static or not, all sample the atlas, so it stays bound for the rest of the frame
+        atlas.bind(0);
+        staticMeshes.draw();
+        sdfShapes.draw(projection, 1.0f / pixelsPerUnit);
 
-        for(auto& shape : shapes_3d){
-            renderer.draw(shape->mesh());
+        if(weighted) {
+            const size_t translucentBegin = commands.translucentBegin(Layer::shapes);
+            commands.replay(submit, shapesBegin, translucentBegin);
+            shapeSDFs.draw(projection, 1.0f / pixelsPerUnit);
+            renderer.oit().begin();
+            commands.replay(submit, translucentBegin, commands.packets().size());
+            renderer.oit().composite();
+        } else {
+            commands.replay(submit, shapesBegin, commands.packets().size());
         }
         //        Renderer::draw()
     }
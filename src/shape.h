@@ -2,11 +2,17 @@
 #define GLPP_SHAPE_H
 
 #include "geometry.h"
+#include "graphics/atlas.h"
+#include "graphics/sdfshapes.h"
+
+#include <optional>
 
 struct Transformable {
     ml::mat4 m_transformation = ml::mat4(1.0f);
   protected:
     bool shouldRegenerateTransformation = false;
+    // Incremented on every change, such that observers (eg. the Scene index) can detect movement
+    unsigned int m_version = 0;
     ml::vec3 translation = ml::vec3(0.0f), rotation = ml::vec3(0.0f), dilation = ml::vec3(1.0f);
   public:
 
@@ -20,18 +26,25 @@ struct Transformable {
         return m_transformation;
     }
 
+    unsigned int version() const {
+        return m_version;
+    }
+
     /* Main functions */
     void translate(const ml::vec3& xyz){
         translation = xyz;
         shouldRegenerateTransformation = true;
+        m_version++;
     }
     void rotate(const ml::vec3& xyz){
         rotation = xyz;
         shouldRegenerateTransformation = true;
+        m_version++;
     }
     void dilate(const ml::vec3& xyz){
         dilation = xyz;
         shouldRegenerateTransformation = true;
+        m_version++;
     }
 
     /* Alternative versions, provide an easier API */
@@ -51,6 +64,63 @@ struct Shape : Transformable {
 
     glpp::Mesh m_mesh;
 
+    /* Spatial index bookkeeping, managed by the Scene */
+    int          proxy           = -1;
+    size_t       order           = 0;
+    unsigned int indexedVersion  = 0;
+    unsigned int indexedRevision = 0;
+    // Handle into the Scene's StaticMeshPool when added as a static shape
+    int          staticHandle    = -1;
+
+    /**
+     * Shapes the SDFRenderer can draw, eg. circles and bordered rectangles, are drawn as one instance instead of their mesh
+     * The attributes are untransformed, m_mesh then only provides the bounds.
+     */
+    std::optional<glpp::SDFInstance> sdf;
+
+    /* Key and layer of the atlas image the shape is textured with, @see Scene::setImage */
+    std::optional<uint64_t> image;
+    int                     imageLayer = -1;
+    // The rectangle of the atlas the texture coordinates are currently mapped into
+    ml::vec4                imageUV = ml::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+    /**
+     * Map the texture coordinates of the mesh, in [0, 1], into an atlas image and select its layer
+     * @param entry nullptr to draw the shape untextured again
+     */
+    void setImage(const glpp::AtlasEntry* entry) {
+        const ml::vec4 uv = entry ? entry->uv : ml::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        for(auto& vertex : m_mesh.vertices) {
+            const float u = (vertex.texCoords.x() - imageUV.x()) / (imageUV.z() - imageUV.x());
+            const float v = (vertex.texCoords.y() - imageUV.y()) / (imageUV.w() - imageUV.y());
+            vertex.texCoords   = {uv.x() + u * (uv.z() - uv.x()), uv.y() + v * (uv.w() - uv.y())};
+            vertex.textureSlot = entry ? static_cast<glpp::Slot>(entry->layer + 1) : 0.0f;
+        }
+        imageUV    = uv;
+        imageLayer = entry ? entry->layer : -1;
+        m_mesh.regenBuffers();
+    }
+
+    /**
+     * World space bounds of the shape
+     * The cached mesh bounds transformed by the current transformation
+     */
+    glpp::BoundingBox bounds() {
+        return mesh().bounds().transformed(transformation());
+    }
+
+    /* The distance field instance of the shape, transformed into world space */
+    glpp::SDFInstance sdfInstance() {
+        glpp::SDFInstance instance = *sdf;
+        const ml::vec4    center   = transformation() * ml::vec4(instance.center.x(), instance.center.y(), 0.0f, 1.0f);
+        instance.center   = {center.x(), center.y()};
+        instance.halfSize = {instance.halfSize.x() * std::abs(dilation.x()), instance.halfSize.y() * std::abs(dilation.y())};
+        instance.rotation += rotation.z();
+        instance.imageUV    = imageUV;
+        instance.imageLayer = static_cast<float>(imageLayer);
+        return instance;
+    }
+
     /**
      * Creates the mesh of a shape.
      * The create function has to be implemented by derivatives.
@@ -89,8 +159,8 @@ struct Shape2D : public Shape {
         this->m_mesh.indices.insert(this->m_mesh.indices.end(), mesh.indices.begin(), mesh.indices.end());
         this->m_mesh.regenBuffers();
     }
-    rgba borderColor = rgba();
-    rgba fillColor;
+    rgba borderColor = rgba(0.0f, 0.0f, 0.0f, 1.0f);
+    rgba fillColor   = rgba(1.0f, 1.0f, 1.0f, 1.0f);
     float borderThickness = 0.1f;
 };
 
@@ -503,13 +573,17 @@ struct Rectangle: public Shape2D {
     ml::vec3 position = ml::vec3(0.0f);
     float height = 0.4, width = 0.5;
 
+    /**
+     * Drawn as a signed distance field, the border lies inside the edge of the extended rectangle
+     * such that it surrounds the rectangle like the extruded border did.
+     */
     void create() {
-        auto baseMesh = createPlane2(position, {width, height}, rgba{0.0f, 1.0f, 0.0f, 1.0f}, 0);
+        fillColor = rgba{0.0f, 1.0f, 0.0f, 1.0f};
         borderThickness = 0.2f;
-        if(borderThickness > 0.0f){
-            addBorder(baseMesh, borderThickness);
-        }
-        Shape::create(std::move(baseMesh));
+        const ml::vec2 halfSize(width + borderThickness, height + borderThickness);
+        Shape::create(createPlane2(position, halfSize, fillColor, 0));
+        sdf = glpp::SDFInstance{{position.x(), position.y()}, halfSize, 0.0f, 0.0f, borderThickness,
+                                static_cast<float>(glpp::SDFShape::RoundedRect), {}, fillColor, borderColor};
     }
 };
 
@@ -532,8 +606,15 @@ struct Circle: Shape2D {
     ml::vec3 center = ml::vec3(0.0f);
     float    radius = 1.0f;
 
+    /**
+     * Drawn as a signed distance field, which stays round at any zoom
+     * m_mesh keeps an octagon, such that the bounds, comparisons and readers of the mesh see the circle.
+     * Its corners lie on both axes, so the bounds are those of the circle.
+     */
     void create() {
-        Shape::create(Mesh(createCircle(center, radius, static_cast<int>(200 * radius))));
+        Shape::create(Mesh(createCircle(center, radius, 8)));
+        sdf = glpp::SDFInstance{{center.x(), center.y()}, {radius, radius}, 0.0f, 0.0f, borderThickness,
+                                static_cast<float>(glpp::SDFShape::Circle), {}, fillColor, borderColor};
     }
 };
 
@@ -66,7 +66,160 @@ static void BM3_(benchmark::State& state) {
 
 }
 
+#include "graphics/commandlist.h"
+
+/* CPU side frame preparation of many shapes: recording the packets in parallel and sorting them, without replaying */
+static void BM_RecordPackets(benchmark::State& state) {
+	glpp::ThreadPool      pool(static_cast<size_t>(state.range(1)));
+	glpp::CommandRecorder recorder(pool);
+	std::vector<ml::mat4> transforms(static_cast<size_t>(state.range(0)), ml::mat4(1.0f));
+	const ml::mat4        projection = ml::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 0.1f, 1.0f);
+	for(auto _: state) {
+		recorder.record(transforms.size(), [&](size_t i, glpp::CommandList& list) {
+			list.push({(i * 2654435761u) & 0xFFFFFFFF, nullptr, nullptr, 0, projection * transforms[i]});
+		});
+		benchmark::DoNotOptimize(recorder.packets().data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RecordPackets)->ArgsProduct({{100000}, {0, 1, 3, 7}})->Unit(benchmark::kMillisecond);
+
+#include "graphics/meshoptimizer.h"
+
+#include <numeric>
+#include <random>
+
+/* Optimizing a grid with duplicated corners and shuffled triangles, the counters report the cache misses per triangle */
+static void BM_OptimizeMesh(benchmark::State& state) {
+	const int                 size = static_cast<int>(state.range(0));
+	std::vector<glpp::Vertex> vertices;
+	std::vector<glpp::Index>  indices;
+	for(int y = 0; y < size; y++) {
+		for(int x = 0; x < size; x++) {
+			const auto first = static_cast<glpp::Index>(vertices.size());
+			for(int corner = 0; corner < 4; corner++)
+				vertices.emplace_back(ml::vec3(float(x + corner % 2), float(y + corner / 2), 0.0f));
+			indices.insert(indices.end(), {first, first + 1, first + 2, first + 2, first + 1, first + 3});
+		}
+	}
+	std::vector<size_t> order(indices.size() / 3);
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), std::mt19937(7));
+	std::vector<glpp::Index> shuffled;
+	for(size_t triangle: order)
+		shuffled.insert(shuffled.end(), indices.begin() + triangle * 3, indices.begin() + triangle * 3 + 3);
+
+	std::vector<glpp::Vertex> optimized;
+	std::vector<glpp::Index>  optimizedIndices;
+	for(auto _: state) {
+		optimized        = vertices;
+		optimizedIndices = shuffled;
+		glpp::optimizeMesh(optimized, optimizedIndices);
+		benchmark::DoNotOptimize(optimizedIndices.data());
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(order.size()));
+	state.counters["acmr_before"] = glpp::acmr(shuffled, vertices.size());
+	state.counters["acmr_after"]  = glpp::acmr(optimizedIndices, optimized.size());
+}
+BENCHMARK(BM_OptimizeMesh)->Arg(64)->Arg(256)->Unit(benchmark::kMillisecond);
+
+#ifdef GLPP_HEADLESS
+#include "graphics/mesh.h"
+#include "graphics/shapes.h"
+
+/* GLFW can only create a context once per process in a cheap way, share it between benchmarks */
+static glpp::Window& headlessWindow() {
+	static glpp::Window window(640, 480, "Benchmark");
+	return window;
+}
 
+/* Frame time of the Renderer drawing many small meshes offscreen, including the asynchronous read back */
+static void BM_HeadlessFrame(benchmark::State& state) {
+	auto& window         = headlessWindow();
+	window.captureFrames = true;
+	glpp::Shader   shader(std::filesystem::path(GLPP_RESOURCES "/scene_shaders"));
+	glpp::Renderer renderer;
+	std::vector<glpp::Mesh> meshes;
+	for(int i = 0; i < state.range(0); i++)
+		meshes.emplace_back(glpp::createCircle({static_cast<float>(i % 32) / 16.0f - 1.0f, static_cast<float>(i / 32) / 16.0f - 1.0f, 0.0f}, 0.02f, 32));
+
+	glpp::UniformBuffer<glpp::FrameData> frame(glpp::FrameData::binding);
+	frame.upload({.projection = ml::mat4(1.0f)});
+	shader.bindUniformBlock("Frame", glpp::FrameData::binding);
+	shader.use();
+	shader.setUniform(shader.uniform("drawID"), -1);
+	renderer.state().resetCounters();
+	for(auto _: state) {
+		window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+		for(auto& mesh: meshes)
+			renderer.draw(mesh);
+		window.display();
+		// Include the GPU time, llvmpipe renders asynchronously as well
+		glFinish();
+	}
+	state.counters["issued"]  = benchmark::Counter(renderer.state().counters().issued, benchmark::Counter::kAvgIterations);
+	state.counters["skipped"] = benchmark::Counter(renderer.state().counters().skipped, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_HeadlessFrame)->Arg(64)->Arg(1024)->Unit(benchmark::kMillisecond);
+
+#include "graphics/model.h"
+
+#include <cmath>
+#include <fstream>
+
+/**
+ * A UV sphere with positions, normals and texture coordinates as OBJ, about the size of a detailed model
+ * Written once to the temp directory, such that the benchmark doesn't need models in the resources.
+ */
+static std::filesystem::path generatedModel(int rings = 384, int segments = 768) {
+	const auto path = std::filesystem::temp_directory_path() / "glpp-bench-sphere-{}x{}.obj"_format(rings, segments);
+	if(std::filesystem::exists(path))
+		return path;
+	std::ofstream file(path);
+	for(int ring = 0; ring <= rings; ring++) {
+		const float theta = static_cast<float>(M_PI) * static_cast<float>(ring) / static_cast<float>(rings);
+		for(int segment = 0; segment <= segments; segment++) {
+			const float phi = 2.0f * static_cast<float>(M_PI) * static_cast<float>(segment) / static_cast<float>(segments);
+			const float x = std::sin(theta) * std::cos(phi), y = std::cos(theta), z = std::sin(theta) * std::sin(phi);
+			file << "v " << x << " " << y << " " << z << "\n";
+			file << "vn " << x << " " << y << " " << z << "\n";
+			file << "vt " << static_cast<float>(segment) / static_cast<float>(segments) << " " << static_cast<float>(ring) / static_cast<float>(rings) << "\n";
+		}
+	}
+	// OBJ indices start at 1 and are shared by position, texture coordinate and normal
+	auto corner = [&](int ring, int segment) {
+		const int i = ring * (segments + 1) + segment + 1;
+		file << " " << i << "/" << i << "/" << i;
+	};
+	for(int ring = 0; ring < rings; ring++) {
+		for(int segment = 0; segment < segments; segment++) {
+			file << "f";
+			corner(ring, segment), corner(ring + 1, segment), corner(ring + 1, segment + 1);
+			file << "\nf";
+			corner(ring, segment), corner(ring + 1, segment + 1), corner(ring, segment + 1);
+			file << "\n";
+		}
+	}
+	return path;
+}
+
+/* Loading a model through Assimp (0) against mapping the converted mesh file (1), including the upload */
+static void BM_LoadModel(benchmark::State& state) {
+	headlessWindow();
+	const std::string path  = generatedModel().string();
+	const auto        cache = std::filesystem::temp_directory_path() / "glpp-bench-meshes";
+	std::filesystem::remove_all(cache);
+	if(state.range(0))
+		glpp::Model warm(path, cache);
+	for(auto _: state) {
+		glpp::Model model(path, state.range(0) ? cache : std::filesystem::path());
+		benchmark::DoNotOptimize(model.size());
+		glFinish();
+	}
+	std::filesystem::remove_all(cache);
+}
+BENCHMARK(BM_LoadModel)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+#endif
 
 BENCHMARK(BM_);
 BENCHMARK(BM2_);
@@ -1,5 +1,30 @@
 #include <gtest/gtest.h>
 #include "plotting/coordinates.h"
+#include "plotting/compute.h"
+#include "plotting/virtualtexture.h"
+#include "graphics/aabbtree.h"
+#include "graphics/atlas.h"
+#include "graphics/blockcompression.h"
+#include "graphics/font.h"
+#include "graphics/lines.h"
+#include "graphics/lod.h"
+#include "graphics/meshcache.h"
+#include "graphics/meshoptimizer.h"
+#include "graphics/profiler.h"
+#include "graphics/shadercache.h"
+#include "graphics/sortkey.h"
+#include "graphics/staticbatch.h"
+#include "graphics/texturefile.h"
+#include "graphics/vertexstreams.h"
+#include "gui/renderloop.h"
+#include "radixsort.h"
+#include "threadpool.h"
+
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <thread>
 
 TEST(CoordinateMapper, screenToCoordinates){
 	/*
@@ -37,4 +62,1205 @@ TEST(CoordinateMapper, screenToCoordinates){
     ASSERT_EQ(mapper(ml::vec2T<double>{250, 0}), ml::vec2T<double>(2, 2));
 
 
-}
\ No newline at end of file
+}
+
+TEST(AABBTree, queryMatchesBruteForce){
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+
+	glpp::AABBTree<int> tree(0.0f);
+	std::vector<glpp::BoundingBox> boxes;
+	std::vector<int> proxies;
+	for(int i = 0; i < 1000; i++) {
+		float x = position(generator), y = position(generator);
+		boxes.emplace_back(ml::vec3{x, y, 0.0f}, ml::vec3{x + 1.0f, y + 1.0f, 0.0f});
+		proxies.push_back(tree.insert(boxes.back(), i));
+	}
+	// Remove every other box and move some of the remaining boxes
+	for(int i = 0; i < 1000; i += 2) {
+		tree.remove(proxies[i]);
+		proxies[i] = -1;
+	}
+	for(int i = 1; i < 1000; i += 4) {
+		float x = position(generator), y = position(generator);
+		boxes[i] = glpp::BoundingBox(ml::vec3{x, y, 0.0f}, ml::vec3{x + 2.0f, y + 2.0f, 0.0f});
+		tree.update(proxies[i], boxes[i]);
+	}
+	ASSERT_EQ(tree.size(), 500);
+
+	for(int q = 0; q < 100; q++) {
+		float x = position(generator), y = position(generator);
+		glpp::BoundingBox view(ml::vec3{x, y, -1.0f}, ml::vec3{x + 10.0f, y + 10.0f, 1.0f});
+		std::set<int> queried, expected;
+		tree.query(view, [&queried](int& i) { queried.insert(i); });
+		for(int i = 0; i < 1000; i++)
+			if(proxies[i] != -1 && boxes[i].intersects(view))
+				expected.insert(i);
+		ASSERT_EQ(queried, expected);
+	}
+}
+
+TEST(LOD, decimatedSamplesKeepColumnExtremes){
+	std::vector<ml::vec2> samples;
+	for(int i = 0; i < 10000; i++) {
+		float x = static_cast<float>(i) / 1000.0f;
+		samples.emplace_back(x, std::sin(x * 37.0f) + (i % 7 == 0 ? 0.5f : 0.0f));
+	}
+	const float unitsPerPixel = 0.01f;
+	auto decimated = glpp::decimateSamples(samples, unitsPerPixel);
+	ASSERT_LE(decimated.size(), 4 * 1000 + 4);
+	ASSERT_EQ(decimated.front(), samples.front());
+	ASSERT_EQ(decimated.back(), samples.back());
+
+	// Every pixel column still covers the same vertical range
+	std::map<long, std::pair<float, float>> expected, actual;
+	auto collect = [unitsPerPixel](const std::vector<ml::vec2>& points, std::map<long, std::pair<float, float>>& columns) {
+		for(auto& p : points) {
+			auto [it, inserted] = columns.try_emplace(static_cast<long>(std::floor(p.x() / unitsPerPixel)), p.y(), p.y());
+			it->second = {std::min(it->second.first, p.y()), std::max(it->second.second, p.y())};
+		}
+	};
+	collect(samples, expected);
+	collect(decimated, actual);
+	ASSERT_EQ(actual, expected);
+
+	ASSERT_EQ(glpp::LOD::circleSegments(0.1f), 8);
+	ASSERT_LT(glpp::LOD::circleSegments(10.0f), glpp::LOD::circleSegments(100.0f));
+}
+
+TEST(RangeAllocator, freedRangesCoalesce){
+	glpp::RangeAllocator allocator(100);
+	auto a = allocator.allocate(30);
+	auto b = allocator.allocate(30);
+	auto c = allocator.allocate(30);
+	ASSERT_TRUE(a && b && c);
+	ASSERT_EQ(*b, 30);
+	ASSERT_FALSE(allocator.allocate(20));
+
+	// Freeing the outer ranges leaves holes of 30 and 40, too small for 45
+	allocator.free(*a, 30);
+	allocator.free(*c, 30);
+	ASSERT_FALSE(allocator.allocate(45));
+	// Freeing the middle range merges everything back into one range
+	allocator.free(*b, 30);
+	ASSERT_EQ(allocator.freeRanges(), 1);
+	ASSERT_EQ(allocator.used(), 0);
+	ASSERT_EQ(allocator.allocate(100), 0);
+
+	allocator.grow(150);
+	ASSERT_EQ(allocator.allocate(50), 100);
+	ASSERT_EQ(allocator.used(), 150);
+}
+
+TEST(VertexStreams, streamsAreAlignedAndRoundTripVertices){
+	const ml::vec3T<short>    up{glpp::packNormal(0.0f), glpp::packNormal(1.0f), glpp::packNormal(-0.6f)};
+	std::vector<glpp::Vertex> vertices = {{{1.0f, 2.0f, 3.0f}, {0.1f, 0.2f, 0.3f, 0.8f}, up, {0.25f, 0.75f}},
+										  {{-1.0f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f, 0.5f}, {}, {1.0f, 0.0f}},
+										  {{4.0f, -2.0f, 1.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, {}, {0.0f, 1.0f}, 1.0f}};
+	glpp::VertexStreams streams(vertices);
+	ASSERT_EQ(streams.size(), vertices.size());
+	for(size_t i = 0; i < glpp::vertexStreamCount; i++) {
+		auto type = static_cast<glpp::VertexStream>(i);
+		// Every stream is tightly packed and starts on its own AVX boundary
+		ASSERT_EQ(streams.stream(type).size(), vertices.size() * glpp::vertexStreamComponents[i]);
+		ASSERT_EQ(reinterpret_cast<uintptr_t>(streams.data(type)) % 32, 0);
+	}
+	const float* positions = streams.data(glpp::VertexStream::Position);
+	ASSERT_EQ(positions[3], -1.0f);
+	ASSERT_EQ(positions[5], 0.0f);
+	ASSERT_EQ(streams.data(glpp::VertexStream::Color)[7], 0.5f);
+	ASSERT_EQ(streams.data(glpp::VertexStream::TexCoord)[1], 0.75f);
+	ASSERT_EQ(streams.data(glpp::VertexStream::TextureSlot)[2], 1.0f);
+	// Normals are unit floats in the stream, as the normalized shorts are read by the shaders
+	ASSERT_EQ(streams.data(glpp::VertexStream::Normal)[1], 1.0f);
+	ASSERT_NEAR(streams.data(glpp::VertexStream::Normal)[2], -0.6f, 1.0f / 32767.0f);
+
+	auto back = streams.toVertices();
+	for(size_t i = 0; i < vertices.size(); i++) {
+		for(int c = 0; c < 3; c++)
+			ASSERT_EQ(back[i].positions[c], vertices[i].positions[c]);
+		ASSERT_EQ(back[i].texCoords.x(), vertices[i].texCoords.x());
+		ASSERT_EQ(back[i].texCoords.y(), vertices[i].texCoords.y());
+		ASSERT_EQ(back[i].textureSlot, vertices[i].textureSlot);
+		for(int c = 0; c < 4; c++)
+			ASSERT_EQ(back[i].color[c], vertices[i].color[c]);
+		for(int c = 0; c < 3; c++)
+			ASSERT_EQ(back[i].normals[c], vertices[i].normals[c]);
+	}
+
+	// Passes only dirty the streams they touch
+	streams.clean();
+	streams.setAlpha(0.5f);
+	ASSERT_TRUE(streams.isDirty(glpp::VertexStream::Color));
+	ASSERT_FALSE(streams.isDirty(glpp::VertexStream::Position));
+	ASSERT_FLOAT_EQ(streams.data(glpp::VertexStream::Color)[3], 0.4f);
+	ASSERT_FLOAT_EQ(streams.data(glpp::VertexStream::Color)[7], 0.25f);
+	streams.translate({1.0f, 0.0f, 0.0f});
+	ASSERT_TRUE(streams.isDirty(glpp::VertexStream::Position));
+	ASSERT_FALSE(streams.isDirty(glpp::VertexStream::TexCoord));
+	auto bounds = streams.bounds();
+	ASSERT_EQ(bounds.min.x(), 0.0f);
+	ASSERT_EQ(bounds.min.y(), -2.0f);
+	ASSERT_EQ(bounds.max.x(), 5.0f);
+	ASSERT_EQ(bounds.max.z(), 3.0f);
+}
+
+/* The profiler is global, every test starts without the frames of the tests before it */
+class Profiler: public ::testing::Test {
+  protected:
+	void SetUp() override { glpp::Profiler::instance().reset(); }
+};
+
+TEST_F(Profiler, nestsZonesAndKeepsTheirHistory){
+	auto& profiler = glpp::Profiler::instance();
+	profiler.frame();
+	auto outer = profiler.begin("outer");
+	auto inner = profiler.begin("inner");
+	profiler.end(inner);
+	profiler.counter("value", 3.0);
+	profiler.end(outer);
+	profiler.frame();
+	// Frames without GPU zones are moved to the history once the next frame finishes
+	const size_t before = profiler.history().size();
+	profiler.frame();
+	ASSERT_EQ(profiler.history().size(), std::min(before + 1, glpp::Profiler::historySize));
+	const auto& frame = profiler.history().back();
+	ASSERT_EQ(frame.zones.size(), 2u);
+	ASSERT_EQ(frame.zones[0].name, "outer");
+	ASSERT_EQ(frame.zones[0].depth, 0);
+	ASSERT_EQ(frame.zones[1].depth, 1);
+	ASSERT_LE(frame.zones[0].cpuStart, frame.zones[1].cpuStart);
+	ASSERT_GE(frame.zones[0].cpuEnd, frame.zones[1].cpuEnd);
+	ASSERT_LT(frame.zones[0].gpu, 0.0);
+	ASSERT_EQ(frame.counters.size(), 1u);
+	ASSERT_GE(frame.duration, frame.zones[0].cpuEnd);
+
+	for(size_t i = 0; i < glpp::Profiler::historySize + 10; i++)
+		profiler.frame();
+	ASSERT_EQ(profiler.history().size(), glpp::Profiler::historySize);
+	ASSERT_TRUE(profiler.history().back().zones.empty());
+}
+
+TEST_F(Profiler, ignoresZonesEndedAfterTheirFrame){
+	auto& profiler = glpp::Profiler::instance();
+	auto  open     = profiler.begin("open");
+	// frame() closes the zone, ending it afterwards must not touch the next frame
+	profiler.frame();
+	auto next = profiler.begin("next");
+	profiler.end(open);
+	profiler.end(next);
+	profiler.frame();
+	profiler.frame();
+	const auto& history = profiler.history();
+	ASSERT_EQ(history.back().zones.size(), 1u);
+	ASSERT_EQ(history.back().zones[0].name, "next");
+	ASSERT_EQ(history[history.size() - 2].zones[0].name, "open");
+}
+
+TEST_F(Profiler, resetIgnoresZonesBegunBefore){
+	auto& profiler = glpp::Profiler::instance();
+	auto  stale    = profiler.begin("stale");
+	profiler.frame();
+	profiler.reset();
+	ASSERT_TRUE(profiler.history().empty());
+	auto zone = profiler.begin("zone");
+	profiler.end(stale);
+	profiler.end(zone);
+	profiler.frame();
+	profiler.frame();
+	ASSERT_EQ(profiler.history().size(), 1u);
+	ASSERT_EQ(profiler.history().back().zones.size(), 1u);
+	ASSERT_EQ(profiler.history().back().zones[0].name, "zone");
+}
+
+TEST_F(Profiler, exportsChromeTrace){
+	auto& profiler = glpp::Profiler::instance();
+	{
+		GLPP_PROFILE("quoted \"zone\"");
+		profiler.counter("latency", 1.5);
+	}
+	profiler.frame();
+	profiler.frame();
+	const auto path = std::filesystem::temp_directory_path() / "glpp-test-trace.json";
+	ASSERT_TRUE(profiler.exportChromeTrace(path));
+	std::ifstream      file(path);
+	std::stringstream  stream;
+	stream << file.rdbuf();
+	const std::string trace = stream.str();
+	ASSERT_EQ(trace.rfind("{\"traceEvents\":[", 0), 0u);
+	ASSERT_NE(trace.find(R"({"name":"quoted \"zone\"","cat":"cpu","ph":"X","pid":0,"tid":0)"), std::string::npos);
+	ASSERT_NE(trace.find(R"({"name":"latency","ph":"C")"), std::string::npos);
+	ASSERT_NE(trace.find(R"("args":{"value":1.5}})"), std::string::npos);
+	ASSERT_EQ(trace.find(R"("cat":"gpu")"), std::string::npos);
+	ASSERT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+	std::filesystem::remove(path);
+}
+
+TEST(PlotExpression, evaluatesParsedExpressions){
+	auto expression = glpp::PlotExpression::compile("2x^2 - 3 + sin(x) / 2");
+	ASSERT_TRUE(expression.has_value());
+	for(double x: {-2.0, -0.5, 0.0, 1.25, 3.0})
+		ASSERT_NEAR(expression->evaluate(x), 2 * x * x - 3 + std::sin(x) / 2, 1e-12);
+	ASSERT_EQ(expression->glsl(), "(((2.00000000 * power(x, 2.00000000)) - 3.00000000) + (sin(x) / 2.00000000))");
+	ASSERT_NEAR(glpp::PlotExpression::compile("x*sin(x)")->evaluate(2.0), 2.0 * std::sin(2.0), 1e-12);
+	ASSERT_FALSE(glpp::PlotExpression::compile("2y").has_value());
+}
+
+#ifdef GLPP_HEADLESS
+#include "graphics/commandlist.h"
+#include "graphics/mesh.h"
+#include "graphics/sdfshapes.h"
+#include "graphics/text.h"
+#include "graphics/textcache.h"
+#include "graphics/textureloader.h"
+#include "gui/window.h"
+#include "plotting/plot.h"
+#include "../examples/sortingrenderer.h"
+
+/* Set by the CMake option or the environment variable GLPP_UPDATE_REFERENCES */
+bool updateReferences() {
+#ifdef GLPP_UPDATE_REFERENCES
+	return true;
+#else
+	return std::getenv("GLPP_UPDATE_REFERENCES") != nullptr;
+#endif
+}
+
+/**
+ * Compare a frame with the reference image test/references/<name>.ppm, alpha is ignored
+ * A missing reference fails, the references are only stored when updateReferences() is set;
+ * check a stored image before committing it. A mismatching frame is kept as <name>.actual.ppm.
+ */
+::testing::AssertionResult matchesReference(glpp::Image image, const std::string& name, int tolerance = 2) {
+	const auto path = std::filesystem::path(__FILE__).parent_path() / "references" / (name + ".ppm");
+	for(size_t i = 3; i < image.pixels.size(); i += 4)
+		image.pixels[i] = 255;
+	if(!updateReferences() && !std::filesystem::exists(path)) {
+		glpp::writePPM(path.parent_path() / (name + ".actual.ppm"), image);
+		return ::testing::AssertionFailure() << "Missing reference " << path << ", store it with GLPP_UPDATE_REFERENCES set";
+	}
+	if(updateReferences()) {
+		std::filesystem::create_directories(path.parent_path());
+		if(!glpp::writePPM(path, image))
+			return ::testing::AssertionFailure() << "Could not store " << path;
+		std::cout << "Stored reference image " << path << std::endl;
+		return ::testing::AssertionSuccess();
+	}
+	const auto difference = glpp::compare(image, glpp::readPPM(path), tolerance);
+	if(difference.matches())
+		return ::testing::AssertionSuccess();
+	glpp::writePPM(path.parent_path() / (name + ".actual.ppm"), image);
+	if(!difference.sameSize)
+		return ::testing::AssertionFailure() << "The size differs from " << path;
+	return ::testing::AssertionFailure() << difference.differentPixels << " pixels differ by up to " << difference.maxDifference << " from " << path;
+}
+
+TEST(Headless, framesAreReadBackOneFrameLate){
+	glpp::Window window(64, 32, "Test");
+	window.captureFrames = true;
+
+	window.clear(rgba{1.0f, 0.0f, 0.0f, 1.0f});
+	glpp::Image red = window.capture();
+	ASSERT_EQ(red.width, 64);
+	ASSERT_EQ(red.pixel(10, 10)[0], 255);
+	ASSERT_EQ(red.pixel(10, 10)[1], 0);
+	window.display();
+	ASSERT_TRUE(window.lastFrame().empty());
+
+	window.clear(rgba{0.0f, 0.0f, 1.0f, 1.0f});
+	window.display();
+	// The first frame arrives while the second one is being read
+	ASSERT_TRUE(glpp::compare(window.lastFrame(), red).matches());
+	ASSERT_FALSE(glpp::compare(window.capture(), red).matches());
+}
+
+TEST(Headless, weightedBlendingIsOrderIndependent){
+	glpp::Window   window(64, 32, "Test");
+	glpp::Renderer renderer;
+	renderer.setTransparency(glpp::Transparency::WeightedBlended);
+	auto quad = [](rgba color) {
+		return glpp::Mesh({{{-1.0f, -1.0f, 0.0f}, color, {}, {0.0f, 0.0f}, 0.0f},
+						   {{1.0f, -1.0f, 0.0f}, color, {}, {1.0f, 0.0f}, 0.0f},
+						   {{-1.0f, 1.0f, 0.0f}, color, {}, {0.0f, 1.0f}, 0.0f},
+						   {{1.0f, 1.0f, 0.0f}, color, {}, {1.0f, 1.0f}, 0.0f}},
+						  {0, 1, 2, 2, 1, 3});
+	};
+	glpp::Mesh red = quad(rgba{1.0f, 0.0f, 0.0f, 0.5f}), blue = quad(rgba{0.0f, 0.0f, 1.0f, 0.5f});
+	glpp::UniformBuffer<glpp::FrameData> frame(glpp::FrameData::binding);
+	frame.upload({.projection = ml::mat4(1.0f)});
+	auto draw = [&](glpp::Mesh& first, glpp::Mesh& second) {
+		window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+		auto& oit = renderer.oit();
+		oit.shader().setUniform(oit.drawIDUniform(), -1);
+		oit.begin();
+		renderer.draw(first);
+		renderer.draw(second);
+		oit.composite();
+		return window.capture();
+	};
+	glpp::Image redFirst = draw(red, blue), blueFirst = draw(blue, red);
+	ASSERT_TRUE(glpp::compare(redFirst, blueFirst).matches());
+	// Both contribute equally, and a quarter of the black background shows through
+	ASSERT_NEAR(redFirst.pixel(10, 10)[0], redFirst.pixel(10, 10)[2], 2);
+	ASSERT_NEAR(redFirst.pixel(10, 10)[0], 96, 4);
+}
+
+TEST(Headless, computePlotMatchesCpuReference){
+	glpp::Window window(64, 32, "Test");
+	if(!glpp::ComputePlot::computeSupported())
+		GTEST_SKIP() << "Compute shaders need OpenGL 4.3";
+	auto expression = glpp::PlotExpression::compile("2x^2 - 3 + sin(x) / 2");
+	glpp::ComputePlot plot(*expression, 1000, 0.05f);
+	plot.sample(-4.0, 4.0);
+	std::vector<glpp::Vertex> gpu = plot.readBack();
+	std::vector<glpp::Vertex> cpu = glpp::ComputePlot::tessellate(*expression, -4.0, 4.0, 1000, 0.025f, rgba{0.0f, 0.0f, 0.0f, 1.0f});
+	ASSERT_EQ(gpu.size(), cpu.size());
+	for(size_t i = 0; i < cpu.size(); i++) {
+		// GLSL doesn't require correctly rounded sin and pow, the tolerance is relative to the magnitude
+		float tolerance = 1e-4f * std::max(1.0f, std::abs(cpu[i].positions.y()));
+		ASSERT_NEAR(gpu[i].positions.x(), cpu[i].positions.x(), tolerance) << "vertex " << i;
+		ASSERT_NEAR(gpu[i].positions.y(), cpu[i].positions.y(), tolerance) << "vertex " << i;
+		ASSERT_EQ(gpu[i].color.a(), cpu[i].color.a());
+	}
+}
+
+TEST(Headless, nestedGpuZonesAreTimed){
+	glpp::Window window(16, 16, "Test");
+	auto&        profiler = glpp::Profiler::instance();
+	profiler.reset();
+	{
+		GLPP_PROFILE_GPU("outer");
+		window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+		{
+			GLPP_PROFILE_GPU("inner");
+			window.clear(rgba{1.0f, 1.0f, 1.0f, 1.0f});
+		}
+	}
+	profiler.frame();
+	glFinish();
+	profiler.frame();
+	ASSERT_FALSE(profiler.history().empty());
+	const auto& zones = profiler.history().front().zones;
+	ASSERT_EQ(zones.size(), 2u);
+	// Both are measured, the outer zone contains the inner one
+	ASSERT_GE(zones[1].gpu, 0.0);
+	ASSERT_GE(zones[0].gpu, zones[1].gpu);
+	profiler.reset();
+}
+
+TEST(Headless, sdfCircleCoversItsRadius){
+	glpp::Window      window(64, 64, "Test");
+	glpp::SDFRenderer shapes;
+	shapes.circle({0.0f, 0.0f}, 0.5f, {.fill = rgba{1.0f, 0.0f, 0.0f, 1.0f}, .stroke = rgba{0.0f, 1.0f, 0.0f, 1.0f}, .border = 0.1f});
+	window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+	shapes.draw(ml::mat4(1.0f), 2.0f / 64.0f);
+	glpp::Image image = window.capture();
+	// Filled in the center, the border inside the edge, nothing outside the radius
+	ASSERT_EQ(image.pixel(32, 32)[0], 255);
+	ASSERT_EQ(image.pixel(32 + 14, 32)[1], 255);
+	ASSERT_EQ(image.pixel(32 + 20, 32)[0], 0);
+	ASSERT_EQ(image.pixel(32 + 20, 32)[1], 0);
+}
+
+TEST(Headless, sdfShapesKeepThePaintersOrder){
+	glpp::Window   window(64, 64, "Test");
+	glpp::Renderer renderer;
+	glpp::Shader   shader(GLPP_RESOURCES "/scene_shaders");
+	shader.bindUniformBlock("Frame", glpp::FrameData::binding);
+	glpp::UniformBuffer<glpp::FrameData> frame(glpp::FrameData::binding);
+	frame.upload({.projection = ml::mat4(1.0f), .viewport = ml::vec4(64.0f, 64.0f, 32.0f, 0.0f)});
+	shader.use();
+	shader.setUniform(shader.uniform("drawID"), -1);
+
+	const rgba  red{1.0f, 0.0f, 0.0f, 1.0f}, green{0.0f, 1.0f, 0.0f, 1.0f}, blue{0.0f, 0.0f, 1.0f, 1.0f};
+	glpp::Mesh  square({glpp::Vertex({-0.5f, -0.5f, 0.0f}, blue, {}), glpp::Vertex({0.5f, -0.5f, 0.0f}, blue, {}),
+						glpp::Vertex({-0.5f, 0.5f, 0.0f}, blue, {}), glpp::Vertex({0.5f, 0.5f, 0.0f}, blue, {})},
+					   {0, 1, 2, 2, 1, 3});
+	glpp::SDFRenderer shapes;
+	// A large and a small circle, both centered on the square
+	const std::vector<glpp::SDFInstance> circles = {
+		{{0.0f, 0.0f}, {0.75f, 0.75f}, 0.0f, 0.0f, 0.0f, static_cast<float>(glpp::SDFShape::Circle), {}, red, red},
+		{{0.0f, 0.0f}, {0.25f, 0.25f}, 0.0f, 0.0f, 0.0f, static_cast<float>(glpp::SDFShape::Circle), {}, green, green}};
+
+	// Records the square and the circles in the given insertion order and replays them like Scene::render
+	glpp::CommandRecorder commands;
+	auto draw = [&](size_t squareOrder) {
+		commands.record(3, [&](size_t i, glpp::CommandList& list) {
+			if(i == 2)
+				list.push({glpp::SortKey::translucent(1, 0.5f, squareOrder), &square, &shader, 0u, ml::mat4(1.0f)});
+			else
+				list.push({glpp::SortKey::translucent(1, 0.5f, i + (i >= squareOrder)), nullptr, &shapes.shader(), 0u,
+						   ml::mat4(1.0f), GLenum(GL_TRIANGLE_STRIP), static_cast<int32_t>(i)});
+		});
+		shapes.clear();
+		for(const auto& packet : commands.packets()) {
+			if(packet.instance >= 0)
+				shapes.add(circles[packet.instance]);
+		}
+		size_t drawn = 0;
+		window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+		commands.replay([&](const glpp::DrawPacket& packet, size_t i) {
+			if(packet.instance < 0) {
+				renderer.draw(*packet.mesh);
+			} else if(i == 0 || commands.packets()[i - 1].instance < 0) {
+				const size_t run = commands.instanceRun(i);
+				shapes.draw(ml::mat4(1.0f), 2.0f / 64.0f, drawn, run);
+				drawn += run;
+			}
+		});
+		return window.capture();
+	};
+
+	// The square added between the circles covers the large one, but not the small one
+	glpp::Image image = draw(1);
+	ASSERT_EQ(image.pixel(32, 32)[1], 255);
+	ASSERT_EQ(image.pixel(44, 32)[2], 255);
+	ASSERT_EQ(image.pixel(52, 32)[0], 255);
+	// Added first, both circles cover the square and are drawn as one run
+	image = draw(0);
+	ASSERT_EQ(image.pixel(32, 32)[1], 255);
+	ASSERT_EQ(image.pixel(44, 32)[0], 255);
+	ASSERT_EQ(image.pixel(44, 32)[2], 0);
+}
+
+TEST(Headless, movedMeshesGetANewRevision){
+	glpp::Window window(16, 16, "Test");
+	auto         triangle = [] {
+		return glpp::Mesh({glpp::Vertex({0.0f, 0.0f, 0.0f}), glpp::Vertex({1.0f, 0.0f, 0.0f}), glpp::Vertex({0.0f, 1.0f, 0.0f})}, {0, 1, 2});
+	};
+	glpp::Mesh   source = triangle();
+	const auto   uploaded = source.revision();
+	glpp::Mesh   moved(std::move(source));
+	ASSERT_GT(moved.revision(), uploaded);
+	// Assigned, the mesh is newer than both its own and the assigned revision
+	glpp::Mesh target = triangle();
+	target.regenBuffers();
+	target.regenBuffers();
+	const auto previous = std::max(target.revision(), moved.revision());
+	target              = std::move(moved);
+	ASSERT_GT(target.revision(), previous);
+}
+
+TEST(Headless, staticMeshPoolGrowsAndRecordsCommands){
+	glpp::Window         window(64, 32, "Test");
+	glpp::StaticMeshPool pool(8, 12);
+	std::vector<glpp::Vertex> quad(4, glpp::Vertex({0.0f, 0.0f, 0.0f}));
+	std::vector<glpp::Index>  quadIndices = {0, 1, 2, 2, 1, 3};
+	const int a = pool.add(quad, quadIndices);
+	const int b = pool.add(quad, quadIndices);
+	ASSERT_EQ(pool.vertexAllocator().used(), 8);
+	// A mesh without triangles is not added and doesn't grow the pool
+	ASSERT_EQ(pool.add({}, {}), glpp::StaticMeshPool::invalid);
+	ASSERT_EQ(pool.add(quad, {}), glpp::StaticMeshPool::invalid);
+	ASSERT_EQ(pool.vertexAllocator().capacity(), 8);
+	ASSERT_EQ(pool.size(), 2);
+
+	// The third mesh doesn't fit, both buffers grow to at least double their size
+	std::vector<glpp::Vertex> hexagon(6, glpp::Vertex({0.0f, 0.0f, 0.0f}));
+	const int c = pool.add(hexagon, {0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 5});
+	ASSERT_EQ(pool.vertexAllocator().capacity(), 16);
+	ASSERT_EQ(pool.indexAllocator().capacity(), 24);
+	ASSERT_EQ(pool.size(), 3);
+
+	// A removed handle and its ranges are reused
+	pool.remove(b);
+	pool.remove(glpp::StaticMeshPool::invalid);
+	const int d = pool.add({quad.begin(), quad.begin() + 3}, {0, 1, 2});
+	ASSERT_EQ(d, b);
+
+	pool.clearCommands();
+	pool.addCommand(a);
+	pool.addCommand(c);
+	pool.addCommand(d);
+	pool.addCommand(glpp::StaticMeshPool::invalid);
+	const auto& commands = pool.commands();
+	ASSERT_EQ(commands.size(), 3);
+	// count, instanceCount, firstIndex, baseVertex, baseInstance (the handle)
+	auto expect = [](const glpp::DrawElementsIndirectCommand& command, GLuint count, GLuint firstIndex, GLint baseVertex, int handle) {
+		EXPECT_EQ(command.count, count);
+		EXPECT_EQ(command.instanceCount, 1u);
+		EXPECT_EQ(command.firstIndex, firstIndex);
+		EXPECT_EQ(command.baseVertex, baseVertex);
+		EXPECT_EQ(command.baseInstance, GLuint(handle));
+	};
+	expect(commands[0], 6, 0, 0, a);
+	expect(commands[1], 12, 12, 8, c);
+	expect(commands[2], 3, 6, 4, d);
+	window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+	pool.draw();
+}
+
+TEST(Headless, scenePassesMatchReference){
+	glpp::Window window(64, 64, "Test");
+	glpp::Shader shader(GLPP_RESOURCES "/scene_shaders");
+	shader.bindUniformBlock("Frame", glpp::FrameData::binding);
+	glpp::UniformBuffer<glpp::FrameData> frame(glpp::FrameData::binding);
+	frame.upload({.projection = ml::mat4(1.0f), .viewport = ml::vec4(64.0f, 64.0f, 32.0f, 0.0f)});
+
+	const rgba           red{1.0f, 0.0f, 0.0f, 1.0f}, green{0.0f, 1.0f, 0.0f, 1.0f}, white{1.0f, 1.0f, 1.0f, 1.0f};
+	glpp::StaticMeshPool staticMeshes;
+	staticMeshes.addCommand(staticMeshes.add({glpp::Vertex({-1.0f, -1.0f, 0.0f}, green, {}), glpp::Vertex({0.0f, -1.0f, 0.0f}, green, {}),
+											  glpp::Vertex({-1.0f, 0.0f, 0.0f}, green, {}), glpp::Vertex({0.0f, 0.0f, 0.0f}, green, {})},
+											 {0, 1, 2, 2, 1, 3}));
+	glpp::LineRenderer  lines;
+	glpp::PolylineBatch grid;
+	grid.add({{-1.0f, 0.5f}, {1.0f, 0.5f}});
+	grid.add({{0.5f, -1.0f}, {0.5f, 1.0f}});
+	glpp::SDFRenderer shapes;
+	shapes.circle({0.5f, -0.5f}, 0.25f, {.fill = red});
+
+	// The passes of Scene::render in its order: lines, static shapes, SDF shapes
+	window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+	lines.draw(grid, ml::mat4(1.0f), {.width = 2.0f, .color = white}, {64.0f, 64.0f});
+	shader.use();
+	shader.setUniform(shader.uniform("drawID"), -1);
+	staticMeshes.draw();
+	shapes.draw(ml::mat4(1.0f), 2.0f / 64.0f);
+	glpp::Image image = window.capture();
+	ASSERT_EQ(image.pixel(16, 16)[1], 255);
+	ASSERT_EQ(image.pixel(8, 48)[2], 255);
+	// The circle covers the line below it
+	ASSERT_EQ(image.pixel(48, 16)[0], 255);
+	ASSERT_EQ(image.pixel(48, 16)[1], 0);
+	ASSERT_TRUE(matchesReference(image, "scene_passes"));
+}
+
+TEST(Headless, sortingBarsMatchReference){
+	glpp::Window window(64, 64, "Test");
+	glpp::Shader shader(GLPP_RESOURCES "/scene_shaders");
+	shader.bindUniformBlock("Frame", glpp::FrameData::binding);
+	glpp::UniformBuffer<glpp::FrameData> frame(glpp::FrameData::binding);
+	// The bars start at -2.5 and are 5 units high, scaled to the whole frame like in the example
+	frame.upload({.projection = ml::scale(0.4f)});
+	shader.use();
+	shader.setUniform(shader.uniform("drawID"), -1);
+
+	std::vector<int> values = {1, 2, 3, 4};
+	SortingRenderer  bars(5, 5, values);
+	window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+	bars.draw(values);
+	glpp::Image image = window.capture();
+	// Every bar is 16 pixels wide and a quarter of the frame higher than the previous one
+	ASSERT_EQ(image.pixel(8, 8)[0], 255);
+	ASSERT_EQ(image.pixel(8, 24)[0], 0);
+	ASSERT_EQ(image.pixel(56, 60)[0], 255);
+	ASSERT_TRUE(matchesReference(image, "sorting_bars"));
+
+	// Only the heights change when the values move
+	std::swap(values[0], values[3]);
+	window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+	bars.draw(values);
+	image = window.capture();
+	ASSERT_EQ(image.pixel(8, 60)[0], 255);
+	ASSERT_EQ(image.pixel(56, 24)[0], 0);
+}
+
+TEST(Headless, cartesianPlaneMatchesReference){
+	glpp::Window         window(64, 64, "Test");
+	glpp::Font           font(GLPP_RESOURCES "/fonts/DejaVuSansMono.ttf", 16);
+	glpp::CartesianPlane plane(font, {.xMin = -2, .xMax = 2, .yMin = -2, .yMax = 2});
+	plane.plotFunction([](float x) { return x + 1.0f; }, {.width = 2.0f, .color = {1.0f, 0.0f, 0.0f, 1.0f}});
+	window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+	plane.draw({64.0f, 64.0f});
+	glpp::Image image = window.capture();
+	// 16 pixels per unit: the axes through the center, the function through (-0.5, 0.5) left of the y axis labels
+	ASSERT_EQ(image.pixel(31, 58)[0], 255);
+	ASSERT_EQ(image.pixel(58, 31)[2], 255);
+	ASSERT_EQ(image.pixel(24, 40)[0], 255);
+	ASSERT_EQ(image.pixel(24, 40)[1], 0);
+	// The label of x = 1 below the x axis
+	size_t lit = 0;
+	for(size_t y = 8; y < 28; y++)
+		for(size_t x = 42; x < 55; x++)
+			lit += image.pixel(x, y)[1] > 200;
+	ASSERT_GT(lit, 5u);
+	ASSERT_TRUE(matchesReference(image, "cartesian_plane"));
+}
+
+TEST(Headless, cartesianPlaneLabelsAppearOnceTheirFieldsArrive){
+	glpp::Window window(64, 64, "Test");
+	const auto   cache = std::filesystem::temp_directory_path() / "glpp-test-plane-fields";
+	std::filesystem::remove_all(cache);
+	glpp::Font           bitmap(GLPP_RESOURCES "/fonts/DejaVuSansMono.ttf", 16);
+	glpp::Font           fields(GLPP_RESOURCES "/fonts/DejaVuSansMono.ttf", 16, glpp::GlyphMode::DistanceField, cache);
+	glpp::CartesianPlane reference(bitmap, {.xMin = -2, .xMax = 2, .yMin = -2, .yMax = 2});
+	glpp::CartesianPlane plane(fields, {.xMin = -2, .xMax = 2, .yMin = -2, .yMax = 2});
+	reference.draw({64.0f, 64.0f});
+	plane.draw({64.0f, 64.0f});
+	// The fields are still being generated, the labels have no glyphs yet
+	ASSERT_LT(plane.labels().batch().size(), reference.labels().batch().size());
+	for(int frame = 0; frame < 1000 && fields.pending() > 0; frame++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		plane.draw({64.0f, 64.0f});
+	}
+	ASSERT_EQ(fields.pending(), 0u);
+	// Without a change of the zoom, the labels were laid out again once the fields were uploaded
+	ASSERT_EQ(plane.labels().batch().size(), reference.labels().batch().size());
+	std::filesystem::remove_all(cache);
+}
+
+TEST(Headless, programBinariesAreStoredAndRestored){
+	glpp::Window window(16, 16, "Test");
+	GLint        formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if(formats == 0)
+		GTEST_SKIP() << "The driver has no program binary formats";
+
+	const auto directory = std::filesystem::temp_directory_path() / "glpp-test-shaders";
+	std::filesystem::remove_all(directory);
+	const std::vector<glpp::ShaderStage> stages = {
+		{GL_VERTEX_SHADER, "#version 410 core\nuniform vec2 offset;\nvoid main(){ gl_Position = vec4(offset, 0.0, 1.0); }"},
+		{GL_FRAGMENT_SHADER, "#version 410 core\nout vec4 o_Color;\nvoid main(){ o_Color = vec4(1.0); }"}};
+	{
+		glpp::ShaderCache cache(directory);
+		auto              program = cache.program(stages);
+		ASSERT_TRUE(program->uniforms.contains("offset"));
+		// Shared while alive
+		ASSERT_EQ(cache.program(stages), program);
+	}
+	std::vector<std::filesystem::path> binaries;
+	for(auto& entry: std::filesystem::directory_iterator(directory))
+		binaries.push_back(entry.path());
+	ASSERT_EQ(binaries.size(), 1u);
+	const auto written = std::filesystem::last_write_time(binaries[0]);
+
+	// A new cache, as in the next run, links the stored binary instead of compiling and storing it again
+	glpp::ShaderCache cache(directory);
+	auto              program = cache.program(stages);
+	GLint             linked  = GL_FALSE;
+	glGetProgramiv(program->id, GL_LINK_STATUS, &linked);
+	ASSERT_EQ(linked, GL_TRUE);
+	ASSERT_TRUE(program->uniforms.contains("offset"));
+	ASSERT_EQ(std::filesystem::last_write_time(binaries[0]), written);
+	std::filesystem::remove_all(directory);
+}
+
+TEST(Headless, atlasPaddingRepeatsTheImageEdge){
+	glpp::Window       window(16, 16, "Test");
+	glpp::TextureAtlas atlas(8, 1, GL_R8, 1);
+	// Fills the whole layer with its padding, the next image evicts it
+	const std::vector<unsigned char> full(6 * 6, 255);
+	ASSERT_TRUE(atlas.add(1, 6, 6, full.data()));
+	const std::vector<unsigned char> image = {10, 20, 30, 40};
+	atlas.beginFrame();
+	auto entry = atlas.add(2, 2, 2, image.data());
+	ASSERT_TRUE(entry);
+
+	std::vector<unsigned char> texels(8 * 8);
+	atlas.bind();
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+	auto texel = [&](int x, int y) { return texels[size_t(entry->rect.y + y) * 8 + entry->rect.x + x]; };
+	// The corners and edges of the padding repeat the nearest texel of the image, nothing of the evicted one is left
+	ASSERT_EQ(texel(-1, -1), 10);
+	ASSERT_EQ(texel(1, -1), 20);
+	ASSERT_EQ(texel(-1, 1), 30);
+	ASSERT_EQ(texel(2, 2), 40);
+	ASSERT_EQ(texel(0, 0), 10);
+}
+
+TEST(Headless, textRendersGlyphQuadsOfTheAtlas){
+	glpp::Window       window(64, 32, "Test");
+	glpp::Font         font(GLPP_RESOURCES "/fonts/DejaVuSansMono.ttf", 16);
+	glpp::TextBatch    batch(font);
+	glpp::TextRenderer renderer;
+	// One world unit per pixel, the origin at the bottom left
+	const ml::mat4 pixels = ml::translate(ml::vec3(-1.0f, -1.0f, 0.0f)) * ml::scale(ml::vec3(2.0f / 64.0f, 2.0f / 32.0f, 1.0f));
+	const ml::vec2 pen    = batch.add("Hi", {4.0f, 10.0f}, 1.0f, rgba{1.0f, 1.0f, 1.0f, 1.0f});
+	ASSERT_EQ(batch.size(), 2u);
+	// Monospaced, both glyphs advance the same
+	ASSERT_FLOAT_EQ(pen.x(), 4.0f + 2.0f * font.glyph('H').advance);
+	ASSERT_FLOAT_EQ(pen.y(), 10.0f);
+	ASSERT_FLOAT_EQ(batch.measure("Hi", 1.0f).x(), pen.x() - 4.0f);
+
+	window.clear(rgba{0.0f, 0.0f, 0.0f, 1.0f});
+	renderer.draw(batch, pixels);
+	glpp::Image image = window.capture();
+	// Lit inside the pen's span above the baseline, nothing left of the text nor far below the baseline
+	size_t lit = 0;
+	for(size_t y = 0; y < image.height; y++) {
+		for(size_t x = 0; x < image.width; x++) {
+			if(image.pixel(x, y)[0] < 128)
+				continue;
+			lit++;
+			ASSERT_GE(x, 4u) << x << ", " << y;
+			ASSERT_LE(x, static_cast<size_t>(pen.x()) + 1) << x << ", " << y;
+			ASSERT_GE(y, 9u) << x << ", " << y;
+		}
+	}
+	ASSERT_GT(lit, 20u);
+}
+
+TEST(Headless, corruptGlyphCachesAreStale){
+	glpp::Window window(16, 16, "Test");
+	const auto   directory = std::filesystem::temp_directory_path() / "glpp-test-glyphs";
+	const auto   fontPath  = GLPP_RESOURCES "/fonts/DejaVuSansMono.ttf";
+	std::filesystem::remove_all(directory);
+	auto generate = [&](glpp::Font& font) {
+		font.glyph('A');
+		while(font.pending() > 0)
+			font.beginFrame();
+	};
+	{
+		glpp::Font font(fontPath, 16, glpp::GlyphMode::DistanceField, directory);
+		generate(font);
+	}
+	std::vector<std::filesystem::path> caches;
+	for(auto& entry: std::filesystem::directory_iterator(directory))
+		caches.push_back(entry.path());
+	ASSERT_EQ(caches.size(), 1u);
+	{
+		// Stored fields are used without generating them again
+		glpp::Font font(fontPath, 16, glpp::GlyphMode::DistanceField, directory);
+		font.glyph('A');
+		ASSERT_EQ(font.pending(), 0u);
+	}
+
+	// A width far beyond the atlas, as a flipped bit would give, is not allocated
+	{
+		std::fstream file(caches[0], std::ios::binary | std::ios::in | std::ios::out);
+		const float  width = 1e30f;
+		file.seekp(3 * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(&width), sizeof(width));
+	}
+	{
+		glpp::Font font(fontPath, 16, glpp::GlyphMode::DistanceField, directory);
+		font.glyph('A');
+		ASSERT_EQ(font.pending(), 1u);
+		generate(font);
+	}
+	std::filesystem::remove_all(directory);
+}
+
+TEST(Headless, textCacheKeepsLayoutsBetweenFrames){
+	glpp::Window    window(16, 16, "Test");
+	glpp::Font      font(GLPP_RESOURCES "/fonts/DejaVuSansMono.ttf", 16);
+	glpp::TextCache cache(4);
+	const glpp::TextLayout& label = cache.get(font, "label");
+	ASSERT_EQ(cache.builds(), 1u);
+	ASSERT_EQ(label.glyphs.size(), 5u);
+	ASSERT_EQ(&cache.get(font, "label"), &label);
+	ASSERT_EQ(cache.builds(), 1u);
+
+	// Only the digits after the shared prefix are laid out again, the kept glyphs don't move
+	const glpp::TextLayout& counter = cache.update(1, font, "frame 99");
+	const ml::vec4          first   = counter.glyphs[0].rect;
+	cache.update(1, font, "frame 100");
+	ASSERT_EQ(cache.builds(), 3u);
+	ASSERT_EQ(counter.glyphs.size(), 8u);
+	ASSERT_EQ(counter.glyphs[0].rect, first);
+	ASSERT_FLOAT_EQ(counter.pen.x(), 9.0f * font.glyph('0').advance);
+	cache.update(1, font, "frame 100");
+	ASSERT_EQ(cache.builds(), 3u);
+	ASSERT_EQ(cache.size(), 2u);
+
+	// Used every frame the counter is kept, the label is swept once unused for longer than maxAge
+	for(int frame = 0; frame < 8; frame++) {
+		cache.beginFrame();
+		cache.update(1, font, "frame 100");
+	}
+	ASSERT_EQ(cache.size(), 1u);
+	ASSERT_EQ(cache.builds(), 3u);
+}
+
+TEST(Headless, axisLabelsAreLaidOutAtEveryTick){
+	glpp::Window window(64, 32, "Test");
+	glpp::Font   font(GLPP_RESOURCES "/fonts/DejaVuSansMono.ttf", 16);
+	AxisLabels   labels(font);
+	labels.build({.xMin = -2, .xMax = 2, .yMin = -1, .yMax = 1}, 1.0, 1.0, 16.0f);
+	// -2 -1 1 2 along x, -1 0 1 along y, the origin is only labeled once
+	ASSERT_EQ(labels.batch().size(), 6u + 4u);
+	// Zooming reuses the layouts, only their placement changes
+	const size_t builds = labels.layouts().builds();
+	labels.build({.xMin = -2, .xMax = 2, .yMin = -1, .yMax = 1}, 1.0, 1.0, 32.0f);
+	ASSERT_EQ(labels.layouts().builds(), builds);
+	// Too dense to read, the x axis has no labels at all
+	labels.build({.xMin = -1e6, .xMax = 1e6, .yMin = -1, .yMax = 1}, 1.0, 1.0, 16.0f);
+	ASSERT_EQ(labels.batch().size(), 4u);
+	ASSERT_EQ(AxisLabels::format(0.1 + 0.2, 0.1), "0.3");
+	ASSERT_EQ(AxisLabels::format(1e-17, 0.1), "0");
+}
+
+TEST(Headless, virtualTextureReadsFeedbackOnceItsFenceSignaled){
+	glpp::Window window(64, 64, "Test");
+	const auto   path = std::filesystem::temp_directory_path() / "glpp-test-headless.vtx";
+	ASSERT_TRUE(glpp::TiledDataset::write(path, 256, 256, [](uint32_t x, uint32_t y) { return float(x + y); }, 64));
+	{
+		glpp::VirtualTexture texture(path, 256);
+		auto                 frame = [&] {
+			texture.update();
+			texture.draw(ml::mat4(1.0f), {-1.0f, -1.0f, 2.0f, 2.0f}, 0.0f, 512.0f);
+		};
+		// The feedback of a frame is read two frames later, only after its draws finished
+		frame();
+		frame();
+		ASSERT_EQ(texture.cache().residentCount(), 0u);
+		glFinish();
+		texture.update();
+		texture.cache().finish();
+		texture.update();
+		ASSERT_GT(texture.cache().residentCount(), 0u);
+	}
+	std::filesystem::remove(path);
+}
+
+TEST(Headless, texturesLoadAsynchronouslyBehindThePlaceholder){
+	glpp::Window        window(64, 32, "Test");
+	glpp::TextureLoader loader;
+	int                 callbacks = 0;
+	auto grid    = loader.load(GLPP_RESOURCES "/default/textures/grid.png", true, [&](glpp::AsyncTexture&) { callbacks++; });
+	auto missing = loader.load(GLPP_RESOURCES "/missing.png", true, [&](glpp::AsyncTexture&) { callbacks++; });
+	ASSERT_EQ(grid->id(), loader.placeholder());
+	while(loader.busy())
+		loader.update();
+	ASSERT_TRUE(grid->ready());
+	ASSERT_NE(grid->id(), loader.placeholder());
+	ASSERT_GT(grid->width(), 0);
+	// Images that fail to load keep the placeholder
+	ASSERT_EQ(missing->state(), glpp::AsyncTexture::State::Failed);
+	ASSERT_EQ(missing->id(), loader.placeholder());
+	ASSERT_EQ(callbacks, 2);
+}
+#endif
+
+TEST(TripleBuffer, consumerSeesIncreasingValues){
+	glpp::TripleBuffer<std::array<int, 64>> buffer;
+	constexpr int count = 100000;
+	std::thread producer([&buffer]() {
+		for(int i = 1; i <= count; i++) {
+			// Fill the whole slot, such that a torn read would show mixed values
+			buffer.writeSlot().fill(i);
+			buffer.publish();
+		}
+	});
+	// Failures only stop consuming, asserting here would return before joining the producer
+	int  last    = 0;
+	bool ordered = true;
+	while(last != count && ordered) {
+		if(!buffer.update())
+			continue;
+		auto& values = buffer.readSlot();
+		EXPECT_GT(values[0], last);
+		EXPECT_EQ(values[0], values[63]);
+		ordered = values[0] > last && values[0] == values[63];
+		last    = values[0];
+	}
+	producer.join();
+}
+
+TEST(RadixSort, matchesStableSort){
+	std::mt19937 random(7);
+	// Few distinct keys, such that stability matters, spread over all bytes of the key
+	std::uniform_int_distribution<int> byte(0, 3);
+	std::vector<std::pair<uint64_t, size_t>> values;
+	for(size_t i = 0; i < 5000; i++)
+		values.emplace_back(uint64_t(byte(random)) << 56 | uint64_t(byte(random)) << 8 | byte(random), i);
+	auto expected = values;
+	std::stable_sort(expected.begin(), expected.end(), [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
+
+	std::vector<std::pair<uint64_t, size_t>> scratch;
+	glpp::radixSort(values, scratch, [](auto& value) { return value.first; });
+	ASSERT_EQ(values, expected);
+}
+
+TEST(ThreadPool, parallelForVisitsEveryIndexOnce){
+	glpp::ThreadPool pool(3);
+	std::vector<std::atomic<int>> visits(10000);
+	pool.parallelFor(visits.size(), [&visits](size_t begin, size_t end) {
+		for(size_t i = begin; i < end; i++)
+			visits[i]++;
+	}, 100);
+	for(auto& count: visits)
+		ASSERT_EQ(count, 1);
+}
+
+TEST(SortKey, ordersOpaqueFrontToBackThenTranslucentBackToFront){
+	using glpp::SortKey;
+	// Opaque draws come first and are grouped by shader before depth
+	ASSERT_LT(SortKey::opaque(0, 1, 9, 0.9f), SortKey::opaque(0, 2, 0, 0.1f));
+	ASSERT_LT(SortKey::opaque(0, 1, 1, 0.1f), SortKey::opaque(0, 1, 1, 0.9f));
+	ASSERT_LT(SortKey::opaque(0, 4095, 4095, 1.0f), SortKey::translucent(0, 1.0f, 0));
+	// Translucent draws are sorted far to near, and keep their sequence at the same depth
+	ASSERT_LT(SortKey::translucent(0, 0.9f, 5), SortKey::translucent(0, 0.1f, 0));
+	ASSERT_LT(SortKey::translucent(0, 0.5f, 1), SortKey::translucent(0, 0.5f, 2));
+	// The layer decides before anything else
+	ASSERT_LT(SortKey::translucent(0, 0.0f, 0), SortKey::opaque(1, 0, 0, 0.0f));
+	ASSERT_TRUE(SortKey::isTranslucent(SortKey::translucent(3, 0.5f, 7)));
+	ASSERT_EQ(SortKey::layer(SortKey::translucent(3, 0.5f, 7)), 3);
+}
+
+TEST(PolylineBatch, appendsNeighboursForAdjacency){
+	std::vector<ml::vec2> points = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}};
+	std::vector<float>    open, closed;
+	// Open polylines repeat their end points, which marks the caps
+	ASSERT_EQ(glpp::PolylineBatch::appendAdjacency(points, false, open), 5);
+	ASSERT_EQ(open, (std::vector<float>{0, 0, 0, 0, 1, 0, 1, 1, 1, 1}));
+	// Closed ones wrap around, such that 3 segments are drawn from 6 points
+	ASSERT_EQ(glpp::PolylineBatch::appendAdjacency(points, true, closed), 6);
+	ASSERT_EQ(closed, (std::vector<float>{1, 1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 0}));
+	ASSERT_EQ(glpp::PolylineBatch::appendAdjacency({{0.0f, 0.0f}}, false, open), 0);
+}
+
+TEST(ShaderCache, hashesStagesIndependentOfOrder){
+	using glpp::ShaderCache;
+	std::vector<glpp::ShaderStage> stages = {{GL_VERTEX_SHADER, "void main(){}"}, {GL_FRAGMENT_SHADER, "out vec4 c; void main(){}"}};
+	std::vector<glpp::ShaderStage> reversed(stages.rbegin(), stages.rend());
+	ASSERT_EQ(ShaderCache::hash(stages), ShaderCache::hash(reversed));
+	// The same source as another stage type is a different program
+	std::vector<glpp::ShaderStage> swapped = {{GL_VERTEX_SHADER, stages[1].source}, {GL_FRAGMENT_SHADER, stages[0].source}};
+	ASSERT_NE(ShaderCache::hash(stages), ShaderCache::hash(swapped));
+	stages[1].source += " ";
+	ASSERT_NE(ShaderCache::hash(stages), ShaderCache::hash(reversed));
+}
+
+TEST(SkylinePacker, packsWithoutOverlapUntilFull){
+	glpp::SkylinePacker          packer(256, 256);
+	std::vector<glpp::AtlasRect> packed;
+	std::mt19937                 random(7);
+	std::uniform_int_distribution<int> size(4, 40);
+	while(auto rect = packer.pack(size(random), size(random))) {
+		ASSERT_GE(rect->x, 0);
+		ASSERT_GE(rect->y, 0);
+		ASSERT_LE(rect->x + rect->width, 256);
+		ASSERT_LE(rect->y + rect->height, 256);
+		for(auto& other: packed) {
+			bool separate = rect->x + rect->width <= other.x || other.x + other.width <= rect->x ||
+							rect->y + rect->height <= other.y || other.y + other.height <= rect->y;
+			ASSERT_TRUE(separate);
+		}
+		packed.push_back(*rect);
+	}
+	// Random sizes still fill most of the area before the first rejection
+	ASSERT_GT(packer.occupancy(), 0.6f);
+	packer.clear();
+	ASSERT_TRUE(packer.pack(256, 256).has_value());
+	ASSERT_FALSE(packer.pack(1, 1).has_value());
+}
+
+TEST(Font, decodesUtf8AndReplacesInvalidBytes){
+	const std::string     text = "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xFF\xE2\x82";
+	std::vector<char32_t> decoded;
+	for(size_t i = 0; i < text.size();)
+		decoded.push_back(glpp::Font::nextCodepoint(text, i));
+	ASSERT_EQ(decoded, (std::vector<char32_t>{U'a', 0xE9, 0x20AC, 0x1F600, 0xFFFD, 0xFFFD, 0xFFFD}));
+}
+
+TEST(Font, distanceFieldIsHalfOnTheOutline){
+	// An 8x8 square in a 12x12 bitmap, grown by a spread of 4
+	std::vector<unsigned char> coverage(12 * 12, 0);
+	for(int y = 2; y < 10; y++)
+		for(int x = 2; x < 10; x++)
+			coverage[size_t(y) * 12 + size_t(x)] = 255;
+	const auto field = glpp::distanceField(coverage.data(), 12, 12, 4);
+	ASSERT_EQ(field.size(), 20u * 20u);
+	auto at = [&](int x, int y) { return int(field[size_t(y + 4) * 20 + size_t(x + 4)]); };
+	// Pixels next to the edge straddle 127, the center is 3.5 pixels inside, the corner more than a spread outside
+	ASSERT_GT(at(2, 5), 127);
+	ASSERT_LT(at(1, 5), 127);
+	ASSERT_EQ(at(5, 5), at(6, 6));
+	ASSERT_EQ(at(5, 5), int(std::lround((0.5f + 3.5f / 8.0f) * 255.0f)));
+	ASSERT_EQ(field[0], 0);
+	// Within the spread distances rise towards the center
+	for(int x = -2; x < 5; x++)
+		ASSERT_LT(at(x, 5), at(x + 1, 5));
+}
+
+TEST(MeshFile, mapsWhatWasWritten){
+	const auto path = std::filesystem::temp_directory_path() / "glpp-test.mesh";
+	std::vector<glpp::MeshData> meshes(2);
+	for(int i = 0; i < 5; i++) {
+		meshes[0].vertices.emplace_back(ml::vec3(float(i), 1.0f, -float(i)));
+		meshes[0].bounds.expand(meshes[0].vertices.back().positions);
+	}
+	meshes[0].indices  = {0, 1, 2, 2, 3, 4};
+	meshes[0].material = 1;
+	meshes[1].vertices.emplace_back(ml::vec3(7.0f, 7.0f, 7.0f));
+	meshes[1].indices = {0, 0, 0};
+	std::vector<glpp::MeshMaterial> materials = {{"", ""}, {"diffuse.png", "specular.png"}};
+	ASSERT_TRUE(glpp::MeshFile::write(path, meshes, materials, 1234, 5678));
+
+	glpp::MeshFile file(path, 1234, 5678);
+	ASSERT_TRUE(file.valid());
+	ASSERT_EQ(file.meshes(), 2u);
+	ASSERT_EQ(file.materials()[1].specular, "specular.png");
+	ASSERT_EQ(file.material(0), 1);
+	ASSERT_EQ(file.vertices(0).size(), 5u);
+	ASSERT_EQ(file.vertices(0)[3].positions.x(), 3.0f);
+	ASSERT_EQ(file.vertices(1)[0].positions.z(), 7.0f);
+	ASSERT_TRUE(std::equal(file.indices(0).begin(), file.indices(0).end(), meshes[0].indices.begin(), meshes[0].indices.end()));
+	ASSERT_EQ(file.bounds(0).max.x(), 4.0f);
+	ASSERT_EQ(file.bounds(0).min.z(), -4.0f);
+	// A changed source invalidates the file
+	ASSERT_FALSE(glpp::MeshFile(path, 1234, 5679).valid());
+	std::filesystem::remove(path);
+}
+
+TEST(MeshOptimizer, weldsAndReordersWithoutChangingTriangles){
+	// A grid of quads that each have their own corners, with the triangles shuffled
+	constexpr int             size = 32;
+	std::vector<glpp::Vertex> vertices;
+	std::vector<glpp::Index>  indices;
+	for(int y = 0; y < size; y++) {
+		for(int x = 0; x < size; x++) {
+			const auto first = static_cast<glpp::Index>(vertices.size());
+			for(int corner = 0; corner < 4; corner++)
+				vertices.emplace_back(ml::vec3(float(x + corner % 2), float(y + corner / 2), 0.0f));
+			indices.insert(indices.end(), {first, first + 1, first + 2, first + 2, first + 1, first + 3});
+		}
+	}
+	std::vector<size_t> shuffle(indices.size() / 3);
+	std::iota(shuffle.begin(), shuffle.end(), 0);
+	std::shuffle(shuffle.begin(), shuffle.end(), std::mt19937(7));
+	std::vector<glpp::Index> shuffled;
+	for(size_t triangle: shuffle)
+		shuffled.insert(shuffled.end(), indices.begin() + triangle * 3, indices.begin() + triangle * 3 + 3);
+
+	// Triangles as their corner positions, rotated to start at the smallest corner to ignore where they start
+	auto triangles = [](const std::vector<glpp::Vertex>& vertices, const std::vector<glpp::Index>& indices) {
+		std::multiset<std::array<std::array<float, 3>, 3>> set;
+		for(size_t i = 0; i < indices.size(); i += 3) {
+			std::array<std::array<float, 3>, 3> corners;
+			for(size_t corner = 0; corner < 3; corner++) {
+				const auto& position = vertices[indices[i + corner]].positions;
+				corners[corner]      = {position.x(), position.y(), position.z()};
+			}
+			std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+			set.insert(corners);
+		}
+		return set;
+	};
+	const float before = glpp::acmr(shuffled, vertices.size());
+	auto        welded        = vertices;
+	auto        weldedIndices = shuffled;
+	ASSERT_EQ(glpp::weldVertices(welded, weldedIndices), vertices.size() - (size + 1) * (size + 1));
+	const float weldedBefore = glpp::acmr(weldedIndices, welded.size());
+	const auto  expected     = triangles(welded, weldedIndices);
+
+	glpp::optimizeMesh(vertices, shuffled);
+	ASSERT_EQ(vertices.size(), size_t(size + 1) * (size + 1));
+	ASSERT_EQ(triangles(vertices, shuffled), expected);
+	const float after = glpp::acmr(shuffled, vertices.size());
+	ASSERT_LT(after, weldedBefore);
+	ASSERT_LT(after, before);
+	ASSERT_LT(after, 1.0f);
+}
+
+TEST(BlockCompression, blocksDecodeCloseToTheirSource){
+	// A gradient with some noise, the colors lie close to a line like in most blocks of photos
+	glpp::BlockCompression::Pixels pixels;
+	for(int p = 0; p < 16; p++) {
+		const int t       = (p % 4) * 12 + (p / 4) * 3 + (p * 7) % 5;
+		pixels[p * 4]     = uint8_t(40 + t * 2);
+		pixels[p * 4 + 1] = uint8_t(200 - t);
+		pixels[p * 4 + 2] = uint8_t(60 + t);
+		pixels[p * 4 + 3] = uint8_t(255 - t * 3);
+	}
+	auto error = [&](glpp::BlockFormat format, int channels) {
+		uint8_t                        block[16];
+		glpp::BlockCompression::Pixels decoded;
+		glpp::BlockCompression::encodeBlock(format, pixels, block);
+		glpp::BlockCompression::decodeBlock(format, block, decoded);
+		int largest = 0;
+		for(int p = 0; p < 16; p++)
+			for(int c = 0; c < channels; c++)
+				largest = std::max(largest, std::abs(int(pixels[p * 4 + c]) - int(decoded[p * 4 + c])));
+		return largest;
+	};
+	// 4 levels for BC1, 8 for BC4 and 16 for BC7 over the range of the block
+	ASSERT_LE(error(glpp::BlockFormat::BC1, 3), 20);
+	ASSERT_LE(error(glpp::BlockFormat::BC3, 4), 20);
+	ASSERT_LE(error(glpp::BlockFormat::BC4, 1), 10);
+	ASSERT_LE(error(glpp::BlockFormat::BC5, 2), 10);
+	ASSERT_LE(error(glpp::BlockFormat::BC7, 4), 6);
+}
+
+TEST(BlockCompression, bc7KeepsAlphaThatDoesNotFollowTheColor){
+	// A cutout over a gradient, no line through RGBA passes close to both
+	glpp::BlockCompression::Pixels pixels;
+	for(int p = 0; p < 16; p++) {
+		pixels[p * 4]     = uint8_t(20 + p * 12);
+		pixels[p * 4 + 1] = uint8_t(100 + p * 4);
+		pixels[p * 4 + 2] = uint8_t(200 - p * 8);
+		pixels[p * 4 + 3] = (p % 4 + p / 4) % 2 ? 255 : 0;
+	}
+	uint8_t                        block[16];
+	glpp::BlockCompression::Pixels decoded;
+	glpp::BlockCompression::encodeBlock(glpp::BlockFormat::BC7, pixels, block);
+	glpp::BlockCompression::decodeBlock(glpp::BlockFormat::BC7, block, decoded);
+	// Mode 5, which has a separate line for alpha
+	ASSERT_EQ(std::countr_zero(block[0]), 5);
+	for(int p = 0; p < 16; p++) {
+		ASSERT_EQ(decoded[p * 4 + 3], pixels[p * 4 + 3]) << p;
+		for(int c = 0; c < 3; c++)
+			ASSERT_LE(std::abs(int(pixels[p * 4 + c]) - int(decoded[p * 4 + c])), 40) << p;
+	}
+}
+
+TEST(BlockCompression, imagesWithAlphaDefaultToBC7){
+	// Grey + alpha keeps its alpha as well, stb_image expands it to RGBA
+	ASSERT_EQ(glpp::BlockCompression::defaultFormat(2), glpp::BlockFormat::BC7);
+	ASSERT_EQ(glpp::BlockCompression::defaultFormat(4), glpp::BlockFormat::BC7);
+	ASSERT_EQ(glpp::BlockCompression::defaultFormat(1), glpp::BlockFormat::BC1);
+	ASSERT_EQ(glpp::BlockCompression::defaultFormat(3), glpp::BlockFormat::BC1);
+}
+
+TEST(TextureFile, mapsTheWrittenLevels){
+	const auto           path = std::filesystem::temp_directory_path() / "glpp-test.gltex";
+	std::vector<uint8_t> image(6 * 5 * 4, 128);
+	std::vector<std::vector<uint8_t>> levels;
+	levels.push_back(glpp::BlockCompression::compress(glpp::BlockFormat::BC1, image.data(), 6, 5));
+	image = glpp::BlockCompression::downsample(image.data(), 6, 5);
+	levels.push_back(glpp::BlockCompression::compress(glpp::BlockFormat::BC1, image.data(), 3, 2));
+	ASSERT_EQ(levels[0].size(), 2u * 2u * 8u);
+	ASSERT_TRUE(glpp::TextureFile::write(path, glpp::BlockFormat::BC1, 6, 5, levels));
+
+	glpp::TextureFile file(path);
+	ASSERT_TRUE(file.valid());
+	ASSERT_EQ(file.format(), glpp::BlockFormat::BC1);
+	ASSERT_EQ(file.levels(), 2u);
+	ASSERT_EQ(file.level(1).width, 3u);
+	ASSERT_EQ(file.level(1).height, 2u);
+	ASSERT_TRUE(std::equal(file.data(1).begin(), file.data(1).end(), levels[1].begin(), levels[1].end()));
+	std::filesystem::remove(path);
+}
+
+TEST(VirtualTexture, streamsTheLevelOfTheViewAndFallsBackToCoarserPages){
+	const auto path = std::filesystem::temp_directory_path() / "glpp-test.vtx";
+	// 5 levels of 64 sample pages, the last one a single page
+	auto sample = [](uint32_t x, uint32_t y) { return float(x) + float(y) * 0.5f; };
+	ASSERT_TRUE(glpp::TiledDataset::write(path, 1000, 700, sample, 64));
+	glpp::TiledDataset dataset(path);
+	ASSERT_TRUE(dataset.valid());
+	ASSERT_EQ(dataset.levels(), 5u);
+	ASSERT_EQ(dataset.pagesX(0), 16u);
+	ASSERT_EQ(dataset.pagesY(1), 6u);
+	ASSERT_EQ(dataset.page(dataset.pageIndex(0, 2, 1))[3 * 64 + 5], sample(2 * 64 + 5, 64 + 3));
+
+	glpp::SoftwareVirtualTexture texture(dataset, 4);
+	auto                         stream = [&] {
+		texture.update();
+		texture.cache().finish();
+		texture.update();
+	};
+	// The whole dataset over 100x70 pixels samples level 3, nothing is resident before streaming
+	auto pixels = texture.draw(100, 70, {0.0f, 0.0f}, {1.0f, 1.0f});
+	ASSERT_TRUE(std::isnan(pixels[0]));
+	stream();
+	pixels = texture.draw(100, 70, {0.0f, 0.0f}, {1.0f, 1.0f});
+	// Pixel (10, 20) covers level 3 sample (13, 25), the mean of an 8x8 block of the finest level
+	ASSERT_NEAR(pixels[20 * 100 + 10], sample(13 * 8, 25 * 8) + 3.5f + 3.5f * 0.5f, 1e-3f);
+
+	// Zoomed in past a sample per pixel the finest level is wanted, the resident coarser pages are shown until it is loaded
+	const ml::vec2 from(0.25f, 0.5f), to(0.3f, 0.55f);
+	pixels = texture.draw(100, 70, from, to);
+	ASSERT_FALSE(std::isnan(pixels[0]));
+	ASSERT_NE(pixels[0], sample(250, 350));
+	stream();
+	pixels = texture.draw(100, 70, from, to);
+	ASSERT_FLOAT_EQ(pixels[0], sample(250, 350));
+	const float u = from.x() + 99.5f * (0.05f / 100.0f), v = from.y() + 69.5f * (0.05f / 70.0f);
+	ASSERT_FLOAT_EQ(pixels[69 * 100 + 99], sample(dataset.texel(0, u, false), dataset.texel(0, v, true)));
+	ASSERT_LE(texture.cache().residentCount(), texture.cache().slots());
+	ASSERT_TRUE(texture.cache().resident(dataset.pageCount() - 1));
+	std::filesystem::remove(path);
+}
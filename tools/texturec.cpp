@@ -0,0 +1,92 @@
+/**
+ * Offline texture compressor
+ * Generates the mipmaps of an image and compresses them into a texture file that Texture uploads as is.
+ *
+ * usage: texturec <image> [output.gltex] [--format bc1|bc3|bc4|bc5|bc7] [--no-mipmaps] [--no-flip]
+ * Images with an alpha channel (grey + alpha or RGBA) default to BC7, others to BC1. Use BC5 for normal maps and BC4 for single channel maps.
+ * BC7 is written in modes 5 and 6 only, which keep alpha apart from the color but don't partition blocks,
+ * so blocks of several unrelated colors lose detail; use a dedicated compressor for such textures.
+ */
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "graphics/blockcompression.h"
+#include "graphics/texturefile.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+	using namespace glpp;
+	const std::map<std::string, BlockFormat> formats = {
+		{"bc1", BlockFormat::BC1}, {"bc3", BlockFormat::BC3}, {"bc4", BlockFormat::BC4}, {"bc5", BlockFormat::BC5}, {"bc7", BlockFormat::BC7}};
+
+	std::filesystem::path input, output;
+	const BlockFormat*    format  = nullptr;
+	bool                  mipmaps = true, flip = true;
+	for(int i = 1; i < argc; i++) {
+		if(std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+			auto it = formats.find(argv[++i]);
+			if(it == formats.end()) {
+				std::cerr << "Unknown format: " << argv[i] << std::endl;
+				return 1;
+			}
+			format = &it->second;
+		} else if(std::strcmp(argv[i], "--no-mipmaps") == 0) {
+			mipmaps = false;
+		} else if(std::strcmp(argv[i], "--no-flip") == 0) {
+			flip = false;
+		} else if(input.empty()) {
+			input = argv[i];
+		} else {
+			output = argv[i];
+		}
+	}
+	if(input.empty()) {
+		std::cerr << "usage: texturec <image> [output" << TextureFile::extension << "] [--format bc1|bc3|bc4|bc5|bc7] [--no-mipmaps] [--no-flip]"
+				  << std::endl
+				  << "Images with alpha default to bc7, others to bc1. bc7 is written in modes 5 and 6 only, which keep alpha\n"
+				  << "apart from the color but don't partition blocks, blocks of several unrelated colors lose detail." << std::endl;
+		return 1;
+	}
+	if(output.empty())
+		output = std::filesystem::path(input).replace_extension(TextureFile::extension);
+
+	const auto start    = std::chrono::steady_clock::now();
+	int        width    = 0, height = 0, channels = 0;
+	// Flipped like Texture flips images when loading them
+	stbi_set_flip_vertically_on_load(flip);
+	unsigned char* pixels = stbi_load(input.string().c_str(), &width, &height, &channels, 4);
+	if(!pixels) {
+		std::cerr << "Failed to load " << input << ": " << stbi_failure_reason() << std::endl;
+		return 1;
+	}
+	const BlockFormat chosen = format ? *format : BlockCompression::defaultFormat(channels);
+
+	std::vector<std::vector<uint8_t>> levels;
+	std::vector<uint8_t>              level(pixels, pixels + size_t(width) * size_t(height) * 4);
+	stbi_image_free(pixels);
+	size_t uncompressed = 0;
+	for(int w = width, h = height;; w = std::max(w / 2, 1), h = std::max(h / 2, 1)) {
+		levels.push_back(BlockCompression::compress(chosen, level.data(), w, h));
+		uncompressed += level.size();
+		if(!mipmaps || (w == 1 && h == 1))
+			break;
+		level = BlockCompression::downsample(level.data(), w, h);
+	}
+	if(!TextureFile::write(output, chosen, width, height, levels))
+		return 1;
+
+	size_t compressed = 0;
+	for(const auto& data: levels)
+		compressed += data.size();
+	const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	std::cout << output.string() << ": " << width << "x" << height << ", " << levels.size() << " levels, " << compressed << " bytes ("
+			  << uncompressed / std::max<size_t>(compressed, 1) << "x smaller than RGBA8) in " << milliseconds << " ms" << std::endl;
+	return 0;
+}